@@ -14,6 +14,9 @@ public class HoverTest : ModuleRules
 
         PublicDependencyModuleNames.AddRange(new string[] { "ShaderCore", "RenderCore", "RHI", "RuntimeMeshComponent" });
 
+        // heightfield collision of the terrain tiles uses the physics engine directly
+        PrivateDependencyModuleNames.AddRange(new string[] { "PhysX", "APEX" });
+
         // Uncomment if you are using Slate UI
         // PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
 
@@ -5,6 +5,8 @@
 #include "Classes/Engine/World.h"
 #include "Hovercraft.h"
 
+DECLARE_CYCLE_STAT(TEXT("Hover Sweep"), STAT_HoverSweep, STATGROUP_HoverTest);
+
 
 // Sets default values for this component's properties
 UHoverComponent::UHoverComponent()
@@ -119,13 +121,18 @@ void UHoverComponent::Hover()
 
 
 
-	if (GetWorld()->SweepSingleByChannel(HitResult, StartLocation, EndLocation, GetOwner()->GetActorRotation().Quaternion(), ECollisionChannel::ECC_Visibility, CollisionShape, CollisionParams))
+	bool bHit = false;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_HoverSweep);
+		bHit = GetWorld()->SweepSingleByChannel(HitResult, StartLocation, EndLocation, GetOwner()->GetActorRotation().Quaternion(), ECollisionChannel::ECC_Visibility, CollisionShape, CollisionParams);
+	}
+	if (bHit)
 	{
 		AHovercraft* Craft = Cast<AHovercraft>(GetOwner());
 		if (Craft)
 		{
 			// player character
-			//FVector ForceToApply = HitResult.ImpactNormal * Craft->GetHovercraftMass() * 981;	//9.81 m/s
+			//FVector ForceToApply = HitResult.ImpactNormal * Craft->GetHovercraftMass() * 981;	//9.81 m/s²
 			//StaticMesh->AddForce(ForceToApply);
 			/*float Ratio = HitResult.Distance / HoverHeight;
 			FVector ForceToApply = FMath::Lerp<float>(HoverForceMaxStrength, 0, Ratio) * HitResult.ImpactNormal;
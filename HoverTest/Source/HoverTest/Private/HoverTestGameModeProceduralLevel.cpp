@@ -209,8 +209,11 @@ void AHoverTestGameModeProceduralLevel::HandlePlayerHovercraftCheckpointOverlap(
 	if (Checkpoint->GetCheckpointID() > Hovercraft->GetCurrentProceduralCheckpointID())
 	{
 		Hovercraft->SetNewProceduralCheckpointID(Checkpoint->GetCheckpointID());
-		PlayerController->SetResetPosition(Checkpoint->GetActorLocation());
-		PlayerController->SetResetYaw(Checkpoint->GetActorRotation().Yaw);
+		// the checkpoint's transform is known from the track planning
+		FTransform CheckpointTransform = Checkpoint->GetActorTransform();
+		TerrainManager->GetCheckpointTransform(Checkpoint->GetCheckpointID(), CheckpointTransform);
+		PlayerController->SetResetPosition(CheckpointTransform.GetLocation());
+		PlayerController->SetResetYaw(CheckpointTransform.Rotator().Yaw);
 	}
 }
 
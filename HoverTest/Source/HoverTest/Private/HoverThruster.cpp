@@ -6,6 +6,8 @@
 #include "Engine/World.h"
 #include "Hovercraft.h"
 
+DECLARE_CYCLE_STAT(TEXT("Hover Thruster Trace"), STAT_HoverThrusterTrace, STATGROUP_HoverTest);
+
 
 // Sets default values for this component's properties
 UHoverThruster::UHoverThruster()
@@ -99,7 +101,12 @@ void UHoverThruster::HoverLogic()
 	CollisionParams.TraceTag = TraceTag;
 	//GetWorld()->DebugDrawTraceTag = TraceTag;
 
-	if (GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, EndLocation, ECollisionChannel::ECC_Visibility, CollisionParams))
+	bool bHit = false;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_HoverThrusterTrace);
+		bHit = GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, EndLocation, ECollisionChannel::ECC_Visibility, CollisionParams);
+	}
+	if (bHit)
 	{
 		if (HitResult.Distance <= HoverHeight)
 		{
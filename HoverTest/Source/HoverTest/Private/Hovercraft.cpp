@@ -299,6 +299,16 @@ void AHovercraft::ResetHovercraft(USpringArmComponent* SpringArmComponent)
 			ATerrainManager* TerrainManager = GameMode->GetTerrainManager();
 			if (TerrainManager)
 			{
+				// the player resets onto the track at the last checkpoint passed or at the player spawn, the checkpoint's tile may have been freed since
+				FTransform TrackResetTransform;
+				const bool bFoundTrackResetTransform = (CurrentProceduralCheckpointID > 0) ? TerrainManager->GetCheckpointTransform(CurrentProceduralCheckpointID, TrackResetTransform) : TerrainManager->GetPlayerSpawnTransform(TrackResetTransform);
+				if (PC && bFoundTrackResetTransform)
+				{
+					ResetLocation = TrackResetTransform.GetLocation();
+					ResetLocation.Z += ResetHeightModificator;
+					ResetRotation = FRotator(0.f, TrackResetTransform.Rotator().Yaw, 0.f);
+				}
+
 				if (TerrainManager->IsLocationCoveredByTile(ResetLocation))
 				{
 					// apply values
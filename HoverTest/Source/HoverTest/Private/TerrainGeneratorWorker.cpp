@@ -3,13 +3,16 @@
 #include "TerrainGeneratorWorker.h"
 #include "TerrainManager.h"
 #include "TerrainGenerator.h"
+#include "TerrainHeightfield.h"
 #include "TerrainTile.h"
+#include "HAL/PlatformTime.h"
 
 TerrainGeneratorWorker::TerrainGeneratorWorker(ATerrainManager* Manager, FTerrainSettings Settings, TQueue<FTerrainJob, EQueueMode::Spsc>* Queue)
 {
 	TerrainManager = Manager;
 	TerrainSettings = Settings;
 	InputQueue = Queue;
+	TrackMeshBuilder.Initialize(Settings);
 
 }
 
@@ -28,237 +31,470 @@ uint32 TerrainGeneratorWorker::Run()
 {
 	while (!IsThreadFinished)
 	{
+		// new jobs first, so every queued tile gets its coarse preview before any tile is refined
 		if (InputQueue->Dequeue(TerrainJob))
 		{
-			FDEM DEM = FDEM
-			(
-				TerrainSettings.FractalNoiseTerrainSettings.H, 
-				TerrainSettings.FractalNoiseTerrainSettings.I, 
-				TerrainSettings.FractalNoiseTerrainSettings.I_bu, 
-				TerrainSettings.FractalNoiseTerrainSettings.rt, 
-				TerrainSettings.FractalNoiseTerrainSettings.rs, 
-				TerrainSettings.FractalNoiseTerrainSettings.n, 
-				TerrainSettings.TerrainMaterialTransitionLowMediumElevation, 
-				TerrainSettings.TerrainMaterialTransitionMediumHighElevation, 
-				TerrainSettings.TransitionElevationVariationLowMedium,
-				TerrainSettings.TransitionElevationVariationMediumHigh
-			);
-
 			if (!TerrainManager) 
 			{ 
 				UE_LOG(LogTemp, Error, TEXT("Provided TerrainManager is nullptr in TerrainGeneratorWorker"));
 				return 1; 
 			}
+			ProcessTerrainJob(TerrainJob);
+		}
+		else if (!PendingRefinements.IsEmpty())
+		{
+			FPendingRefinement Refinement;
+			PendingRefinements.Dequeue(Refinement);
+			RefineTerrainJob(Refinement);
+		}
+		else
+		{
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+	return 1;
+}
+
+void TerrainGeneratorWorker::ProcessTerrainJob(FTerrainJob& Job)
+{
+	// the terrain manager discards outdated jobs, they are only handed back so the manager knows they are done
+	if (IsJobOutdated(Job))
+	{
+		TerrainManager->FinishedJobQueue.Enqueue(Job);
+		return;
+	}
+
+	// the terrain was read from the persistent tile cache, which does not store the track mesh
+	if (Job.bServedFromCache)
+	{
+		if (Job.TrackInfo.bSectorHasTrack)
+		{
+			FTrackMeshBuildResult TrackMesh;
+			TrackMeshBuilder.Build(Job.Sector, Job.TrackInfo, Job.PreviousTrackInfo, TrackMesh);
+			Job.MeshData[0].VertexBuffer = MoveTemp(TrackMesh.Vertices);
+			Job.MeshData[0].TriangleBuffer = MoveTemp(TrackMesh.Triangles);
+		}
+		TerrainManager->FinishedJobQueue.Enqueue(Job);
+		return;
+	}
 
-			// size between two adjacent vertices
-			float UnitSize = 0.f;
-			// track segments
-			TArray<FTrackSegment> TrackSegments;
-			// array to save all constraints for the new DEM
-			TArray<FVector> Constraints;
-			// array to save all border constraints for the new DEM
-			TArray<FBorderVertex> BorderConstraints;
-			// array to save all track constraints for the new DEM
-			TArray<FVector> TrackConstraints;
-			// bools to check if corner points already definded by a constraint
-			bool bBottomLeftCorner = false;
-			bool bBottomRightCorner = false;
-			bool bTopRightCorner = false;
-			bool bTopLeftCorner = false;
-			// array with the defining points for the DEM (the corners of the DEM)
-			TArray<FVector> DefiningPoints;
-			DefiningPoints.Init(FVector(), 4);
-			DefiningPoints[0] = FVector(0.f, 0.f, 0.f);
-			DefiningPoints[1] = FVector(0.f, TerrainSettings.TileEdgeSize, 0.f);
-			DefiningPoints[2] = FVector(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize, 0.f);
-			DefiningPoints[3] = FVector(TerrainSettings.TileEdgeSize, 0.f, 0.f);
-
-			// get adjacent tiles
-			TArray<ATerrainTile*> AdjacentTiles;
-			TerrainManager->GetAdjacentTiles(TerrainJob.TerrainTile->GetCurrentSector(), AdjacentTiles, true);
-
-			for (ATerrainTile* Tile : AdjacentTiles)
+	const double GenerationStartTime = FPlatformTime::Seconds();
+	// distant tiles are generated with fewer iterations, see FTerrainSettings::CalculateTileTriangleEdgeIterations
+	const int32 TriangleEdgeIterations = Job.TriangleEdgeIterations > 0 ? Job.TriangleEdgeIterations : TerrainSettings.FractalNoiseTerrainSettings.TriangleEdgeIterations;
+	Job.TriangleEdgeIterations = TriangleEdgeIterations;
+
+	Job.MeshData.Add(FMeshData());
+
+	// track segments
+	TArray<FTrackSegment> TrackSegments;
+	if (Job.TrackInfo.bSectorHasTrack)
+	{
+		// calculate track mesh from the job's copy of the track info, TrackMap belongs to the game thread
+		FTrackMeshBuildResult TrackMesh;
+		TrackMeshBuilder.Build(Job.Sector, Job.TrackInfo, Job.PreviousTrackInfo, TrackMesh);
+		Job.MeshData[0].VertexBuffer = MoveTemp(TrackMesh.Vertices);
+		Job.MeshData[0].TriangleBuffer = MoveTemp(TrackMesh.Triangles);
+		TrackSegments = MoveTemp(TrackMesh.TrackSegments);
+	}
+
+	// progressive generation: publish a coarse version of the tile right away and refine it once all new jobs got their preview
+	const int32 PreviewIterations = Job.PreviewTriangleEdgeIterations;
+	if (PreviewIterations > 0 && PreviewIterations < TriangleEdgeIterations)
+	{
+		FPendingRefinement Refinement;
+		FTerrainJob PreviewJob = Job;
+		PreviewJob.TriangleEdgeIterations = PreviewIterations;
+		PreviewJob.bIsPreview = true;
+
+		FDEM PreviewDEM = CreateDEM(Job.Sector);
+		GenerateDEM(PreviewDEM, Job.Sector, PreviewIterations, TrackSegments, Job.RetainedTileBorders, nullptr);
+		FinishTerrainJob(PreviewJob, PreviewDEM, PreviewIterations, GenerationStartTime, Refinement.CoarseHeightfield);
+
+		Refinement.Job = MoveTemp(Job);
+		Refinement.TrackSegments = MoveTemp(TrackSegments);
+		Refinement.PreviewGenerationTime = PreviewJob.GenerationTime;
+		PendingRefinements.Enqueue(MoveTemp(Refinement));
+		return;
+	}
+
+	FDEM DEM = CreateDEM(Job.Sector);
+	GenerateDEM(DEM, Job.Sector, TriangleEdgeIterations, TrackSegments, Job.RetainedTileBorders, nullptr);
+	FTerrainHeightfield Heightfield;
+	FinishTerrainJob(Job, DEM, TriangleEdgeIterations, GenerationStartTime, Heightfield);
+}
+
+void TerrainGeneratorWorker::RefineTerrainJob(FPendingRefinement& Refinement)
+{
+	FTerrainJob& Job = Refinement.Job;
+	// the tile got a newer job or was freed since the preview was generated, the refinement would overwrite the newer terrain
+	if (IsJobOutdated(Job))
+	{
+		TerrainManager->FinishedJobQueue.Enqueue(Job);
+		return;
+	}
+
+	// report the time of both passes, the preview belongs to the generation of the tile
+	const double GenerationStartTime = FPlatformTime::Seconds() - Refinement.PreviewGenerationTime / 1000.0;
+	FDEM DEM = CreateDEM(Job.Sector);
+	GenerateDEM(DEM, Job.Sector, Job.TriangleEdgeIterations, Refinement.TrackSegments, Job.RetainedTileBorders, Refinement.CoarseHeightfield.IsValid() ? &Refinement.CoarseHeightfield : nullptr);
+	FTerrainHeightfield Heightfield;
+	FinishTerrainJob(Job, DEM, Job.TriangleEdgeIterations, GenerationStartTime, Heightfield);
+}
+
+bool TerrainGeneratorWorker::IsJobOutdated(const FTerrainJob& Job)
+{
+	return Job.JobSerial != Job.TerrainTile->GetLatestJobSerial();
+}
+
+FDEM TerrainGeneratorWorker::CreateDEM(const FIntVector2D Sector) const
+{
+	FDEM DEM = FDEM(TerrainSettings);
+
+	// every sector gets its own random stream, so the terrain does not depend on the order in which tiles are generated by the workers
+	DEM.SetRandomSeed(HashCombine(static_cast<uint32>(TerrainSettings.Seed), GetTypeHash(Sector)));
+	return DEM;
+}
+
+void TerrainGeneratorWorker::GenerateDEM(FDEM& DEM, const FIntVector2D Sector, const int32 TriangleEdgeIterations, const TArray<FTrackSegment>& TrackSegments, const TArray<FAdjacentTileBorder>& RetainedTileBorders, const FTerrainHeightfield* CoarseHeightfield)
+{
+	const float GridUnitSize = TerrainSettings.TileEdgeSize / (1 << (TriangleEdgeIterations + 1));
+	// size between two adjacent vertices
+	float UnitSize = 0.f;
+	// array to save all constraints for the new DEM
+	TArray<FVector> Constraints;
+	// array to save all border constraints for the new DEM
+	TArray<FBorderVertex> BorderConstraints;
+	// array to save all track constraints for the new DEM
+	TArray<FVector> TrackConstraints;
+	// bools to check if corner points already definded by a constraint
+	bool bBottomLeftCorner = false;
+	bool bBottomRightCorner = false;
+	bool bTopRightCorner = false;
+	bool bTopLeftCorner = false;
+	// bools to check if a border is already defined by an adjacent tile
+	bool bBottomBorder = false;
+	bool bTopBorder = false;
+	bool bLeftBorder = false;
+	bool bRightBorder = false;
+	// array with the defining points for the DEM (the corners of the DEM)
+	TArray<FVector> DefiningPoints;
+	DefiningPoints.Init(FVector(), 4);
+	DefiningPoints[0] = FVector(0.f, 0.f, 0.f);
+	DefiningPoints[1] = FVector(0.f, TerrainSettings.TileEdgeSize, 0.f);
+	DefiningPoints[2] = FVector(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize, 0.f);
+	DefiningPoints[3] = FVector(TerrainSettings.TileEdgeSize, 0.f, 0.f);
+
+	// get adjacent tiles, the borders of retained tiles were copied into the job by the game thread
+	TArray<ATerrainTile*> AdjacentTiles;
+	TerrainManager->GetAdjacentTiles(Sector, AdjacentTiles, true);
+	TArray<FAdjacentTileBorder> AdjacentBorders;
+	for (const ATerrainTile* Tile : AdjacentTiles)
+	{
+		FAdjacentTileBorder Border;
+		if (Tile->GetBorderToSector(Sector, Border))
+		{
+			AdjacentBorders.Add(MoveTemp(Border));
+		}
+	}
+	AdjacentBorders.Append(RetainedTileBorders);
+
+	for (const FAdjacentTileBorder& Border : AdjacentBorders)
+	{
+		TArray<FBorderVertex> Verts = Border.Vertices;
+		// top tile?
+		if (Border.Sector == (Sector + FIntVector2D(1, 0)))
+		{
+			FTerrainHeightfield::ResampleBorderVertices(Verts, true, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(Verts);
+			bTopBorder = true;
+			if (!bTopRightCorner)
 			{
-				if (!Tile->GetVerticesOnBorderSet()) { continue; }
-				else
-				{
-					TArray<FBorderVertex> Verts;
-					// top tile?
-					if (Tile->GetCurrentSector() == (TerrainJob.TerrainTile->GetCurrentSector() + FIntVector2D(1, 0)))
-					{
-						Tile->GetVerticesBottomBorder(Verts);
-						BorderConstraints.Append(Verts);
-						if (!bTopRightCorner)
-						{
-							DefiningPoints[2].Z = Tile->GetBottomRightCorner().Z;
-							bTopRightCorner = true;
-						}
-						if (!bTopLeftCorner)
-						{
-							DefiningPoints[3].Z = Tile->GetBottomLeftCorner().Z;
-							bTopLeftCorner = true;
-						}
-						continue;
-					}
-					// bottom tile?
-					if (Tile->GetCurrentSector() == (TerrainJob.TerrainTile->GetCurrentSector() - FIntVector2D(1, 0)))
-					{
-						Tile->GetVerticesTopBorder(Verts);
-						BorderConstraints.Append(Verts);
-						if (!bBottomLeftCorner)
-						{
-							DefiningPoints[0].Z = Tile->GetTopLeftCorner().Z;
-							bBottomLeftCorner = true;
-						}
-						if (!bBottomRightCorner)
-						{
-							DefiningPoints[1].Z = Tile->GetTopRightCorner().Z;
-							bBottomRightCorner = true;
-						}
-						continue;
-					}
-					// right tile?
-					if (Tile->GetCurrentSector() == (TerrainJob.TerrainTile->GetCurrentSector() + FIntVector2D(0, 1)))
-					{
-						Tile->GetVerticesLeftBorder(Verts);
-						BorderConstraints.Append(Verts);
-						if (!bBottomRightCorner)
-						{
-							DefiningPoints[1].Z = Tile->GetBottomLeftCorner().Z;
-							bBottomRightCorner = true;
-						}
-						if (!bTopRightCorner)
-						{
-							DefiningPoints[2].Z = Tile->GetTopLeftCorner().Z;
-							bTopRightCorner = true;
-						}
-						continue;
-					}
-					// left tile?
-					if (Tile->GetCurrentSector() == (TerrainJob.TerrainTile->GetCurrentSector() - FIntVector2D(0, 1)))
-					{
-						Tile->GetVerticesRightBorder(Verts);
-						BorderConstraints.Append(Verts);
-						if (!bBottomLeftCorner)
-						{
-							DefiningPoints[0].Z = Tile->GetBottomRightCorner().Z;
-							bBottomLeftCorner = true;
-						}
-						if (!bTopLeftCorner)
-						{
-							DefiningPoints[3].Z = Tile->GetTopRightCorner().Z;
-							bTopLeftCorner = true;
-						}
-						continue;
-					}
-				}
+				DefiningPoints[2].Z = Border.BottomRightCorner.Z;
+				bTopRightCorner = true;
 			}
-
-			// check if we got all defining points, if not, use default values
+			if (!bTopLeftCorner)
+			{
+				DefiningPoints[3].Z = Border.BottomLeftCorner.Z;
+				bTopLeftCorner = true;
+			}
+			continue;
+		}
+		// bottom tile?
+		if (Border.Sector == (Sector - FIntVector2D(1, 0)))
+		{
+			FTerrainHeightfield::ResampleBorderVertices(Verts, true, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(Verts);
+			bBottomBorder = true;
 			if (!bBottomLeftCorner)
 			{
-				DefiningPoints[0].Z = TerrainSettings.Point1Elevation;
+				DefiningPoints[0].Z = Border.TopLeftCorner.Z;
 				bBottomLeftCorner = true;
 			}
 			if (!bBottomRightCorner)
 			{
-				DefiningPoints[1].Z = TerrainSettings.Point2Elevation;
+				DefiningPoints[1].Z = Border.TopRightCorner.Z;
+				bBottomRightCorner = true;
+			}
+			continue;
+		}
+		// right tile?
+		if (Border.Sector == (Sector + FIntVector2D(0, 1)))
+		{
+			FTerrainHeightfield::ResampleBorderVertices(Verts, false, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(Verts);
+			bRightBorder = true;
+			if (!bBottomRightCorner)
+			{
+				DefiningPoints[1].Z = Border.BottomLeftCorner.Z;
 				bBottomRightCorner = true;
 			}
 			if (!bTopRightCorner)
 			{
-				DefiningPoints[2].Z = TerrainSettings.Point3Elevation;
+				DefiningPoints[2].Z = Border.TopLeftCorner.Z;
 				bTopRightCorner = true;
 			}
+			continue;
+		}
+		// left tile?
+		if (Border.Sector == (Sector - FIntVector2D(0, 1)))
+		{
+			FTerrainHeightfield::ResampleBorderVertices(Verts, false, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(Verts);
+			bLeftBorder = true;
+			if (!bBottomLeftCorner)
+			{
+				DefiningPoints[0].Z = Border.BottomRightCorner.Z;
+				bBottomLeftCorner = true;
+			}
 			if (!bTopLeftCorner)
 			{
-				DefiningPoints[3].Z = TerrainSettings.Point3Elevation;
+				DefiningPoints[3].Z = Border.TopRightCorner.Z;
 				bTopLeftCorner = true;
 			}
+			continue;
+		}
+	}
 
-			if ((Constraints.Num() == 0) && (BorderConstraints.Num() == 0))
+	/**
+	 * a refinement keeps every grid point of the published coarse version, so the terrain only gains detail instead of changing its shape
+	 * borders without an adjacent tile are restricted to the coarse border, since adjacent tiles may already have been generated from the coarse version
+	 */
+	if (CoarseHeightfield)
+	{
+		const int32 Last = CoarseHeightfield->GridSize - 1;
+		for (int32 X = 0; X <= Last; ++X)
+		{
+			for (int32 Y = 0; Y <= Last; ++Y)
 			{
-				// add default values for the moment
-				/* vertex data hardcoded for the moment */
-				Constraints.Append(DefiningPoints);
-				Constraints.Add(FVector(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.Point5Elevation));
-				
+				Constraints.Add(CoarseHeightfield->GetPosition(X, Y));
 			}
+		}
 
-			TerrainJob.MeshData.Add(FMeshData());
+		TArray<FBorderVertex> BottomVerts, TopVerts, LeftVerts, RightVerts;
+		for (int32 i = 0; i <= Last; ++i)
+		{
+			BottomVerts.Add(FBorderVertex(CoarseHeightfield->GetPosition(0, i)));
+			TopVerts.Add(FBorderVertex(CoarseHeightfield->GetPosition(Last, i)));
+			LeftVerts.Add(FBorderVertex(CoarseHeightfield->GetPosition(i, 0)));
+			RightVerts.Add(FBorderVertex(CoarseHeightfield->GetPosition(i, Last)));
+		}
+		if (!bBottomBorder)
+		{
+			FTerrainHeightfield::ResampleBorderVertices(BottomVerts, true, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(BottomVerts);
+		}
+		if (!bTopBorder)
+		{
+			FTerrainHeightfield::ResampleBorderVertices(TopVerts, true, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(TopVerts);
+		}
+		if (!bLeftBorder)
+		{
+			FTerrainHeightfield::ResampleBorderVertices(LeftVerts, false, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(LeftVerts);
+		}
+		if (!bRightBorder)
+		{
+			FTerrainHeightfield::ResampleBorderVertices(RightVerts, false, GridUnitSize, TerrainSettings.TileEdgeSize);
+			BorderConstraints.Append(RightVerts);
+		}
 
-			// get possible track entry and exit points
-			FVector TrackEntryPoint;
-			FVector TrackExitPoint;
+		if (!bBottomLeftCorner)
+		{
+			DefiningPoints[0].Z = CoarseHeightfield->GetPosition(0, 0).Z;
+			bBottomLeftCorner = true;
+		}
+		if (!bBottomRightCorner)
+		{
+			DefiningPoints[1].Z = CoarseHeightfield->GetPosition(0, Last).Z;
+			bBottomRightCorner = true;
+		}
+		if (!bTopRightCorner)
+		{
+			DefiningPoints[2].Z = CoarseHeightfield->GetPosition(Last, Last).Z;
+			bTopRightCorner = true;
+		}
+		if (!bTopLeftCorner)
+		{
+			DefiningPoints[3].Z = CoarseHeightfield->GetPosition(Last, 0).Z;
+			bTopLeftCorner = true;
+		}
+	}
 
-			if (TerrainManager->ContainsSectorTrack(TerrainJob.TerrainTile->GetCurrentSector()))
-			{
-				//UE_LOG(LogTemp, Error, TEXT("Debugging log for sector %s"), *TerrainJob.TerrainTile->GetCurrentSector().ToString());
-				// calculate track mesh
-				TArray<FRuntimeMeshVertexSimple> TrackVertexBuffer;
-				TArray<int32> TrackTriangleBuffer;
-				TerrainManager->GenerateTrackMesh(TerrainJob.TerrainTile->GetCurrentSector(), TerrainJob.MeshData[0].VertexBuffer, TerrainJob.MeshData[0].TriangleBuffer, TrackSegments);
-			}
+	// check if we got all defining points, if not, use default values
+	if (!bBottomLeftCorner)
+	{
+		DefiningPoints[0].Z = TerrainSettings.Point1Elevation;
+		bBottomLeftCorner = true;
+	}
+	if (!bBottomRightCorner)
+	{
+		DefiningPoints[1].Z = TerrainSettings.Point2Elevation;
+		bBottomRightCorner = true;
+	}
+	if (!bTopRightCorner)
+	{
+		DefiningPoints[2].Z = TerrainSettings.Point3Elevation;
+		bTopRightCorner = true;
+	}
+	if (!bTopLeftCorner)
+	{
+		DefiningPoints[3].Z = TerrainSettings.Point3Elevation;
+		bTopLeftCorner = true;
+	}
 
-			//int32 SectorProcessed = TerrainManager->GetTrackPointsForSector(TerrainJob.TerrainTile->GetCurrentSector(), TrackEntryPoint, TrackExitPoint);
-			//// make sure we already processed the current sector in TerrainManager (should always be processed, but better safe than sorry
-			//while (SectorProcessed == -1)
-			//{
-			//	FPlatformProcess::Sleep(0.01f);
-			//	SectorProcessed = TerrainManager->GetTrackPointsForSector(TerrainJob.TerrainTile->GetCurrentSector(), TrackEntryPoint, TrackExitPoint);
-			//}
-
-			//// check if the tile should have a track inside
-			//if (SectorProcessed == 1)
-			//{
-			//	// calculate track mesh
-			//	TArray<FRuntimeMeshVertexSimple> TrackVertexBuffer;
-			//	TArray<int32> TrackTriangleBuffer;
-			//	TArray<FRuntimeMeshVertexSimple> Array1;
-			//	TArray<int32> Array2;
-			//	TerrainManager->GenerateTrackMesh(TerrainJob.TerrainTile->GetCurrentSector(), TerrainJob.MeshData[0].VertexBuffer, TerrainJob.MeshData[0].TriangleBuffer, TrackSegments);
-			//	//TerrainManager->GenerateTrackMesh(TerrainJob.TerrainTile->GetCurrentSector(), TrackEntryPoint, TrackExitPoint, TerrainJob.MeshData[0].VertexBuffer, TerrainJob.MeshData[0].TriangleBuffer, TrackSegments);
-			//}
-
-			DEM.SimulateTriangleEdge(&DefiningPoints, 0, TerrainSettings.FractalNoiseTerrainSettings.TriangleEdgeIterations);
-			UnitSize = DEM.GetUnitSize();
-
-			/*if (TerrainManager->ContainsSectorTrack(TerrainJob.TerrainTile->GetCurrentSector()))
-			{
-				UE_LOG(LogTemp, Warning, TEXT("UnitSize is %f"), UnitSize);
-			}*/
+	if ((Constraints.Num() == 0) && (BorderConstraints.Num() == 0))
+	{
+		// add default values for the moment
+		/* vertex data hardcoded for the moment */
+		Constraints.Append(DefiningPoints);
+		Constraints.Add(FVector(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.Point5Elevation));
+		
+	}
 
-			// calculate track constraints in TrackSegments
-			for (int32 Index = 0; Index < TrackSegments.Num(); ++Index)
+	DEM.SimulateTriangleEdge(&DefiningPoints, 0, TriangleEdgeIterations);
+	UnitSize = DEM.GetUnitSize();
+
+	// calculate track constraints in TrackSegments
+	const FTrackGenerationSettings& TrackSettings = TerrainSettings.TrackGenerationSettings;
+	if (TrackSettings.bUseTrackCorridorField)
+	{
+		const float HalfWidth = TrackSettings.TrackWidth / 2.f;
+		FTrackCorridorField CorridorField;
+		CorridorField.Build(TrackSegments, UnitSize, TerrainSettings.TileEdgeSize, HalfWidth + TrackSettings.TrackCorridorFalloffWidth);
+		CorridorField.GetTrackConstraints(HalfWidth, TrackSettings.TrackCorridorFalloffWidth, TrackSettings.TrackCorridorFalloffDepth, TrackSettings.TrackElevationOffset, TrackConstraints);
+	}
+	else
+	{
+		for (int32 Index = 0; Index < TrackSegments.Num(); ++Index)
+		{
+			// CalculatePointsOnTrack stores its intermediate results in the segment, so it works on a copy
+			FTrackSegment TrackSegment = TrackSegments[Index];
+			TArray<FVector> PointsOnTrack;
+			TrackSegment.CalculatePointsOnTrack(UnitSize, TrackSettings.bUseTightTrackBoundingBox, PointsOnTrack, (Index == 0), (Index == (TrackSegments.Num() - 1)));
+			TrackConstraints.Append(PointsOnTrack);
+		}
+	}
+
+	DEM.MidpointDisplacementBottomUp(&Constraints, &BorderConstraints, &TrackConstraints);
+	DEM.TriangleEdge(&DefiningPoints, 0, TriangleEdgeIterations);// , TerrainJob.MeshData);
+}
+
+void TerrainGeneratorWorker::FinishTerrainJob(FTerrainJob& Job, FDEM& DEM, const int32 TriangleEdgeIterations, const double GenerationStartTime, FTerrainHeightfield& OUTHeightfield)
+{
+	// the terrain section is queued compact and only expanded right before it gets uploaded
+	if (OUTHeightfield.InitializeFromDEM(DEM, TerrainSettings.TileEdgeSize, TriangleEdgeIterations))
+	{
+		OUTHeightfield.Encode(Job.CompactTerrain, TerrainSettings.bDeltaEncodeTileHeights, TerrainSettings.bStoreTileNormals);
+#if !UE_BUILD_SHIPPING
+		Job.CompactTerrainHeightError = OUTHeightfield.CalculateHeightError(Job.CompactTerrain);
+		// allow for float rounding when the elevations are restored
+		const FCompactTerrainTile& Compact = Job.CompactTerrain;
+		const float ErrorTolerance = Compact.GetMaximumHeightError() + 4.f * FLT_EPSILON * (FMath::Abs(Compact.MinHeight) + MAX_uint16 * Compact.HeightStep);
+		if (Job.CompactTerrainHeightError < 0.f || Job.CompactTerrainHeightError > ErrorTolerance)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Compact terrain of sector %s exceeds its error bound (%f > %f)"), *Job.Sector.ToString(), Job.CompactTerrainHeightError, ErrorTolerance);
+		}
+#endif
+		CalculateTerrainQuadLevels(Job, OUTHeightfield);
+	}
+	else
+	{
+		OUTHeightfield = FTerrainHeightfield();
+		DEM.CopyBufferToMeshData(Job.MeshData);
+	}
+	DEM.CalculateBorderVertexNormals();
+	Job.GenerationTime = static_cast<float>((FPlatformTime::Seconds() - GenerationStartTime) * 1000.0);
+
+	// the tile's border vertices belong to its newer job
+	if (IsJobOutdated(Job))
+	{
+		TerrainManager->FinishedJobQueue.Enqueue(Job);
+		return;
+	}
+
+	Job.TerrainTile->SetVerticesLeftBorder(DEM.VerticesLeftBorder);
+	Job.TerrainTile->SetVerticesRightBorder(DEM.VerticesRightBorder);
+	Job.TerrainTile->SetVerticesTopBorder(DEM.VerticesTopBorder);
+	Job.TerrainTile->SetVerticesBottomBorder(DEM.VerticesBottomBorder);
+	Job.TerrainTile->SetBottomLeftCorner(DEM.BottomLeftCorner);
+	Job.TerrainTile->SetBottomRightCorner(DEM.BottomRightCorner);
+	Job.TerrainTile->SetTopRightCorner(DEM.TopRightCorner);
+	Job.TerrainTile->SetTopLeftCorner(DEM.TopLeftCorner);
+	Job.TerrainTile->AllVerticesOnBorderSet();
+
+	TerrainManager->FinishedJobQueue.Enqueue(Job);
+}
+
+void TerrainGeneratorWorker::CalculateTerrainQuadLevels(FTerrainJob& Job, const FTerrainHeightfield& Heightfield) const
+{
+	const bool bHasCollisionQuadtree = TerrainSettings.bLowResolutionTileCollision && !TerrainSettings.bHeightfieldTileCollision;
+	// the terrain below and next to the track keeps full resolution, so large triangles cannot cut through the track
+	TArray<FBox2D> TrackAreas;
+	if ((TerrainSettings.bAdaptiveTileTessellation || bHasCollisionQuadtree) && Job.MeshData.Num() > 0)
+	{
+		GetTrackAreas(Job.MeshData[0], Heightfield.UnitSize, TrackAreas);
+	}
+
+	if (TerrainSettings.bAdaptiveTileTessellation)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Heightfield.CalculateAdaptiveQuadLevels(Job.CompactTerrain.QuadLevels, TerrainSettings.AdaptiveTessellationTolerance, TrackAreas);
+		Job.TessellationTime = static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+	if (bHasCollisionQuadtree)
+	{
+		Heightfield.CalculateCollisionQuadLevels(Job.CompactTerrain.CollisionQuadLevels, TerrainSettings.TileCollisionReductionLevels, TrackAreas);
+	}
+
+#if !UE_BUILD_SHIPPING
+	// the vertex cache simulation only depends on the order of the triangles, which the quadtree defines, so it does not have to run on the game thread
+	FMeshData TerrainMeshData;
+	Heightfield.BuildAdaptiveMeshData(TerrainMeshData, Job.CompactTerrain.QuadLevels, TerrainSettings.CalculateTileSkirtDepth(Heightfield.GridSize));
+	Job.TerrainACMR = TerrainMeshData.CalculateACMR();
+#endif
+}
+
+void TerrainGeneratorWorker::GetTrackAreas(const FMeshData& TrackMeshData, const float UnitSize, TArray<FBox2D>& OUTAreas)
+{
+	OUTAreas.Reset();
+	const FVector2D Margin(2.f * UnitSize, 2.f * UnitSize);
+	for (int32 i = 0; i + 2 < TrackMeshData.TriangleBuffer.Num(); i += 3)
+	{
+		FBox2D Area(ForceInit);
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			const int32 VertexIndex = TrackMeshData.TriangleBuffer[i + Corner];
+			if (TrackMeshData.VertexBuffer.IsValidIndex(VertexIndex))
 			{
-				TArray<FVector> PointsOnTrack;
-				TrackSegments[Index].CalculatePointsOnTrack(UnitSize, TerrainSettings.TrackGenerationSettings.bUseTightTrackBoundingBox, PointsOnTrack, (Index == 0), (Index == (TrackSegments.Num() - 1)));
-				TrackConstraints.Append(PointsOnTrack);
+				Area += FVector2D(TrackMeshData.VertexBuffer[VertexIndex].Position);
 			}
-
-			DEM.MidpointDisplacementBottomUp(&Constraints, &BorderConstraints, &TrackConstraints);
-			DEM.TriangleEdge(&DefiningPoints, 0, TerrainSettings.FractalNoiseTerrainSettings.TriangleEdgeIterations);// , TerrainJob.MeshData);
-			DEM.CopyBufferToMeshData(TerrainJob.MeshData);
-			DEM.CalculateBorderVertexNormals();
-
-			TerrainJob.TerrainTile->SetVerticesLeftBorder(DEM.VerticesLeftBorder);
-			TerrainJob.TerrainTile->SetVerticesRightBorder(DEM.VerticesRightBorder);
-			TerrainJob.TerrainTile->SetVerticesTopBorder(DEM.VerticesTopBorder);
-			TerrainJob.TerrainTile->SetVerticesBottomBorder(DEM.VerticesBottomBorder);
-			TerrainJob.TerrainTile->SetBottomLeftCorner(DEM.BottomLeftCorner);
-			TerrainJob.TerrainTile->SetBottomRightCorner(DEM.BottomRightCorner);
-			TerrainJob.TerrainTile->SetTopRightCorner(DEM.TopRightCorner);
-			TerrainJob.TerrainTile->SetTopLeftCorner(DEM.TopLeftCorner);
-			TerrainJob.TerrainTile->AllVerticesOnBorderSet();
-
-			TerrainManager->FinishedJobQueue.Enqueue(TerrainJob);
 		}
-		else
+		if (Area.bIsValid)
 		{
-			FPlatformProcess::Sleep(0.01f);
+			OUTAreas.Add(FBox2D(Area.Min - Margin, Area.Max + Margin));
 		}
 	}
-	return 1;
 }
 
 void TerrainGeneratorWorker::Stop()
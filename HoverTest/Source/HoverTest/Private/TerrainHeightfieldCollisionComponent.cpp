@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainHeightfieldCollisionComponent.h"
+#include "Engine/World.h"
+#include "Engine/CollisionProfile.h"
+#include "PhysicsPublic.h"
+#include "PhysicsFiltering.h"
+#include "PhysXPublic.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+
+DECLARE_CYCLE_STAT(TEXT("Create Terrain Heightfield"), STAT_CreateTerrainHeightfield, STATGROUP_HoverTest);
+
+
+UTerrainHeightfieldCollisionComponent::UTerrainHeightfieldCollisionComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	SetGenerateOverlapEvents(false);
+	bHiddenInGame = true;
+	CastShadow = false;
+}
+
+float UTerrainHeightfieldCollisionComponent::SetHeightfield(const FTerrainCollisionHeightfield& InHeightfield)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CreateTerrainHeightfield);
+	const double StartTime = FPlatformTime::Seconds();
+
+	// the actor has to be removed from the scene before its heightfield is released
+	DestroyPhysicsState();
+	ReleaseHeightfield();
+	Heightfield = InHeightfield;
+
+#if WITH_PHYSX
+	if (Heightfield.IsValid() && GPhysXSDK)
+	{
+		const int32 GridSize = Heightfield.GridSize;
+		TArray<PxHeightFieldSample> Samples;
+		Samples.SetNumZeroed(GridSize * GridSize);
+		for (int32 Row = 0; Row < GridSize; ++Row)
+		{
+			for (int32 Column = 0; Column < GridSize; ++Column)
+			{
+				// grid point (X, Y) of the tile is the sample in row Y and column X, see GetHeightfieldTransform
+				Samples[Row * GridSize + Column].height = Heightfield.Heights[Column * GridSize + Row];
+			}
+		}
+
+		PxHeightFieldDesc Desc;
+		Desc.format = PxHeightFieldFormat::eS16_TM;
+		Desc.nbRows = GridSize;
+		Desc.nbColumns = GridSize;
+		Desc.samples.data = Samples.GetData();
+		Desc.samples.stride = sizeof(PxHeightFieldSample);
+		PHeightField = GPhysXSDK->createHeightField(Desc);
+		if (PHeightField == nullptr)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not create the collision heightfield of %s"), *GetName());
+		}
+	}
+#endif
+
+	CreatePhysicsState();
+	UpdateBounds();
+	return static_cast<float>((FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+bool UTerrainHeightfieldCollisionComponent::HasHeightfield() const
+{
+	return PHeightField != nullptr;
+}
+
+FBoxSphereBounds UTerrainHeightfieldCollisionComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (!Heightfield.IsValid())
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	}
+	const float EdgeSize = (Heightfield.GridSize - 1) * Heightfield.UnitSize;
+	const float HalfHeight = MAX_int16 * Heightfield.HeightScale;
+	const FBox LocalBox(FVector(0.f, 0.f, Heightfield.HeightOffset - HalfHeight), FVector(EdgeSize, EdgeSize, Heightfield.HeightOffset + HalfHeight));
+	return FBoxSphereBounds(LocalBox.TransformBy(LocalToWorld));
+}
+
+bool UTerrainHeightfieldCollisionComponent::ShouldCreatePhysicsState() const
+{
+	return PHeightField != nullptr && Super::ShouldCreatePhysicsState();
+}
+
+void UTerrainHeightfieldCollisionComponent::BeginDestroy()
+{
+	ReleaseHeightfield();
+	Super::BeginDestroy();
+}
+
+void UTerrainHeightfieldCollisionComponent::OnCreatePhysicsState()
+{
+	// the heightfield's actor replaces the body instance of the primitive component, so the primitive component's implementation is skipped
+	USceneComponent::OnCreatePhysicsState();
+
+#if WITH_PHYSX
+	UWorld* World = GetWorld();
+	FPhysScene* PhysScene = World ? World->GetPhysicsScene() : nullptr;
+	PxScene* PScene = PhysScene ? PhysScene->GetPxScene(PST_Sync) : nullptr;
+	if (PHeightField == nullptr || PScene == nullptr || PActor != nullptr) { return; }
+
+	PxHeightFieldGeometry Geometry(PHeightField, PxMeshGeometryFlags(), Heightfield.HeightScale, Heightfield.UnitSize, Heightfield.UnitSize);
+	UPhysicalMaterial* PhysicalMaterial = GetBodyInstance()->GetSimplePhysicalMaterial();
+	PxMaterial* PMaterial = PhysicalMaterial ? PhysicalMaterial->GetPhysicsMaterial().Material : nullptr;
+	if (!Geometry.isValid() || PMaterial == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Invalid collision heightfield for %s"), *GetName());
+		return;
+	}
+
+	FCollisionFilterData QueryFilterData;
+	FCollisionFilterData SimFilterData;
+	const AActor* Owner = GetOwner();
+	CreateShapeFilterData(GetCollisionObjectType(), FMaskFilter(0), Owner ? Owner->GetUniqueID() : 0, GetCollisionResponseToChannels(), GetUniqueID(), 0, QueryFilterData, SimFilterData, false, false, true);
+	// hover traces use complex collision, the heightfield is both
+	QueryFilterData.Word3 |= EPDF_SimpleCollision | EPDF_ComplexCollision;
+	SimFilterData.Word3 |= EPDF_SimpleCollision | EPDF_ComplexCollision;
+
+	PxShape* PShape = GPhysXSDK->createShape(Geometry, *PMaterial, true);
+	PShape->setQueryFilterData(U2PFilterData(QueryFilterData));
+	PShape->setSimulationFilterData(U2PFilterData(SimFilterData));
+	PShape->setFlag(PxShapeFlag::eSCENE_QUERY_SHAPE, true);
+	PShape->setFlag(PxShapeFlag::eSIMULATION_SHAPE, true);
+
+	BodyInstance.OwnerComponent = this;
+	PhysxUserData = FPhysxUserData(&BodyInstance);
+	PShape->userData = &PhysxUserData;
+
+	PActor = GPhysXSDK->createRigidStatic(U2PTransform(GetHeightfieldTransform()));
+	PActor->userData = &PhysxUserData;
+	PActor->attachShape(*PShape);
+	PShape->release();
+
+	SCOPED_SCENE_WRITE_LOCK(PScene);
+	PScene->addActor(*PActor);
+#endif
+}
+
+void UTerrainHeightfieldCollisionComponent::OnDestroyPhysicsState()
+{
+#if WITH_PHYSX
+	if (PActor)
+	{
+		PxScene* PScene = PActor->getScene();
+		if (PScene)
+		{
+			SCOPED_SCENE_WRITE_LOCK(PScene);
+			PScene->removeActor(*PActor);
+		}
+		PActor->release();
+		PActor = nullptr;
+	}
+#endif
+
+	USceneComponent::OnDestroyPhysicsState();
+}
+
+void UTerrainHeightfieldCollisionComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+#if WITH_PHYSX
+	// tiles are moved to other sectors when they are reused
+	if (PActor)
+	{
+		PxScene* PScene = PActor->getScene();
+		SCOPED_SCENE_WRITE_LOCK(PScene);
+		PActor->setGlobalPose(U2PTransform(GetHeightfieldTransform()));
+	}
+#endif
+}
+
+FTransform UTerrainHeightfieldCollisionComponent::GetHeightfieldTransform() const
+{
+	// rotates the physics engine's X axis onto the Y axis, its Y axis onto the Z axis and its Z axis onto the X axis
+	const FQuat Rotation(0.5f, 0.5f, 0.5f, 0.5f);
+	return FTransform(Rotation, GetComponentLocation() + FVector(0.f, 0.f, Heightfield.HeightOffset));
+}
+
+void UTerrainHeightfieldCollisionComponent::ReleaseHeightfield()
+{
+#if WITH_PHYSX
+	if (PHeightField)
+	{
+		PHeightField->release();
+		PHeightField = nullptr;
+	}
+#endif
+}
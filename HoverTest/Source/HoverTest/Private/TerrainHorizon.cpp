@@ -0,0 +1,312 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainHorizon.h"
+#include "TerrainTile.h"
+#include "TerrainGenerator.h"
+
+void FTerrainHorizon::Initialize(const FTerrainSettings& InSettings)
+{
+	Settings = InSettings;
+	CenterSectors.Empty();
+	Cells.Empty();
+	PendingCells.Empty();
+	ChangedChunks.Empty();
+	Chunks.Empty();
+	FreeSections.Empty();
+	NextSection = 0;
+}
+
+void FTerrainHorizon::SetCenterSectors(const TArray<FIntVector2D>& InCenterSectors)
+{
+	if (InCenterSectors == CenterSectors) { return; }
+	CenterSectors = InCenterSectors;
+
+	TSet<FIntVector2D> NeededSectors;
+	const int32 Radius = FMath::Max(Settings.HorizonRadius, 1);
+	for (const FIntVector2D& Center : CenterSectors)
+	{
+		for (int32 X = -Radius; X <= Radius; ++X)
+		{
+			for (int32 Y = -Radius; Y <= Radius; ++Y)
+			{
+				NeededSectors.Add(Center + FIntVector2D(X, Y));
+			}
+		}
+	}
+
+	for (auto It = Cells.CreateIterator(); It; ++It)
+	{
+		if (!NeededSectors.Contains(It.Key()))
+		{
+			ChangedChunks.Add(GetChunk(It.Key()));
+			It.RemoveCurrent();
+		}
+	}
+	PendingCells.RemoveAll([&NeededSectors](const FIntVector2D& Sector) { return !NeededSectors.Contains(Sector); });
+
+	TSet<FIntVector2D> QueuedSectors(PendingCells);
+	for (const FIntVector2D& Sector : NeededSectors)
+	{
+		if (!Cells.Contains(Sector) && !QueuedSectors.Contains(Sector))
+		{
+			PendingCells.Add(Sector);
+		}
+	}
+
+	// the nearest cells are generated first, they are the first ones to become visible
+	PendingCells.Sort([this](const FIntVector2D& A, const FIntVector2D& B)
+	{
+		return GetDistanceToCenters(A) > GetDistanceToCenters(B);
+	});
+}
+
+bool FTerrainHorizon::GenerateNextCell(TFunctionRef<const ATerrainTile*(const FIntVector2D)> FindTile)
+{
+	if (PendingCells.Num() == 0) { return false; }
+	const FIntVector2D Sector = PendingCells.Pop(false);
+
+	const int32 TriangleEdgeIterations = FMath::Max(Settings.HorizonTriangleEdgeIterations, 1);
+	TArray<FVector> Constraints;
+	TArray<FBorderVertex> BorderConstraints;
+	TArray<FVector> TrackConstraints;
+
+	// same corners and default elevations as a tile, see TerrainGeneratorWorker::GenerateDEM
+	TArray<FVector> DefiningPoints;
+	DefiningPoints.Add(FVector(0.f, 0.f, Settings.Point1Elevation));
+	DefiningPoints.Add(FVector(0.f, Settings.TileEdgeSize, Settings.Point2Elevation));
+	DefiningPoints.Add(FVector(Settings.TileEdgeSize, Settings.TileEdgeSize, Settings.Point3Elevation));
+	DefiningPoints.Add(FVector(Settings.TileEdgeSize, 0.f, Settings.Point3Elevation));
+	bool bCornerSet[4] = { false, false, false, false };
+
+	// bottom, top, left and right side and the corners at the start and the end of each side
+	const FIntVector2D Directions[4] = { FIntVector2D(-1, 0), FIntVector2D(1, 0), FIntVector2D(0, -1), FIntVector2D(0, 1) };
+	const int32 StartCorners[4] = { 0, 3, 0, 1 };
+	const int32 EndCorners[4] = { 1, 2, 3, 2 };
+	for (int32 Side = 0; Side < 4; ++Side)
+	{
+		TArray<FBorderVertex> Vertices;
+		if (!GetBorderVertices(Sector, Directions[Side], FindTile, Vertices)) { continue; }
+
+		if (!bCornerSet[StartCorners[Side]])
+		{
+			DefiningPoints[StartCorners[Side]].Z = Vertices[0].Position.Z;
+			bCornerSet[StartCorners[Side]] = true;
+		}
+		if (!bCornerSet[EndCorners[Side]])
+		{
+			DefiningPoints[EndCorners[Side]].Z = Vertices.Last().Position.Z;
+			bCornerSet[EndCorners[Side]] = true;
+		}
+		BorderConstraints.Append(Vertices);
+	}
+
+	if (BorderConstraints.Num() == 0)
+	{
+		Constraints.Append(DefiningPoints);
+		Constraints.Add(FVector(Settings.TileEdgeSize / 2.f, Settings.TileEdgeSize / 2.f, Settings.Point5Elevation));
+	}
+
+	// the horizon has no track, so the track constraints stay empty
+	FDEM DEM = FDEM(Settings);
+	DEM.SetRandomSeed(HashCombine(static_cast<uint32>(Settings.Seed), GetTypeHash(Sector)));
+	DEM.SimulateTriangleEdge(&DefiningPoints, 0, TriangleEdgeIterations);
+	DEM.MidpointDisplacementBottomUp(&Constraints, &BorderConstraints, &TrackConstraints);
+	DEM.TriangleEdge(&DefiningPoints, 0, TriangleEdgeIterations);
+
+	FTerrainHeightfield Cell;
+	if (!Cell.InitializeFromDEM(DEM, Settings.TileEdgeSize, TriangleEdgeIterations))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not generate horizon for sector %s"), *Sector.ToString());
+		return true;
+	}
+	Cells.Add(Sector, MoveTemp(Cell));
+	ChangedChunks.Add(GetChunk(Sector));
+	return true;
+}
+
+void FTerrainHorizon::RegenerateCellsAround(const FIntVector2D Sector)
+{
+	// the last pending cell is generated first, so the sector itself is added last
+	const FIntVector2D Directions[5] = { FIntVector2D(-1, 0), FIntVector2D(1, 0), FIntVector2D(0, -1), FIntVector2D(0, 1), FIntVector2D(0, 0) };
+	for (const FIntVector2D& Direction : Directions)
+	{
+		const FIntVector2D CellSector = Sector + Direction;
+		if (Cells.Contains(CellSector) || PendingCells.Contains(CellSector))
+		{
+			PendingCells.Remove(CellSector);
+			PendingCells.Add(CellSector);
+		}
+	}
+	MarkSectorChanged(Sector);
+}
+
+void FTerrainHorizon::MarkSectorChanged(const FIntVector2D Sector)
+{
+	if (Cells.Contains(Sector))
+	{
+		ChangedChunks.Add(GetChunk(Sector));
+	}
+}
+
+bool FTerrainHorizon::BuildNextChangedChunk(TFunctionRef<bool(const FIntVector2D)> IsSectorCovered, int32& OUTSection, FMeshData& OUTMeshData)
+{
+	OUTSection = INDEX_NONE;
+	OUTMeshData.VertexBuffer.Reset();
+	OUTMeshData.TriangleBuffer.Reset();
+	if (ChangedChunks.Num() == 0) { return false; }
+
+	// chunks that still wait for cells would only be built again, so complete chunks are preferred
+	TSet<FIntVector2D> IncompleteChunks;
+	for (const FIntVector2D& Sector : PendingCells)
+	{
+		IncompleteChunks.Add(GetChunk(Sector));
+	}
+	FIntVector2D Chunk = *ChangedChunks.CreateConstIterator();
+	for (const FIntVector2D& ChangedChunk : ChangedChunks)
+	{
+		if (!IncompleteChunks.Contains(ChangedChunk))
+		{
+			Chunk = ChangedChunk;
+			break;
+		}
+	}
+	ChangedChunks.Remove(Chunk);
+
+	const int32 ChunkSize = FMath::Max(Settings.HorizonChunkSize, 1);
+	FMeshData CellMeshData;
+	for (int32 X = Chunk.X * ChunkSize; X < (Chunk.X + 1) * ChunkSize; ++X)
+	{
+		for (int32 Y = Chunk.Y * ChunkSize; Y < (Chunk.Y + 1) * ChunkSize; ++Y)
+		{
+			const FIntVector2D Sector(X, Y);
+			const FTerrainHeightfield* Cell = Cells.Find(Sector);
+			if (Cell == nullptr || IsSectorCovered(Sector)) { continue; }
+
+			Cell->BuildMeshData(CellMeshData, Settings.HorizonSkirtDepth);
+			const FVector Offset(X * Settings.TileEdgeSize, Y * Settings.TileEdgeSize, 0.f);
+			const int32 FirstVertex = OUTMeshData.VertexBuffer.Num();
+			for (FTerrainVertex& Vertex : CellMeshData.VertexBuffer)
+			{
+				Vertex.Position += Offset;
+			}
+			OUTMeshData.VertexBuffer.Append(CellMeshData.VertexBuffer);
+			for (const int32 Index : CellMeshData.TriangleBuffer)
+			{
+				OUTMeshData.TriangleBuffer.Add(FirstVertex + Index);
+			}
+		}
+	}
+
+	FHorizonChunk* ExistingChunk = Chunks.Find(Chunk);
+	if (OUTMeshData.TriangleBuffer.Num() == 0)
+	{
+		// nothing left to show, the chunk's mesh section is cleared and can be reused by another chunk
+		if (ExistingChunk)
+		{
+			OUTSection = ExistingChunk->Section;
+			FreeSections.Add(ExistingChunk->Section);
+			Chunks.Remove(Chunk);
+		}
+		return true;
+	}
+
+	if (ExistingChunk == nullptr)
+	{
+		ExistingChunk = &Chunks.Add(Chunk);
+		ExistingChunk->Section = FreeSections.Num() > 0 ? FreeSections.Pop(false) : NextSection++;
+	}
+	ExistingChunk->Triangles = OUTMeshData.TriangleBuffer.Num() / 3;
+	OUTSection = ExistingChunk->Section;
+	return true;
+}
+
+int32 FTerrainHorizon::NumCells() const
+{
+	return Cells.Num();
+}
+
+int32 FTerrainHorizon::NumPendingCells() const
+{
+	return PendingCells.Num();
+}
+
+int32 FTerrainHorizon::NumTriangles() const
+{
+	int32 Triangles = 0;
+	for (const TPair<FIntVector2D, FHorizonChunk>& Chunk : Chunks)
+	{
+		Triangles += Chunk.Value.Triangles;
+	}
+	return Triangles;
+}
+
+bool FTerrainHorizon::GetBorderVertices(const FIntVector2D Sector, const FIntVector2D Direction, TFunctionRef<const ATerrainTile*(const FIntVector2D)> FindTile, TArray<FBorderVertex>& OUTVertices) const
+{
+	OUTVertices.Reset();
+	const bool bAlongY = Direction.X != 0;
+	const float EdgeSize = Settings.TileEdgeSize;
+
+	// the border vertices of a tile are stored transformed into the space of the adjacent tile, see FDEM::CheckForBorderVertex
+	if (const ATerrainTile* Tile = FindTile(Sector))
+	{
+		// the sector's own tile, its border has to be transformed back
+		if (Direction.X < 0) { Tile->GetVerticesBottomBorder(OUTVertices); }
+		else if (Direction.X > 0) { Tile->GetVerticesTopBorder(OUTVertices); }
+		else if (Direction.Y < 0) { Tile->GetVerticesLeftBorder(OUTVertices); }
+		else { Tile->GetVerticesRightBorder(OUTVertices); }
+
+		for (FBorderVertex& Vertex : OUTVertices)
+		{
+			if (bAlongY) { Vertex.Position.X = Direction.X > 0 ? EdgeSize : 0.f; }
+			else { Vertex.Position.Y = Direction.Y > 0 ? EdgeSize : 0.f; }
+		}
+	}
+	else if (const ATerrainTile* AdjacentTile = FindTile(Sector + Direction))
+	{
+		if (Direction.X > 0) { AdjacentTile->GetVerticesBottomBorder(OUTVertices); }
+		else if (Direction.X < 0) { AdjacentTile->GetVerticesTopBorder(OUTVertices); }
+		else if (Direction.Y > 0) { AdjacentTile->GetVerticesLeftBorder(OUTVertices); }
+		else { AdjacentTile->GetVerticesRightBorder(OUTVertices); }
+	}
+	else if (const FTerrainHeightfield* Cell = Cells.Find(Sector + Direction))
+	{
+		const int32 Last = Cell->GridSize - 1;
+		for (int32 i = 0; i <= Last; ++i)
+		{
+			FVector Position;
+			if (Direction.X > 0) { Position = Cell->GetPosition(0, i); Position.X = EdgeSize; }
+			else if (Direction.X < 0) { Position = Cell->GetPosition(Last, i); Position.X = 0.f; }
+			else if (Direction.Y > 0) { Position = Cell->GetPosition(i, 0); Position.Y = EdgeSize; }
+			else { Position = Cell->GetPosition(i, Last); Position.Y = 0.f; }
+			OUTVertices.Add(FBorderVertex(Position));
+		}
+	}
+
+	if (OUTVertices.Num() < 2)
+	{
+		OUTVertices.Reset();
+		return false;
+	}
+	const float UnitSize = EdgeSize / (1 << (FMath::Max(Settings.HorizonTriangleEdgeIterations, 1) + 1));
+	FTerrainHeightfield::ResampleBorderVertices(OUTVertices, bAlongY, UnitSize, EdgeSize);
+	return true;
+}
+
+int32 FTerrainHorizon::GetDistanceToCenters(const FIntVector2D Sector) const
+{
+	int32 Distance = MAX_int32;
+	for (const FIntVector2D& Center : CenterSectors)
+	{
+		Distance = FMath::Min(Distance, FMath::Max(FMath::Abs(Sector.X - Center.X), FMath::Abs(Sector.Y - Center.Y)));
+	}
+	return Distance;
+}
+
+FIntVector2D FTerrainHorizon::GetChunk(const FIntVector2D Sector) const
+{
+	// floor division, so chunks do not get twice as large around sector 0
+	const int32 ChunkSize = FMath::Max(Settings.HorizonChunkSize, 1);
+	const int32 X = Sector.X >= 0 ? Sector.X / ChunkSize : (Sector.X - ChunkSize + 1) / ChunkSize;
+	const int32 Y = Sector.Y >= 0 ? Sector.Y / ChunkSize : (Sector.Y - ChunkSize + 1) / ChunkSize;
+	return FIntVector2D(X, Y);
+}
@@ -6,6 +6,9 @@
 #include "TerrainGeneratorWorker.h"
 #include "Engine/Classes/Kismet/KismetMathLibrary.h"
 #include "HoverTestGameModeProceduralLevel.h"
+#include "Misc/Paths.h"
+#include "TerrainHeightfield.h"
+#include "RuntimeMeshComponent.h"
 
 
 // Sets default values
@@ -13,6 +16,10 @@ ATerrainManager::ATerrainManager()
 {
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+
+	HorizonMesh = CreateDefaultSubobject<URuntimeMeshComponent>(TEXT("Horizon Mesh"));
+	RootComponent = HorizonMesh;
+	HorizonMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 }
 
 // Called when the game starts or when spawned
@@ -27,6 +34,26 @@ void ATerrainManager::BeginPlay()
 		UE_LOG(LogTemp, Error, TEXT("Could not cast game mode to AHoverTestGameModeProceduralLevel"));
 	}
 
+	// the seed has to be known before the worker threads get their copy of the settings
+	if (TerrainSettings.bUseRandomSeed)
+	{
+		TerrainSettings.Seed = FMath::Rand();
+	}
+	TrackPlannerState.TrackRandomStream.Initialize(TerrainSettings.Seed);
+	TrackPlanner.Initialize(TerrainSettings);
+	if (TerrainSettings.bPlanTrackInBackground)
+	{
+		TrackPlanningWorker = new FTrackPlanningWorker(TerrainSettings, &TrackPlanningRestartQueue, &PlannedTrackQueue, &TakenTrackSectors);
+		TrackPlanningThread = FRunnableThread::Create(
+			TrackPlanningWorker,
+			TEXT("TrackPlanningWorkerThread"),
+			0,
+			EThreadPriority::TPri_BelowNormal,
+			FPlatformAffinity::GetNoAffinityMask()
+		);
+	}
+	RestartTrackPlanning();
+
 	// create threads
 	FString ThreadName = "TerrainGeneratorWorkerThread";
 	for (int i = 0; i < TerrainSettings.NumberOfThreadsToUse; ++i)
@@ -43,6 +70,35 @@ void ATerrainManager::BeginPlay()
 		);
 	}
 
+	GenerationSettingsHash = TerrainSettings.CalculateGenerationSettingsHash();
+	TileCache.SetBudget(static_cast<int64>(TerrainSettings.TileCacheBudgetMegabytes) * 1024 * 1024);
+	if (TerrainSettings.bUsePersistentTileCache && !TerrainSettings.bUseRandomSeed)
+	{
+		const FString Filename = FPaths::ProjectSavedDir() / TEXT("TerrainCache") / FString::Printf(TEXT("Tiles_%i_%08x.bin"), TerrainSettings.Seed, GenerationSettingsHash);
+		TileDiskCache.Open(Filename, TerrainSettings.Seed, GenerationSettingsHash);
+	}
+	else if (TerrainSettings.bUsePersistentTileCache)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Persistent tile cache is not used, it needs a fixed seed (bUseRandomSeed is set)"));
+	}
+
+	// the horizon's vertices are in world space, independent of where the terrain manager was placed
+	Horizon.Initialize(TerrainSettings);
+	TrackSplineIndex.Initialize(TerrainSettings.TileEdgeSize);
+	if (HorizonMesh)
+	{
+		HorizonMesh->SetAbsolute(true, true, true);
+		HorizonMesh->SetWorldTransform(FTransform::Identity);
+	}
+
+	// pre-warm the tile pool, so tracked actors can get their tiles without spawning actors during gameplay
+	const int32 TilesPerActor = (2 * TerrainSettings.TilesToBeCreatedAroundActorRadius + 1) * (2 * TerrainSettings.TilesToBeCreatedAroundActorRadius + 1);
+	TilePoolTargetSize = TilesPerActor * FMath::Max(TerrainSettings.ExpectedNumberOfTrackedActors, 1) + TerrainSettings.AdditionalPooledTiles + TerrainSettings.NumberOfRetainedTiles;
+	if (FreeTiles.Num() + TilesInUse.Num() < TilePoolTargetSize)
+	{
+		CreateAndInitializeTiles(TilePoolTargetSize - FreeTiles.Num() - TilesInUse.Num());
+	}
+
 	/**
 	 * evil code that will make the game run in the editor, but not in a packaged game
 	 */
@@ -55,6 +111,56 @@ void ATerrainManager::BeginPlay()
 
 }
 
+void ATerrainManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	const FTilePoolStatistics Statistics = GetTilePoolStatistics();
+	if (Statistics.CompactTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Compact tiles: %i tiles, %i bytes per compact tile, %i bytes per expanded terrain section, maximum elevation error %f"), Statistics.CompactTiles, Statistics.AverageCompactTileBytes, Statistics.AverageExpandedTileBytes, Statistics.MaximumCompactTileHeightError);
+	}
+	if (Statistics.ReducedDetailTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Tile detail: %i full detail tiles with %i triangles in %f ms, %i reduced detail tiles with %i triangles in %f ms, %i tiles refined"), NumberOfFullDetailTiles, Statistics.AverageFullDetailTileTriangles, Statistics.AverageFullDetailTileGenerationTime, Statistics.ReducedDetailTiles, Statistics.AverageReducedDetailTileTriangles, Statistics.AverageReducedDetailTileGenerationTime, Statistics.RefinedTiles);
+	}
+	if (Statistics.PreviewTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Progressive tiles: %i previews shown, %f ms until a tile showed terrain, %i outdated jobs discarded"), Statistics.PreviewTiles, Statistics.AverageTimeToFirstTerrain, Statistics.DiscardedJobs);
+	}
+	if (Statistics.AdaptiveTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Adaptive tessellation: %i tiles, %f%% fewer terrain triangles, %f ms per tile"), Statistics.AdaptiveTiles, Statistics.AverageAdaptiveTriangleReduction, Statistics.AverageAdaptiveTessellationTime);
+	}
+	if (Statistics.LowResolutionCollisionTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Terrain collision: %i tiles, %i triangles and %i bytes to cook per tile, %f%% fewer triangles than rendered"), Statistics.LowResolutionCollisionTiles, Statistics.AverageCollisionTriangles, Statistics.AverageCollisionBytes, Statistics.AverageCollisionTriangleReduction);
+	}
+	if (Statistics.HeightfieldCollisionTiles > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Heightfield collision: %i tiles, %i bytes per tile created in %f ms without cooking"), Statistics.HeightfieldCollisionTiles, Statistics.AverageHeightfieldCollisionBytes, Statistics.AverageHeightfieldCollisionTime);
+	}
+	if (Statistics.HorizonCells > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Horizon: %i sectors with %i triangles"), Statistics.HorizonCells, Statistics.HorizonTriangles);
+	}
+	if (NumberOfTrackSectorsPlannedAhead + NumberOfTrackSectorsPlannedOnGameThread > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Track planning: %i sectors planned ahead, %i sectors planned on the game thread"), NumberOfTrackSectorsPlannedAhead, NumberOfTrackSectorsPlannedOnGameThread);
+	}
+	if (NumberOfMeshUploads > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Mesh uploads: %i updates with %f MB, %i bytes per update"), NumberOfMeshUploads, Statistics.UploadedMeshMegabytes, Statistics.AverageUploadedMeshBytes);
+	}
+	if (Statistics.MeshSections16BitIndices + Statistics.MeshSections32BitIndices > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Index buffers: %i mesh sections with 16 bit and %i with 32 bit indices, average terrain ACMR %f"), Statistics.MeshSections16BitIndices, Statistics.MeshSections32BitIndices, Statistics.AverageTerrainACMR);
+	}
+
+	StopTrackPlanningThread();
+	TileDiskCache.Save();
+	TileDiskCache.Close();
+	Super::EndPlay(EndPlayReason);
+}
+
 void ATerrainManager::CalculateSectorsNeededAroundGivenLocation(const FVector Location, TArray<FIntVector2D>& OUTSectorsNeeded)
 {
 	FIntVector2D BaseSector = CalculateSectorFromLocation(Location);
@@ -82,73 +188,157 @@ void ATerrainManager::CalculateSectorsNeededAroundGivenSector(const FIntVector2D
 	return;
 }
 
-void ATerrainManager::CalculateTrackPath(const TArray<FIntVector2D> SectorsToCreate)
+void ATerrainManager::CalculateTrackPath(const TArray<FIntVector2D>& SectorsToCreate)
 {
-	TArray<FIntVector2D> SectorsToCreateTileFor;
-	SectorsToCreateTileFor.Append(SectorsToCreate);
-
-	while (SectorsToCreateTileFor.Num() > 0)
+	// the track only continues within the requested sectors, a set finds NextTrackSector among them in constant time
+	SectorsWaitingForTrack.Reserve(SectorsWaitingForTrack.Num() + SectorsToCreate.Num());
+	for (const FIntVector2D Sector : SectorsToCreate)
 	{
-		// check if NextTrackSector is contained in tiles that should be created
-		if (!SectorsToCreateTileFor.Contains(NextTrackSector))
+		if (!TrackMapSectors.Contains(Sector))
 		{
-			// all tiles will not have any tracks in them
-			for (FIntVector2D Sector : SectorsToCreateTileFor)
-			{
-				if (!TrackMap.Contains(Sector))
-				{
-					TrackMap.Add(Sector, FSectorTrackInfo());
-				}
-			}
+			SectorsWaitingForTrack.Add(Sector);
+		}
+	}
+	ExtendTrackThroughWaitingSectors();
+}
 
-			SectorsToCreateTileFor.Empty();
-			return;
+void ATerrainManager::ExtendTrackThroughWaitingSectors()
+{
+	// extend the track through every waiting sector it reaches
+	TArray<FPlannedTrackSector> PlannedSectors;
+	bool bIsWaitingForPlanningThread = false;
+	while (SectorsWaitingForTrack.Contains(TrackPlannerState.NextTrackSector))
+	{
+		// the track was planned ahead on the planning thread, the game thread only takes the planned sector
+		FPlannedTrackSector PlannedSector;
+		if (!TakePlannedTrackSector(PlannedSector))
+		{
+			bIsWaitingForPlanningThread = true;
+			break;
 		}
+		SectorsWaitingForTrack.Remove(PlannedSector.Sector);
+		// blocked for a restart of the planning in the same pass
+		TrackMapSectors.Add(PlannedSector.Sector);
+		TrackPlannerState = PlannedSector.State;
+		TakenTrackSectors.Set(TrackPlannerState.PlannedSectors);
+		// the planner's state is not needed anymore, only the sector's track
+		PlannedSector.State = FTrackPlannerState();
+		PlannedSectors.Add(MoveTemp(PlannedSector));
+	}
 
-		// NextTrackSector is contained in SectorsToCreateTileFor -> remove it, calculate track for it, update
-		if (SectorsToCreateTileFor.Remove(NextTrackSector) != 1)
+	// add all sectors to TrackMap, the sectors the track did not reach have no track
+	TrackMap.Reserve(TrackMap.Num() + PlannedSectors.Num() + SectorsWaitingForTrack.Num());
+	for (FPlannedTrackSector& PlannedSector : PlannedSectors)
+	{
+		if (PlannedSector.TrackInfo.bSectorHasTrack)
 		{
-			UE_LOG(LogTemp, Error, TEXT("Removed none or more than one occurence of NextTrackSector in CalculateTrackPointsInSectors in %s"), *GetName());
+			TrackSplineIndex.AddSector(PlannedSector.Sector, PlannedSector.TrackInfo.PointsOnBezierCurve);
 		}
+		if (PlannedSector.TrackInfo.CheckpointID != -1)
+		{
+			CheckpointSectors.Add(PlannedSector.TrackInfo.CheckpointID, PlannedSector.Sector);
+		}
+		if (PlannedSector.TrackInfo.bHasPlayerSpawn && GameMode)
+		{
+			GameMode->SetPlayerSpawn(PlannedSector.TrackInfo.PlayerSpawnTransform);
+		}
+		TrackMap.Add(PlannedSector.Sector, MoveTemp(PlannedSector.TrackInfo));
+	}
+	// the track may still reach the remaining sectors once the planning thread got further, their tiles keep waiting
+	if (bIsWaitingForPlanningThread) { return; }
 
-		if (!TrackMap.Contains(NextTrackSector))
+	for (const FIntVector2D Sector : SectorsWaitingForTrack)
+	{
+		TrackMap.Add(Sector, FSectorTrackInfo());
+		TrackMapSectors.Add(Sector);
+	}
+	SectorsWaitingForTrack.Reset();
+}
+
+void ATerrainManager::QueueTilesWaitingForTrack()
+{
+	for (int32 i = 0; i < TilesWaitingForTrack.Num(); )
+	{
+		ATerrainTile* Tile = TilesWaitingForTrack[i];
+		if (SectorsWaitingForTrack.Contains(Tile->GetCurrentSector()))
 		{
-			FSectorTrackInfo TrackInfo = CalculateNewNextTrackSector();
-			// !!! CurrentTrackSector now has the value of NextTrackSector !!!
+			++i;
+			continue;
+		}
+		TilesWaitingForTrack.RemoveAt(i);
+		EnqueueTerrainJob(Tile, true);
+	}
+}
 
-			// PreviousTrackSector and FollowingTrackSector are used to calculate the entry and exit point
+bool ATerrainManager::TakePlannedTrackSector(FPlannedTrackSector& OUTPlannedSector)
+{
+	if (TrackPlanningThread == nullptr)
+	{
+		// without planning thread, see bPlanTrackInBackground, the game thread plans the track itself
+		FTrackPlannerState State = TrackPlannerState;
+		TrackPlanner.PlanNextSector(State, BlockedTrackSectors, OUTPlannedSector);
+		NumberOfTrackSectorsPlannedOnGameThread++;
 
-			FVector2D EntryPoint;
-			FVector2D ExitPoint;
+		// the following sector got a tile without track after it was planned, so the track has to go somewhere else
+		if (OUTPlannedSector.TrackInfo.bSectorHasTrack && TrackMapSectors.Contains(OUTPlannedSector.TrackInfo.FollowingTrackSector))
+		{
+			RestartTrackPlanning();
+			State = TrackPlannerState;
+			TrackPlanner.PlanNextSector(State, BlockedTrackSectors, OUTPlannedSector);
+			NumberOfTrackSectorsPlannedOnGameThread++;
+		}
+		return true;
+	}
+
+	FPlannedTrackSector PlannedSector;
+	while (PlannedTrackQueue.Dequeue(PlannedSector))
+	{
+		if (PlannedSector.Generation == TrackPlanningGeneration)
+		{
+			PlannedTrack.Add(MoveTemp(PlannedSector));
+		}
+	}
+	// sectors that were planned on the game thread in the meantime
+	int32 NumberOfOutdatedSectors = 0;
+	while (NumberOfOutdatedSectors < PlannedTrack.Num() && PlannedTrack[NumberOfOutdatedSectors].State.PlannedSectors <= TrackPlannerState.PlannedSectors)
+	{
+		NumberOfOutdatedSectors++;
+	}
+	PlannedTrack.RemoveAt(0, NumberOfOutdatedSectors, false);
 
-			CalculateEntryExitPoints(TrackInfo, EntryPoint, ExitPoint);
-			TrackInfo.TrackEntryPoint = EntryPoint;
-			TrackInfo.TrackExitPoint = ExitPoint;
+	// the planning thread did not get that far yet
+	if (PlannedTrack.Num() == 0) { return false; }
 
-			// calculate exit point elevation
-			CalculateTrackExitPointElevation(CurrentTrackSector, TrackInfo, TrackInfo.TrackExitPointElevation);	
-			CalculateBezierControlPoints(CurrentTrackSector, TrackInfo, TrackInfo.FirstBezierControlPoint, TrackInfo.SecondBezierControlPoint);
+	// the following sector got a tile without track after it was planned, so the track has to go somewhere else
+	// the planning thread plans the sector again with that sector blocked
+	const FPlannedTrackSector& NextPlannedSector = PlannedTrack[0];
+	if (NextPlannedSector.Sector != TrackPlannerState.NextTrackSector || (NextPlannedSector.TrackInfo.bSectorHasTrack && TrackMapSectors.Contains(NextPlannedSector.TrackInfo.FollowingTrackSector)))
+	{
+		RestartTrackPlanning();
+		return false;
+	}
 
-			TrackInfo.CheckpointID = NextAvailableCheckPointID;
-			NextAvailableCheckPointID++;
+	OUTPlannedSector = MoveTemp(PlannedTrack[0]);
+	PlannedTrack.RemoveAt(0, 1, false);
+	NumberOfTrackSectorsPlannedAhead++;
+	return true;
+}
 
-			// calculate points on bezier curve
-			CalculatePointsOnBezierCurve(CurrentTrackSector, TrackInfo, TrackInfo.PointsOnBezierCurve);
+void ATerrainManager::RestartTrackPlanning()
+{
+	TrackPlanningGeneration++;
+	PlannedTrack.Reset();
 
-			// Calculate Y0 and Y1
-			CalculateY0Y1(TrackInfo.PointsOnBezierCurve, TrackInfo.TrackExitPointElevation, TrackInfo.Y0Position, TrackInfo.Y1Position);
+	BlockedTrackSectors = TrackMapSectors;
 
-			// add to TrackMap
-			TrackMap.Add(CurrentTrackSector, TrackInfo);
-		}
-		else
-		{
-			// this case should not happen
-			UE_LOG(LogTemp, Error, TEXT("NextTrackSector was found in TrackMap, which means it was already calculated!"));
-		}
-		
+	if (TrackPlanningThread)
+	{
+		FTrackPlanningRestart Restart;
+		Restart.Generation = TrackPlanningGeneration;
+		Restart.State = TrackPlannerState;
+		Restart.BlockedSectors = BlockedTrackSectors;
+		TrackPlanningRestartQueue.Enqueue(MoveTemp(Restart));
 	}
-
 }
 
 void ATerrainManager::GetAdjacentSectors(const FIntVector2D Sector, TArray<FIntVector2D>& OUTAdjacentSectors)
@@ -176,541 +366,748 @@ void ATerrainManager::GetRelevantAdjacentSectors(const FIntVector2D Sector, TArr
 	return;
 }
 
-FSectorTrackInfo ATerrainManager::CalculateNewNextTrackSector()
+// Called every frame
+void ATerrainManager::Tick(float DeltaTime)
 {
-	// get all possible next sectors
-	TArray<FIntVector2D> PossibleSectors;
-
-	FIntVector2D LeftDirection = NextTrackSector - FIntVector2D(0, 1);
-	FIntVector2D UpDirection = NextTrackSector + FIntVector2D(1, 0);
-	FIntVector2D RightDirection = NextTrackSector + FIntVector2D(0, 1);
-	FIntVector2D DownDirection = NextTrackSector - FIntVector2D(1, 0);
+	Super::Tick(DeltaTime);
 
-	FSectorTrackInfo TrackInfo = FSectorTrackInfo();
+	// check if free tiles can be deleted
+	ShrinkTilePool();
 
-	// check if this is the first track we create -> all directions possible
-	if (NextTrackSector == FIntVector2D(0, 0) && CurrentTrackSector == FIntVector2D(0, 0))
+	// the planning thread may have planned the track of waiting sectors by now
+	if (SectorsWaitingForTrack.Num() > 0)
 	{
-		PossibleSectors.Add(LeftDirection);
-		PossibleSectors.Add(UpDirection);
-		PossibleSectors.Add(RightDirection);
-		PossibleSectors.Add(DownDirection);
+		ExtendTrackThroughWaitingSectors();
 	}
-	else
+	if (TilesWaitingForTrack.Num() > 0)
 	{
+		QueueTilesWaitingForTrack();
+	}
 
-		// left of our current NextTrackSector
-		if (CheckupSector(LeftDirection))
-		{
-			PossibleSectors.Add(LeftDirection);
-		}
-		// right
-		if (CheckupSector(RightDirection))
-		{
-			PossibleSectors.Add(RightDirection);
-		}
-		// up
-		if (CheckupSector(UpDirection))
+	// check if we need to create mesh data
+	// with progressive generation all pending jobs are handed out at once, since workers create previews of new jobs before refining older ones
+	const int32 JobsToDistribute = (TerrainSettings.bProgressiveTileGeneration && TerrainSettings.NumberOfThreadsToUse > 0) ? MAX_int32 : TerrainSettings.NumberOfThreadsToUse;
+	for (int i = 0; i < JobsToDistribute; ++i)
+	{
+		FTerrainJob Job;
+		// TODO check if we need a limit on mesh data (Job) memory usage
+		if (PendingTerrainJobQueue.Dequeue(Job))
 		{
-			PossibleSectors.Add(UpDirection);
+			if (!bHasTileBeenAddedToQueue)
+			{
+				bHasTileBeenAddedToQueue = true;
+			}
+			TilesInProcessCounter++;
+			TerrainCreationQueue[i % TerrainSettings.NumberOfThreadsToUse].Enqueue(Job);
 		}
-		// down
-		if (CheckupSector(DownDirection))
+		else
 		{
-			PossibleSectors.Add(DownDirection);
+			break;
 		}
 	}
 
-	if (PossibleSectors.Num() == 0)
+	// check if we need to update mesh data
+	for (int i = 0; i < TerrainSettings.MeshUpdatesPerFrame; ++i)
 	{
-		UE_LOG(LogTemp, Error, TEXT("No possible NextTrackSector could be determined!"));
-		return TrackInfo;
-	}
-	TrackInfo.bSectorHasTrack = true;
-
-	// draw random direction
-	int32 RandomVariable = FMath::RandRange(0, PossibleSectors.Num() - 1);
-	
-	// update previous track sector of NextTrackSector
-	TrackInfo.PreviousTrackSector = CurrentTrackSector;
-
-	CurrentTrackSector = NextTrackSector;
-
-	// include CurrentTrackSector in the no-go quad
-	AdjustQuad();
-
-	NextTrackSector = PossibleSectors[RandomVariable];
+		FTerrainJob Job;
+		if (FinishedJobQueue.Dequeue(Job))
+		{
+			// a preview is followed by the refined job of the same tile
+			if (!Job.bIsPreview)
+			{
+				TilesInProcessCounter--;
+			}
+			if (Job.TerrainTile == nullptr)
+			{
+				UE_LOG(LogTemp, Error, TEXT("TerrainTile pointer in Job is nullptr!"));
+			}
+			// the tile got a newer job or was freed while the job was processed, the newer job creates the terrain
+			else if (Job.JobSerial != Job.TerrainTile->GetLatestJobSerial())
+			{
+				TilePoolStatistics.DiscardedJobs++;
+			}
+			else
+			{
+				if (bShouldCheckSectorsNeedCoverageForReset)
+				{
+					SectorsNeedCoverageForReset.Remove(Job.TerrainTile->GetCurrentSector());
+				}
+				// a tile may have been retained while its job was processed, it does not cover its sector until it is used again
+				if (!Job.TerrainTile->IsTileRetained())
+				{
+					SectorsCurrentlyProcessed.AddUnique(Job.TerrainTile->GetCurrentSector());
+				}
+				/* check if we need to recalculate the tile 'behind' our track start point to match the border elevations */
+				if (!Job.bIsPreview && !bRecalculatedTileBehindStartPoint && Job.TerrainTile->GetCurrentSector() == FIntVector2D(0, 0))
+				{
+					bRecalculatedTileBehindStartPoint = true;
+					FSectorTrackInfo TrackInfo = TrackMap.FindRef(FIntVector2D(0, 0));
 
-	// update following sector of Current track sector (= previous Next track sector)
-	TrackInfo.FollowingTrackSector = NextTrackSector;
+					// calculate which sector lies 'behind' track entry point
+					FVector2D EntryPoint = TrackInfo.TrackEntryPoint;
+					float EdgeSize = TerrainSettings.TileEdgeSize;
+					// entry point is at the top?
+					if (EntryPoint.X > 0.75 * EdgeSize)
+					{
+						RecalculateTileForSector(FIntVector2D(1, 0));
+					}
+					// entry point at bottom?
+					else if (EntryPoint.X < 0.25 * EdgeSize)
+					{
+						RecalculateTileForSector(FIntVector2D(-1, 0));
+					}
+					// entry point left?
+					else if (EntryPoint.Y < 0.25 * EdgeSize)
+					{
+						RecalculateTileForSector(FIntVector2D(0, -1));
+					}
+					// entry point right?
+					else if (EntryPoint.Y > 0.75 * EdgeSize)
+					{
+						RecalculateTileForSector(FIntVector2D(0, 1));
+					}
+				}
+				if (Job.TerrainTile->GetTileStatus() != ETileStatus::TILE_FINISHED)
+				{
+					NumberOfFirstTerrains++;
+					TotalTimeToFirstTerrain += GetWorld()->TimeSeconds - Job.QueuedTime;
+				}
+				ExpandCompactTerrain(Job);
+				TotalUploadedMeshBytes += Job.TerrainTile->UpdateMeshData(TerrainSettings, Job.MeshData);
+				NumberOfMeshUploads++;
+				UpdateTileCollision(Job.TerrainTile, Job.CollisionVertices, Job.CollisionTriangles, Job.CollisionHeightfield);
+				Job.TerrainTile->SetCompactTerrain(TerrainSettings.bIncrementalBorderRegeneration && !Job.bIsPreview ? Job.CompactTerrain : FCompactTerrainTile());
+				for (const FMeshData& MeshData : Job.MeshData)
+				{
+					if (MeshData.VertexBuffer.Num() == 0) { continue; }
+					if (MeshData.CanUse16BitIndices()) { TilePoolStatistics.MeshSections16BitIndices++; }
+					else { TilePoolStatistics.MeshSections32BitIndices++; }
+				}
+				// the horizon around the sector continues the tile's new borders and leaves the sector out
+				Horizon.RegenerateCellsAround(Job.Sector);
+				if (Job.bIsPreview)
+				{
+					TilePoolStatistics.PreviewTiles++;
+				}
+				else if (!Job.bServedFromCache)
+				{
+					if (Job.CompactTerrain.IsValid())
+					{
+						TilePoolStatistics.CompactTiles++;
+						TotalCompactTileBytes += Job.CompactTerrain.GetAllocatedSize();
+						TilePoolStatistics.MaximumCompactTileHeightError = FMath::Max(TilePoolStatistics.MaximumCompactTileHeightError, Job.CompactTerrainHeightError);
+					}
+					const int32 TerrainTriangles = Job.MeshData.IsValidIndex(TerrainMeshSection) ? Job.MeshData[TerrainMeshSection].TriangleBuffer.Num() / 3 : 0;
+					if (Job.TriangleEdgeIterations < TerrainSettings.FractalNoiseTerrainSettings.TriangleEdgeIterations)
+					{
+						TilePoolStatistics.ReducedDetailTiles++;
+						TotalReducedDetailTileTriangles += TerrainTriangles;
+						TotalReducedDetailTileGenerationTime += Job.GenerationTime;
+					}
+					else
+					{
+						NumberOfFullDetailTiles++;
+						TotalFullDetailTileTriangles += TerrainTriangles;
+						TotalFullDetailTileGenerationTime += Job.GenerationTime;
+					}
+					AddFinishedJobToTileCache(Job);
+				}
+			}
+		}
+	}
 
-	return TrackInfo;
-}
+	UpdateHorizon();
 
-bool ATerrainManager::CheckSectorWithinQuad(const FIntVector2D Sector)
-{
-	if (Sector.X <= TopLeftCorner.X && Sector.X >= BottomLeftCorner.X && Sector.Y >= TopLeftCorner.Y && Sector.Y <= TopRightCorner.Y)
+	// check if we can spawn the player
+	if (bHasTileBeenAddedToQueue && TilesInProcessCounter == 0 && TilesWaitingForTrack.Num() == 0 && RemainingPlayersToSpawn > 0)
 	{
-		return true;
+		RemainingPlayersToSpawn--;
+		// notify gamemode to spawn player
+		if (GameMode)
+		{
+			GameMode->SpawnPlayerFromTerrainManager(TerrainSettings.TransitionElevationOffset, TerrainSettings.TransitionInterpolationSpeed, TerrainSettings.TransitionDeltaToStop);
+		}
 	}
-	else
+
+	if (bShouldCheckSectorsNeedCoverageForReset)
 	{
-		return false;
+		if (SectorsNeedCoverageForReset.Num() == 0)
+		{
+			// notify game mode
+			UWorld* World = GetWorld();
+			if (World)
+			{
+				AHoverTestGameModeProceduralLevel* GameMode = Cast<AHoverTestGameModeProceduralLevel>(World->GetAuthGameMode());
+				if (GameMode)
+				{
+					GameMode->AllowDefaultPawnToTransitionToEndLocation();
+					bShouldCheckSectorsNeedCoverageForReset = false;
+					// just in case
+					SectorsNeedCoverageForReset.Empty();
+				}
+			}
+		}
 	}
 }
 
-bool ATerrainManager::CheckupSector(const FIntVector2D Sector)
+void ATerrainManager::CreateAndInitializeTiles(int32 NumberOfTilesToCreate)
 {
-	if (!TrackMap.Contains(Sector))
+	for (int i = 0; i < NumberOfTilesToCreate; ++i)
 	{
-		// not yet calculated -> check if it lies within our no-go quad
-		if (!CheckSectorWithinQuad(Sector))
+		ATerrainTile* Tile = GetWorld()->SpawnActor<ATerrainTile>(FVector(0.f, 0.f, 0.f), FRotator(0.f, 0.f, 0.f), FActorSpawnParameters());
+		// at first spawn them all at the same location
+		if (Tile == nullptr)
+		{
+			UE_LOG(LogTemp, Error, TEXT("SpawnActor return pointer is nullptr"));
+		}
+		else
 		{
-			return true;
+			Tile->SetupTile(TerrainSettings, FIntVector2D(0, 0));
+			FreeTiles.Add(Tile);
+			TilePoolStatistics.TilesSpawned++;
 		}
+
 	}
-	return false;
 }
 
-void ATerrainManager::CalculateEntryExitPoints(const FSectorTrackInfo TrackInfo, FVector2D & OUTEntryPoint, FVector2D & OUTExitPoint)
+ATerrainTile* ATerrainManager::GetTileFromPool()
 {
-	// exit point
-	if (TrackInfo.FollowingTrackSector == CurrentTrackSector + FIntVector2D(1, 0))
-	{
-		// Top
-		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize / 2.f);
-	}
-	else if (TrackInfo.FollowingTrackSector == CurrentTrackSector + FIntVector2D(0, 1))
+	// rather reuse the oldest retained tile than spawning new ones
+	if (FreeTiles.Num() == 0 && RetainedTiles.Num() > 0)
 	{
-		// Right
-		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize);
+		EvictOldestRetainedTile();
 	}
-	else if (TrackInfo.FollowingTrackSector == CurrentTrackSector - FIntVector2D(1, 0))
+
+	if (FreeTiles.Num() > 0)
 	{
-		// Bottom
-		OUTExitPoint = FVector2D(0.f, TerrainSettings.TileEdgeSize / 2.f);
+		TilePoolStatistics.PoolHits++;
 	}
-	else if (TrackInfo.FollowingTrackSector == CurrentTrackSector - FIntVector2D(0, 1))
+	else
 	{
-		// Left
-		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, 0.f);
+		TilePoolStatistics.PoolMisses++;
+		UE_LOG(LogTemp, Warning, TEXT("Tile pool of %s ran empty, spawning %i additional tiles"), *GetName(), FMath::Max(TerrainSettings.TilePoolGrowBatchSize, 1));
+		CreateAndInitializeTiles(FMath::Max(TerrainSettings.TilePoolGrowBatchSize, 1));
+		if (FreeTiles.Num() == 0)
+		{
+			return nullptr;
+		}
 	}
+	// the most recently freed tile is used first, so tiles at the front of FreeTiles are the ones that were unused the longest
+	return FreeTiles.Pop();
+}
 
-	// special case: start of the game, where CurrentTrackSector == (0,0)
-	if (CurrentTrackSector == FIntVector2D())
+bool ATerrainManager::AssignTileToSector(const FIntVector2D Sector, const bool bAssociateActor)
+{
+	// a retained tile already contains the terrain for the sector, so no terrain job is needed
+	ATerrainTile* RetainedTile = TakeRetainedTile(Sector);
+	if (RetainedTile)
 	{
-		// entry point needs to be at the opposite direction of exit point
-		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize) - OUTExitPoint;
-		return;
+		RetainedTile->RestoreRetainedTile();
+		if (bAssociateActor)
+		{
+			RetainedTile->AddAssociatedActor();
+		}
+		TilesInUse.Add(RetainedTile);
+		SectorsCurrentlyProcessed.AddUnique(Sector);
+		SectorsNeedCoverageForReset.Remove(Sector);
+		Horizon.MarkSectorChanged(Sector);
+		TilePoolStatistics.RetentionHits++;
+		TilePoolStatistics.PeakTilesInUse = FMath::Max(TilePoolStatistics.PeakTilesInUse, TilesInUse.Num());
+		return true;
 	}
 
-	// entry point
-	if (TrackInfo.PreviousTrackSector == CurrentTrackSector + FIntVector2D(1, 0))
-	{
-		// Top
-		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize / 2.f);
-	}
-	else if (TrackInfo.PreviousTrackSector == CurrentTrackSector + FIntVector2D(0, 1))
+	ATerrainTile* Tile = GetTileFromPool();
+	if (Tile == nullptr)
 	{
-		// Right
-		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize);
+		UE_LOG(LogTemp, Error, TEXT("Could not get a tile from the tile pool for sector %s in %s"), *Sector.ToString(), *GetName());
+		return false;
 	}
-	else if (TrackInfo.PreviousTrackSector == CurrentTrackSector - FIntVector2D(1, 0))
+
+	Tile->UpdateTilePosition(TerrainSettings, Sector);
+	if (bAssociateActor)
 	{
-		// Bottom
-		OUTEntryPoint = FVector2D(0.f, TerrainSettings.TileEdgeSize / 2.f);
+		Tile->AddAssociatedActor();
 	}
-	else if (TrackInfo.PreviousTrackSector == CurrentTrackSector - FIntVector2D(0, 1))
+	TilesInUse.Add(Tile);
+	EnqueueTerrainJob(Tile, true);
+
+	// the pool should be able to hold at least as many tiles as were needed at the same time
+	if (TilesInUse.Num() > TilePoolStatistics.PeakTilesInUse)
 	{
-		// Left
-		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, 0.f);
+		TilePoolStatistics.PeakTilesInUse = TilesInUse.Num();
+		TilePoolTargetSize = FMath::Max(TilePoolTargetSize, TilePoolStatistics.PeakTilesInUse + TerrainSettings.AdditionalPooledTiles + TerrainSettings.NumberOfRetainedTiles);
 	}
-
-	return;
+	return true;
 }
 
-void ATerrainManager::AdjustQuad()
+void ATerrainManager::ShrinkTilePool()
 {
-	if (CurrentTrackSector.X > TopLeftCorner.X)
+	const int32 PoolSize = FreeTiles.Num() + TilesInUse.Num() + RetainedTiles.Num();
+	if (!bIsTilePoolShrinking)
 	{
-		TopLeftCorner.X = CurrentTrackSector.X;
-		TopRightCorner.X = CurrentTrackSector.X;
+		if (PoolSize <= TilePoolTargetSize + TerrainSettings.TilePoolShrinkHysteresis)
+		{
+			return;
+		}
+		bIsTilePoolShrinking = true;
 	}
 
-	if (CurrentTrackSector.X < BottomLeftCorner.X)
+	int32 TilesToDelete = PoolSize - TilePoolTargetSize;
+	// tiles at the front of FreeTiles have been unused the longest
+	for (int32 i = 0; i < FreeTiles.Num() && TilesToDelete > 0; )
 	{
-		BottomLeftCorner.X = CurrentTrackSector.X;
-		BottomRightCorner.X = CurrentTrackSector.X;
+		ATerrainTile* Tile = FreeTiles[i];
+		if (Tile->GetTileStatus() == ETileStatus::TILE_FREE && GetWorld()->TimeSeconds - Tile->GetTimeSinceTileFreed() >= TerrainSettings.SecondsUntilFreeTileGetsDeleted)
+		{
+			FreeTiles.RemoveAt(i);
+			Tile->Destroy();
+			TilePoolStatistics.TilesDestroyed++;
+			TilesToDelete--;
+		}
+		else
+		{
+			++i;
+		}
 	}
 
-	if (CurrentTrackSector.Y > TopRightCorner.Y)
+	if (TilesToDelete <= 0)
 	{
-		TopRightCorner.Y = CurrentTrackSector.Y;
-		BottomRightCorner.Y = CurrentTrackSector.Y;
+		bIsTilePoolShrinking = false;
 	}
+}
+
+void ATerrainManager::ReleaseTile(ATerrainTile* Tile)
+{
+	if (Tile == nullptr) { return; }
 
-	if (CurrentTrackSector.Y < TopLeftCorner.Y)
+	SectorsCurrentlyProcessed.Remove(Tile->GetCurrentSector());
+	TilesWaitingForTrack.Remove(Tile);
+	// the horizon covers the sector again
+	Horizon.MarkSectorChanged(Tile->GetCurrentSector());
+	if (TerrainSettings.NumberOfRetainedTiles > 0 && Tile->GetTileStatus() == ETileStatus::TILE_FINISHED)
 	{
-		TopLeftCorner.Y = CurrentTrackSector.Y;
-		BottomLeftCorner.Y = CurrentTrackSector.Y;
+		Tile->RetainTile();
+		RetainedTiles.Add(Tile);
+		while (RetainedTiles.Num() > TerrainSettings.NumberOfRetainedTiles)
+		{
+			EvictOldestRetainedTile();
+		}
+	}
+	else
+	{
+		Tile->FreeTile();
+		FreeTiles.Add(Tile);
 	}
+}
 
-	return;
+void ATerrainManager::EvictOldestRetainedTile()
+{
+	if (RetainedTiles.Num() == 0) { return; }
 
+	ATerrainTile* Tile = RetainedTiles[0];
+	RetainedTiles.RemoveAt(0);
+	Tile->FreeTile();
+	FreeTiles.Add(Tile);
 }
 
-bool ATerrainManager::CalculateTrackExitPointElevation(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, float& OUTExitPointElevation)
+void ATerrainManager::GetRetainedTileBorders(const FIntVector2D Sector, TArray<FAdjacentTileBorder>& OUTBorders) const
 {
-	//UE_LOG(LogTemp, Error, TEXT("Track exit point elevations for sector %s"), *Sector.ToString());
-	if (Sector == FIntVector2D(0, 0))
+	OUTBorders.Reset();
+	for (const ATerrainTile* Tile : RetainedTiles)
 	{
-		// very first sector, use default elevation for entry point height
-		OUTExitPointElevation = TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight + (UMyStaticLibrary::GetNormalDistribution(TerrainSettings.TrackGenerationSettings.Steepness_Mean, TerrainSettings.TrackGenerationSettings.Steepness_Deviation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
-		//UE_LOG(LogTemp, Warning, TEXT("Exit point elevation is %f"), OUTExitPointElevation);
-		//OUTExitPointElevation = TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight + FMath::RandRange(-TerrainSettings.TrackGenerationSettings.MaximumElevationDifference, TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
-		return true;
+		FAdjacentTileBorder Border;
+		if (Tile->GetBorderToSector(Sector, Border))
+		{
+			OUTBorders.Add(MoveTemp(Border));
+		}
 	}
-	const FSectorTrackInfo PreviousTrackInfo = TrackMap.FindRef(TrackInfo.PreviousTrackSector);
-	if (!TrackMap.Contains(TrackInfo.PreviousTrackSector))
+}
+
+ATerrainTile* ATerrainManager::TakeRetainedTile(const FIntVector2D Sector)
+{
+	for (int32 i = 0; i < RetainedTiles.Num(); ++i)
 	{
-		//UE_LOG(LogTemp, Error, TEXT("Could not find previous track sector %s in function CalculateTrackExitPointElevation for sector %s"), *TrackInfo.PreviousTrackSector.ToString(), *Sector.ToString());
-		return false;
+		if (RetainedTiles[i]->GetCurrentSector() == Sector)
+		{
+			ATerrainTile* Tile = RetainedTiles[i];
+			RetainedTiles.RemoveAt(i);
+			return Tile;
+		}
 	}
-	// calculate exit elevation: exit elevation <-- start elevation + Random[-MaximumElevationDifference, MaximumElevationDifference]
-	OUTExitPointElevation = PreviousTrackInfo.TrackExitPointElevation + (UMyStaticLibrary::GetNormalDistribution(TerrainSettings.TrackGenerationSettings.Steepness_Mean, TerrainSettings.TrackGenerationSettings.Steepness_Deviation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
-	//UE_LOG(LogTemp, Warning, TEXT("Exit point elevation is %f"), OUTExitPointElevation);
-	//OUTExitPointElevation = PreviousTrackInfo.TrackExitPointElevation + FMath::RandRange(-TerrainSettings.TrackGenerationSettings.MaximumElevationDifference, TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
-	return true;
-
+	return nullptr;
 }
 
-void ATerrainManager::CalculateBezierControlPoints(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, FVector & OUTControlPointOne, FVector & OUTControlPointTwo)
+void ATerrainManager::EnqueueTerrainJob(ATerrainTile* Tile, const bool bAllowTileCache)
 {
-	if (Sector != FIntVector2D(0,0) && !TrackMap.Contains(TrackInfo.PreviousTrackSector))
+	// the track of the sector is not known yet, the job is queued once the planning thread planned that far, see QueueTilesWaitingForTrack
+	if (SectorsWaitingForTrack.Contains(Tile->GetCurrentSector()))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Could not find previous track sector of sector %s in TrackMap."), *Sector.ToString());
+		TilesWaitingForTrack.AddUnique(Tile);
 		return;
 	}
-	FSectorTrackInfo PreviousTrackInfo = TrackMap.FindRef(TrackInfo.PreviousTrackSector);
-	const FVector2D MiddlePoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize / 2.f);
 
-	FVector ControlPoint1;
-	FVector ControlPoint2;
-	/**
-	 * first control point is:
-	 *		vector of second control point of previous sector to end point of previous sector (called 'Vector')
-	 *		added to start point of current sector (called 'EntryPoint')
-	 */
-	if (Sector == FIntVector2D(0, 0))
+	FTerrainJob Job;
+	Job.TerrainTile = Tile;
+	Job.Sector = Tile->GetCurrentSector();
+	// jobs queued for the tile before are outdated, also if they are for the same sector
+	Job.JobSerial = Tile->BeginTerrainJob();
+	Job.TriangleEdgeIterations = CalculateTileTriangleEdgeIterations(Job.Sector);
+	// the tile's current terrain gets replaced
+	Tile->SetCompactTerrain(FCompactTerrainTile());
+	Job.QueuedTime = GetWorld()->TimeSeconds;
+	// the checkpoint's transform is known from the track planning, so it does not wait for the terrain
+	SpawnCheckpointForTile(Tile);
+
+	// cached tiles with less detail than needed are generated again, cached tiles with more detail can be used as they are
+	const int32 MinimumGridSize = FTerrainHeightfield::CalculateGridSize(Job.TriangleEdgeIterations);
+	const FCachedTerrainTile* CachedTile = bAllowTileCache ? TileCache.Find(FTerrainTileCacheKey(Job.Sector, GenerationSettingsHash)) : nullptr;
+	if (CachedTile && (CachedTile->Terrain.GridSize < MinimumGridSize || CachedTile->TrackHash != CalculateSectorTrackHash(Job.Sector)))
 	{
-		// default control point one to tile middle with default entry point height in case we have no control point in a previous sector
-		ControlPoint1 = FVector(MiddlePoint, TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight);
+		CachedTile = nullptr;
 	}
-	else
+	// tile read from the persistent tile cache
+	FCachedTerrainTile LoadedTile;
+	bool bIsLoadedTile = false;
+	if (CachedTile == nullptr && bAllowTileCache && LoadTileFromDiskCache(Job.Sector, MinimumGridSize, LoadedTile))
 	{
-		FVector Vector = FVector(PreviousTrackInfo.TrackExitPoint, PreviousTrackInfo.TrackExitPointElevation) - PreviousTrackInfo.SecondBezierControlPoint;
-		FVector EntryPoint = FVector(TrackInfo.TrackEntryPoint, PreviousTrackInfo.TrackExitPointElevation);
-		ControlPoint1 = EntryPoint + Vector;
+		CachedTile = &LoadedTile;
+		bIsLoadedTile = true;
 	}
+	if (CachedTile == nullptr)
+	{
+		// tiles that already show terrain are only refined, they don't need a preview
+		if (TerrainSettings.bProgressiveTileGeneration && Tile->GetTileStatus() != ETileStatus::TILE_FINISHED)
+		{
+			Job.PreviewTriangleEdgeIterations = TerrainSettings.PreviewTriangleEdgeIterations;
+		}
+		Tile->SetTriangleEdgeIterations(Job.TriangleEdgeIterations);
+		SetJobTrackInfo(Job);
+		GetRetainedTileBorders(Job.Sector, Job.RetainedTileBorders);
+		PendingTerrainJobQueue.Enqueue(Job);
+		return;
+	}
+	Job.TriangleEdgeIterations = FTerrainHeightfield::CalculateTriangleEdgeIterations(CachedTile->Terrain.GridSize);
+	Tile->SetTriangleEdgeIterations(Job.TriangleEdgeIterations);
 
-	//UE_LOG(LogTemp, Error, TEXT("Bezier control points for sector %s"), *Sector.ToString());
-	//UE_LOG(LogTemp, Warning, TEXT("First control point %s"), *ControlPoint1.ToString());
-
-	/**
-	 * calculation of control point 2 follows instructions given by Michael Franke in 'Dynamische Streckengenerierung und deren Einbettung in ein Terrain' in 2011
-	 */
-	//float RandomNumber = UMyStaticLibrary::GetNormalDistribution(TerrainSettings.TrackGenerationSettings.CURVINESS_MEAN, TerrainSettings.TrackGenerationSettings.Curviness, 0.f, 1.f);
-	float RandomNumber = UMyStaticLibrary::GetNormalDistribution(TerrainSettings.TrackGenerationSettings.CURVINESS_MEAN, TerrainSettings.TrackGenerationSettings.CurvinessDisplacement, -0.5f, 0.5f);
-	float Displacement = RandomNumber * (TerrainSettings.TileEdgeSize / 4.f);
-	//UE_LOG(LogTemp, Warning, TEXT("Second control point displacement: %f"), Displacement);
-	// vector from middle point to track exit point
-	FVector2D LineEndPointMiddlePoint = TrackInfo.TrackExitPoint - MiddlePoint;
-	// point halfway between middle point and track exit point
-	FVector2D EndPointMiddlePointHalf = MiddlePoint + (LineEndPointMiddlePoint / 2.f);
-	// control point before rotation is applied
-	FVector2D IntermediatePoint = EndPointMiddlePointHalf + (LineEndPointMiddlePoint.GetSafeNormal() * Displacement);
-
-	float RotationAngle = UMyStaticLibrary::GetNormalDistribution(0.f, TerrainSettings.TrackGenerationSettings.CurvinessRotation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumRotationAngle;
-
-	//UE_LOG(LogTemp, Warning, TEXT("Second control point rotation angle: %f"), RotationAngle);
-
-	float Angle = RotationAngle * (UKismetMathLibrary::GetPI() / 180.f);	// convert to radians
-
-	ControlPoint2.X = FMath::Cos(Angle) * (IntermediatePoint.X - TrackInfo.TrackExitPoint.X) -
-		FMath::Sin(Angle) * (IntermediatePoint.Y - TrackInfo.TrackExitPoint.Y) + TrackInfo.TrackExitPoint.X;
-	ControlPoint2.Y = FMath::Sin(Angle) * (IntermediatePoint.X - TrackInfo.TrackExitPoint.X) +
-		FMath::Cos(Angle) * (IntermediatePoint.Y - TrackInfo.TrackExitPoint.Y) + TrackInfo.TrackExitPoint.Y;
-
-	float AverageElevation = PreviousTrackInfo.TrackExitPointElevation + (TrackInfo.TrackExitPointElevation - PreviousTrackInfo.TrackExitPointElevation) / 2.f;
-	ControlPoint2.Z = UMyStaticLibrary::GetNormalDistribution(AverageElevation, TerrainSettings.TrackGenerationSettings.Hilliness);
-
-	//UE_LOG(LogTemp, Warning, TEXT("Second control point %s"), *ControlPoint2.ToString());
-
-	OUTControlPointOne = ControlPoint1;
-	OUTControlPointTwo = ControlPoint2;
-
-}
+	// apply everything the worker would have set on the tile
+	TArray<FBorderVertex> VerticesLeftBorder;
+	TArray<FBorderVertex> VerticesRightBorder;
+	TArray<FBorderVertex> VerticesTopBorder;
+	TArray<FBorderVertex> VerticesBottomBorder;
+	FTerrainHeightfield::GetBorderVertices(CachedTile->Terrain, VerticesLeftBorder, VerticesRightBorder, VerticesTopBorder, VerticesBottomBorder);
+	Tile->SetVerticesLeftBorder(VerticesLeftBorder);
+	Tile->SetVerticesRightBorder(VerticesRightBorder);
+	Tile->SetVerticesTopBorder(VerticesTopBorder);
+	Tile->SetVerticesBottomBorder(VerticesBottomBorder);
+	Tile->SetBottomLeftCorner(CachedTile->BottomLeftCorner);
+	Tile->SetBottomRightCorner(CachedTile->BottomRightCorner);
+	Tile->SetTopRightCorner(CachedTile->TopRightCorner);
+	Tile->SetTopLeftCorner(CachedTile->TopLeftCorner);
+	Tile->AllVerticesOnBorderSet();
 
-void ATerrainManager::CalculatePointsOnBezierCurve(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, TArray<FVector>& OUTPointsOnBezierCurve)
-{
-	FSectorTrackInfo PreviousTrackInfo = TrackMap.FindRef(TrackInfo.PreviousTrackSector);
+	Job.MeshData = CachedTile->MeshData;
+	Job.CompactTerrain = CachedTile->Terrain;
+	Job.bServedFromCache = true;
 
-	FVector BezierPoints[4];
-
-	if (Sector == FIntVector2D(0, 0))
+	if (bIsLoadedTile)
 	{
-		BezierPoints[0] = FVector(TrackInfo.TrackEntryPoint, TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight);
+		TileCache.Add(FTerrainTileCacheKey(Job.Sector, GenerationSettingsHash), MoveTemp(LoadedTile));
 	}
-	else
+
+	// tiles read from the persistent tile cache have no track mesh, a worker builds it, see TerrainGeneratorWorker::ProcessTerrainJob
+	if (ContainsSectorTrack(Job.Sector) && Job.MeshData[TrackMeshSection].VertexBuffer.Num() == 0)
 	{
-		BezierPoints[0] = FVector(TrackInfo.TrackEntryPoint, PreviousTrackInfo.TrackExitPointElevation);
+		SetJobTrackInfo(Job);
+		PendingTerrainJobQueue.Enqueue(Job);
+		return;
 	}
 
-	BezierPoints[1] = TrackInfo.FirstBezierControlPoint;
-	BezierPoints[2] = TrackInfo.SecondBezierControlPoint;
-	BezierPoints[3] = FVector(TrackInfo.TrackExitPoint, TrackInfo.TrackExitPointElevation);
-
-
-	FVector::EvaluateBezier(BezierPoints, TerrainSettings.TrackGenerationSettings.TrackResolution, OUTPointsOnBezierCurve);
+	// treat the job like a finished job of a worker thread, so mesh updates stay limited per frame
+	bHasTileBeenAddedToQueue = true;
+	TilesInProcessCounter++;
+	FinishedJobQueue.Enqueue(MoveTemp(Job));
 }
 
-void ATerrainManager::CalculateY0Y1(const TArray<FVector>& PointsOnTrack, const float ExitPointElevation, FVector& OUTY0, FVector& OUTY1)
+bool ATerrainManager::LoadTileFromDiskCache(const FIntVector2D Sector, const int32 MinimumGridSize, FCachedTerrainTile& OUTTile)
 {
-	// calculate last track segment
-	/**
-	 *			Last Track Segment:	(border is at top, track middle line goes from W0 to X0, Z0Y0 is left track border, Z1Y1 is right track border)
-	 *
-	 *			Y0--------------------X0--------------------Y1
-	 *			|					  |						|
-	 *			|					  | 					|
-	 *			|					  | 					|
-	 *			H0					  |						H1
-	 *			|					  |						|
-	 *			|					  |						|
-	 *			Z0--------------------W0--------------------Z1
-	 *
-	 * H0 and H1 are helper points that lie on the respective line (Z0Y0 or Z1Y1)
-	 */
-	FVector W0 = PointsOnTrack[PointsOnTrack.Num() - 2];
-	FVector X0 = PointsOnTrack[PointsOnTrack.Num() - 1];
-	FVector W0X0 = X0 - W0;
-	FVector Normal = FVector::CrossProduct(W0X0, FVector(0.f, 0.f, 1.f)).GetSafeNormal();
-
-	FVector Z0 = W0 + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-	FVector Z1 = W0 + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-
-	FVector H0 = Z0 + W0X0.GetSafeNormal();
-	FVector H1 = Z1 + W0X0.GetSafeNormal();
-
-	// calculate intersection point of lines Z0H0 / Z1H1 and tile border with Points PointA and PointB
-	FVector2D PointA;
-	FVector2D PointB;
-	// guess tile border
-	float TileSize = TerrainSettings.TileEdgeSize;
-	switch (UMyStaticLibrary::GuessTileBorder(X0, TileSize))
-	{
-		case ETileBorder::ETB_Bottom:
-			PointA = FVector2D(0.f, 0.f);
-			PointB = FVector2D(0.f, TileSize);
-			break;
-		case ETileBorder::ETB_Top:
-			PointA = FVector2D(TileSize, 0.f);
-			PointB = FVector2D(TileSize, TileSize);
-			break;
-		case ETileBorder::ETB_Left:
-			PointA = FVector2D(0.f, 0.f);
-			PointB = FVector2D(TileSize, 0.f);
-			break;
-		case ETileBorder::ETB_Right:
-			PointA = FVector2D(0.f, TileSize);
-			PointB = FVector2D(TileSize, TileSize);
-			break;
-	}
-	FVector2D IntersectionZ0H0;
-	FVector2D IntersectionZ1H1;
-	UMyStaticLibrary::CalculateIntersectionPoint(FVector2D(Z0.X, Z0.Y), FVector2D(H0.X, H0.Y), PointA, PointB, IntersectionZ0H0);
-	UMyStaticLibrary::CalculateIntersectionPoint(FVector2D(Z1.X, Z1.Y), FVector2D(H1.X, H1.Y), PointA, PointB, IntersectionZ1H1);
-	OUTY0 = FVector(IntersectionZ0H0, ExitPointElevation);
-	OUTY1 = FVector(IntersectionZ1H1, ExitPointElevation);
-	return;
+	// the terrain was carved around the sector's current track (the track hashes match), the track mesh is not stored but built by a worker
+	return TileDiskCache.Find(Sector, CalculateSectorTrackHash(Sector), OUTTile) && OUTTile.Terrain.GridSize >= MinimumGridSize;
 }
 
-// Called every frame
-void ATerrainManager::Tick(float DeltaTime)
+void ATerrainManager::AddFinishedJobToTileCache(FTerrainJob& Job)
 {
-	Super::Tick(DeltaTime);
+	if (TerrainSettings.TileCacheBudgetMegabytes <= 0 && !TileDiskCache.IsOpen()) { return; }
 
-	// check if free tiles can be deleted
-	for (int i = FreeTiles.Num() - 1; i >= 0; --i)
+	ATerrainTile* Tile = Job.TerrainTile;
+	// the tile may have been freed or moved while the job was processed
+	if (!Job.CompactTerrain.IsValid() || Tile->GetCurrentSector() != Job.Sector || Tile->GetTileStatus() != ETileStatus::TILE_FINISHED || !Tile->GetVerticesOnBorderSet())
 	{
-		if (FreeTiles[i]->GetTileStatus() == ETileStatus::TILE_FREE)
-		{
-			if (GetWorld()->TimeSeconds - FreeTiles[i]->GetTimeSinceTileFreed() >= TerrainSettings.SecondsUntilFreeTileGetsDeleted)
-			{
-				// delete the tile
-				ATerrainTile* Tile = FreeTiles.Pop();
-				Tile->Destroy();
-			}
-		}
+		return;
 	}
 
-	// check if we need to create mesh data
-	for (int i = 0; i < TerrainSettings.NumberOfThreadsToUse; ++i)
+	// cached neighbors that are not shown were not used as border constraints for this tile, so they would not match it anymore
+	TArray<FIntVector2D> AdjacentSectors;
+	GetRelevantAdjacentSectors(Job.Sector, AdjacentSectors);
+	for (const ATerrainTile* OtherTile : TilesInUse)
 	{
-		FTerrainJob Job;
-		// TODO check if we need a limit on mesh data (Job) memory usage
-		if (PendingTerrainJobQueue.Dequeue(Job))
-		{
-			if (!bHasTileBeenAddedToQueue)
-			{
-				bHasTileBeenAddedToQueue = true;
-			}
-			TilesInProcessCounter++;
-			TerrainCreationQueue[i].Enqueue(Job);
-		}
+		AdjacentSectors.Remove(OtherTile->GetCurrentSector());
 	}
-
-	// check if we need to update mesh data
-	for (int i = 0; i < TerrainSettings.MeshUpdatesPerFrame; ++i)
-	{
-		FTerrainJob Job;
-		if (FinishedJobQueue.Dequeue(Job))
-		{
-			TilesInProcessCounter--;
-			if (Job.TerrainTile == nullptr)
-			{
-				UE_LOG(LogTemp, Error, TEXT("TerrainTile pointer in Job is nullptr!"));
-			}
-			else
-			{
-				if (bShouldCheckSectorsNeedCoverageForReset)
-				{
-					SectorsNeedCoverageForReset.Remove(Job.TerrainTile->GetCurrentSector());
-				}
-				SectorsCurrentlyProcessed.AddUnique(Job.TerrainTile->GetCurrentSector());
-				/* check if we need to recalculate the tile 'behind' our track start point to match the border elevations */
-				if (!bRecalculatedTileBehindStartPoint && Job.TerrainTile->GetCurrentSector() == FIntVector2D(0, 0))
-				{
-					bRecalculatedTileBehindStartPoint = true;
-					FSectorTrackInfo TrackInfo = TrackMap.FindRef(FIntVector2D(0, 0));
-
-					// calculate which sector lies 'behind' track entry point
-					FVector2D EntryPoint = TrackInfo.TrackEntryPoint;
-					float EdgeSize = TerrainSettings.TileEdgeSize;
-					// entry point is at the top?
-					if (EntryPoint.X > 0.75 * EdgeSize)
-					{
-						RecalculateTileForSector(FIntVector2D(1, 0));
-					}
-					// entry point at bottom?
-					else if (EntryPoint.X < 0.25 * EdgeSize)
-					{
-						RecalculateTileForSector(FIntVector2D(-1, 0));
-					}
-					// entry point left?
-					else if (EntryPoint.Y < 0.25 * EdgeSize)
-					{
-						RecalculateTileForSector(FIntVector2D(0, -1));
-					}
-					// entry point right?
-					else if (EntryPoint.Y > 0.75 * EdgeSize)
-					{
-						RecalculateTileForSector(FIntVector2D(0, 1));
-					}
-				}
-				Job.TerrainTile->UpdateMeshData(TerrainSettings, Job.MeshData);
-			}
-		}
+	for (const ATerrainTile* OtherTile : RetainedTiles)
+	{
+		AdjacentSectors.Remove(OtherTile->GetCurrentSector());
+	}
+	for (const FIntVector2D AdjacentSector : AdjacentSectors)
+	{
+		TileCache.Remove(FTerrainTileCacheKey(AdjacentSector, GenerationSettingsHash));
+		TileDiskCache.Remove(AdjacentSector);
 	}
 
-	// check if we need to spawn checkpoints
-	while (!PendingCheckpointSpawnQueue.IsEmpty())
+	FCachedTerrainTile CachedTile;
+	CachedTile.MeshData = MoveTemp(Job.MeshData);
+	// the expanded terrain section is not cached, it gets recreated from the compact terrain
+	if (CachedTile.MeshData.IsValidIndex(TerrainMeshSection))
 	{
-		FCheckpointSpawnJob SpawnJob;
-		if (PendingCheckpointSpawnQueue.Dequeue(SpawnJob))
-		{
-			UWorld* World = GetWorld();
-			if (World)
-			{
-				AActor* Actor = World->SpawnActor(CheckpointClassToSpawn, &SpawnJob.CheckpointTransform, FActorSpawnParameters());
-				AProceduralCheckpoint* Checkpoint = Cast<AProceduralCheckpoint>(Actor);
-				if (Checkpoint)
-				{
-					Checkpoint->SetCheckpointID(SpawnJob.CheckpointID);
-					Checkpoint->SetActorScale3D(FVector(1.f, TerrainSettings.TrackGenerationSettings.TrackWidth / 100.f, 1.f));
-					// search tile that is responsible for the sector and add checkpoint reference
-					for (ATerrainTile* Tile : TilesInUse)
-					{
-						if (Tile->GetCurrentSector() == SpawnJob.CheckpointSector)
-						{
-							Tile->SetCheckpointReference(Checkpoint);
-							break;
-						}
-					}
-				}
-				else
-				{
-					UE_LOG(LogTemp, Error, TEXT("Spawned Checkpoint could not be cast to AProceduralCheckpoint in %s"), *GetName());
-				}
-			}
-		}
+		CachedTile.MeshData[TerrainMeshSection] = FMeshData();
 	}
+	CachedTile.Terrain = MoveTemp(Job.CompactTerrain);
+	CachedTile.BottomLeftCorner = Tile->GetBottomLeftCorner();
+	CachedTile.BottomRightCorner = Tile->GetBottomRightCorner();
+	CachedTile.TopRightCorner = Tile->GetTopRightCorner();
+	CachedTile.TopLeftCorner = Tile->GetTopLeftCorner();
+	// the worker carved the terrain around the job's track info, not around the current entry of TrackMap
+	CachedTile.TrackHash = Job.TrackInfo.CalculateTrackHash(Job.PreviousTrackInfo);
 
-	// check if we can spawn the player
-	if (bHasTileBeenAddedToQueue && TilesInProcessCounter == 0 && RemainingPlayersToSpawn > 0)
+	TileDiskCache.Add(Job.Sector, CachedTile);
+	TileCache.Add(FTerrainTileCacheKey(Job.Sector, GenerationSettingsHash), MoveTemp(CachedTile));
+}
+
+void ATerrainManager::ExpandCompactTerrain(FTerrainJob& Job)
+{
+	if (!Job.CompactTerrain.IsValid()) { return; }
+
+	FTerrainHeightfield Heightfield;
+	if (!Heightfield.InitializeFromCompactTile(Job.CompactTerrain))
 	{
-		RemainingPlayersToSpawn--;
-		// notify gamemode to spawn player
-		if (GameMode)
-		{
-			GameMode->SpawnPlayerFromTerrainManager(TerrainSettings.TransitionElevationOffset, TerrainSettings.TransitionInterpolationSpeed, TerrainSettings.TransitionDeltaToStop);
-		}
+		UE_LOG(LogTemp, Error, TEXT("Could not expand compact terrain of sector %s"), *Job.Sector.ToString());
+		return;
+	}
+	if (!Job.MeshData.IsValidIndex(TerrainMeshSection))
+	{
+		Job.MeshData.SetNum(TerrainMeshSection + 1);
+	}
+	FMeshData& TerrainMeshData = Job.MeshData[TerrainMeshSection];
+	// the worker calculated the quadtrees of the terrain and collision meshes, so only their vertices and triangles are created here
+	BuildTerrainMeshData(Heightfield, Job.CompactTerrain.QuadLevels, TerrainMeshData);
+	if (TerrainSettings.bAdaptiveTileTessellation && Job.CompactTerrain.QuadLevels.Num() > 0 && !Job.bServedFromCache)
+	{
+		const int32 UniformTriangles = 2 * (Heightfield.GridSize - 1) * (Heightfield.GridSize - 1) + (TerrainSettings.CalculateTileSkirtDepth(Heightfield.GridSize) > 0.f ? 8 * (Heightfield.GridSize - 1) : 0);
+		const int32 Triangles = TerrainMeshData.TriangleBuffer.Num() / 3;
+		const float Reduction = UniformTriangles > 0 ? 100.f * (UniformTriangles - Triangles) / UniformTriangles : 0.f;
+		UE_LOG(LogTemp, Verbose, TEXT("Adaptive tessellation of sector %s: %i instead of %i triangles (%f%% less) in %f ms"), *Job.Sector.ToString(), Triangles, UniformTriangles, Reduction, Job.TessellationTime);
+		TilePoolStatistics.AdaptiveTiles++;
+		TotalAdaptiveTriangleReduction += Reduction;
+		TotalAdaptiveTessellationTime += Job.TessellationTime;
 	}
 
-	if (bShouldCheckSectorsNeedCoverageForReset)
+	TotalExpandedTileBytes += TerrainMeshData.VertexBuffer.GetAllocatedSize() + TerrainMeshData.TriangleBuffer.GetAllocatedSize();
+	NumberOfExpandedTiles++;
+
+	BuildTerrainCollision(Heightfield, Job.CompactTerrain.CollisionQuadLevels, TerrainMeshData, Job.CollisionVertices, Job.CollisionTriangles, Job.CollisionHeightfield);
+
+	// measured by the worker, tiles served from a cache are not measured again
+	if (Job.TerrainACMR >= 0.f)
 	{
-		if (SectorsNeedCoverageForReset.Num() == 0)
-		{
-			// notify game mode
-			UWorld* World = GetWorld();
-			if (World)
-			{
-				AHoverTestGameModeProceduralLevel* GameMode = Cast<AHoverTestGameModeProceduralLevel>(World->GetAuthGameMode());
-				if (GameMode)
-				{
-					GameMode->AllowDefaultPawnToTransitionToEndLocation();
-					bShouldCheckSectorsNeedCoverageForReset = false;
-					// just in case
-					SectorsNeedCoverageForReset.Empty();
-				}
-			}
-		}
+		UE_LOG(LogTemp, Verbose, TEXT("Terrain mesh of sector %s: %i vertices, %i triangles, ACMR %f (%s indices)"), *Job.Sector.ToString(), TerrainMeshData.VertexBuffer.Num(), TerrainMeshData.TriangleBuffer.Num() / 3, Job.TerrainACMR, TerrainMeshData.CanUse16BitIndices() ? TEXT("16 bit") : TEXT("32 bit"));
+		TotalTerrainACMR += Job.TerrainACMR;
+		NumberOfMeasuredACMRTiles++;
 	}
 }
 
-void ATerrainManager::CreateAndInitializeTiles(int32 NumberOfTilesToCreate)
+void ATerrainManager::BuildTerrainMeshData(const FTerrainHeightfield& Heightfield, const TArray<uint8>& QuadLevels, FMeshData& OUTMeshData) const
 {
-	for (int i = 0; i < NumberOfTilesToCreate; ++i)
+	const float SkirtDepth = TerrainSettings.CalculateTileSkirtDepth(Heightfield.GridSize);
+	if (TerrainSettings.bAdaptiveTileTessellation)
 	{
-		ATerrainTile* Tile = GetWorld()->SpawnActor<ATerrainTile>(FVector(0.f, 0.f, 0.f), FRotator(0.f, 0.f, 0.f), FActorSpawnParameters());
-		// at first spawn them all at the same location
-		if (Tile == nullptr)
-		{
-			UE_LOG(LogTemp, Error, TEXT("SpawnActor return pointer is nullptr"));
-		}
-		else
+		Heightfield.BuildAdaptiveMeshData(OUTMeshData, QuadLevels, SkirtDepth);
+	}
+	else
+	{
+		Heightfield.BuildMeshData(OUTMeshData, SkirtDepth);
+	}
+}
+
+void ATerrainManager::BuildTerrainCollision(const FTerrainHeightfield& Heightfield, const TArray<uint8>& CollisionQuadLevels, FMeshData& TerrainMeshData, TArray<FVector>& OUTVertices, TArray<int32>& OUTTriangles, FTerrainCollisionHeightfield& OUTHeightfield)
+{
+	OUTVertices.Reset();
+	OUTTriangles.Reset();
+	OUTHeightfield = FTerrainCollisionHeightfield();
+	TerrainMeshData.bCreateCollision = !TerrainSettings.bLowResolutionTileCollision && !TerrainSettings.bHeightfieldTileCollision;
+	if (TerrainSettings.bHeightfieldTileCollision)
+	{
+		Heightfield.BuildCollisionHeightfield(OUTHeightfield);
+		// a tile without heightfield keeps the collision of its terrain mesh section
+		TerrainMeshData.bCreateCollision = !OUTHeightfield.IsValid();
+		return;
+	}
+	if (!TerrainSettings.bLowResolutionTileCollision) { return; }
+
+	Heightfield.BuildCollisionMeshData(OUTVertices, OUTTriangles, CollisionQuadLevels);
+	const int32 Triangles = OUTTriangles.Num() / 3;
+	const int32 RenderedTriangles = TerrainMeshData.TriangleBuffer.Num() / 3;
+	const int32 Bytes = OUTVertices.Num() * sizeof(FVector) + OUTTriangles.Num() * sizeof(int32);
+	const float Reduction = RenderedTriangles > 0 ? 100.f * (RenderedTriangles - Triangles) / RenderedTriangles : 0.f;
+	UE_LOG(LogTemp, Verbose, TEXT("Terrain collision: %i instead of %i triangles (%f%% less), %i bytes to cook"), Triangles, RenderedTriangles, Reduction, Bytes);
+	TilePoolStatistics.LowResolutionCollisionTiles++;
+	TotalCollisionTriangles += Triangles;
+	TotalCollisionBytes += Bytes;
+	TotalCollisionTriangleReduction += Reduction;
+}
+
+void ATerrainManager::UpdateTileCollision(ATerrainTile* Tile, const TArray<FVector>& Vertices, const TArray<int32>& Triangles, const FTerrainCollisionHeightfield& Heightfield)
+{
+	Tile->UpdateCollisionMesh(Vertices, Triangles);
+	const float HeightfieldTime = Tile->UpdateCollisionHeightfield(Heightfield);
+	if (!Heightfield.IsValid()) { return; }
+
+	const int32 Bytes = Heightfield.Heights.Num() * sizeof(int16);
+	UE_LOG(LogTemp, Verbose, TEXT("Collision heightfield of %s: %i bytes in %f ms"), *Tile->GetName(), Bytes, HeightfieldTime);
+	TilePoolStatistics.HeightfieldCollisionTiles++;
+	TotalHeightfieldCollisionTime += HeightfieldTime;
+	TotalHeightfieldCollisionBytes += Bytes;
+}
+
+bool ATerrainManager::RegenerateTileBorders(ATerrainTile* Tile)
+{
+	const FIntVector2D Sector = Tile->GetCurrentSector();
+	if (Tile->GetTileStatus() != ETileStatus::TILE_FINISHED || Tile->IsTileRetained() || !Tile->GetCompactTerrain().IsValid() || ContainsSectorTrack(Sector))
+	{
+		return false;
+	}
+	FTerrainHeightfield Heightfield;
+	if (!Heightfield.InitializeFromCompactTile(Tile->GetCompactTerrain())) { return false; }
+	// the band keeps the quadtrees the worker calculated, so the terrain mesh keeps its triangles and only the changed vertices are uploaded
+	const TArray<uint8>& QuadLevels = Tile->GetCompactTerrain().QuadLevels;
+	const TArray<uint8>& CollisionQuadLevels = Tile->GetCompactTerrain().CollisionQuadLevels;
+	FMeshData PreviousMeshData;
+	BuildTerrainMeshData(Heightfield, QuadLevels, PreviousMeshData);
+
+	// same borders of the adjacent tiles the worker threads use as border constraints
+	const FIntVector2D Directions[4] = { FIntVector2D(1, 0), FIntVector2D(-1, 0), FIntVector2D(0, 1), FIntVector2D(0, -1) };
+	bool bHasChanged = false;
+	for (const FIntVector2D& Direction : Directions)
+	{
+		const ATerrainTile* AdjacentTile = FindFinishedTile(Sector + Direction);
+		if (AdjacentTile == nullptr) { continue; }
+
+		TArray<FBorderVertex> BorderVertices;
+		if (Direction.X > 0) { AdjacentTile->GetVerticesBottomBorder(BorderVertices); }
+		else if (Direction.X < 0) { AdjacentTile->GetVerticesTopBorder(BorderVertices); }
+		else if (Direction.Y > 0) { AdjacentTile->GetVerticesLeftBorder(BorderVertices); }
+		else { AdjacentTile->GetVerticesRightBorder(BorderVertices); }
+		FTerrainHeightfield::ResampleBorderVertices(BorderVertices, Direction.X != 0, Heightfield.UnitSize, TerrainSettings.TileEdgeSize);
+		if (Heightfield.ApplyBorderConstraints(Direction, BorderVertices, TerrainSettings.BorderRegenerationBandWidth, KINDA_SMALL_NUMBER) > 0.f)
 		{
-			Tile->SetupTile(TerrainSettings, FIntVector2D(0, 0));
-			FreeTiles.Add(Tile);
+			bHasChanged = true;
 		}
-
 	}
+	// the borders already match
+	if (!bHasChanged) { return true; }
+
+	// the tile shows its terrain the same way as after ExpandCompactTerrain
+	FCompactTerrainTile CompactTerrain;
+	Heightfield.Encode(CompactTerrain, TerrainSettings.bDeltaEncodeTileHeights, TerrainSettings.bStoreTileNormals);
+	CompactTerrain.QuadLevels = QuadLevels;
+	CompactTerrain.CollisionQuadLevels = CollisionQuadLevels;
+	if (!Heightfield.InitializeFromCompactTile(CompactTerrain)) { return false; }
+	FMeshData MeshData;
+	BuildTerrainMeshData(Heightfield, QuadLevels, MeshData);
+	TArray<FVector> CollisionVertices;
+	TArray<int32> CollisionTriangles;
+	FTerrainCollisionHeightfield CollisionHeightfield;
+	BuildTerrainCollision(Heightfield, CollisionQuadLevels, MeshData, CollisionVertices, CollisionTriangles, CollisionHeightfield);
+	TArray<FMeshVertexRange> Ranges;
+	int32 UploadedBytes = 0;
+	const bool bHasSameTriangles = MeshData.GetChangedVertexRanges(PreviousMeshData, Ranges);
+	if (bHasSameTriangles)
+	{
+		UploadedBytes = Tile->UpdateMeshSectionVertices(TerrainMeshSection, MeshData, Ranges);
+	}
+	// the section could not be written in place or the quadtrees could not be used, the tile finds the changed parts of the section itself then
+	if (!bHasSameTriangles || (Ranges.Num() > 0 && UploadedBytes == 0))
+	{
+		TArray<FMeshData> AllMeshData;
+		AllMeshData.SetNum(TerrainMeshSection + 1);
+		AllMeshData[TerrainMeshSection] = MoveTemp(MeshData);
+		UploadedBytes = Tile->UpdateMeshData(TerrainSettings, AllMeshData);
+	}
+	TotalUploadedMeshBytes += UploadedBytes;
+	NumberOfMeshUploads++;
+	UpdateTileCollision(Tile, CollisionVertices, CollisionTriangles, CollisionHeightfield);
+
+	// adjacent tiles and the horizon continue the new borders
+	TArray<FBorderVertex> VerticesLeftBorder;
+	TArray<FBorderVertex> VerticesRightBorder;
+	TArray<FBorderVertex> VerticesTopBorder;
+	TArray<FBorderVertex> VerticesBottomBorder;
+	FTerrainHeightfield::GetBorderVertices(CompactTerrain, VerticesLeftBorder, VerticesRightBorder, VerticesTopBorder, VerticesBottomBorder);
+	Tile->SetVerticesLeftBorder(VerticesLeftBorder);
+	Tile->SetVerticesRightBorder(VerticesRightBorder);
+	Tile->SetVerticesTopBorder(VerticesTopBorder);
+	Tile->SetVerticesBottomBorder(VerticesBottomBorder);
+	const int32 Last = Heightfield.GridSize - 1;
+	Tile->SetBottomLeftCorner(Heightfield.GetPosition(0, 0));
+	Tile->SetBottomRightCorner(Heightfield.GetPosition(0, Last));
+	Tile->SetTopRightCorner(Heightfield.GetPosition(Last, Last));
+	Tile->SetTopLeftCorner(Heightfield.GetPosition(Last, 0));
+	Tile->SetCompactTerrain(CompactTerrain);
+	Horizon.RegenerateCellsAround(Sector);
+
+	TilePoolStatistics.IncrementalBorderRegenerations++;
+	TilePoolStatistics.IncrementallyUploadedBytes += UploadedBytes;
+	UE_LOG(LogTemp, Verbose, TEXT("Regenerated the borders of sector %s incrementally, uploaded %i bytes"), *Sector.ToString(), UploadedBytes);
+	return true;
+}
+
+FTilePoolStatistics ATerrainManager::GetTilePoolStatistics() const
+{
+	FTilePoolStatistics Statistics = TilePoolStatistics;
+	Statistics.TilesInUse = TilesInUse.Num();
+	Statistics.FreeTiles = FreeTiles.Num();
+	Statistics.RetainedTiles = RetainedTiles.Num();
+	Statistics.TileCacheHits = TileCache.GetHits();
+	Statistics.TileCacheMisses = TileCache.GetMisses();
+	Statistics.TileCacheEntries = TileCache.Num();
+	Statistics.TileCacheBytes = TileCache.GetUsedBytes();
+	Statistics.PersistentTileCacheHits = TileDiskCache.GetHits();
+	Statistics.PersistentTileCacheEntries = TileDiskCache.Num();
+	Statistics.AverageCompactTileBytes = Statistics.CompactTiles > 0 ? static_cast<int32>(TotalCompactTileBytes / Statistics.CompactTiles) : 0;
+	Statistics.AverageExpandedTileBytes = NumberOfExpandedTiles > 0 ? static_cast<int32>(TotalExpandedTileBytes / NumberOfExpandedTiles) : 0;
+	Statistics.AverageFullDetailTileTriangles = NumberOfFullDetailTiles > 0 ? static_cast<int32>(TotalFullDetailTileTriangles / NumberOfFullDetailTiles) : 0;
+	Statistics.AverageReducedDetailTileTriangles = Statistics.ReducedDetailTiles > 0 ? static_cast<int32>(TotalReducedDetailTileTriangles / Statistics.ReducedDetailTiles) : 0;
+	Statistics.AverageFullDetailTileGenerationTime = NumberOfFullDetailTiles > 0 ? static_cast<float>(TotalFullDetailTileGenerationTime / NumberOfFullDetailTiles) : 0.f;
+	Statistics.AverageReducedDetailTileGenerationTime = Statistics.ReducedDetailTiles > 0 ? static_cast<float>(TotalReducedDetailTileGenerationTime / Statistics.ReducedDetailTiles) : 0.f;
+	Statistics.AverageAdaptiveTriangleReduction = Statistics.AdaptiveTiles > 0 ? static_cast<float>(TotalAdaptiveTriangleReduction / Statistics.AdaptiveTiles) : 0.f;
+	Statistics.AverageAdaptiveTessellationTime = Statistics.AdaptiveTiles > 0 ? static_cast<float>(TotalAdaptiveTessellationTime / Statistics.AdaptiveTiles) : 0.f;
+	Statistics.AverageCollisionTriangles = Statistics.LowResolutionCollisionTiles > 0 ? static_cast<int32>(TotalCollisionTriangles / Statistics.LowResolutionCollisionTiles) : 0;
+	Statistics.AverageCollisionBytes = Statistics.LowResolutionCollisionTiles > 0 ? static_cast<int32>(TotalCollisionBytes / Statistics.LowResolutionCollisionTiles) : 0;
+	Statistics.AverageCollisionTriangleReduction = Statistics.LowResolutionCollisionTiles > 0 ? static_cast<float>(TotalCollisionTriangleReduction / Statistics.LowResolutionCollisionTiles) : 0.f;
+	Statistics.AverageHeightfieldCollisionTime = Statistics.HeightfieldCollisionTiles > 0 ? static_cast<float>(TotalHeightfieldCollisionTime / Statistics.HeightfieldCollisionTiles) : 0.f;
+	Statistics.AverageHeightfieldCollisionBytes = Statistics.HeightfieldCollisionTiles > 0 ? static_cast<int32>(TotalHeightfieldCollisionBytes / Statistics.HeightfieldCollisionTiles) : 0;
+	Statistics.HorizonCells = Horizon.NumCells();
+	Statistics.HorizonTriangles = Horizon.NumTriangles();
+	Statistics.UploadedMeshMegabytes = static_cast<float>(TotalUploadedMeshBytes / (1024.0 * 1024.0));
+	Statistics.AverageUploadedMeshBytes = NumberOfMeshUploads > 0 ? static_cast<int32>(TotalUploadedMeshBytes / NumberOfMeshUploads) : 0;
+	Statistics.AverageTerrainACMR = NumberOfMeasuredACMRTiles > 0 ? static_cast<float>(TotalTerrainACMR / NumberOfMeasuredACMRTiles) : 0.f;
+	Statistics.AverageTimeToFirstTerrain = NumberOfFirstTerrains > 0 ? static_cast<float>(TotalTimeToFirstTerrain / NumberOfFirstTerrains * 1000.0) : 0.f;
+	Statistics.TargetPoolSize = TilePoolTargetSize;
+	return Statistics;
 }
 
 void ATerrainManager::AddActorToTrack(AActor * ActorToTrack)
 {
 	if (ActorToTrack == nullptr) { return; }
 	TrackedActors.Add(ActorToTrack);
+	TrackedActorSectors.Add(ActorToTrack, CalculateSectorFromLocation(ActorToTrack->GetActorLocation()));
 
 	if (bGenerateTerrainOnActorRegister)
 	{
@@ -730,50 +1127,17 @@ void ATerrainManager::AddActorToTrack(AActor * ActorToTrack)
 
 		CalculateTrackPath(SectorsThatNeedCoverage);
 
-		// use free tiles to cover sectors
-		while (SectorsThatNeedCoverage.Num() > 0 && FreeTiles.Num() > 0)
-		{
-			FIntVector2D Sector = SectorsThatNeedCoverage.Pop();
-			ATerrainTile* Tile = FreeTiles.Pop();
-			Tile->UpdateTilePosition(TerrainSettings, Sector);
-			Tile->AddAssociatedActor();
-			FTerrainJob Job;
-			Job.TerrainTile = Tile;
-			PendingTerrainJobQueue.Enqueue(Job);
-
-			TilesInUse.Add(Tile);
-		}
-
-		// check if we need to create additional tiles to cover the sectors
-		if (SectorsThatNeedCoverage.Num() > 0)
+		// use tiles from the tile pool to cover sectors
+		while (SectorsThatNeedCoverage.Num() > 0)
 		{
-			CreateAndInitializeTiles(SectorsThatNeedCoverage.Num());
-			// should be exactly the number of tiles we need, but better safe than sorry
-			while (SectorsThatNeedCoverage.Num() > 0 && FreeTiles.Num() > 0)
-			{
-				FIntVector2D Sector = SectorsThatNeedCoverage.Pop();
-				ATerrainTile* Tile = FreeTiles.Pop();
-
-				Tile->UpdateTilePosition(TerrainSettings, Sector);
-				Tile->AddAssociatedActor();
-				FTerrainJob Job;
-				Job.TerrainTile = Tile;
-				PendingTerrainJobQueue.Enqueue(Job);
-
-				TilesInUse.Add(Tile);
-			}
-
-			if (SectorsThatNeedCoverage.Num() != 0)
+			if (!AssignTileToSector(SectorsThatNeedCoverage.Pop(), true))
 			{
 				UE_LOG(LogTemp, Error, TEXT("Something went wrong in %s, not all sectors could get assigned a tile to"), *GetName());
-			}
-			// check if something went wrong and we created too many free tiles
-			if (FreeTiles.Num() != 0)
-			{
-				UE_LOG(LogTemp, Error, TEXT("Something went wrong in %s, too many free tiles were created to cover sectors"), *GetName());
+				break;
 			}
 		}
 	}
+	RefineTilesAroundTrackedActors();
 }
 
 void ATerrainManager::BuildTerrainAroundSector(const FIntVector2D Sector)
@@ -790,49 +1154,14 @@ void ATerrainManager::BuildTerrainAroundSector(const FIntVector2D Sector)
 
 	CalculateTrackPath(SectorsThatNeedCoverage);
 
-	// use free tiles to cover sectors
-	while (SectorsThatNeedCoverage.Num() > 0 && FreeTiles.Num() > 0)
+	// use tiles from the tile pool to cover sectors
+	while (SectorsThatNeedCoverage.Num() > 0)
 	{
-		FIntVector2D Sec = SectorsThatNeedCoverage.Pop();
-		ATerrainTile* Tile = FreeTiles.Pop();
-
-		Tile->UpdateTilePosition(TerrainSettings, Sec);
 		// don't increase associated actor count
-
-		FTerrainJob Job;
-		Job.TerrainTile = Tile;
-		PendingTerrainJobQueue.Enqueue(Job);
-
-		TilesInUse.Add(Tile);
-	}
-
-	// check if we need to create additional tiles to cover the sectors
-	if (SectorsThatNeedCoverage.Num() > 0)
-	{
-		CreateAndInitializeTiles(SectorsThatNeedCoverage.Num());
-		while (SectorsThatNeedCoverage.Num() > 0 && FreeTiles.Num() > 0)
-		{
-			FIntVector2D Sec = SectorsThatNeedCoverage.Pop();
-			ATerrainTile* Tile = FreeTiles.Pop();
-
-			Tile->UpdateTilePosition(TerrainSettings, Sec);
-			// don't increase associated actor count
-
-			FTerrainJob Job;
-			Job.TerrainTile = Tile;
-			PendingTerrainJobQueue.Enqueue(Job);
-
-			TilesInUse.Add(Tile);
-		}
-
-		if (SectorsThatNeedCoverage.Num() != 0)
+		if (!AssignTileToSector(SectorsThatNeedCoverage.Pop(), false))
 		{
 			UE_LOG(LogTemp, Error, TEXT("Something went wrong in %s, not all sectors could get assigned a tile to"), *GetName());
-		}
-		// check if something went wrong and we created too many free tiles
-		if (FreeTiles.Num() != 0)
-		{
-			UE_LOG(LogTemp, Error, TEXT("Something went wrong in %s, too many free tiles were created to cover sectors"), *GetName());
+			break;
 		}
 	}
 }
@@ -848,8 +1177,14 @@ void ATerrainManager::RemoveTrackedActor(AActor * ActorToRemove)
 	}
 
 	// free Tiles associated with this actor
+	// use the sector the actor was assigned to, since it may differ from its location because of SectorChangeHysteresis
+	FIntVector2D ActorSector;
+	if (!TrackedActorSectors.RemoveAndCopyValue(ActorToRemove, ActorSector))
+	{
+		ActorSector = CalculateSectorFromLocation(ActorToRemove->GetActorLocation());
+	}
 	TArray<FIntVector2D> Sectors;
-	CalculateSectorsNeededAroundGivenLocation(ActorToRemove->GetActorLocation(), Sectors);
+	CalculateSectorsNeededAroundGivenSector(ActorSector, Sectors);
 	TArray<ATerrainTile*> TilesToFree;
 
 	for (ATerrainTile* Tile : TilesInUse)
@@ -858,8 +1193,6 @@ void ATerrainManager::RemoveTrackedActor(AActor * ActorToRemove)
 		{
 			if (Tile->RemoveAssociatedActor() <= 0)
 			{
-				SectorsCurrentlyProcessed.Remove(Tile->GetCurrentSector());
-				Tile->FreeTile();
 				TilesToFree.Add(Tile);
 			}
 		}
@@ -868,7 +1201,7 @@ void ATerrainManager::RemoveTrackedActor(AActor * ActorToRemove)
 	for (ATerrainTile* Tile : TilesToFree)
 	{
 		TilesInUse.Remove(Tile);
-		FreeTiles.Add(Tile);
+		ReleaseTile(Tile);
 	}
 
 	TilesToFree.Empty();
@@ -910,6 +1243,15 @@ FIntVector2D ATerrainManager::CalculateSectorFromLocation(FVector CurrentWorldLo
 	return FIntVector2D(static_cast<int32>(XSector), static_cast<int32>(YSector));
 }
 
+bool ATerrainManager::HasLocationLeftSector(const FVector Location, const FIntVector2D Sector) const
+{
+	const float EdgeSize = TerrainSettings.TileEdgeSize;
+	const float Margin = FMath::Max(TerrainSettings.SectorChangeHysteresis, 0.f);
+
+	return Location.X < Sector.X * EdgeSize - Margin || Location.X >= (Sector.X + 1) * EdgeSize + Margin
+		|| Location.Y < Sector.Y * EdgeSize - Margin || Location.Y >= (Sector.Y + 1) * EdgeSize + Margin;
+}
+
 void ATerrainManager::BeginDestroy()
 {
 	for (auto& Thread : Threads)
@@ -919,12 +1261,28 @@ void ATerrainManager::BeginDestroy()
 			Thread->Kill();
 		}
 	}
+	// EndPlay already stopped the thread unless the manager never played
+	StopTrackPlanningThread();
 	Super::BeginDestroy();
 }
 
+void ATerrainManager::StopTrackPlanningThread()
+{
+	if (TrackPlanningThread)
+	{
+		// calls Stop on the worker and waits for Run to return
+		TrackPlanningThread->Kill(true);
+		delete TrackPlanningThread;
+		TrackPlanningThread = nullptr;
+	}
+	delete TrackPlanningWorker;
+	TrackPlanningWorker = nullptr;
+}
+
 void ATerrainManager::HandleTrackedActorChangedSector(AActor * TrackedActor, FIntVector2D PreviousSector, FIntVector2D NewSector)
 {
 	// my rhymes are lit
+	TrackedActorSectors.Add(TrackedActor, NewSector);
 
 	// identify sectors that are no longer needed by this actor
 	TArray<FIntVector2D> SectorsNeededAtNewPosition;
@@ -944,11 +1302,9 @@ void ATerrainManager::HandleTrackedActorChangedSector(AActor * TrackedActor, FIn
 	{
 		if (SectorsNeededAtPreviousPosition.Remove(Tile->GetCurrentSector()) > 0)
 		{
-			// if these tiles aren't needed by any other actor aswell -> free them
+			// if these tiles aren't needed by any other actor aswell -> retain or free them
 			if (Tile->RemoveAssociatedActor() <= 0)
 			{
-				SectorsCurrentlyProcessed.Remove(Tile->GetCurrentSector());
-				Tile->FreeTile();
 				TilesToFree.Add(Tile);
 			}
 		}
@@ -957,7 +1313,7 @@ void ATerrainManager::HandleTrackedActorChangedSector(AActor * TrackedActor, FIn
 	for (ATerrainTile* Tile : TilesToFree)
 	{
 		TilesInUse.Remove(Tile);
-		FreeTiles.Add(Tile);
+		ReleaseTile(Tile);
 	}
 
 	SectorsNeededAtNewPosition.Empty();
@@ -984,29 +1340,116 @@ void ATerrainManager::HandleTrackedActorChangedSector(AActor * TrackedActor, FIn
 		}
 	}
 
-	// check how many free tiles are available
-	// (if necessary: create new tiles if free tiles do not suffice to cover all newly needed sectors)
-	if (SectorsNeededAtNewPosition.Num() > FreeTiles.Num())
+	CalculateTrackPath(SectorsNeededAtNewPosition);
+
+	// use tiles from the tile pool to cover new sectors and increase associatedactors count
+	// (the pool grows by itself if free tiles do not suffice to cover all newly needed sectors)
+	while (SectorsNeededAtNewPosition.Num() > 0)
+	{
+		if (!AssignTileToSector(SectorsNeededAtNewPosition.Pop(), true))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Something went wrong in %s, not all sectors could get assigned a tile to"), *GetName());
+			break;
+		}
+	}
+
+	// tiles that were at the edge of the actor's ring are closer now
+	RefineTilesAroundTrackedActors();
+}
+
+int32 ATerrainManager::CalculateTileTriangleEdgeIterations(const FIntVector2D Sector) const
+{
+	if (TrackedActorSectors.Num() == 0 || (TerrainSettings.bFullDetailTrackTiles && ContainsSectorTrack(Sector)))
 	{
-		CreateAndInitializeTiles(SectorsNeededAtNewPosition.Num() - FreeTiles.Num());
+		return TerrainSettings.FractalNoiseTerrainSettings.TriangleEdgeIterations;
 	}
 
-	CalculateTrackPath(SectorsNeededAtNewPosition);
+	int32 SectorDistance = MAX_int32;
+	for (const TPair<AActor*, FIntVector2D>& TrackedActorSector : TrackedActorSectors)
+	{
+		const int32 Distance = FMath::Max(FMath::Abs(Sector.X - TrackedActorSector.Value.X), FMath::Abs(Sector.Y - TrackedActorSector.Value.Y));
+		SectorDistance = FMath::Min(SectorDistance, Distance);
+	}
+	return TerrainSettings.CalculateTileTriangleEdgeIterations(SectorDistance);
+}
+
+void ATerrainManager::RefineTilesAroundTrackedActors()
+{
+	if (TerrainSettings.TileDetailReductionPerSector <= 0) { return; }
 
-	// update free tiles to cover new sectors and increase associatedactors count
-	while (SectorsNeededAtNewPosition.Num() > 0 && FreeTiles.Num() > 0)
+	for (ATerrainTile* Tile : TilesInUse)
 	{
-		FIntVector2D Sector = SectorsNeededAtNewPosition.Pop();
-		ATerrainTile* Tile = FreeTiles.Pop();
+		// tiles that are still being generated were queued with the detail of their job, they get refined on the next sector change if necessary
+		if (Tile->GetTileStatus() != ETileStatus::TILE_FINISHED) { continue; }
+		if (CalculateTileTriangleEdgeIterations(Tile->GetCurrentSector()) <= Tile->GetTriangleEdgeIterations()) { continue; }
 
-		Tile->UpdateTilePosition(TerrainSettings, Sector);
-		Tile->AddAssociatedActor();
-		FTerrainJob Job;
-		Job.TerrainTile = Tile;
-		PendingTerrainJobQueue.Enqueue(Job);
+		TilePoolStatistics.RefinedTiles++;
+		EnqueueTerrainJob(Tile, true);
+	}
+}
+
+void ATerrainManager::UpdateHorizon()
+{
+	if (!TerrainSettings.bUseHorizon || HorizonMesh == nullptr) { return; }
+
+	TArray<FIntVector2D> CenterSectors;
+	TrackedActorSectors.GenerateValueArray(CenterSectors);
+	if (CenterSectors.Num() == 0) { return; }
+	// the order of the map may change when actors are added or removed, the horizon only has to be updated if the sectors changed
+	CenterSectors.Sort([](const FIntVector2D& A, const FIntVector2D& B) { return A.X != B.X ? A.X < B.X : A.Y < B.Y; });
+	Horizon.SetCenterSectors(CenterSectors);
+
+	for (int32 i = 0; i < TerrainSettings.HorizonCellsPerFrame; ++i)
+	{
+		if (!Horizon.GenerateNextCell([this](const FIntVector2D Sector) { return FindFinishedTile(Sector); }))
+		{
+			break;
+		}
+	}
 
-		TilesInUse.Add(Tile);
+	for (int32 i = 0; i < TerrainSettings.HorizonChunksPerFrame; ++i)
+	{
+		int32 Section = INDEX_NONE;
+		FMeshData MeshData;
+		if (!Horizon.BuildNextChangedChunk([this](const FIntVector2D Sector) { return FindFinishedTile(Sector) != nullptr; }, Section, MeshData))
+		{
+			break;
+		}
+		if (Section == INDEX_NONE) { continue; }
+
+		if (MeshData.TriangleBuffer.Num() == 0)
+		{
+			HorizonMesh->ClearMeshSection(Section);
+		}
+		else
+		{
+			TArray<uint16> TriangleBuffer16;
+			if (MeshData.GetTriangleBuffer16(TriangleBuffer16))
+			{
+				HorizonMesh->CreateMeshSection(Section, MeshData.VertexBuffer, TriangleBuffer16, false, EUpdateFrequency::Infrequent, ESectionUpdateFlags::None);
+			}
+			else
+			{
+				HorizonMesh->CreateMeshSection(Section, MeshData.VertexBuffer, MeshData.TriangleBuffer, false, EUpdateFrequency::Infrequent, ESectionUpdateFlags::None);
+			}
+			if (TerrainSettings.Materials.IsValidIndex(TerrainMeshSection))
+			{
+				HorizonMesh->SetMaterial(Section, TerrainSettings.Materials[TerrainMeshSection]);
+			}
+		}
+	}
+}
+
+const ATerrainTile* ATerrainManager::FindFinishedTile(const FIntVector2D Sector) const
+{
+	for (const ATerrainTile* Tile : TilesInUse)
+	{
+		if (Tile->GetCurrentSector() == Sector && Tile->GetTileStatus() == ETileStatus::TILE_FINISHED && Tile->GetVerticesOnBorderSet() && !Tile->IsTileRetained())
+		{
+			return Tile;
+		}
 	}
+	return nullptr;
 }
 
 void ATerrainManager::GetAdjacentTiles(const FIntVector2D Sector, TArray<ATerrainTile*>& OUTAdjacentTiles, const bool OnlyReturnRelevantTiles)
@@ -1070,233 +1513,42 @@ int32 ATerrainManager::GetTrackPointsForSector(const FIntVector2D Sector, FVecto
 	}
 }
 
-void ATerrainManager::GenerateTrackMesh(const FIntVector2D Sector, TArray<FRuntimeMeshVertexSimple>& OUTVertexBuffer, TArray<int32>& OUTTriangleBuffer, TArray<FTrackSegment>& OUTTrackSegments)
+void ATerrainManager::SetJobTrackInfo(FTerrainJob& Job) const
 {
-	if (!TrackMap.Contains(Sector))
+	Job.TrackInfo = TrackMap.FindRef(Job.Sector);
+	if (Job.TrackInfo.bSectorHasTrack)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Could not find track info for sector %s in TrackMap."), *Sector.ToString());
-		return;
+		Job.PreviousTrackInfo = TrackMap.FindRef(Job.TrackInfo.PreviousTrackSector);
 	}
+}
 
-	FSectorTrackInfo TrackInfo = TrackMap.FindRef(Sector);
-	FSectorTrackInfo PreviousTrackInfo = TrackMap.FindRef(TrackInfo.PreviousTrackSector);
-
-	//float HalfHeight = TrackInfo.TrackExitPointElevation - ((TrackInfo.TrackExitPointElevation - PreviousTrackInfo.TrackExitPointElevation) / 2.f);
-		//EndPoint.Z - ((EndPoint.Z - StartPoint.Z) / 2.f);
-
-
-	/*FVector BezierPoints[4]; 
-	BezierPoints[1] = TrackInfo.FirstBezierControlPoint;
-	BezierPoints[2] = TrackInfo.SecondBezierControlPoint;
-
-	GetTrackPointsForSector(Sector, BezierPoints[0], BezierPoints[3]);*/
+uint32 ATerrainManager::CalculateSectorTrackHash(const FIntVector2D Sector) const
+{
+	const FSectorTrackInfo* TrackInfo = TrackMap.Find(Sector);
+	if (TrackInfo == nullptr || !TrackInfo->bSectorHasTrack) { return 0; }
+	const FSectorTrackInfo* PreviousTrackInfo = TrackMap.Find(TrackInfo->PreviousTrackSector);
+	return TrackInfo->CalculateTrackHash(PreviousTrackInfo ? *PreviousTrackInfo : FSectorTrackInfo());
+}
 
-	// calculate mesh
-	TArray<FVector> PointsOnTrack = TrackInfo.PointsOnBezierCurve;
-	//FVector::EvaluateBezier(BezierPoints, TerrainSettings.TrackGenerationSettings.TrackResolution, PointsOnTrack);
-#
-	// check if we should spawn a checkpoint
-	if (TrackInfo.CheckpointID != -1 && PointsOnTrack.Num() >= 3)
-	{
-		FVector SpawnLocation;
-		FVector SpawnDirection;
-		if (Sector == FIntVector2D(0, 0))
-		{
-			SpawnLocation = FVector(Sector.X * TerrainSettings.TileEdgeSize + PointsOnTrack[1].X, Sector.Y * TerrainSettings.TileEdgeSize + PointsOnTrack[1].Y, PointsOnTrack[1].Z);
-			SpawnDirection = PointsOnTrack[2] - PointsOnTrack[1];
-		}
-		else
-		{
-			SpawnLocation = FVector(Sector.X * TerrainSettings.TileEdgeSize + PointsOnTrack[0].X, Sector.Y * TerrainSettings.TileEdgeSize + PointsOnTrack[0].Y, PointsOnTrack[0].Z);
-			SpawnDirection = PointsOnTrack[1] - PointsOnTrack[0];
-		}
-		FQuat SpawnRotation = SpawnDirection.Rotation().Quaternion();
-		FVector SpawnScaling = FVector(1.f, 1.f, 1.f);
-		FTransform Transform;
-		Transform.SetLocation(SpawnLocation);
-		Transform.SetRotation(SpawnRotation);
-		Transform.SetScale3D(SpawnScaling);
+void ATerrainManager::SpawnCheckpointForTile(ATerrainTile* Tile)
+{
+	const FSectorTrackInfo* TrackInfo = TrackMap.Find(Tile->GetCurrentSector());
+	if (!TrackInfo || TrackInfo->CheckpointID == -1 || Tile->GetCheckpointReference()) { return; }
 
-		// actors need to be spawned in the game thread
-		PendingCheckpointSpawnQueue.Enqueue(FCheckpointSpawnJob(TrackInfo.CheckpointID, Transform, Sector));
-	}
+	UWorld* World = GetWorld();
+	if (!World) { return; }
 
-	// check if we can set the player spawn point
-	if (Sector == FIntVector2D(0, 0))
+	AActor* Actor = World->SpawnActor(CheckpointClassToSpawn, &TrackInfo->CheckpointTransform, FActorSpawnParameters());
+	AProceduralCheckpoint* Checkpoint = Cast<AProceduralCheckpoint>(Actor);
+	if (Checkpoint)
 	{
-		if (PointsOnTrack.Num() > 3 && TerrainSettings.TrackSegmentToSpawnPlayerAt < (PointsOnTrack.Num() -1))
-		{
-			FVector SpawnLocation = PointsOnTrack[TerrainSettings.TrackSegmentToSpawnPlayerAt];
-			FVector SpawnDirection = PointsOnTrack[TerrainSettings.TrackSegmentToSpawnPlayerAt + 1] - PointsOnTrack[TerrainSettings.TrackSegmentToSpawnPlayerAt];
-			SpawnLocation += (UKismetMathLibrary::GetForwardVector(SpawnDirection.Rotation()) * TerrainSettings.TrackSegmentToSpawnPlayerAtOffset);
-			SpawnLocation.Z += TerrainSettings.PlayerSpawnElevationOffset;
-			FQuat SpawnRotation = SpawnDirection.Rotation().Quaternion();
-			FVector SpawnScaling = FVector(1.f, 1.f, 1.f);
-
-			FTransform Transform;
-			Transform.SetLocation(SpawnLocation);
-			Transform.SetRotation(SpawnRotation);
-			Transform.SetScale3D(SpawnScaling);
-
-			if (GameMode)
-			{
-				GameMode->SetPlayerSpawn(Transform);
-			}
-		}
+		Checkpoint->SetCheckpointID(TrackInfo->CheckpointID);
+		Checkpoint->SetActorScale3D(FVector(1.f, TerrainSettings.TrackGenerationSettings.TrackWidth / 100.f, 1.f));
+		Tile->SetCheckpointReference(Checkpoint);
 	}
-
-	for (int32 i = 0; i < PointsOnTrack.Num(); ++i)
+	else
 	{
-		// calculate normal
-
-		/**
-		 * X1X0 is the vector from the current track mid point to the next track mid point
-		 * Normal is the normal of X1X0 and (0,0,1)
-		 * Y0 and Y1 are the track border points (left and right) of the current track mid point
-		 */
-		FVector Y0;
-		FVector Y1;
-		FVector Normal;
-		if (i == 0)
-		{
-			int32 TileSize = TerrainSettings.TileEdgeSize;
-			FVector Pt = PointsOnTrack[i];		// shorter writing
-
-			if (Sector == FIntVector2D(0, 0))
-			{
-				switch (UMyStaticLibrary::GuessTileBorder(Pt, TileSize))
-				{
-					case ETileBorder::ETB_Bottom:
-						Normal = FVector::CrossProduct(FVector(1, 0, 0), FVector(0, 0, 1)).GetSafeNormal();
-						break;
-					case ETileBorder::ETB_Right:
-						Normal = FVector::CrossProduct(FVector(0, -1, 0), FVector(0, 0, 1)).GetSafeNormal();
-						break;
-					case ETileBorder::ETB_Top:
-						Normal = FVector::CrossProduct(FVector(-1, 0, 0), FVector(0, 0, 1)).GetSafeNormal();
-						break;
-					case ETileBorder::ETB_Left:
-						Normal = FVector::CrossProduct(FVector(0, 1, 0), FVector(0, 0, 1)).GetSafeNormal();
-						break;
-					case ETileBorder::ETB_Invalid:
-						UE_LOG(LogTemp, Error, TEXT("Could not guess on which border the first point on the bzier curve lies."));
-						break;
-				}
-
-				Y0 = PointsOnTrack[i] + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-				Y1 = PointsOnTrack[i] + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-
-			}
-			else
-			{
-				// load intersection points from TrackInfo (Y0 and Y1 values from previous tile)
-				Y0 = PreviousTrackInfo.Y0Position;
-				Y1 = PreviousTrackInfo.Y1Position;
-
-				// 'guess' on what border of the tile the entry point lies
-				switch (UMyStaticLibrary::GuessTileBorder(Pt, TileSize))
-				{
-					case ETileBorder::ETB_Bottom:
-						Y0.X = 0.f;
-						Y1.X = 0.f;
-						break;
-					case ETileBorder::ETB_Right:
-						Y0.Y = TileSize;
-						Y1.Y = TileSize;
-						break;
-					case ETileBorder::ETB_Top:
-						Y0.X = TileSize;
-						Y1.X = TileSize;
-						break;
-					case ETileBorder::ETB_Left:
-						Y0.Y = 0.f;
-						Y1.Y = 0.f;
-						break;
-					case ETileBorder::ETB_Invalid:
-						UE_LOG(LogTemp, Error, TEXT("Could not guess on which border the first point on the bzier curve lies."));
-						break;
-				}
-			}
-		}
-		else if (i == PointsOnTrack.Num() - 1)
-		{
-			Y0 = TrackInfo.Y0Position;
-			Y1 = TrackInfo.Y1Position;
-		}
-		else
-		{
-			FVector X1X0 = PointsOnTrack[i + 1] - PointsOnTrack[i];
-			Normal = FVector::CrossProduct(X1X0, FVector(0, 0, 1)).GetSafeNormal();
-
-			Y0 = PointsOnTrack[i] + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-			Y1 = PointsOnTrack[i] + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
-		}
-
-		Y0.Z = PointsOnTrack[i].Z;
-		Y1.Z = PointsOnTrack[i].Z;
-
-		if (!(FMath::IsNearlyEqual(PointsOnTrack[i].Z, Y0.Z) && FMath::IsNearlyEqual(PointsOnTrack[i].Z, Y1.Z)))
-		{
-			UE_LOG(LogTemp, Error, TEXT("Elevation of PointsOnTrack[i] and Y0 and Y1 are not equal! In %s"), *GetName());
-			UE_LOG(LogTemp, Error, TEXT("PointsOnTrack[i] elevation is %f | Y0 elevation is %f | Y1 elevation is %f"), PointsOnTrack[i].Z, Y0.Z, Y1.Z);
-		}
-
-		OUTVertexBuffer.Add(CreateRuntimeMeshVertexSimple(PointsOnTrack[i], FVector(0, 0, 1)));
-		OUTVertexBuffer.Add(CreateRuntimeMeshVertexSimple(Y0, FVector(0, 0, 1)));
-		OUTVertexBuffer.Add(CreateRuntimeMeshVertexSimple(Y1, FVector(0, 0, 1)));
-
-		// create triangles
-		// can only create triangles if we have at least two midpoints calculated
-		if (i > 0)
-		{
-			/**
-			 * track segments looks like this: (viewing from point X1)
-			 *
-			 *			Y2----------X1----------Y3
-			 *			|			|			|
-			 *			|			|			|
-			 *			|			|			|
-			 *			Y0----------X0----------Y1
-			 *
-			 *
-			 * points:	Y3 = Num - 1
-			 *			Y2 = Num - 2
-			 *			X1 = Num - 3
-			 *			Y1 = Num - 4
-			 *			Y0 = Num - 5
-			 *			X0 = Num - 6
-			 *
-			 *	(note that order of Y2 and Y3 (and Y0 and Y1) may be reversed due to normal calculation (but since its reveresed for all points, it doesn't matter)
-			 */
-			int32 Num = OUTVertexBuffer.Num();
-			// triangle Y0 X0 Y2
-			OUTTriangleBuffer.Add(Num - 5);
-			OUTTriangleBuffer.Add(Num - 6);
-			OUTTriangleBuffer.Add(Num - 2);
-
-			// triangle X0 X1 Y2
-			OUTTriangleBuffer.Add(Num - 6);
-			OUTTriangleBuffer.Add(Num - 3);
-			OUTTriangleBuffer.Add(Num - 2);
-
-			// triangle X0 Y1 X1
-			OUTTriangleBuffer.Add(Num - 6);
-			OUTTriangleBuffer.Add(Num - 4);
-			OUTTriangleBuffer.Add(Num - 3);
-
-			// triangle Y1 Y3 X1
-			OUTTriangleBuffer.Add(Num - 4);
-			OUTTriangleBuffer.Add(Num - 1);
-			OUTTriangleBuffer.Add(Num - 3);
-
-			float PreviousSegmentBaseElevation = 0.f;
-			if (i > 1)
-			{
-				PreviousSegmentBaseElevation = OUTVertexBuffer[Num - 9].Position.Z;
-			}
-
-			OUTTrackSegments.Add(FTrackSegment(OUTVertexBuffer[Num - 5].Position, OUTVertexBuffer[Num - 4].Position, OUTVertexBuffer[Num - 1].Position, OUTVertexBuffer[Num - 2].Position, OUTVertexBuffer[Num - 6].Position, OUTVertexBuffer[Num - 3].Position, PreviousSegmentBaseElevation, TerrainSettings.TileEdgeSize, TerrainSettings.TrackGenerationSettings.PointInsideErrorTolerance, TerrainSettings.TrackGenerationSettings.TrackElevationOffset));
-		}
+		UE_LOG(LogTemp, Error, TEXT("Spawned Checkpoint could not be cast to AProceduralCheckpoint in %s"), *GetName());
 	}
 }
 
@@ -1306,9 +1558,11 @@ void ATerrainManager::RecalculateTileForSector(const FIntVector2D Sector)
 	{
 		if (Tile->GetCurrentSector() == Sector)
 		{
-			FTerrainJob Job;
-			Job.TerrainTile = Tile;
-			PendingTerrainJobQueue.Enqueue(Job);
+			// the cached tile is outdated, the recalculated one gets cached when it is finished
+			TileCache.Remove(FTerrainTileCacheKey(Sector, GenerationSettingsHash));
+			TileDiskCache.Remove(Sector);
+			if (TerrainSettings.bIncrementalBorderRegeneration && RegenerateTileBorders(Tile)) { return; }
+			EnqueueTerrainJob(Tile, false);
 			return;
 		}
 	}	
@@ -1373,17 +1627,35 @@ bool ATerrainManager::ContainsSectorTrack(const FIntVector2D Sector) const
 	return TrackInfo.bSectorHasTrack;
 }
 
-// Creates a FRuntimeMeshVertexSimple from the given Vertex
-FRuntimeMeshVertexSimple ATerrainManager::CreateRuntimeMeshVertexSimple(const FVector Vertex, const FVector Normal) const
+bool ATerrainManager::FindNearestPointOnTrack(const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const
+{
+	return TrackSplineIndex.FindNearestPoint(Location, OUTPoint, OUTDistanceAlongTrack);
+}
+
+bool ATerrainManager::GetTrackLocationAtDistance(const float DistanceAlongTrack, FVector& OUTLocation, FVector& OUTDirection) const
+{
+	return TrackSplineIndex.GetLocationAtDistance(DistanceAlongTrack, OUTLocation, OUTDirection);
+}
+
+float ATerrainManager::GetTrackLength() const
 {
-	return FRuntimeMeshVertexSimple(
-		Vertex,										// Vertex position
-		Normal,											// Vertex normal
-		FRuntimeMeshTangent(0.f, -1.f, 0.f),			// Vertex tangent
-		FColor::White,
-		FVector2D(Vertex.X / 500.f, Vertex.Y / 500.f)	// Vertex texture coordinates
-	);
+	return TrackSplineIndex.GetTrackLength();
 }
 
+bool ATerrainManager::GetCheckpointTransform(const int32 CheckpointID, FTransform& OUTTransform) const
+{
+	const FIntVector2D* Sector = CheckpointSectors.Find(CheckpointID);
+	if (!Sector) { return false; }
+
+	OUTTransform = TrackMap.FindChecked(*Sector).CheckpointTransform;
+	return true;
+}
 
+bool ATerrainManager::GetPlayerSpawnTransform(FTransform& OUTTransform) const
+{
+	const FSectorTrackInfo* TrackInfo = TrackMap.Find(FIntVector2D(0, 0));
+	if (!TrackInfo || !TrackInfo->bHasPlayerSpawn) { return false; }
 
+	OUTTransform = TrackInfo->PlayerSpawnTransform;
+	return true;
+}
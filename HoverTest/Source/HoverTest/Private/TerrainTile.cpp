@@ -2,6 +2,7 @@
 
 #include "TerrainTile.h"
 #include "RuntimeMeshComponent.h"
+#include "TerrainHeightfieldCollisionComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "Runtime/Engine/Classes/Engine/World.h"
 #include "ProceduralCheckpoint.h"
@@ -15,6 +16,15 @@ ATerrainTile::ATerrainTile()
 
 	RootComponent = CreateDefaultSubobject<USphereComponent>(TEXT("RootComponent"));
 
+	// create the runtime mesh together with the actor, so pooled tiles never need to create components during gameplay
+	RuntimeMesh = CreateDefaultSubobject<URuntimeMeshComponent>(TEXT("Runtime Mesh"));
+	RuntimeMesh->SetupAttachment(RootComponent);
+	RuntimeMesh->BodyInstance.SetResponseToAllChannels(ECollisionResponse::ECR_Block);
+	RuntimeMesh->SetVisibility(false);
+
+	HeightfieldCollision = CreateDefaultSubobject<UTerrainHeightfieldCollisionComponent>(TEXT("Heightfield Collision"));
+	HeightfieldCollision->SetupAttachment(RootComponent);
+
 	MeshSectionsCreated.Empty();
 
 }
@@ -51,16 +61,19 @@ void ATerrainTile::SetupTile(FTerrainSettings TerrainSettings, FIntVector2D Sect
 	SetActorLocation(FVector(TerrainSettings.TileEdgeSize * Sector.X, TerrainSettings.TileEdgeSize * Sector.Y, 0.f));
 	CurrentSector = Sector;
 	// make sure newly created tile does not get destroyed immediately
-	TimeSinceTileFreed = FPlatformTime::Seconds();
+	TimeSinceTileFreed = GetWorld()->TimeSeconds;
 	if (!bIsInitialized)
 	{
-		RuntimeMesh = NewObject<URuntimeMeshComponent>(this, URuntimeMeshComponent::StaticClass(), FName("Runtime Mesh"));
-		RuntimeMesh->SetRelativeTransform(FTransform());
-		RuntimeMesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
-		RuntimeMesh->BodyInstance.SetResponseToAllChannels(ECollisionResponse::ECR_Block);
-		RuntimeMesh->SetCollisionUseAsyncCooking(TerrainSettings.bUseAsyncCollisionCooking);
-		RuntimeMesh->RegisterComponent();
-		RuntimeMesh->SetVisibility(false);
+		// the runtime mesh itself is created in the constructor, only apply the settings here
+		if (RuntimeMesh)
+		{
+			RuntimeMesh->SetCollisionUseAsyncCooking(TerrainSettings.bUseAsyncCollisionCooking);
+			RuntimeMesh->SetVisibility(false);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Runtime mesh of %s was not created in the constructor"), *GetName());
+		}
 
 		bIsInitialized = true;
 	}
@@ -87,15 +100,16 @@ void ATerrainTile::UpdateTilePosition(FTerrainSettings TerrainSettings, FIntVect
 	SetActorHiddenInGame(true);
 }
 
-void ATerrainTile::UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMeshData>& MeshData)
+int32 ATerrainTile::UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMeshData>& MeshData)
 {
-	if (RuntimeMesh == nullptr) { return; }
+	if (RuntimeMesh == nullptr) { return 0; }
 	if (!bIsInitialized || TileStatus == ETileStatus::TILE_UNDEFINED)
 	{
 		UE_LOG(LogTemp, Error, TEXT("Tried to call UpdateMeshData on %s before calling SetupTile"), *GetName());
-		return;
+		return 0;
 	}
 
+	int32 UploadedBytes = 0;
 	if (TileStatus == ETileStatus::TILE_INITIALIZED || TileStatus == ETileStatus::TILE_TRANSITION)
 	{
 		// tile is initialized, but runtime mesh sections do not exist
@@ -103,7 +117,7 @@ void ATerrainTile::UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMesh
 		{
 			if (MeshData[i].VertexBuffer.Num() != 0)
 			{
-				RuntimeMesh->CreateMeshSection(i, MeshData[i].VertexBuffer, MeshData[i].TriangleBuffer, true, EUpdateFrequency::Infrequent, ESectionUpdateFlags::None);
+				UploadedBytes += UploadMeshSection(i, MeshData[i], false);
 				MeshSectionsCreated.Add(i);
 			}
 		}
@@ -118,13 +132,13 @@ void ATerrainTile::UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMesh
 			if (MeshSectionsCreated.Find(i) == INDEX_NONE) { continue; }
 			if (MeshData[i].VertexBuffer.Num() != 0)
 			{
-				RuntimeMesh->UpdateMeshSection(i, MeshData[i].VertexBuffer, MeshData[i].TriangleBuffer, ESectionUpdateFlags::None);
+				UploadedBytes += UploadMeshSection(i, MeshData[i], true);
 			}
 		}
 
 		TileStatus = ETileStatus::TILE_FINISHED;
 	}
-	else { return; }
+	else { return 0; }
 
 	// apply materials
 	for (int32 i = 0; i < MeshData.Num(); ++i)
@@ -132,15 +146,143 @@ void ATerrainTile::UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMesh
 		if (MeshSectionsCreated.Find(i) == INDEX_NONE) { continue; }
 		if (MeshData[i].VertexBuffer.Num() != 0)
 		{
-			if (TerrainSettings.Materials.IsValidIndex(i))
+			if (TerrainSettings.Materials.IsValidIndex(i) && RuntimeMesh->GetMaterial(i) != TerrainSettings.Materials[i])
 			{
 				RuntimeMesh->SetMaterial(i, TerrainSettings.Materials[i]);
 			}
 		}
 	}
+	UE_LOG(LogTemp, Verbose, TEXT("Uploaded %i bytes of mesh data for %s"), UploadedBytes, *GetName());
+
+	// retained tiles stay hidden until they are used again
+	if (bIsRetained) { return UploadedBytes; }
 
 	RuntimeMesh->SetVisibility(true);
 	SetActorHiddenInGame(false);
+	return UploadedBytes;
+}
+
+int32 ATerrainTile::UploadMeshSection(const int32 Section, const FMeshData& MeshData, const bool bSectionExists)
+{
+	TArray<uint16> TriangleBuffer16;
+	const bool bUse16BitIndices = MeshData.GetTriangleBuffer16(TriangleBuffer16);
+	const int32 VertexBytes = MeshData.VertexBuffer.Num() * sizeof(FTerrainVertex);
+	const int32 IndexBytes = MeshData.TriangleBuffer.Num() * (bUse16BitIndices ? sizeof(uint16) : sizeof(int32));
+	FMeshSectionUploadState UploadState(MeshData, bUse16BitIndices);
+	const FMeshSectionUploadState* PreviousUploadState = UploadedMeshSections.Find(Section);
+
+	int32 UploadedBytes = 0;
+	if (bSectionExists && PreviousUploadState && UploadState.HasSameTriangles(*PreviousUploadState))
+	{
+		// the index buffer stays as it is, only the changed vertices are written
+		TArray<FMeshVertexRange> Ranges;
+		UploadState.GetChangedVertexRanges(*PreviousUploadState, Ranges);
+		if (Ranges.Num() == 0) { return 0; }
+		UploadedBytes = WriteMeshSectionVertices(Section, MeshData, Ranges) * sizeof(FTerrainVertex);
+	}
+
+	// the vertices could not be written in place (or the triangles changed), so the whole section is uploaded
+	if (UploadedBytes == 0)
+	{
+		if (bSectionExists && PreviousUploadState && UploadState.CanUpdateSection(*PreviousUploadState))
+		{
+			if (bUse16BitIndices)
+			{
+				RuntimeMesh->UpdateMeshSection(Section, MeshData.VertexBuffer, TriangleBuffer16, ESectionUpdateFlags::None);
+			}
+			else
+			{
+				RuntimeMesh->UpdateMeshSection(Section, MeshData.VertexBuffer, MeshData.TriangleBuffer, ESectionUpdateFlags::None);
+			}
+		}
+		else
+		{
+			if (bUse16BitIndices)
+			{
+				RuntimeMesh->CreateMeshSection(Section, MeshData.VertexBuffer, TriangleBuffer16, MeshData.bCreateCollision, EUpdateFrequency::Infrequent, ESectionUpdateFlags::None);
+			}
+			else
+			{
+				RuntimeMesh->CreateMeshSection(Section, MeshData.VertexBuffer, MeshData.TriangleBuffer, MeshData.bCreateCollision, EUpdateFrequency::Infrequent, ESectionUpdateFlags::None);
+			}
+		}
+		UploadedBytes = VertexBytes + IndexBytes;
+	}
+	UploadedMeshSections.Add(Section, MoveTemp(UploadState));
+	return UploadedBytes;
+}
+
+int32 ATerrainTile::UpdateMeshSectionVertices(const int32 Section, const FMeshData& MeshData, const TArray<FMeshVertexRange>& Ranges)
+{
+	if (RuntimeMesh == nullptr || TileStatus != ETileStatus::TILE_FINISHED || !MeshSectionsCreated.Contains(Section)) { return 0; }
+
+	const FMeshSectionUploadState* PreviousUploadState = UploadedMeshSections.Find(Section);
+	if (PreviousUploadState == nullptr) { return 0; }
+	FMeshSectionUploadState UploadState(MeshData, PreviousUploadState->b16BitIndices);
+	if (!UploadState.HasSameTriangles(*PreviousUploadState)) { return 0; }
+
+	const int32 UploadedBytes = WriteMeshSectionVertices(Section, MeshData, Ranges) * sizeof(FTerrainVertex);
+	// nothing was written, keep the previous state so a following full upload does not skip the changed vertices
+	if (UploadedBytes == 0) { return 0; }
+	UploadedMeshSections.Add(Section, MoveTemp(UploadState));
+	return UploadedBytes;
+}
+
+int32 ATerrainTile::WriteMeshSectionVertices(const int32 Section, const FMeshData& MeshData, const TArray<FMeshVertexRange>& Ranges)
+{
+	TUniquePtr<FRuntimeMeshScopedUpdater> Updater = RuntimeMesh->BeginSectionUpdate(Section);
+	if (!Updater.IsValid() || Updater->NumVertices() != MeshData.VertexBuffer.Num()) { return 0; }
+
+	int32 WrittenVertices = 0;
+	for (const FMeshVertexRange& Range : Ranges)
+	{
+		const int32 LastVertex = FMath::Min(Range.FirstVertex + Range.NumVertices, MeshData.VertexBuffer.Num());
+		for (int32 i = FMath::Max(Range.FirstVertex, 0); i < LastVertex; ++i)
+		{
+			const FTerrainVertex& Vertex = MeshData.VertexBuffer[i];
+			Updater->SetPosition(i, Vertex.Position);
+			Updater->SetNormal(i, Vertex.Normal);
+			Updater->SetTangent(i, Vertex.Tangent);
+			Updater->SetUV(i, Vertex.UV0);
+			WrittenVertices++;
+		}
+	}
+	Updater->Commit();
+	return WrittenVertices;
+}
+
+void ATerrainTile::UpdateCollisionMesh(const TArray<FVector>& Vertices, const TArray<int32>& Triangles)
+{
+	if (RuntimeMesh == nullptr) { return; }
+	if (Vertices.Num() == 0 || Triangles.Num() == 0)
+	{
+		if (bHasCollisionMesh)
+		{
+			RuntimeMesh->ClearCollisionMesh();
+			bHasCollisionMesh = false;
+		}
+		return;
+	}
+	RuntimeMesh->SetCollisionMesh(Vertices, Triangles);
+	bHasCollisionMesh = true;
+}
+
+float ATerrainTile::UpdateCollisionHeightfield(const FTerrainCollisionHeightfield& Heightfield)
+{
+	if (HeightfieldCollision == nullptr) { return 0.f; }
+	// nothing to do for tiles without heightfield collision
+	if (!Heightfield.IsValid() && !HeightfieldCollision->HasHeightfield()) { return 0.f; }
+	return HeightfieldCollision->SetHeightfield(Heightfield);
+}
+
+void ATerrainTile::SetCompactTerrain(const FCompactTerrainTile& Terrain)
+{
+	CompactTerrain = Terrain;
+}
+
+const FCompactTerrainTile& ATerrainTile::GetCompactTerrain() const
+{
+	return CompactTerrain;
 }
 
 FIntVector2D ATerrainTile::GetCurrentSector() const
@@ -148,6 +290,16 @@ FIntVector2D ATerrainTile::GetCurrentSector() const
 	return CurrentSector;
 }
 
+int32 ATerrainTile::BeginTerrainJob()
+{
+	return LatestJobSerial.Increment();
+}
+
+int32 ATerrainTile::GetLatestJobSerial() const
+{
+	return LatestJobSerial.GetValue();
+}
+
 void ATerrainTile::AddAssociatedActor()
 {
 	ActorsAssociatedWithThisTile++;
@@ -170,6 +322,8 @@ void ATerrainTile::FreeTile()
 		/*TerrainMesh->ClearMeshSection(0);
 		TrackMesh->ClearMeshSection(0);*/
 	}
+	UpdateCollisionMesh(TArray<FVector>(), TArray<int32>());
+	UpdateCollisionHeightfield(FTerrainCollisionHeightfield());
 
 	if (Checkpoint && Checkpoint->IsValidLowLevel())
 	{
@@ -179,9 +333,16 @@ void ATerrainTile::FreeTile()
 
 	// better safe than sorry
 	MeshSectionsCreated.Empty();
+	UploadedMeshSections.Empty();
+	CompactTerrain = FCompactTerrainTile();
 
 	TileStatus = ETileStatus::TILE_FREE;
+	// jobs still in process for the tile are outdated
+	LatestJobSerial.Increment();
+	bIsRetained = false;
 	SetActorHiddenInGame(true);
+	// a retained tile had its collision disabled
+	SetActorEnableCollision(true);
 	ActorsAssociatedWithThisTile = 0;
 	CurrentSector = FIntVector2D();
 	SetActorLocation(FVector(0.f, 0.f, 0.f));
@@ -194,9 +355,45 @@ void ATerrainTile::FreeTile()
 	BottomRightCorner = FVector();
 	TopRightCorner = FVector();
 	TopLeftCorner = FVector();
+	TriangleEdgeIterations = 0;
 	TimeSinceTileFreed = GetWorld()->TimeSeconds;
 }
 
+void ATerrainTile::RetainTile()
+{
+	bIsRetained = true;
+	SetActorHiddenInGame(true);
+	// the tile stays at its sector, so neither the hovercraft nor a checkpoint trigger must hit it there while nobody needs it
+	SetActorEnableCollision(false);
+	if (Checkpoint && Checkpoint->IsValidLowLevel())
+	{
+		Checkpoint->SetActorHiddenInGame(true);
+		Checkpoint->SetActorEnableCollision(false);
+	}
+	ActorsAssociatedWithThisTile = 0;
+	TimeSinceTileFreed = GetWorld()->TimeSeconds;
+}
+
+void ATerrainTile::RestoreRetainedTile()
+{
+	bIsRetained = false;
+	SetActorEnableCollision(true);
+	if (Checkpoint && Checkpoint->IsValidLowLevel())
+	{
+		Checkpoint->SetActorHiddenInGame(false);
+		Checkpoint->SetActorEnableCollision(true);
+	}
+	if (TileStatus == ETileStatus::TILE_FINISHED)
+	{
+		SetActorHiddenInGame(false);
+	}
+}
+
+bool ATerrainTile::IsTileRetained() const
+{
+	return bIsRetained;
+}
+
 float ATerrainTile::GetTimeSinceTileFreed() const
 {
 	return TimeSinceTileFreed;
@@ -321,3 +518,45 @@ void ATerrainTile::SetTopLeftCorner(const FVector Vertex)
 	TopLeftCorner = Vertex;
 }
 
+bool ATerrainTile::GetBorderToSector(const FIntVector2D Sector, FAdjacentTileBorder& OUTBorder) const
+{
+	if (!bVerticesOnBorderSet) { return false; }
+
+	const FIntVector2D Offset = Sector - CurrentSector;
+	if (Offset == FIntVector2D(1, 0))
+	{
+		OUTBorder.Vertices = VerticesTopBorder;
+	}
+	else if (Offset == FIntVector2D(-1, 0))
+	{
+		OUTBorder.Vertices = VerticesBottomBorder;
+	}
+	else if (Offset == FIntVector2D(0, 1))
+	{
+		OUTBorder.Vertices = VerticesRightBorder;
+	}
+	else if (Offset == FIntVector2D(0, -1))
+	{
+		OUTBorder.Vertices = VerticesLeftBorder;
+	}
+	else
+	{
+		return false;
+	}
+	OUTBorder.Sector = CurrentSector;
+	OUTBorder.BottomLeftCorner = BottomLeftCorner;
+	OUTBorder.BottomRightCorner = BottomRightCorner;
+	OUTBorder.TopRightCorner = TopRightCorner;
+	OUTBorder.TopLeftCorner = TopLeftCorner;
+	return true;
+}
+
+void ATerrainTile::SetTriangleEdgeIterations(const int32 Iterations)
+{
+	TriangleEdgeIterations = Iterations;
+}
+
+int32 ATerrainTile::GetTriangleEdgeIterations() const
+{
+	return TriangleEdgeIterations;
+}
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainTileCache.h"
+
+void FTerrainTileCache::SetBudget(const int64 BudgetInBytes)
+{
+	Budget = FMath::Max<int64>(BudgetInBytes, 0);
+	EvictToBudget();
+}
+
+void FTerrainTileCache::Add(const FTerrainTileCacheKey& Key, FCachedTerrainTile&& Tile)
+{
+	if (Budget <= 0) { return; }
+
+	Remove(Key);
+
+	const int64 Size = Tile.GetAllocatedSize();
+	if (Size > Budget)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Tile of sector %s does not fit into the tile cache budget (%lld of %lld bytes)"), *Key.Sector.ToString(), Size, Budget);
+		return;
+	}
+
+	Tile.LastAccess = ++AccessCounter;
+	Entries.Add(Key, MoveTemp(Tile));
+	UsedBytes += Size;
+	EvictToBudget();
+}
+
+const FCachedTerrainTile* FTerrainTileCache::Find(const FTerrainTileCacheKey& Key)
+{
+	FCachedTerrainTile* Tile = Entries.Find(Key);
+	if (Tile == nullptr)
+	{
+		Misses++;
+		return nullptr;
+	}
+	Hits++;
+	Tile->LastAccess = ++AccessCounter;
+	return Tile;
+}
+
+void FTerrainTileCache::Remove(const FTerrainTileCacheKey& Key)
+{
+	const FCachedTerrainTile* Tile = Entries.Find(Key);
+	if (Tile)
+	{
+		UsedBytes -= Tile->GetAllocatedSize();
+		Entries.Remove(Key);
+	}
+}
+
+void FTerrainTileCache::Empty()
+{
+	Entries.Empty();
+	UsedBytes = 0;
+}
+
+int32 FTerrainTileCache::Num() const
+{
+	return Entries.Num();
+}
+
+int64 FTerrainTileCache::GetUsedBytes() const
+{
+	return UsedBytes;
+}
+
+int32 FTerrainTileCache::GetHits() const
+{
+	return Hits;
+}
+
+int32 FTerrainTileCache::GetMisses() const
+{
+	return Misses;
+}
+
+void FTerrainTileCache::EvictToBudget()
+{
+	while (UsedBytes > Budget && Entries.Num() > 0)
+	{
+		// the cache only holds a few dozen tiles, so a linear search for the least recently used one is cheap
+		const FTerrainTileCacheKey* OldestKey = nullptr;
+		uint64 OldestAccess = MAX_uint64;
+		for (const TPair<FTerrainTileCacheKey, FCachedTerrainTile>& Entry : Entries)
+		{
+			if (Entry.Value.LastAccess < OldestAccess)
+			{
+				OldestAccess = Entry.Value.LastAccess;
+				OldestKey = &Entry.Key;
+			}
+		}
+		Remove(FTerrainTileCacheKey(*OldestKey));
+	}
+
+	if (Entries.Num() == 0)
+	{
+		UsedBytes = 0;
+	}
+}
@@ -0,0 +1,394 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TerrainTileDiskCache.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/Archive.h"
+
+namespace
+{
+	// "HTTC" (HoverTest tile cache)
+	const uint32 TileCacheFileMagic = 0x43545448;
+
+	// has to be increased whenever the file layout or the terrain generation changes in a way the settings hash does not cover
+	const uint32 TileCacheFileVersion = 4;
+
+	struct FFileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		int32 Seed;
+		uint32 SettingsHash;
+		int32 NumberOfTiles;
+		uint32 Padding;
+	};
+
+	struct FIndexEntry
+	{
+		int32 SectorX;
+		int32 SectorY;
+		int64 Offset;
+		int64 Size;
+	};
+
+	/**
+	 * followed by GridSize * 4 border elevations (float), HeightDataSize bytes of elevations, NormalDataSize bytes of normals
+	 * and the quad levels of the terrain mesh and the collision mesh
+	 * see FCompactTerrainTile for their meaning
+	 */
+	struct FBlockHeader
+	{
+		int32 GridSize;
+		float UnitSize;
+		float MinHeight;
+		float HeightStep;
+		uint32 bIsDeltaEncoded;
+		int32 HeightDataSize;
+		int32 NormalDataSize;
+		int32 QuadLevelDataSize;
+		int32 CollisionQuadLevelDataSize;
+		// see FSectorTrackInfo::CalculateTrackHash
+		uint32 TrackHash;
+		// bottom left, bottom right, top right and top left corner
+		float Corners[4][3];
+	};
+
+	int64 CalculateBlockSize(const int32 GridSize, const int32 HeightDataSize, const int32 NormalDataSize, const int32 QuadLevelDataSize, const int32 CollisionQuadLevelDataSize)
+	{
+		return Align(sizeof(FBlockHeader) + static_cast<int64>(GridSize) * 4 * sizeof(float) + HeightDataSize + NormalDataSize + QuadLevelDataSize + CollisionQuadLevelDataSize, 8);
+	}
+}
+
+FTerrainTileDiskCache::~FTerrainTileDiskCache()
+{
+	Close();
+}
+
+void FTerrainTileDiskCache::Open(const FString& InFilename, const int32 InSeed, const uint32 InSettingsHash)
+{
+	Close();
+
+	Filename = InFilename;
+	Seed = InSeed;
+	SettingsHash = InSettingsHash;
+	bIsOpen = true;
+
+	if (!FPaths::FileExists(Filename)) { return; }
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFileHandle = PlatformFile.OpenMapped(*Filename);
+	if (MappedFileHandle)
+	{
+		MappedFileRegion = MappedFileHandle->MapRegion();
+	}
+	if (MappedFileRegion)
+	{
+		FileData = MappedFileRegion->GetMappedPtr();
+		FileSize = MappedFileRegion->GetMappedSize();
+	}
+	else
+	{
+		// memory mapping is not supported on every platform
+		if (!FFileHelper::LoadFileToArray(LoadedFile, *Filename))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Could not read tile cache file %s, it will be replaced"), *Filename);
+			bIsDirty = true;
+			return;
+		}
+		FileData = LoadedFile.GetData();
+		FileSize = LoadedFile.Num();
+	}
+
+	if (FileSize < static_cast<int64>(sizeof(FFileHeader)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Tile cache file %s is corrupted and will be replaced"), *Filename);
+		bIsDirty = true;
+		return;
+	}
+
+	const FFileHeader* Header = reinterpret_cast<const FFileHeader*>(FileData);
+	if (Header->Magic != TileCacheFileMagic || Header->Version != TileCacheFileVersion || Header->Seed != Seed || Header->SettingsHash != SettingsHash)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Tile cache file %s is outdated and will be replaced"), *Filename);
+		bIsDirty = true;
+		return;
+	}
+
+	const int64 IndexEnd = sizeof(FFileHeader) + static_cast<int64>(Header->NumberOfTiles) * sizeof(FIndexEntry);
+	if (Header->NumberOfTiles < 0 || IndexEnd > FileSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Tile cache file %s is corrupted and will be replaced"), *Filename);
+		bIsDirty = true;
+		return;
+	}
+
+	const FIndexEntry* Index = reinterpret_cast<const FIndexEntry*>(FileData + sizeof(FFileHeader));
+	for (int32 i = 0; i < Header->NumberOfTiles; ++i)
+	{
+		if (Index[i].Offset < IndexEnd || Index[i].Size <= 0 || Index[i].Offset + Index[i].Size > FileSize)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Skipping corrupted entry of sector (%i, %i) in tile cache file %s"), Index[i].SectorX, Index[i].SectorY, *Filename);
+			bIsDirty = true;
+			continue;
+		}
+		FBlockLocation Location;
+		Location.Offset = Index[i].Offset;
+		Location.Size = Index[i].Size;
+		FileIndex.Add(FIntVector2D(Index[i].SectorX, Index[i].SectorY), Location);
+	}
+}
+
+bool FTerrainTileDiskCache::Save()
+{
+	if (!bIsOpen || !bIsDirty) { return true; }
+
+	struct FBlockToWrite
+	{
+		FIntVector2D Sector;
+		const uint8* Data;
+		int64 Size;
+	};
+
+	TArray<FBlockToWrite> Blocks;
+	for (const TPair<FIntVector2D, FBlockLocation>& Entry : FileIndex)
+	{
+		Blocks.Add({ Entry.Key, FileData + Entry.Value.Offset, Entry.Value.Size });
+	}
+	for (const TPair<FIntVector2D, TArray<uint8>>& Entry : AddedBlocks)
+	{
+		Blocks.Add({ Entry.Key, Entry.Value.GetData(), Entry.Value.Num() });
+	}
+
+	const FString TempFilename = Filename + TEXT(".tmp");
+	FArchive* Writer = IFileManager::Get().CreateFileWriter(*TempFilename);
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not create tile cache file %s"), *TempFilename);
+		return false;
+	}
+
+	FFileHeader Header;
+	Header.Magic = TileCacheFileMagic;
+	Header.Version = TileCacheFileVersion;
+	Header.Seed = Seed;
+	Header.SettingsHash = SettingsHash;
+	Header.NumberOfTiles = Blocks.Num();
+	Header.Padding = 0;
+	Writer->Serialize(&Header, sizeof(FFileHeader));
+
+	int64 Offset = sizeof(FFileHeader) + static_cast<int64>(Blocks.Num()) * sizeof(FIndexEntry);
+	for (const FBlockToWrite& Block : Blocks)
+	{
+		FIndexEntry Entry;
+		Entry.SectorX = Block.Sector.X;
+		Entry.SectorY = Block.Sector.Y;
+		Entry.Offset = Offset;
+		Entry.Size = Block.Size;
+		Writer->Serialize(&Entry, sizeof(FIndexEntry));
+		Offset += Block.Size;
+	}
+	for (const FBlockToWrite& Block : Blocks)
+	{
+		Writer->Serialize(const_cast<uint8*>(Block.Data), Block.Size);
+	}
+
+	const bool bWriteFailed = Writer->IsError();
+	delete Writer;
+	if (bWriteFailed)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write tile cache file %s"), *TempFilename);
+		IFileManager::Get().Delete(*TempFilename);
+		return false;
+	}
+
+	// the mapped file has to be released before it can be replaced
+	const FString CacheFilename = Filename;
+	const int32 CacheSeed = Seed;
+	const uint32 CacheSettingsHash = SettingsHash;
+	Close();
+
+	if (!IFileManager::Get().Move(*CacheFilename, *TempFilename, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not replace tile cache file %s"), *CacheFilename);
+		IFileManager::Get().Delete(*TempFilename);
+		return false;
+	}
+
+	// reopen, so the cache can still be used after saving
+	Open(CacheFilename, CacheSeed, CacheSettingsHash);
+	return true;
+}
+
+void FTerrainTileDiskCache::Close()
+{
+	delete MappedFileRegion;
+	MappedFileRegion = nullptr;
+	delete MappedFileHandle;
+	MappedFileHandle = nullptr;
+	LoadedFile.Empty();
+	FileData = nullptr;
+	FileSize = 0;
+	FileIndex.Empty();
+	AddedBlocks.Empty();
+	bIsDirty = false;
+	bIsOpen = false;
+}
+
+bool FTerrainTileDiskCache::IsOpen() const
+{
+	return bIsOpen;
+}
+
+bool FTerrainTileDiskCache::Find(const FIntVector2D Sector, const uint32 TrackHash, FCachedTerrainTile& OUTTile)
+{
+	if (!bIsOpen) { return false; }
+
+	int64 BlockSize = 0;
+	const uint8* Block = FindBlock(Sector, BlockSize);
+	if (Block == nullptr) { return false; }
+
+	if (!ReadBlock(Block, BlockSize, OUTTile))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Removing corrupted tile of sector %s from the tile cache file"), *Sector.ToString());
+		Remove(Sector);
+		return false;
+	}
+	// the terrain was carved around another track, the regenerated tile replaces it
+	if (OUTTile.TrackHash != TrackHash)
+	{
+		UE_LOG(LogTemp, Verbose, TEXT("Removing tile of sector %s from the tile cache file, it was generated for another track"), *Sector.ToString());
+		Remove(Sector);
+		return false;
+	}
+	Hits++;
+	return true;
+}
+
+void FTerrainTileDiskCache::Add(const FIntVector2D Sector, const FCachedTerrainTile& Tile)
+{
+	if (!bIsOpen) { return; }
+
+	TArray<uint8> Block;
+	if (!WriteBlock(Tile, Block)) { return; }
+
+	FileIndex.Remove(Sector);
+	AddedBlocks.Add(Sector, MoveTemp(Block));
+	bIsDirty = true;
+}
+
+void FTerrainTileDiskCache::Remove(const FIntVector2D Sector)
+{
+	if (FileIndex.Remove(Sector) + AddedBlocks.Remove(Sector) > 0)
+	{
+		bIsDirty = true;
+	}
+}
+
+int32 FTerrainTileDiskCache::Num() const
+{
+	return FileIndex.Num() + AddedBlocks.Num();
+}
+
+int32 FTerrainTileDiskCache::GetHits() const
+{
+	return Hits;
+}
+
+const uint8* FTerrainTileDiskCache::FindBlock(const FIntVector2D Sector, int64& OUTSize) const
+{
+	if (const TArray<uint8>* AddedBlock = AddedBlocks.Find(Sector))
+	{
+		OUTSize = AddedBlock->Num();
+		return AddedBlock->GetData();
+	}
+	if (const FBlockLocation* Location = FileIndex.Find(Sector))
+	{
+		OUTSize = Location->Size;
+		return FileData + Location->Offset;
+	}
+	return nullptr;
+}
+
+bool FTerrainTileDiskCache::WriteBlock(const FCachedTerrainTile& Tile, TArray<uint8>& OUTBlock)
+{
+	const FCompactTerrainTile& Terrain = Tile.Terrain;
+	if (!Terrain.IsValid()) { return false; }
+
+	OUTBlock.SetNumZeroed(CalculateBlockSize(Terrain.GridSize, Terrain.HeightData.Num(), Terrain.NormalData.Num(), Terrain.QuadLevels.Num(), Terrain.CollisionQuadLevels.Num()));
+	FBlockHeader* Header = reinterpret_cast<FBlockHeader*>(OUTBlock.GetData());
+	Header->GridSize = Terrain.GridSize;
+	Header->UnitSize = Terrain.UnitSize;
+	Header->MinHeight = Terrain.MinHeight;
+	Header->HeightStep = Terrain.HeightStep;
+	Header->bIsDeltaEncoded = Terrain.bIsDeltaEncoded ? 1 : 0;
+	Header->HeightDataSize = Terrain.HeightData.Num();
+	Header->NormalDataSize = Terrain.NormalData.Num();
+	Header->QuadLevelDataSize = Terrain.QuadLevels.Num();
+	Header->CollisionQuadLevelDataSize = Terrain.CollisionQuadLevels.Num();
+	Header->TrackHash = Tile.TrackHash;
+	const FVector Corners[4] = { Tile.BottomLeftCorner, Tile.BottomRightCorner, Tile.TopRightCorner, Tile.TopLeftCorner };
+	for (int32 i = 0; i < 4; ++i)
+	{
+		Header->Corners[i][0] = Corners[i].X;
+		Header->Corners[i][1] = Corners[i].Y;
+		Header->Corners[i][2] = Corners[i].Z;
+	}
+
+	uint8* Data = reinterpret_cast<uint8*>(Header + 1);
+	FMemory::Memcpy(Data, Terrain.BorderHeights.GetData(), Terrain.BorderHeights.Num() * sizeof(float));
+	Data += Terrain.BorderHeights.Num() * sizeof(float);
+	FMemory::Memcpy(Data, Terrain.HeightData.GetData(), Terrain.HeightData.Num());
+	Data += Terrain.HeightData.Num();
+	FMemory::Memcpy(Data, Terrain.NormalData.GetData(), Terrain.NormalData.Num());
+	Data += Terrain.NormalData.Num();
+	FMemory::Memcpy(Data, Terrain.QuadLevels.GetData(), Terrain.QuadLevels.Num());
+	Data += Terrain.QuadLevels.Num();
+	FMemory::Memcpy(Data, Terrain.CollisionQuadLevels.GetData(), Terrain.CollisionQuadLevels.Num());
+	return true;
+}
+
+bool FTerrainTileDiskCache::ReadBlock(const uint8* Block, const int64 BlockSize, FCachedTerrainTile& OUTTile)
+{
+	if (BlockSize < static_cast<int64>(sizeof(FBlockHeader))) { return false; }
+
+	const FBlockHeader* Header = reinterpret_cast<const FBlockHeader*>(Block);
+	if (Header->GridSize < 2 || Header->HeightDataSize < 0 || Header->NormalDataSize < 0 || Header->QuadLevelDataSize < 0 || Header->CollisionQuadLevelDataSize < 0
+		|| BlockSize != CalculateBlockSize(Header->GridSize, Header->HeightDataSize, Header->NormalDataSize, Header->QuadLevelDataSize, Header->CollisionQuadLevelDataSize))
+	{
+		return false;
+	}
+
+	FCompactTerrainTile& Terrain = OUTTile.Terrain;
+	Terrain.GridSize = Header->GridSize;
+	Terrain.UnitSize = Header->UnitSize;
+	Terrain.MinHeight = Header->MinHeight;
+	Terrain.HeightStep = Header->HeightStep;
+	Terrain.bIsDeltaEncoded = Header->bIsDeltaEncoded != 0;
+
+	const uint8* Data = reinterpret_cast<const uint8*>(Header + 1);
+	Terrain.BorderHeights.SetNumUninitialized(4 * Header->GridSize);
+	FMemory::Memcpy(Terrain.BorderHeights.GetData(), Data, Terrain.BorderHeights.Num() * sizeof(float));
+	Data += Terrain.BorderHeights.Num() * sizeof(float);
+	Terrain.HeightData.SetNumUninitialized(Header->HeightDataSize);
+	FMemory::Memcpy(Terrain.HeightData.GetData(), Data, Header->HeightDataSize);
+	Data += Header->HeightDataSize;
+	Terrain.NormalData.SetNumUninitialized(Header->NormalDataSize);
+	FMemory::Memcpy(Terrain.NormalData.GetData(), Data, Header->NormalDataSize);
+	Data += Header->NormalDataSize;
+	Terrain.QuadLevels.SetNumUninitialized(Header->QuadLevelDataSize);
+	FMemory::Memcpy(Terrain.QuadLevels.GetData(), Data, Header->QuadLevelDataSize);
+	Data += Header->QuadLevelDataSize;
+	Terrain.CollisionQuadLevels.SetNumUninitialized(Header->CollisionQuadLevelDataSize);
+	FMemory::Memcpy(Terrain.CollisionQuadLevels.GetData(), Data, Header->CollisionQuadLevelDataSize);
+
+	OUTTile.MeshData.Init(FMeshData(), 4);
+	OUTTile.TrackHash = Header->TrackHash;
+	OUTTile.BottomLeftCorner = FVector(Header->Corners[0][0], Header->Corners[0][1], Header->Corners[0][2]);
+	OUTTile.BottomRightCorner = FVector(Header->Corners[1][0], Header->Corners[1][1], Header->Corners[1][2]);
+	OUTTile.TopRightCorner = FVector(Header->Corners[2][0], Header->Corners[2][1], Header->Corners[2][2]);
+	OUTTile.TopLeftCorner = FVector(Header->Corners[3][0], Header->Corners[3][1], Header->Corners[3][2]);
+	return true;
+}
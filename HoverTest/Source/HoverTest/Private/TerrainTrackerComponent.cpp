@@ -48,7 +48,8 @@ void UTerrainTrackerComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 		FIntVector2D SectorThisTick = TerrainManager->CalculateSectorFromLocation(GetOwner()->GetActorLocation());
 		//UE_LOG(LogTemp, Warning, TEXT("Sector this tick: %s"), *SectorThisTick.ToString());
 		//UE_LOG(LogTemp, Error, TEXT("Current sector: %s"), *CurrentSector.ToString());
-		if (SectorThisTick != CurrentSector)
+		// only count as a sector change once the actor moved far enough past the sector border, see SectorChangeHysteresis
+		if (SectorThisTick != CurrentSector && TerrainManager->HasLocationLeftSector(GetOwner()->GetActorLocation(), CurrentSector))
 		{
 			//UE_LOG(LogTemp, Warning, TEXT("%s has moved sectors"), *GetOwner()->GetName());
 			TerrainManager->HandleTrackedActorChangedSector(GetOwner(), CurrentSector, SectorThisTick);
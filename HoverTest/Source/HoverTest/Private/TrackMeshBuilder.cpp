@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TrackMeshBuilder.h"
+#include "TrackPlanner.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+static FAutoConsoleCommand BenchmarkTrackMeshBuilderCommand(
+	TEXT("HoverTest.BenchmarkTrackMeshBuilder"),
+	TEXT("Plans track sectors and builds their track meshes, logs the time per sector. Arguments: [Sectors]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FTrackMeshBuilder::RunBenchmark)
+);
+
+void FTrackMeshBuilder::Initialize(const FTerrainSettings& InSettings)
+{
+	TerrainSettings = InSettings;
+}
+
+void FTrackMeshBuilder::Build(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FTrackMeshBuildResult& OUTResult) const
+{
+	const TArray<FVector>& PointsOnTrack = TrackInfo.PointsOnBezierCurve;
+	TArray<FTerrainVertex>& OUTVertexBuffer = OUTResult.Vertices;
+	TArray<int32>& OUTTriangleBuffer = OUTResult.Triangles;
+	OUTVertexBuffer.Reserve(OUTVertexBuffer.Num() + 3 * PointsOnTrack.Num());
+	OUTTriangleBuffer.Reserve(OUTTriangleBuffer.Num() + 12 * PointsOnTrack.Num());
+	OUTResult.TrackSegments.Reserve(OUTResult.TrackSegments.Num() + PointsOnTrack.Num());
+
+	for (int32 i = 0; i < PointsOnTrack.Num(); ++i)
+	{
+		// calculate normal
+
+		/**
+		 * X1X0 is the vector from the current track mid point to the next track mid point
+		 * Normal is the normal of X1X0 and (0,0,1)
+		 * Y0 and Y1 are the track border points (left and right) of the current track mid point
+		 */
+		FVector Y0;
+		FVector Y1;
+		FVector Normal;
+		if (i == 0)
+		{
+			int32 TileSize = TerrainSettings.TileEdgeSize;
+			FVector Pt = PointsOnTrack[i];		// shorter writing
+
+			if (Sector == FIntVector2D(0, 0))
+			{
+				switch (UMyStaticLibrary::GuessTileBorder(Pt, TileSize))
+				{
+					case ETileBorder::ETB_Bottom:
+						Normal = FVector::CrossProduct(FVector(1, 0, 0), FVector(0, 0, 1)).GetSafeNormal();
+						break;
+					case ETileBorder::ETB_Right:
+						Normal = FVector::CrossProduct(FVector(0, -1, 0), FVector(0, 0, 1)).GetSafeNormal();
+						break;
+					case ETileBorder::ETB_Top:
+						Normal = FVector::CrossProduct(FVector(-1, 0, 0), FVector(0, 0, 1)).GetSafeNormal();
+						break;
+					case ETileBorder::ETB_Left:
+						Normal = FVector::CrossProduct(FVector(0, 1, 0), FVector(0, 0, 1)).GetSafeNormal();
+						break;
+					case ETileBorder::ETB_Invalid:
+						UE_LOG(LogTemp, Error, TEXT("Could not guess on which border the first point on the bezier curve lies."));
+						break;
+				}
+
+				Y0 = PointsOnTrack[i] + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+				Y1 = PointsOnTrack[i] + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+
+			}
+			else
+			{
+				/**
+				 * load intersection points from TrackInfo (Y0 and Y1 values from previous tile) and move them into this sector
+				 * they lie exactly on the previous sector's exit border and the move is by whole tile edges, so both tiles emit exactly the same edge vertices
+				 */
+				const FIntVector2D Offset = TrackInfo.PreviousTrackSector - Sector;
+				const FVector SectorOffset = FVector(Offset.X * TerrainSettings.TileEdgeSize, Offset.Y * TerrainSettings.TileEdgeSize, 0.f);
+				Y0 = PreviousTrackInfo.Y0Position + SectorOffset;
+				Y1 = PreviousTrackInfo.Y1Position + SectorOffset;
+			}
+		}
+		else if (i == PointsOnTrack.Num() - 1)
+		{
+			Y0 = TrackInfo.Y0Position;
+			Y1 = TrackInfo.Y1Position;
+		}
+		else
+		{
+			FVector X1X0 = PointsOnTrack[i + 1] - PointsOnTrack[i];
+			Normal = FVector::CrossProduct(X1X0, FVector(0, 0, 1)).GetSafeNormal();
+
+			Y0 = PointsOnTrack[i] + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+			Y1 = PointsOnTrack[i] + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+		}
+
+		Y0.Z = PointsOnTrack[i].Z;
+		Y1.Z = PointsOnTrack[i].Z;
+
+		OUTVertexBuffer.Add(FTerrainVertex(PointsOnTrack[i], FVector(0, 0, 1)));
+		OUTVertexBuffer.Add(FTerrainVertex(Y0, FVector(0, 0, 1)));
+		OUTVertexBuffer.Add(FTerrainVertex(Y1, FVector(0, 0, 1)));
+
+		// create triangles
+		// can only create triangles if we have at least two midpoints calculated
+		if (i > 0)
+		{
+			/**
+			 * track segments looks like this: (viewing from point X1)
+			 *
+			 *			Y2----------X1----------Y3
+			 *			|			|			|
+			 *			|			|			|
+			 *			|			|			|
+			 *			Y0----------X0----------Y1
+			 *
+			 *
+			 * points:	Y3 = Num - 1
+			 *			Y2 = Num - 2
+			 *			X1 = Num - 3
+			 *			Y1 = Num - 4
+			 *			Y0 = Num - 5
+			 *			X0 = Num - 6
+			 *
+			 *	(note that order of Y2 and Y3 (and Y0 and Y1) may be reversed due to normal calculation (but since its reveresed for all points, it doesn't matter)
+			 */
+			int32 Num = OUTVertexBuffer.Num();
+			// triangle Y0 X0 Y2
+			OUTTriangleBuffer.Add(Num - 5);
+			OUTTriangleBuffer.Add(Num - 6);
+			OUTTriangleBuffer.Add(Num - 2);
+
+			// triangle X0 X1 Y2
+			OUTTriangleBuffer.Add(Num - 6);
+			OUTTriangleBuffer.Add(Num - 3);
+			OUTTriangleBuffer.Add(Num - 2);
+
+			// triangle X0 Y1 X1
+			OUTTriangleBuffer.Add(Num - 6);
+			OUTTriangleBuffer.Add(Num - 4);
+			OUTTriangleBuffer.Add(Num - 3);
+
+			// triangle Y1 Y3 X1
+			OUTTriangleBuffer.Add(Num - 4);
+			OUTTriangleBuffer.Add(Num - 1);
+			OUTTriangleBuffer.Add(Num - 3);
+
+			float PreviousSegmentBaseElevation = 0.f;
+			if (i > 1)
+			{
+				PreviousSegmentBaseElevation = OUTVertexBuffer[Num - 9].Position.Z;
+			}
+
+			OUTResult.TrackSegments.Add(FTrackSegment(OUTVertexBuffer[Num - 5].Position, OUTVertexBuffer[Num - 4].Position, OUTVertexBuffer[Num - 1].Position, OUTVertexBuffer[Num - 2].Position, OUTVertexBuffer[Num - 6].Position, OUTVertexBuffer[Num - 3].Position, PreviousSegmentBaseElevation, TerrainSettings.TileEdgeSize, TerrainSettings.TrackGenerationSettings.TrackElevationOffset));
+		}
+	}
+}
+
+void FTrackMeshBuilder::RunBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumberOfSectors = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+
+	FTerrainSettings Settings;
+	FTrackPlanner Planner;
+	Planner.Initialize(Settings);
+	FTrackMeshBuilder Builder;
+	Builder.Initialize(Settings);
+
+	// the track is planned before the benchmark starts, only building the meshes is measured
+	FTrackPlannerState State;
+	State.TrackRandomStream.Initialize(Settings.Seed);
+	const FSectorBitmap BlockedSectors;
+	TArray<FPlannedTrackSector> PlannedSectors;
+	PlannedSectors.Reserve(NumberOfSectors);
+	while (PlannedSectors.Num() < NumberOfSectors)
+	{
+		FPlannedTrackSector PlannedSector;
+		const bool bTrackContinues = Planner.PlanNextSector(State, BlockedSectors, PlannedSector);
+		if (PlannedSector.TrackInfo.bSectorHasTrack)
+		{
+			PlannedSectors.Add(MoveTemp(PlannedSector));
+		}
+		if (!bTrackContinues) { break; }
+	}
+
+	int64 NumberOfVertices = 0;
+	const FSectorTrackInfo NoTrackInfo;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < PlannedSectors.Num(); ++i)
+	{
+		FTrackMeshBuildResult Result;
+		Builder.Build(PlannedSectors[i].Sector, PlannedSectors[i].TrackInfo, i > 0 ? PlannedSectors[i - 1].TrackInfo : NoTrackInfo, Result);
+		NumberOfVertices += Result.Vertices.Num();
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogTemp, Log, TEXT("Track mesh builder benchmark: %i sectors with %lld vertices in %f ms, %f us per sector"), PlannedSectors.Num(), NumberOfVertices, Seconds * 1000.0, PlannedSectors.Num() > 0 ? Seconds * 1.0e6 / PlannedSectors.Num() : 0.0);
+}
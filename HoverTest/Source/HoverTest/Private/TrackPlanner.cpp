@@ -0,0 +1,636 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TrackPlanner.h"
+#include "Engine/Classes/Kismet/KismetMathLibrary.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+static FAutoConsoleCommand BenchmarkTrackPlannerCommand(
+	TEXT("HoverTest.BenchmarkTrackPlanner"),
+	TEXT("Chooses the following sector of many track sectors and logs the time per sector. Arguments: [Sectors] [BlockedSectorProbability]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&FTrackPlanner::RunBenchmark)
+);
+
+void FTrackPlanner::Initialize(const FTerrainSettings& InSettings)
+{
+	TerrainSettings = InSettings;
+}
+
+bool FTrackPlanner::PlanNextSector(FTrackPlannerState& State, const FSectorBitmap& BlockedSectors, FPlannedTrackSector& OUTPlannedSector) const
+{
+	const FIntVector2D Sector = State.NextTrackSector;
+	const FSectorTrackInfo PreviousTrackInfo = State.CurrentTrackInfo;
+	State.PlannedSectors++;
+
+	OUTPlannedSector.Sector = Sector;
+	OUTPlannedSector.TrackInfo = CalculateNewNextTrackSector(State, BlockedSectors);
+	if (!OUTPlannedSector.TrackInfo.bSectorHasTrack)
+	{
+		// the track ends, the sector gets no track
+		OUTPlannedSector.State = State;
+		return false;
+	}
+	// !!! CurrentTrackSector now has the value of NextTrackSector !!!
+	FSectorTrackInfo& TrackInfo = OUTPlannedSector.TrackInfo;
+
+	// PreviousTrackSector and FollowingTrackSector are used to calculate the entry and exit point
+	CalculateEntryExitPoints(State, TrackInfo, TrackInfo.TrackEntryPoint, TrackInfo.TrackExitPoint);
+
+	// calculate exit point elevation
+	CalculateTrackExitPointElevation(State, Sector, PreviousTrackInfo, TrackInfo.TrackExitPointElevation);
+	CalculateBezierControlPoints(State, Sector, TrackInfo, PreviousTrackInfo, TrackInfo.FirstBezierControlPoint, TrackInfo.SecondBezierControlPoint);
+
+	TrackInfo.CheckpointID = State.NextAvailableCheckPointID;
+	State.NextAvailableCheckPointID++;
+
+	// calculate points on bezier curve
+	CalculatePointsOnBezierCurve(Sector, TrackInfo, PreviousTrackInfo, TrackInfo.PointsOnBezierCurve);
+
+	// Calculate Y0 and Y1
+	CalculateY0Y1(TrackInfo.PointsOnBezierCurve, TrackInfo.TrackExitPointElevation, UMyStaticLibrary::GetTileBorderTowards(Sector, TrackInfo.FollowingTrackSector), TrackInfo.Y0Position, TrackInfo.Y1Position);
+
+	// checkpoint and player spawn, so they can be looked up before the sector's tile is generated
+	CalculateSpawnTransforms(Sector, TrackInfo, PreviousTrackInfo);
+
+	State.CurrentTrackInfo = TrackInfo;
+	OUTPlannedSector.State = State;
+	return true;
+}
+
+FSectorTrackInfo FTrackPlanner::CalculateNewNextTrackSector(FTrackPlannerState& State, const FSectorBitmap& BlockedSectors) const
+{
+	// get all possible next sectors
+	TArray<FIntVector2D> PossibleSectors;
+
+	FIntVector2D LeftDirection = State.NextTrackSector - FIntVector2D(0, 1);
+	FIntVector2D UpDirection = State.NextTrackSector + FIntVector2D(1, 0);
+	FIntVector2D RightDirection = State.NextTrackSector + FIntVector2D(0, 1);
+	FIntVector2D DownDirection = State.NextTrackSector - FIntVector2D(1, 0);
+
+	FSectorTrackInfo TrackInfo = FSectorTrackInfo();
+
+	// check if this is the first track we create -> all directions possible
+	if (State.NextTrackSector == FIntVector2D(0, 0) && State.CurrentTrackSector == FIntVector2D(0, 0))
+	{
+		PossibleSectors.Add(LeftDirection);
+		PossibleSectors.Add(UpDirection);
+		PossibleSectors.Add(RightDirection);
+		PossibleSectors.Add(DownDirection);
+	}
+	else
+	{
+
+		// left of our current NextTrackSector
+		if (CheckupSector(State, BlockedSectors, LeftDirection))
+		{
+			PossibleSectors.Add(LeftDirection);
+		}
+		// right
+		if (CheckupSector(State, BlockedSectors, RightDirection))
+		{
+			PossibleSectors.Add(RightDirection);
+		}
+		// up
+		if (CheckupSector(State, BlockedSectors, UpDirection))
+		{
+			PossibleSectors.Add(UpDirection);
+		}
+		// down
+		if (CheckupSector(State, BlockedSectors, DownDirection))
+		{
+			PossibleSectors.Add(DownDirection);
+		}
+
+		// only keep the directions with the longest continuation, so the track does not run into a dead end within the next TrackPlanningSearchDepth sectors
+		const int32 SearchDepth = TerrainSettings.TrackGenerationSettings.TrackPlanningSearchDepth;
+		if (SearchDepth > 0 && PossibleSectors.Num() > 1)
+		{
+			// no-go quad after NextTrackSector became CurrentTrackSector
+			const FIntVector2D QuadMin = FIntVector2D(FMath::Min(State.BottomLeftCorner.X, State.NextTrackSector.X), FMath::Min(State.TopLeftCorner.Y, State.NextTrackSector.Y));
+			const FIntVector2D QuadMax = FIntVector2D(FMath::Max(State.TopLeftCorner.X, State.NextTrackSector.X), FMath::Max(State.TopRightCorner.Y, State.NextTrackSector.Y));
+
+			int32 Continuations[4];
+			int32 LongestContinuation = 0;
+			for (int32 i = 0; i < PossibleSectors.Num(); ++i)
+			{
+				Continuations[i] = MeasureContinuation(BlockedSectors, PossibleSectors[i], QuadMin, QuadMax, SearchDepth);
+				LongestContinuation = FMath::Max(LongestContinuation, Continuations[i]);
+			}
+			for (int32 i = PossibleSectors.Num() - 1; i >= 0; --i)
+			{
+				if (Continuations[i] < LongestContinuation)
+				{
+					PossibleSectors.RemoveAt(i);
+				}
+			}
+		}
+	}
+
+	if (PossibleSectors.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No possible NextTrackSector could be determined!"));
+		return TrackInfo;
+	}
+	TrackInfo.bSectorHasTrack = true;
+
+	// draw random direction
+	int32 RandomVariable = State.TrackRandomStream.RandRange(0, PossibleSectors.Num() - 1);
+	
+	// update previous track sector of NextTrackSector
+	TrackInfo.PreviousTrackSector = State.CurrentTrackSector;
+
+	State.CurrentTrackSector = State.NextTrackSector;
+
+	// include CurrentTrackSector in the no-go quad
+	AdjustQuad(State);
+
+	State.NextTrackSector = PossibleSectors[RandomVariable];
+
+	// update following sector of Current track sector (= previous Next track sector)
+	TrackInfo.FollowingTrackSector = State.NextTrackSector;
+
+	return TrackInfo;
+}
+
+int32 FTrackPlanner::MeasureContinuation(const FSectorBitmap& BlockedSectors, const FIntVector2D Sector, FIntVector2D QuadMin, FIntVector2D QuadMax, const int32 Depth)
+{
+	if (Depth <= 0) { return 0; }
+
+	// the track entered the sector, so the sector becomes part of the no-go quad
+	QuadMin = FIntVector2D(FMath::Min(QuadMin.X, Sector.X), FMath::Min(QuadMin.Y, Sector.Y));
+	QuadMax = FIntVector2D(FMath::Max(QuadMax.X, Sector.X), FMath::Max(QuadMax.Y, Sector.Y));
+
+	const FIntVector2D Neighbors[4] = { Sector - FIntVector2D(0, 1), Sector + FIntVector2D(0, 1), Sector + FIntVector2D(1, 0), Sector - FIntVector2D(1, 0) };
+	int32 LongestContinuation = 0;
+	for (const FIntVector2D& Neighbor : Neighbors)
+	{
+		const bool bWithinQuad = Neighbor.X >= QuadMin.X && Neighbor.X <= QuadMax.X && Neighbor.Y >= QuadMin.Y && Neighbor.Y <= QuadMax.Y;
+		if (bWithinQuad || BlockedSectors.Contains(Neighbor)) { continue; }
+
+		LongestContinuation = FMath::Max(LongestContinuation, 1 + MeasureContinuation(BlockedSectors, Neighbor, QuadMin, QuadMax, Depth - 1));
+		if (LongestContinuation == Depth) { break; }
+	}
+	return LongestContinuation;
+}
+
+void FTrackPlanner::RunBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumberOfSectors = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000000;
+	const float BlockedSectorProbability = Args.Num() > 1 ? FMath::Clamp(FCString::Atof(*Args[1]), 0.f, 1.f) : 0.2f;
+
+	FTerrainSettings Settings;
+	FTrackPlanner Planner;
+	Planner.Initialize(Settings);
+	FTrackPlannerState State;
+	State.TrackRandomStream.Initialize(Settings.Seed);
+	FRandomStream BlockingStream(Settings.Seed + 1);
+	FSectorBitmap BlockedSectors;
+
+	int32 PlannedSectors = 0;
+	int32 DeadEnds = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	while (PlannedSectors < NumberOfSectors)
+	{
+		const FSectorTrackInfo TrackInfo = Planner.CalculateNewNextTrackSector(State, BlockedSectors);
+		if (!TrackInfo.bSectorHasTrack)
+		{
+			// the track would end here, forget the blocked sectors to continue the benchmark
+			DeadEnds++;
+			BlockedSectors.Reset();
+			continue;
+		}
+		PlannedSectors++;
+
+		// tiles without track appear around the track, like the tiles around a tracked actor
+		const FIntVector2D Neighbors[4] = { State.NextTrackSector - FIntVector2D(0, 1), State.NextTrackSector + FIntVector2D(0, 1), State.NextTrackSector + FIntVector2D(1, 0), State.NextTrackSector - FIntVector2D(1, 0) };
+		for (const FIntVector2D& Neighbor : Neighbors)
+		{
+			if (!Planner.CheckSectorWithinQuad(State, Neighbor) && BlockingStream.FRand() < BlockedSectorProbability)
+			{
+				BlockedSectors.Add(Neighbor);
+			}
+		}
+	}
+	const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogTemp, Log, TEXT("Track planner benchmark: %i sectors with search depth %i in %f ms, %f ns per sector, %i dead ends"), NumberOfSectors, Settings.TrackGenerationSettings.TrackPlanningSearchDepth, Seconds * 1000.0, Seconds * 1.0e9 / NumberOfSectors, DeadEnds);
+}
+
+bool FTrackPlanner::CheckSectorWithinQuad(const FTrackPlannerState& State, const FIntVector2D Sector) const
+{
+	if (Sector.X <= State.TopLeftCorner.X && Sector.X >= State.BottomLeftCorner.X && Sector.Y >= State.TopLeftCorner.Y && Sector.Y <= State.TopRightCorner.Y)
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+bool FTrackPlanner::CheckupSector(const FTrackPlannerState& State, const FSectorBitmap& BlockedSectors, const FIntVector2D Sector) const
+{
+	if (!BlockedSectors.Contains(Sector))
+	{
+		// not yet calculated -> check if it lies within our no-go quad
+		if (!CheckSectorWithinQuad(State, Sector))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FTrackPlanner::CalculateEntryExitPoints(const FTrackPlannerState& State, const FSectorTrackInfo& TrackInfo, FVector2D& OUTEntryPoint, FVector2D& OUTExitPoint) const
+{
+	// exit point
+	if (TrackInfo.FollowingTrackSector == State.CurrentTrackSector + FIntVector2D(1, 0))
+	{
+		// Top
+		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize / 2.f);
+	}
+	else if (TrackInfo.FollowingTrackSector == State.CurrentTrackSector + FIntVector2D(0, 1))
+	{
+		// Right
+		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize);
+	}
+	else if (TrackInfo.FollowingTrackSector == State.CurrentTrackSector - FIntVector2D(1, 0))
+	{
+		// Bottom
+		OUTExitPoint = FVector2D(0.f, TerrainSettings.TileEdgeSize / 2.f);
+	}
+	else if (TrackInfo.FollowingTrackSector == State.CurrentTrackSector - FIntVector2D(0, 1))
+	{
+		// Left
+		OUTExitPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, 0.f);
+	}
+
+	// special case: start of the game, where CurrentTrackSector == (0,0)
+	if (State.CurrentTrackSector == FIntVector2D())
+	{
+		// entry point needs to be at the opposite direction of exit point
+		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize) - OUTExitPoint;
+		return;
+	}
+
+	// entry point
+	if (TrackInfo.PreviousTrackSector == State.CurrentTrackSector + FIntVector2D(1, 0))
+	{
+		// Top
+		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize, TerrainSettings.TileEdgeSize / 2.f);
+	}
+	else if (TrackInfo.PreviousTrackSector == State.CurrentTrackSector + FIntVector2D(0, 1))
+	{
+		// Right
+		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize);
+	}
+	else if (TrackInfo.PreviousTrackSector == State.CurrentTrackSector - FIntVector2D(1, 0))
+	{
+		// Bottom
+		OUTEntryPoint = FVector2D(0.f, TerrainSettings.TileEdgeSize / 2.f);
+	}
+	else if (TrackInfo.PreviousTrackSector == State.CurrentTrackSector - FIntVector2D(0, 1))
+	{
+		// Left
+		OUTEntryPoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, 0.f);
+	}
+
+	return;
+}
+
+void FTrackPlanner::AdjustQuad(FTrackPlannerState& State) const
+{
+	if (State.CurrentTrackSector.X > State.TopLeftCorner.X)
+	{
+		State.TopLeftCorner.X = State.CurrentTrackSector.X;
+		State.TopRightCorner.X = State.CurrentTrackSector.X;
+	}
+
+	if (State.CurrentTrackSector.X < State.BottomLeftCorner.X)
+	{
+		State.BottomLeftCorner.X = State.CurrentTrackSector.X;
+		State.BottomRightCorner.X = State.CurrentTrackSector.X;
+	}
+
+	if (State.CurrentTrackSector.Y > State.TopRightCorner.Y)
+	{
+		State.TopRightCorner.Y = State.CurrentTrackSector.Y;
+		State.BottomRightCorner.Y = State.CurrentTrackSector.Y;
+	}
+
+	if (State.CurrentTrackSector.Y < State.TopLeftCorner.Y)
+	{
+		State.TopLeftCorner.Y = State.CurrentTrackSector.Y;
+		State.BottomLeftCorner.Y = State.CurrentTrackSector.Y;
+	}
+
+	return;
+
+}
+
+void FTrackPlanner::CalculateTrackExitPointElevation(FTrackPlannerState& State, const FIntVector2D Sector, const FSectorTrackInfo& PreviousTrackInfo, float& OUTExitPointElevation) const
+{
+	//UE_LOG(LogTemp, Error, TEXT("Track exit point elevations for sector %s"), *Sector.ToString());
+	if (Sector == FIntVector2D(0, 0))
+	{
+		// very first sector, use default elevation for entry point height
+		OUTExitPointElevation = TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight + (UMyStaticLibrary::GetNormalDistribution(State.TrackRandomStream, TerrainSettings.TrackGenerationSettings.Steepness_Mean, TerrainSettings.TrackGenerationSettings.Steepness_Deviation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
+		//UE_LOG(LogTemp, Warning, TEXT("Exit point elevation is %f"), OUTExitPointElevation);
+		//OUTExitPointElevation = TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight + FMath::RandRange(-TerrainSettings.TrackGenerationSettings.MaximumElevationDifference, TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
+		return;
+	}
+	// calculate exit elevation: exit elevation <-- start elevation + Random[-MaximumElevationDifference, MaximumElevationDifference]
+	OUTExitPointElevation = PreviousTrackInfo.TrackExitPointElevation + (UMyStaticLibrary::GetNormalDistribution(State.TrackRandomStream, TerrainSettings.TrackGenerationSettings.Steepness_Mean, TerrainSettings.TrackGenerationSettings.Steepness_Deviation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
+	//UE_LOG(LogTemp, Warning, TEXT("Exit point elevation is %f"), OUTExitPointElevation);
+	//OUTExitPointElevation = PreviousTrackInfo.TrackExitPointElevation + FMath::RandRange(-TerrainSettings.TrackGenerationSettings.MaximumElevationDifference, TerrainSettings.TrackGenerationSettings.MaximumElevationDifference);
+}
+
+void FTrackPlanner::CalculateBezierControlPoints(FTrackPlannerState& State, const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FVector& OUTControlPointOne, FVector& OUTControlPointTwo) const
+{
+	const FVector2D MiddlePoint = FVector2D(TerrainSettings.TileEdgeSize / 2.f, TerrainSettings.TileEdgeSize / 2.f);
+
+	FVector ControlPoint1;
+	FVector ControlPoint2;
+	/**
+	 * first control point is:
+	 *		vector of second control point of previous sector to end point of previous sector (called 'Vector')
+	 *		added to start point of current sector (called 'EntryPoint')
+	 */
+	if (Sector == FIntVector2D(0, 0))
+	{
+		// default control point one to tile middle with default entry point height in case we have no control point in a previous sector
+		ControlPoint1 = FVector(MiddlePoint, TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight);
+	}
+	else
+	{
+		FVector Vector = FVector(PreviousTrackInfo.TrackExitPoint, PreviousTrackInfo.TrackExitPointElevation) - PreviousTrackInfo.SecondBezierControlPoint;
+		FVector EntryPoint = FVector(TrackInfo.TrackEntryPoint, PreviousTrackInfo.TrackExitPointElevation);
+		ControlPoint1 = EntryPoint + Vector;
+	}
+
+	//UE_LOG(LogTemp, Error, TEXT("Bezier control points for sector %s"), *Sector.ToString());
+	//UE_LOG(LogTemp, Warning, TEXT("First control point %s"), *ControlPoint1.ToString());
+
+	/**
+	 * calculation of control point 2 follows instructions given by Michael Franke in 'Dynamische Streckengenerierung und deren Einbettung in ein Terrain' in 2011
+	 */
+	//float RandomNumber = UMyStaticLibrary::GetNormalDistribution(TerrainSettings.TrackGenerationSettings.CURVINESS_MEAN, TerrainSettings.TrackGenerationSettings.Curviness, 0.f, 1.f);
+	float RandomNumber = UMyStaticLibrary::GetNormalDistribution(State.TrackRandomStream, TerrainSettings.TrackGenerationSettings.CURVINESS_MEAN, TerrainSettings.TrackGenerationSettings.CurvinessDisplacement, -0.5f, 0.5f);
+	float Displacement = RandomNumber * (TerrainSettings.TileEdgeSize / 4.f);
+	//UE_LOG(LogTemp, Warning, TEXT("Second control point displacement: %f"), Displacement);
+	// vector from middle point to track exit point
+	FVector2D LineEndPointMiddlePoint = TrackInfo.TrackExitPoint - MiddlePoint;
+	// point halfway between middle point and track exit point
+	FVector2D EndPointMiddlePointHalf = MiddlePoint + (LineEndPointMiddlePoint / 2.f);
+	// control point before rotation is applied
+	FVector2D IntermediatePoint = EndPointMiddlePointHalf + (LineEndPointMiddlePoint.GetSafeNormal() * Displacement);
+
+	float RotationAngle = UMyStaticLibrary::GetNormalDistribution(State.TrackRandomStream, 0.f, TerrainSettings.TrackGenerationSettings.CurvinessRotation, -1.f, 1.f) * TerrainSettings.TrackGenerationSettings.MaximumRotationAngle;
+
+	//UE_LOG(LogTemp, Warning, TEXT("Second control point rotation angle: %f"), RotationAngle);
+
+	float Angle = RotationAngle * (UKismetMathLibrary::GetPI() / 180.f);	// convert to radians
+
+	ControlPoint2.X = FMath::Cos(Angle) * (IntermediatePoint.X - TrackInfo.TrackExitPoint.X) -
+		FMath::Sin(Angle) * (IntermediatePoint.Y - TrackInfo.TrackExitPoint.Y) + TrackInfo.TrackExitPoint.X;
+	ControlPoint2.Y = FMath::Sin(Angle) * (IntermediatePoint.X - TrackInfo.TrackExitPoint.X) +
+		FMath::Cos(Angle) * (IntermediatePoint.Y - TrackInfo.TrackExitPoint.Y) + TrackInfo.TrackExitPoint.Y;
+
+	float AverageElevation = PreviousTrackInfo.TrackExitPointElevation + (TrackInfo.TrackExitPointElevation - PreviousTrackInfo.TrackExitPointElevation) / 2.f;
+	ControlPoint2.Z = UMyStaticLibrary::GetNormalDistribution(State.TrackRandomStream, AverageElevation, TerrainSettings.TrackGenerationSettings.Hilliness);
+
+	//UE_LOG(LogTemp, Warning, TEXT("Second control point %s"), *ControlPoint2.ToString());
+
+	OUTControlPointOne = ControlPoint1;
+	OUTControlPointTwo = ControlPoint2;
+
+}
+
+void FTrackPlanner::GetBezierPoints(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FVector OUTBezierPoints[4]) const
+{
+	if (Sector == FIntVector2D(0, 0))
+	{
+		OUTBezierPoints[0] = FVector(TrackInfo.TrackEntryPoint, TerrainSettings.TrackGenerationSettings.DefaultEntryPointHeight);
+	}
+	else
+	{
+		OUTBezierPoints[0] = FVector(TrackInfo.TrackEntryPoint, PreviousTrackInfo.TrackExitPointElevation);
+	}
+
+	OUTBezierPoints[1] = TrackInfo.FirstBezierControlPoint;
+	OUTBezierPoints[2] = TrackInfo.SecondBezierControlPoint;
+	OUTBezierPoints[3] = FVector(TrackInfo.TrackExitPoint, TrackInfo.TrackExitPointElevation);
+}
+
+void FTrackPlanner::CalculatePointsOnBezierCurve(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, TArray<FVector>& OUTPointsOnBezierCurve) const
+{
+	FVector BezierPoints[4];
+	GetBezierPoints(Sector, TrackInfo, PreviousTrackInfo, BezierPoints);
+
+	const FTrackGenerationSettings& TrackSettings = TerrainSettings.TrackGenerationSettings;
+	if (!TrackSettings.bAdaptiveTrackSampling || TrackSettings.TrackResolution < 4)
+	{
+		FVector::EvaluateBezier(BezierPoints, TrackSettings.TrackResolution, OUTPointsOnBezierCurve);
+		// forward differencing drifts away from the end points, but the track has to end exactly where the following sector's track starts
+		if (OUTPointsOnBezierCurve.Num() > 1)
+		{
+			OUTPointsOnBezierCurve[0] = BezierPoints[0];
+			OUTPointsOnBezierCurve.Last() = BezierPoints[3];
+		}
+		return;
+	}
+
+	/**
+	 * the first and the last segment are the same as with even sampling, since the spawn points and CalculateY0Y1 take the track's direction at the borders from them
+	 * everything in between is split only where the curve bends or changes its elevation
+	 */
+	const float EdgeParameter = 1.f / (TrackSettings.TrackResolution - 1);
+	const FVector FirstInnerPoint = UMyStaticLibrary::EvaluateCubicBezier(BezierPoints, EdgeParameter);
+	const FVector LastInnerPoint = UMyStaticLibrary::EvaluateCubicBezier(BezierPoints, 1.f - EdgeParameter);
+	// never more segments than with even sampling at four times the resolution
+	const int32 MaximumDepth = FMath::CeilLogTwo(4 * TrackSettings.TrackResolution);
+
+	OUTPointsOnBezierCurve.Reset();
+	OUTPointsOnBezierCurve.Add(BezierPoints[0]);
+	OUTPointsOnBezierCurve.Add(FirstInnerPoint);
+	UMyStaticLibrary::SubdivideCubicBezier(BezierPoints, EdgeParameter, FirstInnerPoint, 1.f - EdgeParameter, LastInnerPoint, MaximumDepth, TrackSettings.MinimumTrackSegmentLength, TrackSettings.MaximumTrackSegmentLength, TrackSettings.TrackSamplingTolerance, TrackSettings.TrackSamplingElevationTolerance, OUTPointsOnBezierCurve);
+	OUTPointsOnBezierCurve.Add(LastInnerPoint);
+	OUTPointsOnBezierCurve.Add(BezierPoints[3]);
+}
+
+void FTrackPlanner::CalculateSpawnTransforms(const FIntVector2D Sector, FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo) const
+{
+	const TArray<FVector>& PointsOnTrack = TrackInfo.PointsOnBezierCurve;
+	const FVector SpawnScaling = FVector(1.f, 1.f, 1.f);
+
+	// checkpoint at the track's entry, in the start sector one point further in, since the entry lies on the border to the sector behind the start
+	if (PointsOnTrack.Num() < 3)
+	{
+		TrackInfo.CheckpointID = -1;
+	}
+	else
+	{
+		const int32 CheckpointPoint = (Sector == FIntVector2D(0, 0)) ? 1 : 0;
+		const FVector SpawnLocation = FVector(Sector.X * TerrainSettings.TileEdgeSize + PointsOnTrack[CheckpointPoint].X, Sector.Y * TerrainSettings.TileEdgeSize + PointsOnTrack[CheckpointPoint].Y, PointsOnTrack[CheckpointPoint].Z);
+		const FVector SpawnDirection = PointsOnTrack[CheckpointPoint + 1] - PointsOnTrack[CheckpointPoint];
+		TrackInfo.CheckpointTransform = FTransform(SpawnDirection.Rotation().Quaternion(), SpawnLocation, SpawnScaling);
+	}
+
+	// the player spawns on the start sector's track
+	TrackInfo.bHasPlayerSpawn = false;
+	if (Sector != FIntVector2D(0, 0)) { return; }
+
+	/**
+	 * the spawn segment counts the segments of even sampling by TrackResolution, adaptive sampling places its points elsewhere
+	 * so the segment's points are evaluated on the bezier curve at the parameters even sampling used
+	 */
+	const int32 TrackResolution = TerrainSettings.TrackGenerationSettings.TrackResolution;
+	const int32 PlayerSpawnPoint = TerrainSettings.TrackSegmentToSpawnPlayerAt;
+	if (TrackResolution <= 3 || PlayerSpawnPoint >= TrackResolution - 1)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Player spawn at track segment %i does not lie on the start sector's track with track resolution %i, the player has no spawn"), PlayerSpawnPoint, TrackResolution);
+		return;
+	}
+	FVector BezierPoints[4];
+	GetBezierPoints(Sector, TrackInfo, PreviousTrackInfo, BezierPoints);
+	const FVector SegmentStart = UMyStaticLibrary::EvaluateCubicBezier(BezierPoints, static_cast<float>(PlayerSpawnPoint) / (TrackResolution - 1));
+	const FVector SegmentEnd = UMyStaticLibrary::EvaluateCubicBezier(BezierPoints, static_cast<float>(PlayerSpawnPoint + 1) / (TrackResolution - 1));
+	FVector SpawnLocation = SegmentStart;
+	const FVector SpawnDirection = SegmentEnd - SegmentStart;
+	SpawnLocation += (UKismetMathLibrary::GetForwardVector(SpawnDirection.Rotation()) * TerrainSettings.TrackSegmentToSpawnPlayerAtOffset);
+	SpawnLocation.Z += TerrainSettings.PlayerSpawnElevationOffset;
+	TrackInfo.PlayerSpawnTransform = FTransform(SpawnDirection.Rotation().Quaternion(), SpawnLocation, SpawnScaling);
+	TrackInfo.bHasPlayerSpawn = true;
+}
+
+void FTrackPlanner::CalculateY0Y1(const TArray<FVector>& PointsOnTrack, const float ExitPointElevation, const ETileBorder ExitBorder, FVector& OUTY0, FVector& OUTY1) const
+{
+	// calculate last track segment
+	/**
+	 *			Last Track Segment:	(border is at top, track middle line goes from W0 to X0, Z0Y0 is left track border, Z1Y1 is right track border)
+	 *
+	 *			Y0--------------------X0--------------------Y1
+	 *			|					  |						|
+	 *			|					  | 					|
+	 *			|					  | 					|
+	 *			H0					  |						H1
+	 *			|					  |						|
+	 *			|					  |						|
+	 *			Z0--------------------W0--------------------Z1
+	 *
+	 * H0 and H1 are helper points that lie on the respective line (Z0Y0 or Z1Y1)
+	 */
+	FVector W0 = PointsOnTrack[PointsOnTrack.Num() - 2];
+	FVector X0 = PointsOnTrack[PointsOnTrack.Num() - 1];
+	FVector W0X0 = X0 - W0;
+	FVector Normal = FVector::CrossProduct(W0X0, FVector(0.f, 0.f, 1.f)).GetSafeNormal();
+
+	FVector Z0 = W0 + (TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+	FVector Z1 = W0 + (-TerrainSettings.TrackGenerationSettings.TrackWidth / 2.f) * Normal;
+
+	FVector H0 = Z0 + W0X0.GetSafeNormal();
+	FVector H1 = Z1 + W0X0.GetSafeNormal();
+
+	// calculate intersection point of lines Z0H0 / Z1H1 and tile border with Points PointA and PointB
+	FVector2D PointA;
+	FVector2D PointB;
+	float TileSize = TerrainSettings.TileEdgeSize;
+	switch (ExitBorder)
+	{
+		case ETileBorder::ETB_Bottom:
+			PointA = FVector2D(0.f, 0.f);
+			PointB = FVector2D(0.f, TileSize);
+			break;
+		case ETileBorder::ETB_Top:
+			PointA = FVector2D(TileSize, 0.f);
+			PointB = FVector2D(TileSize, TileSize);
+			break;
+		case ETileBorder::ETB_Left:
+			PointA = FVector2D(0.f, 0.f);
+			PointB = FVector2D(TileSize, 0.f);
+			break;
+		case ETileBorder::ETB_Right:
+			PointA = FVector2D(0.f, TileSize);
+			PointB = FVector2D(TileSize, TileSize);
+			break;
+	}
+	FVector2D IntersectionZ0H0;
+	FVector2D IntersectionZ1H1;
+	UMyStaticLibrary::CalculateIntersectionPoint(FVector2D(Z0.X, Z0.Y), FVector2D(H0.X, H0.Y), PointA, PointB, IntersectionZ0H0);
+	UMyStaticLibrary::CalculateIntersectionPoint(FVector2D(Z1.X, Z1.Y), FVector2D(H1.X, H1.Y), PointA, PointB, IntersectionZ1H1);
+
+	// the intersection is only close to the border, but the following sector's tile has to get exactly the same edge vertices
+	if (ExitBorder == ETileBorder::ETB_Bottom || ExitBorder == ETileBorder::ETB_Top)
+	{
+		IntersectionZ0H0.X = PointA.X;
+		IntersectionZ1H1.X = PointA.X;
+	}
+	else
+	{
+		IntersectionZ0H0.Y = PointA.Y;
+		IntersectionZ1H1.Y = PointA.Y;
+	}
+	OUTY0 = FVector(IntersectionZ0H0, ExitPointElevation);
+	OUTY1 = FVector(IntersectionZ1H1, ExitPointElevation);
+	return;
+}
+
+FTrackPlanningWorker::FTrackPlanningWorker(const FTerrainSettings& Settings, TQueue<FTrackPlanningRestart, EQueueMode::Spsc>* InRestartQueue, TQueue<FPlannedTrackSector, EQueueMode::Spsc>* InPlannedQueue, FThreadSafeCounter* InTakenSectors)
+{
+	Planner.Initialize(Settings);
+	RestartQueue = InRestartQueue;
+	PlannedQueue = InPlannedQueue;
+	TakenSectors = InTakenSectors;
+	Lookahead = FMath::Max(Settings.TrackPlanningLookahead, 1);
+}
+
+bool FTrackPlanningWorker::Init()
+{
+	IsThreadFinished = false;
+	return true;
+}
+
+uint32 FTrackPlanningWorker::Run()
+{
+	while (!IsThreadFinished)
+	{
+		// only the latest restart matters
+		FTrackPlanningRestart Restart;
+		bool bRestarted = false;
+		while (RestartQueue->Dequeue(Restart))
+		{
+			bRestarted = true;
+		}
+		if (bRestarted)
+		{
+			Generation = Restart.Generation;
+			State = Restart.State;
+			BlockedSectors = MoveTemp(Restart.BlockedSectors);
+			bCanPlan = true;
+		}
+
+		if (bCanPlan && State.PlannedSectors - TakenSectors->GetValue() < Lookahead)
+		{
+			FPlannedTrackSector PlannedSector;
+			PlannedSector.Generation = Generation;
+			// nothing can follow the sector the track ends in
+			bCanPlan = Planner.PlanNextSector(State, BlockedSectors, PlannedSector);
+			PlannedQueue->Enqueue(MoveTemp(PlannedSector));
+		}
+		else
+		{
+			FPlatformProcess::Sleep(0.01f);
+		}
+	}
+	return 1;
+}
+
+void FTrackPlanningWorker::Stop()
+{
+	IsThreadFinished = true;
+}
+
+void FTrackPlanningWorker::Exit()
+{
+
+}
@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "TrackSplineIndex.h"
+
+void FTrackSplineIndex::Initialize(const float InTileEdgeSize)
+{
+	TileEdgeSize = InTileEdgeSize;
+	Sectors.Empty();
+	SectorIndices.Empty();
+	MinSector = FIntVector2D();
+	MaxSector = FIntVector2D();
+}
+
+void FTrackSplineIndex::AddSector(const FIntVector2D Sector, const TArray<FVector>& PointsOnTrack)
+{
+	if (PointsOnTrack.Num() == 0 || SectorIndices.Contains(Sector)) { return; }
+
+	FTrackSplineSector SplineSector;
+	SplineSector.Sector = Sector;
+	SplineSector.StartDistance = GetTrackLength();
+	SplineSector.Points.Reserve(PointsOnTrack.Num());
+	SplineSector.Distances.Reserve(PointsOnTrack.Num());
+
+	const FVector SectorOrigin = FVector(Sector.X * TileEdgeSize, Sector.Y * TileEdgeSize, 0.f);
+	float Distance = 0.f;
+	for (const FVector& Point : PointsOnTrack)
+	{
+		const FVector WorldPoint = SectorOrigin + Point;
+		if (SplineSector.Points.Num() > 0)
+		{
+			Distance += FVector::Dist(SplineSector.Points.Last(), WorldPoint);
+		}
+		SplineSector.Points.Add(WorldPoint);
+		SplineSector.Distances.Add(Distance);
+	}
+
+	if (Sectors.Num() == 0)
+	{
+		MinSector = Sector;
+		MaxSector = Sector;
+	}
+	else
+	{
+		MinSector = FIntVector2D(FMath::Min(MinSector.X, Sector.X), FMath::Min(MinSector.Y, Sector.Y));
+		MaxSector = FIntVector2D(FMath::Max(MaxSector.X, Sector.X), FMath::Max(MaxSector.Y, Sector.Y));
+	}
+
+	SectorIndices.Add(Sector, Sectors.Num());
+	Sectors.Add(MoveTemp(SplineSector));
+}
+
+bool FTrackSplineIndex::FindNearestPoint(const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const
+{
+	if (Sectors.Num() == 0 || TileEdgeSize <= 0.f) { return false; }
+
+	const FIntVector2D Center = FIntVector2D(FMath::FloorToInt(Location.X / TileEdgeSize), FMath::FloorToInt(Location.Y / TileEdgeSize));
+	// no sector outside of this ring has track
+	const int32 MaximumRing = FMath::Max
+	(
+		FMath::Max(FMath::Abs(Center.X - MinSector.X), FMath::Abs(Center.X - MaxSector.X)),
+		FMath::Max(FMath::Abs(Center.Y - MinSector.Y), FMath::Abs(Center.Y - MaxSector.Y))
+	);
+
+	float BestSquaredDistance = MAX_flt;
+	for (int32 Ring = 0; Ring <= MaximumRing; ++Ring)
+	{
+		for (int32 X = -Ring; X <= Ring; ++X)
+		{
+			// only the first and the last column of the ring are complete, the other columns only contain the ring's top and bottom sector
+			const int32 Step = (FMath::Abs(X) == Ring) ? 1 : 2 * Ring;
+			for (int32 Y = -Ring; Y <= Ring; Y += Step)
+			{
+				const int32* Index = SectorIndices.Find(Center + FIntVector2D(X, Y));
+				if (!Index) { continue; }
+
+				FVector Point;
+				float DistanceAlongTrack = 0.f;
+				const float SquaredDistance = FindNearestPointInSector(Sectors[*Index], Location, Point, DistanceAlongTrack);
+				if (SquaredDistance < BestSquaredDistance)
+				{
+					BestSquaredDistance = SquaredDistance;
+					OUTPoint = Point;
+					OUTDistanceAlongTrack = DistanceAlongTrack;
+				}
+			}
+		}
+
+		// every sector of the next ring is at least Ring tile edges away from the location
+		if (BestSquaredDistance <= FMath::Square(Ring * TileEdgeSize)) { break; }
+	}
+
+	return BestSquaredDistance < MAX_flt;
+}
+
+bool FTrackSplineIndex::GetLocationAtDistance(const float DistanceAlongTrack, FVector& OUTLocation, FVector& OUTDirection) const
+{
+	if (Sectors.Num() == 0) { return false; }
+
+	const float Distance = FMath::Clamp(DistanceAlongTrack, 0.f, GetTrackLength());
+
+	// last sector that starts before the distance
+	int32 Low = 0;
+	int32 High = Sectors.Num() - 1;
+	while (Low < High)
+	{
+		const int32 Middle = (Low + High + 1) / 2;
+		if (Sectors[Middle].StartDistance <= Distance) { Low = Middle; }
+		else { High = Middle - 1; }
+	}
+	const FTrackSplineSector& SplineSector = Sectors[Low];
+
+	if (SplineSector.Points.Num() == 1)
+	{
+		OUTLocation = SplineSector.Points[0];
+		OUTDirection = FVector::ZeroVector;
+		return true;
+	}
+
+	// first point of the segment that contains the distance
+	const float SectorDistance = Distance - SplineSector.StartDistance;
+	Low = 0;
+	High = SplineSector.Points.Num() - 2;
+	while (Low < High)
+	{
+		const int32 Middle = (Low + High + 1) / 2;
+		if (SplineSector.Distances[Middle] <= SectorDistance) { Low = Middle; }
+		else { High = Middle - 1; }
+	}
+
+	const float SegmentLength = SplineSector.Distances[Low + 1] - SplineSector.Distances[Low];
+	const float Alpha = SegmentLength > KINDA_SMALL_NUMBER ? FMath::Clamp((SectorDistance - SplineSector.Distances[Low]) / SegmentLength, 0.f, 1.f) : 0.f;
+	OUTLocation = FMath::Lerp(SplineSector.Points[Low], SplineSector.Points[Low + 1], Alpha);
+	OUTDirection = (SplineSector.Points[Low + 1] - SplineSector.Points[Low]).GetSafeNormal();
+	return true;
+}
+
+float FTrackSplineIndex::GetTrackLength() const
+{
+	if (Sectors.Num() == 0) { return 0.f; }
+	return Sectors.Last().StartDistance + Sectors.Last().Distances.Last();
+}
+
+int32 FTrackSplineIndex::NumSectors() const
+{
+	return Sectors.Num();
+}
+
+float FTrackSplineIndex::FindNearestPointInSector(const FTrackSplineSector& SplineSector, const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const
+{
+	const FVector2D Pt = FVector2D(Location);
+
+	OUTPoint = SplineSector.Points[0];
+	OUTDistanceAlongTrack = SplineSector.StartDistance;
+	float BestSquaredDistance = FVector2D::DistSquared(Pt, FVector2D(OUTPoint));
+
+	for (int32 i = 0; i + 1 < SplineSector.Points.Num(); ++i)
+	{
+		const FVector2D Start = FVector2D(SplineSector.Points[i]);
+		const FVector2D Direction = FVector2D(SplineSector.Points[i + 1]) - Start;
+		const float SquaredLength = Direction.SizeSquared();
+		const float Alpha = SquaredLength > KINDA_SMALL_NUMBER ? FMath::Clamp(FVector2D::DotProduct(Pt - Start, Direction) / SquaredLength, 0.f, 1.f) : 0.f;
+		const float SquaredDistance = FVector2D::DistSquared(Pt, Start + Alpha * Direction);
+		if (SquaredDistance < BestSquaredDistance)
+		{
+			BestSquaredDistance = SquaredDistance;
+			OUTPoint = FMath::Lerp(SplineSector.Points[i], SplineSector.Points[i + 1], Alpha);
+			OUTDistanceAlongTrack = SplineSector.StartDistance + FMath::Lerp(SplineSector.Distances[i], SplineSector.Distances[i + 1], Alpha);
+		}
+	}
+
+	return BestSquaredDistance;
+}
@@ -7,11 +7,16 @@
 #include "UObject/NoExportTypes.h"
 #include "Engine/Classes/Materials/MaterialInterface.h"
 #include "Math/NumericLimits.h"
+#include "Math/Vector2DHalf.h"
+#include "Async/ParallelFor.h"
 #include <random>
 #include "MyStaticLibrary.generated.h"
 
 class ATerrainTile;
 
+// cycle stats of the terrain and the hover traces, shown with "stat HoverTest"
+DECLARE_STATS_GROUP(TEXT("HoverTest"), STATGROUP_HoverTest, STATCAT_Advanced);
+
 /**
  * enum to differ tile borders
  */
@@ -103,42 +108,6 @@ struct FIntVector2D
 	}
 };
 
-/**
- * struct that contains a checkpoint spawn job
- */
-USTRUCT()
-struct FCheckpointSpawnJob
-{
-	GENERATED_USTRUCT_BODY()
-
-	// the checkpoint's ID
-	int32 CheckpointID = -1;
-
-	// the checkpoint's transform
-	UPROPERTY()
-	FTransform CheckpointTransform = FTransform();
-
-	// the sector the checkpoint should be created for
-	UPROPERTY()
-	FIntVector2D CheckpointSector = FIntVector2D();
-
-	/**
-	 * @DEPRECATED, use other constructor
-	 */
-	FCheckpointSpawnJob()
-	{
-
-	}
-
-	FCheckpointSpawnJob(const uint32 ID, const FTransform& Transform, const FIntVector2D Sector)
-	{
-		CheckpointID = ID;
-		CheckpointTransform = Transform;
-		CheckpointSector = Sector;
-	}
-
-};
-
 USTRUCT()
 struct FLineSegment2D
 {
@@ -220,11 +189,11 @@ struct FSectorTrackInfo
 	UPROPERTY()
 	float TrackExitPointElevation = 0.f;
 
-	// first bzier control point
+	// first bézier control point
 	UPROPERTY()
 	FVector FirstBezierControlPoint = FVector();
 
-	// second bzier control point
+	// second bézier control point
 	UPROPERTY()
 	FVector SecondBezierControlPoint = FVector();
 
@@ -247,12 +216,47 @@ struct FSectorTrackInfo
 	UPROPERTY()
 	int32 CheckpointID = -1;
 
+	// transform of the checkpoint in world space, only valid if CheckpointID is not -1
+	UPROPERTY()
+	FTransform CheckpointTransform = FTransform();
+
+	// true if the player spawns on the track of this sector, only the case for the start sector
+	UPROPERTY()
+	bool bHasPlayerSpawn = false;
+
+	// the player's spawn transform in world space (the start sector's space), only valid if bHasPlayerSpawn is true
+	UPROPERTY()
+	FTransform PlayerSpawnTransform = FTransform();
+
 	// sector has no track
 	FSectorTrackInfo()
 	{
 
 	}
 
+	/**
+	 * calculates a hash of everything the terrain of the sector is carved around, used to tell if a cached tile still matches the planned track
+	 * @param PreviousTrackInfo Track info of the sector before this one on the track, its exit border points are this sector's entry border points
+	 */
+	uint32 CalculateTrackHash(const FSectorTrackInfo& PreviousTrackInfo) const
+	{
+		if (!bSectorHasTrack) { return 0; }
+		uint32 Hash = GetTypeHash(TrackEntryPoint);
+		Hash = HashCombine(Hash, GetTypeHash(TrackExitPoint));
+		Hash = HashCombine(Hash, GetTypeHash(TrackExitPointElevation));
+		Hash = HashCombine(Hash, GetTypeHash(FirstBezierControlPoint));
+		Hash = HashCombine(Hash, GetTypeHash(SecondBezierControlPoint));
+		Hash = HashCombine(Hash, GetTypeHash(Y0Position));
+		Hash = HashCombine(Hash, GetTypeHash(Y1Position));
+		if (PreviousTrackInfo.bSectorHasTrack)
+		{
+			Hash = HashCombine(Hash, GetTypeHash(PreviousTrackInfo.Y0Position));
+			Hash = HashCombine(Hash, GetTypeHash(PreviousTrackInfo.Y1Position));
+		}
+		// a sector with track never gets the hash of a sector without track
+		return Hash != 0 ? Hash : 1;
+	}
+
 	// sector has a track
 	FSectorTrackInfo(FVector2D EntryPoint, FVector2D ExitPoint, FIntVector2D PreviousSector, FIntVector2D FollowingSector)
 	{
@@ -328,6 +332,7 @@ struct FTrackSegment
 
 	/**
 	 * error tolerance when calculating if a point lies between the defining points
+	 * adjacent track segments and adjacent sectors share their edge vertices exactly, so no tolerance is needed and points are not constrained by two segments
 	 */
 	float ErrorTolerance = 0.f;
 
@@ -363,7 +368,7 @@ struct FTrackSegment
 		UE_LOG(LogTemp, Error, TEXT("Using wrong FTrackSegment constructor"));
 	}
 
-	FTrackSegment(const FVector Point1, const FVector Point2, const FVector Point3, const FVector Point4, const FVector TrackMiddlePointStart, const FVector TrackMiddlePointEnd, const float PreviousSegmentBaseElevation, const float TileEdgeSize, const float IncludeErrorTolerance, const float TrackElevationOffset)
+	FTrackSegment(const FVector Point1, const FVector Point2, const FVector Point3, const FVector Point4, const FVector TrackMiddlePointStart, const FVector TrackMiddlePointEnd, const float PreviousSegmentBaseElevation, const float TileEdgeSize, const float TrackElevationOffset)
 	{
 		DefiningPoints.Add(FVector2D(Point1.X, Point1.Y));
 		DefiningPoints.Add(FVector2D(Point2.X, Point2.Y));
@@ -377,7 +382,6 @@ struct FTrackSegment
 		EndLineHeight = TrackMiddlePointEnd.Z;
 
 		this->TileEdgeSize = TileEdgeSize;
-		this->ErrorTolerance = IncludeErrorTolerance;
 		this->PreviousSegmentBaseElevation = PreviousSegmentBaseElevation;
 		ElevationOffset = TrackElevationOffset;
 	}
@@ -435,20 +439,9 @@ struct FTrackSegment
 		i_min = FMath::FloorToInt(MinX / UnitSize);
 		i_max = FMath::CeilToInt(MaxX / UnitSize);
 
-		// calculate points in rectangular bounding box
-		for (int32 i = i_min; i <= i_max; ++i)
-		{
-			for (int32 j = j_min; j <= j_max; ++j)
-			{
-				const FVector2D Point = FVector2D(i * UnitSize, j * UnitSize);
-
-				PointsOnTrackSegment.Add(FVector(Point.X, Point.Y, 0.f/*InterpolatePointElevationTriangle(Point, PointA, PointB, PointC)*/ /*InterpolatePointElevation(Point)*/));
-			}
-		}
-
 		/**
-		 * filter out points that probably lie within the next or previous track segment, as they will be processed there
-		 * don't do this for the last track segment in the tile, since there is no next track segment
+		 * only keep points that lie between the track segment's start and end line, points outside of them get handled by the next / previous track segment
+		 * instead of testing every point of the rectangular bounding box, every row of the bounding box is rasterized as one span between these lines
 		 *
 		 *				X3--------------------X2
 		 *				|					  |
@@ -456,148 +449,34 @@ struct FTrackSegment
 		 *				|					  |
 		 *				X0--------------------X1
 		 */
-
-		FVector2D X2X3 = DefiningPoints[3] - DefiningPoints[2];
-		FVector2D X1X0 = DefiningPoints[0] - DefiningPoints[1];
-		FVector2D X0X3 = DefiningPoints[3] - DefiningPoints[0];
-		FVector2D X1X2 = DefiningPoints[2] - DefiningPoints[1];
-
-		for (int32 i = PointsOnTrackSegment.Num() - 1; i >= 0; --i)
-		{
-			FVector2D Pt = FVector2D(PointsOnTrackSegment[i].X, PointsOnTrackSegment[i].Y);
-
-			/**
-			 * filter out points that are within our bounding rectangle, but not within the track segment's start and end line (these points get handled by the next / previous track segment)
-			 * point lies between X1X0 and X2X3 if det(X2X3, X2Pt) (== DetA) and det(X1X0, X1Pt) (== DetB) have different signs
-			 */
-			float DetA = FVector2D::CrossProduct(X2X3, Pt - DefiningPoints[2]);
-			float DetB = FVector2D::CrossProduct(X1X0, Pt - DefiningPoints[1]);
-
-			// since sometimes the determinant of a point lying on the same line as the defining points is not 0 but somewhere close to it, an error tolerance is introduced 
-			if ((DetA > ErrorTolerance && DetB > ErrorTolerance) || (DetA < -ErrorTolerance && DetB < -ErrorTolerance))
-			{
-				PointsOnTrackSegment.RemoveAt(i);
-				continue;
-			}
-
-			/**
-			 * this section should help fix the terrain discontinuity on borders if one tile defines a track constraint that the other tile does not define
-			 */
-
-			// only continue if current point lies on one of the tile's borders
-			if (FMath::IsNearlyZero(Pt.X) || FMath::IsNearlyEqual(Pt.X, TileEdgeSize) || FMath::IsNearlyZero(Pt.Y) || FMath::IsNearlyEqual(Pt.Y, TileEdgeSize))
-			{
-				// only continue if point is outside of track borders (X0X3 && X1X2)
-				float DetC = FVector2D::CrossProduct(X0X3, Pt - DefiningPoints[0]);
-				float DetD = FVector2D::CrossProduct(X1X2, Pt - DefiningPoints[1]);
-
-				if ((DetC > ErrorTolerance && DetD > ErrorTolerance) || (DetC < -ErrorTolerance && DetD < -ErrorTolerance))
-				{
-					float MinDistance = 0.f;
-
-					if (bIsFirstSegmentOnTrack || bIsLastSegmentOnTrack)
-					{
-						// X1X0 (or X2X3) will lie on border
-						int32 Index1 = -1;
-						int32 Index2 = -1;
-						if (bIsFirstSegmentOnTrack)
-						{
-							Index1 = 0;
-							Index2 = 1;
-						}
-						if (bIsLastSegmentOnTrack)
-						{
-							Index1 = 3;
-							Index2 = 2;
-						}
-						// calculate minimum distance between point and line segment
-						MinDistance = FMath::Min<float>
-							(
-								FVector2D::Distance(Pt, DefiningPoints[Index1]),
-								FVector2D::Distance(Pt, DefiningPoints[Index2])
-							);
-
-					}
-					else
-					{
-						MinDistance = FMath::Min3<float>
-							(
-								FVector2D::Distance(Pt, DefiningPoints[0]),
-								FVector2D::Distance(Pt, DefiningPoints[1]),
-								FVector2D::Distance(Pt, DefiningPoints[2])
-							);
-						MinDistance = FMath::Min<float>
-							(
-								MinDistance,
-								FVector2D::Distance(Pt, DefiningPoints[3])
-							);
-					}
-
-					// if minimum distance is greater than UnitSize, we know there is at least one other point between the current point and the defining point, so we can remove the current point from the constraints
-					if (MinDistance > UnitSize)
-					{
-						PointsOnTrackSegment.RemoveAt(i);
-						continue;
-					}
-				}
-			}
-		}
-
-		// for every remaining point, calculate the points elevation by interpolating the height of the triangle it is in
-		for (FVector& Point : PointsOnTrackSegment)
+		for (int32 i = i_min; i <= i_max; ++i)
 		{
-			const FVector2D Point2D = FVector2D(Point.X, Point.Y);
-
-			//UE_LOG(LogTemp, Error, TEXT("Point is %s"), *Point2D.ToString());
+			int32 FirstColumn = j_min;
+			int32 LastColumn = j_max;
+			const bool bIsSpan = CalculateRowSpanBetweenStartAndEndLine(i, FirstColumn, LastColumn);
+			if (FirstColumn > LastColumn) { continue; }
 
-			if ((bIsFirstSegmentOnTrack || bIsLastSegmentOnTrack) && CheckPointLiesOnTileBorder(Point2D))
-			{
-				Point.Z = bIsFirstSegmentOnTrack ? BaseLineHeight : EndLineHeight;
-				//UE_LOG(LogTemp, Warning, TEXT("Point lies on border."));
-			}
+			// barycentric coordinates of the span's points in the segment's triangles change by the same amount from one point to the next
+			FVector FirstBaryCoords[4];
+			FVector BaryCoordsSteps[4];
+			CalculateRowBaryCoords(i, FirstColumn, FirstBaryCoords, BaryCoordsSteps);
 
-			else
+			for (int32 j = FirstColumn; j <= LastColumn; ++j)
 			{
-				// create Array that contains all possible elevations for the point: PossibleElevations
-				TArray<float> PossibleElevations;
-
-				// for each line segment: check if line segment intersects with one of the triangles edges (from point A to point B)(except base line and end line of the segment) (every time check all triangle edges)
-				CheckPointIntersectsWithTriangleEdges(Point, PossibleElevations);
-
-
-				// if (not IsFirstSegmentOnTrack) && slope of current track segment is greater than slope of previous
-				//float SlopeCurrentTrackSegment = EndLineHeight - BaseLineHeight;
-				//float SlopePreviousTrackSegment = BaseLineHeight - PreviousSegmentBaseElevation;
-				//if (!bIsFirstSegmentOnTrack && (SlopeCurrentTrackSegment > SlopePreviousTrackSegment))
-				//{
-				//	UE_LOG(LogTemp, Warning, TEXT("Slope of current track segment is higher than slope of previous track segment: %f > %f"), SlopeCurrentTrackSegment, SlopePreviousTrackSegment);
-				//	// check for each line segment if it intersects with the segment's base line
-				//	CheckPointIntersectsWithBaseLine(Point, PossibleElevations);
+				const FVector2D Pt = FVector2D(i * UnitSize, j * UnitSize);
+				// the lines diverge too much in this row to bound a single span, so every point is tested
+				if (!bIsSpan && !IsBetweenStartAndEndLine(Pt)) { continue; }
+				if (IsRedundantBorderPoint(Pt)) { continue; }
 
-				//}
-				CheckPointIntersectsWithBaseLineOrEndLine(Point, PossibleElevations);
-
-
-				// get the minimum elevation from PossibleElevations -> this (minus the offset) is the points final elevation
-				if (PossibleElevations.Num() > 0)
-				{
-					PossibleElevations.Sort();
-					//UE_LOG(LogTemp, Warning, TEXT("Found %i possible elevations: First entry is %f, last entry is %f"), PossibleElevations.Num(), PossibleElevations[0], PossibleElevations[PossibleElevations.Num() -1]);
-					Point.Z = PossibleElevations[0];
-				}
-				else
+				FVector BaryCoords[4];
+				for (int32 Triangle = 0; Triangle < 4; ++Triangle)
 				{
-					// the point lies inside one of the track segment's triangles, but is surrounded by other terrain vertices that lie in the same triangle
-					// in this case, we simply calculate the points elevation by interpolating his elevation in the triangle
-					//UE_LOG(LogTemp, Warning, TEXT("Could not find any possible elevation, interpolating in triangle where point lies"));
-
-					Point.Z = InterpolatePointElevationInTrackSegment(Point);
-
+					BaryCoords[Triangle] = FirstBaryCoords[Triangle] + (j - FirstColumn) * BaryCoordsSteps[Triangle];
 				}
+				FVector Point = FVector(Pt.X, Pt.Y, 0.f);
+				Point.Z = CalculatePointElevation(Point, BaryCoords);
+				PointsOnTrackSegment.Add(Point);
 			}
-			
-			// finally add elevation offset
-			Point.Z -= ElevationOffset;
 		}
 
 		//UE_LOG(LogTemp, Warning, TEXT("----------End of track segment----------"));
@@ -634,6 +513,235 @@ struct FTrackSegment
 		//}
 	}
 
+	/**
+	 * checks if the given point lies between the track segment's start line [X0, X1] and end line [X3, X2]
+	 * this is the case if det(X2X3, X2Pt) (== DetA) and det(X1X0, X1Pt) (== DetB) have different signs
+	 */
+	bool IsBetweenStartAndEndLine(const FVector2D Pt) const
+	{
+		const float DetA = FVector2D::CrossProduct(DefiningPoints[3] - DefiningPoints[2], Pt - DefiningPoints[2]);
+		const float DetB = FVector2D::CrossProduct(DefiningPoints[0] - DefiningPoints[1], Pt - DefiningPoints[1]);
+
+		// since sometimes the determinant of a point lying on the same line as the defining points is not 0 but somewhere close to it, an error tolerance is introduced
+		return !((DetA > ErrorTolerance && DetB > ErrorTolerance) || (DetA < -ErrorTolerance && DetB < -ErrorTolerance));
+	}
+
+	/**
+	 * calculates the first and last column j of row i within the bounding box whose points lie between the start and end line, see IsBetweenStartAndEndLine
+	 * both determinants are linear in j, so the span follows from the lines' equations and only the points at its ends are tested
+	 * @param OUTFirstColumn First column of the span, greater than OUTLastColumn if no point of the row lies between the lines
+	 * @return False if the points of the row between the lines do not form a single span (start and end line point in opposite directions),
+	 * OUTFirstColumn and OUTLastColumn are the whole row then and every point has to be tested
+	 */
+	bool CalculateRowSpanBetweenStartAndEndLine(const int32 i, int32& OUTFirstColumn, int32& OUTLastColumn) const
+	{
+		OUTFirstColumn = j_min;
+		OUTLastColumn = j_max;
+		const FVector2D X2X3 = DefiningPoints[3] - DefiningPoints[2];
+		const FVector2D X1X0 = DefiningPoints[0] - DefiningPoints[1];
+		const float X = i * UnitSize;
+
+		// Det(j) = Offset + j * Gradient
+		const float GradientA = X2X3.X * UnitSize;
+		const float OffsetA = -X2X3.X * DefiningPoints[2].Y - X2X3.Y * (X - DefiningPoints[2].X);
+		const float GradientB = X1X0.X * UnitSize;
+		const float OffsetB = -X1X0.X * DefiningPoints[1].Y - X1X0.Y * (X - DefiningPoints[1].X);
+		if (GradientA * GradientB < 0.f) { return false; }
+
+		// columns with Offset + j * Gradient <= Limit, a half-open range of the row since the gradient is the same for every column
+		auto GetColumnsBelow = [this](const float Offset, const float Gradient, const float Limit, int32& OUTFirst, int32& OUTLast)
+		{
+			OUTFirst = j_min;
+			OUTLast = j_max;
+			if (Gradient > 0.f)
+			{
+				OUTLast = FMath::FloorToInt(FMath::Clamp((Limit - Offset) / Gradient, j_min - 1.f, j_max + 1.f));
+			}
+			else if (Gradient < 0.f)
+			{
+				OUTFirst = FMath::CeilToInt(FMath::Clamp((Limit - Offset) / Gradient, j_min - 1.f, j_max + 1.f));
+			}
+			else if (Offset > Limit)
+			{
+				OUTFirst = j_max + 1;
+			}
+		};
+		// union of two ranges that are open to the same side
+		auto Unite = [](const int32 FirstA, const int32 LastA, const int32 FirstB, const int32 LastB, int32& OUTFirst, int32& OUTLast)
+		{
+			if (FirstA > LastA) { OUTFirst = FirstB; OUTLast = LastB; }
+			else if (FirstB > LastB) { OUTFirst = FirstA; OUTLast = LastA; }
+			else { OUTFirst = FMath::Min(FirstA, FirstB); OUTLast = FMath::Max(LastA, LastB); }
+		};
+
+		// a point is kept if DetA <= ErrorTolerance or DetB <= ErrorTolerance ...
+		int32 FirstA, LastA, FirstB, LastB, FirstBelow, LastBelow;
+		GetColumnsBelow(OffsetA, GradientA, ErrorTolerance, FirstA, LastA);
+		GetColumnsBelow(OffsetB, GradientB, ErrorTolerance, FirstB, LastB);
+		Unite(FirstA, LastA, FirstB, LastB, FirstBelow, LastBelow);
+		// ... and DetA >= -ErrorTolerance or DetB >= -ErrorTolerance
+		int32 FirstAbove, LastAbove;
+		GetColumnsBelow(-OffsetA, -GradientA, ErrorTolerance, FirstA, LastA);
+		GetColumnsBelow(-OffsetB, -GradientB, ErrorTolerance, FirstB, LastB);
+		Unite(FirstA, LastA, FirstB, LastB, FirstAbove, LastAbove);
+
+		int32 First = FMath::Max3(j_min, FirstBelow, FirstAbove);
+		int32 Last = FMath::Min3(j_max, LastBelow, LastAbove);
+		if (First > Last)
+		{
+			// rounding may hide a single point close to the lines
+			First = FMath::Clamp(First, j_min, j_max);
+			Last = First;
+		}
+
+		// the span's ends are tested exactly, so rounding in the lines' equations does not change which points are kept
+		auto IsKept = [this, X](const int32 j) { return IsBetweenStartAndEndLine(FVector2D(X, j * UnitSize)); };
+		while (First <= Last && !IsKept(First)) { ++First; }
+		while (Last >= First && !IsKept(Last)) { --Last; }
+		if (First <= Last)
+		{
+			while (First > j_min && IsKept(First - 1)) { --First; }
+			while (Last < j_max && IsKept(Last + 1)) { ++Last; }
+		}
+		OUTFirstColumn = First;
+		OUTLastColumn = Last;
+		return true;
+	}
+
+	/**
+	 * filters out points on the tile's borders that lie outside of the track borders (X0X3 && X1X2), but have other points between them and the track
+	 * this should help fix the terrain discontinuity on borders if one tile defines a track constraint that the other tile does not define
+	 */
+	bool IsRedundantBorderPoint(const FVector2D Pt) const
+	{
+		// only continue if current point lies on one of the tile's borders
+		if (!(FMath::IsNearlyZero(Pt.X) || FMath::IsNearlyEqual(Pt.X, TileEdgeSize) || FMath::IsNearlyZero(Pt.Y) || FMath::IsNearlyEqual(Pt.Y, TileEdgeSize)))
+		{
+			return false;
+		}
+
+		// only continue if point is outside of track borders (X0X3 && X1X2)
+		const float DetC = FVector2D::CrossProduct(DefiningPoints[3] - DefiningPoints[0], Pt - DefiningPoints[0]);
+		const float DetD = FVector2D::CrossProduct(DefiningPoints[2] - DefiningPoints[1], Pt - DefiningPoints[1]);
+		if (!((DetC > ErrorTolerance && DetD > ErrorTolerance) || (DetC < -ErrorTolerance && DetD < -ErrorTolerance)))
+		{
+			return false;
+		}
+
+		float MinDistance = 0.f;
+		if (bIsFirstSegmentOnTrack || bIsLastSegmentOnTrack)
+		{
+			// X1X0 (or X2X3) will lie on border
+			const int32 Index1 = bIsLastSegmentOnTrack ? 3 : 0;
+			const int32 Index2 = bIsLastSegmentOnTrack ? 2 : 1;
+			// calculate minimum distance between point and line segment
+			MinDistance = FMath::Min<float>(FVector2D::Distance(Pt, DefiningPoints[Index1]), FVector2D::Distance(Pt, DefiningPoints[Index2]));
+		}
+		else
+		{
+			MinDistance = FMath::Min<float>
+				(
+					FMath::Min3<float>(FVector2D::Distance(Pt, DefiningPoints[0]), FVector2D::Distance(Pt, DefiningPoints[1]), FVector2D::Distance(Pt, DefiningPoints[2])),
+					FVector2D::Distance(Pt, DefiningPoints[3])
+				);
+		}
+
+		// if minimum distance is greater than UnitSize, we know there is at least one other point between the current point and the defining point, so we can remove the current point from the constraints
+		return MinDistance > UnitSize;
+	}
+
+	/**
+	 * calculates the barycentric coordinates of the point in column FirstColumn of row i in the segment's four triangles
+	 * (see InterpolatePointElevationInTrackSegment for their order) and how much they change from one column to the next
+	 */
+	void CalculateRowBaryCoords(const int32 i, const int32 FirstColumn, FVector OUTFirstBaryCoords[4], FVector OUTBaryCoordsSteps[4]) const
+	{
+		const FVector X0 = FVector(DefiningPoints[0], 0.f);
+		const FVector X1 = FVector(DefiningPoints[1], 0.f);
+		const FVector X2 = FVector(DefiningPoints[2], 0.f);
+		const FVector X3 = FVector(DefiningPoints[3], 0.f);
+		const FVector T0 = FVector(TrackStartMiddlePoint.X, TrackStartMiddlePoint.Y, 0.f);
+		const FVector T1 = FVector(TrackEndMiddlePoint.X, TrackEndMiddlePoint.Y, 0.f);
+		const FVector Triangles[4][3] = { { X0, T0, X3 }, { T0, T1, X3 }, { T0, X1, T1 }, { X1, X2, T1 } };
+
+		const FVector First = FVector(i * UnitSize, FirstColumn * UnitSize, 0.f);
+		const FVector Next = FVector(i * UnitSize, (FirstColumn + 1) * UnitSize, 0.f);
+		for (int32 Triangle = 0; Triangle < 4; ++Triangle)
+		{
+			OUTFirstBaryCoords[Triangle] = FMath::ComputeBaryCentric2D(First, Triangles[Triangle][0], Triangles[Triangle][1], Triangles[Triangle][2]);
+			OUTBaryCoordsSteps[Triangle] = FMath::ComputeBaryCentric2D(Next, Triangles[Triangle][0], Triangles[Triangle][1], Triangles[Triangle][2]) - OUTFirstBaryCoords[Triangle];
+		}
+	}
+
+	/**
+	 * calculates the elevation of a point on the track segment including the elevation offset
+	 * @param BaryCoords Barycentric coordinates of the point in the segment's four triangles, see CalculateRowBaryCoords
+	 */
+	float CalculatePointElevation(const FVector Point, const FVector BaryCoords[4])
+	{
+		const FVector2D Point2D = FVector2D(Point.X, Point.Y);
+		float Elevation = 0.f;
+
+		if ((bIsFirstSegmentOnTrack || bIsLastSegmentOnTrack) && CheckPointLiesOnTileBorder(Point2D))
+		{
+			Elevation = bIsFirstSegmentOnTrack ? BaseLineHeight : EndLineHeight;
+		}
+		else
+		{
+			// create Array that contains all possible elevations for the point: PossibleElevations
+			TArray<float, TInlineAllocator<16>> PossibleElevations;
+
+			// for each line segment: check if line segment intersects with one of the triangles edges (from point A to point B)(except base line and end line of the segment) (every time check all triangle edges)
+			CheckPointIntersectsWithTriangleEdges(Point, PossibleElevations);
+			CheckPointIntersectsWithBaseLineOrEndLine(Point, PossibleElevations);
+
+			// get the minimum elevation from PossibleElevations -> this (minus the offset) is the points final elevation
+			if (PossibleElevations.Num() > 0)
+			{
+				Elevation = PossibleElevations[0];
+				for (const float PossibleElevation : PossibleElevations)
+				{
+					Elevation = FMath::Min(Elevation, PossibleElevation);
+				}
+			}
+			else
+			{
+				// the point lies inside one of the track segment's triangles, but is surrounded by other terrain vertices that lie in the same triangle
+				// in this case, we simply calculate the points elevation by interpolating his elevation in the triangle
+				Elevation = InterpolatePointElevationInTrackSegment(Point, BaryCoords);
+			}
+		}
+
+		// finally add elevation offset
+		return Elevation - ElevationOffset;
+	}
+
+	/**
+	 * same as InterpolatePointElevationInTrackSegment, but with the point's barycentric coordinates in the segment's triangles already known
+	 */
+	float InterpolatePointElevationInTrackSegment(const FVector Point, const FVector BaryCoords[4])
+	{
+		// elevations of the corners of the triangles in the order of CalculateRowBaryCoords
+		const FVector TriangleHeights[4] =
+		{
+			FVector(BaseLineHeight, BaseLineHeight, EndLineHeight),
+			FVector(BaseLineHeight, EndLineHeight, EndLineHeight),
+			FVector(BaseLineHeight, BaseLineHeight, EndLineHeight),
+			FVector(BaseLineHeight, EndLineHeight, EndLineHeight)
+		};
+		for (int32 Triangle = 0; Triangle < 4; ++Triangle)
+		{
+			const FVector& Coords = BaryCoords[Triangle];
+			if (Coords.X >= 0.f && Coords.Y >= 0.f && Coords.Z >= 0.f)
+			{
+				// point lies inside this triangle
+				return FVector::DotProduct(Coords, TriangleHeights[Triangle]);
+			}
+		}
+		// point does not lie within any of these triangles, it gets projected
+		return InterpolatePointElevationInTrackSegment(Point);
+	}
+
 	/**
 	 * calculates the elevation of the given point inside one of the track segment's triangles
 	 * if the point does not lie in one of the triangles, it will get projected onto either [X0, X3] or [X1, X2] and this elevation is going to be used
@@ -717,7 +825,8 @@ struct FTrackSegment
 	 * checks if all line segments with the given point as start point and UnitSize-1 in all directions as end point intersect with the base line (not the segment of it!)
 	 * if they intersect, the base line height will added to the given array as one possible elevation
 	 */
-	void CheckPointIntersectsWithBaseLineOrEndLine(const FVector Point, TArray<float>& OUTElevationOfIntersectionPoints)
+	template <typename AllocatorType>
+	void CheckPointIntersectsWithBaseLineOrEndLine(const FVector Point, TArray<float, AllocatorType>& OUTElevationOfIntersectionPoints)
 	{
 		/**
 		*			X3----------T1----------X2
@@ -861,7 +970,8 @@ struct FTrackSegment
 	 * if they intersect, their intersection point is calculated and it's elevation linearly interpolated on the edge
 	 * the resulting elevation is added to the provided array
 	 */
-	void CheckPointIntersectsWithTriangleEdges(const FVector Point, TArray<float>& OUTElevationOfIntersectionPoints)
+	template <typename AllocatorType>
+	void CheckPointIntersectsWithTriangleEdges(const FVector Point, TArray<float, AllocatorType>& OUTElevationOfIntersectionPoints)
 	{
 		/**
 		*			X3----------T1----------X2
@@ -882,12 +992,7 @@ struct FTrackSegment
 		const FVector T1 = FVector(TrackEndMiddlePoint.X, TrackEndMiddlePoint.Y, EndLineHeight);
 
 		// add all edges in array
-		TArray<FLineSegment> TriangleEdges;
-		TriangleEdges.Add(FLineSegment(X0, X3));
-		TriangleEdges.Add(FLineSegment(T0, X3));
-		TriangleEdges.Add(FLineSegment(T0, T1));
-		TriangleEdges.Add(FLineSegment(X1, T1));
-		TriangleEdges.Add(FLineSegment(X1, X2));
+		const FLineSegment TriangleEdges[5] = { FLineSegment(X0, X3), FLineSegment(T0, X3), FLineSegment(T0, T1), FLineSegment(X1, T1), FLineSegment(X1, X2) };
 
 		FVector2D IntersectionPoint;
 
@@ -896,7 +1001,7 @@ struct FTrackSegment
 		{
 			CheckPointLineSegmentsIntersectWithGivenSegment(Point, Edge.SegmentStartPoint, Edge.SegmentEndPoint, OUTElevationOfIntersectionPoints);
 		}*/
-		for (int32 i = 0; i < TriangleEdges.Num(); ++i)
+		for (int32 i = 0; i < 5; ++i)
 		{
 			/*switch (i)
 			{
@@ -930,7 +1035,8 @@ struct FTrackSegment
 	 * @param PointB End point of the line segment to check for intersections
 	 * @param OUTElevations Array to which all interpolated elevations of intersection points will be added
 	 */
-	void CheckPointLineSegmentsIntersectWithGivenSegment(const FVector Point, const FVector PointA, const FVector PointB, TArray<float>& OUTElevations)
+	template <typename AllocatorType>
+	void CheckPointLineSegmentsIntersectWithGivenSegment(const FVector Point, const FVector PointA, const FVector PointB, TArray<float, AllocatorType>& OUTElevations)
 	{
 		// build line segment in each direction (X/Y coordinate + - (UnitSize - 1))
 		const FVector LineSegmentUp = Point + FVector(UnitSize - 1.f, 0.f, 0.f);
@@ -1389,10 +1495,138 @@ struct FTrackSegment
 	}
 };
 
+/**
+ * distance and elevation field of the track centerline of a tile
+ * the centerline is the polyline through the middle points of the tile's track segments, for every lattice point near it the distance to the nearest centerline point and that point's elevation are stored
+ * the field is computed once and replaces the per segment calculation of the track constraints, so overlapping segments need no special handling
+ */
+struct FTrackCorridorField
+{
+	// number of lattice points along a tile edge
+	int32 GridSize = 0;
+
+	// size between two adjacent lattice points
+	float UnitSize = 0.f;
+
+	// size of a terrain tile edge
+	float TileEdgeSize = 0.f;
+
+	// squared distance of every lattice point (index X * GridSize + Y) to the centerline, MAX_flt for points outside of the field's radius
+	TArray<float> SquaredDistances;
+
+	// elevation of the nearest centerline point of every lattice point
+	TArray<float> Elevations;
+
+	/**
+	 * computes the field for all lattice points whose distance to the centerline is at most Radius
+	 * the rows of the lattice are computed in parallel, every row only tests the centerline segments whose bounds overlap it
+	 * @param TrackSegments The track segments of the tile, in track order
+	 * @param InUnitSize The distance between two adjacent lattice points
+	 * @param InTileEdgeSize The size of a terrain tile edge
+	 * @param Radius Maximum distance to the centerline of the points that are part of the field
+	 */
+	void Build(const TArray<FTrackSegment>& TrackSegments, const float InUnitSize, const float InTileEdgeSize, const float Radius)
+	{
+		UnitSize = InUnitSize;
+		TileEdgeSize = InTileEdgeSize;
+		GridSize = FMath::RoundToInt(TileEdgeSize / UnitSize) + 1;
+		SquaredDistances.Init(MAX_flt, GridSize * GridSize);
+		Elevations.Init(0.f, GridSize * GridSize);
+
+		/**
+		 * a segment of the centerline together with the lattice points that can be within Radius of it
+		 */
+		struct FCenterlineSegment
+		{
+			FVector Start;
+			FVector End;
+			int32 i_min;
+			int32 i_max;
+			int32 j_min;
+			int32 j_max;
+		};
+
+		TArray<FCenterlineSegment> Centerline;
+		Centerline.Reserve(TrackSegments.Num());
+		for (const FTrackSegment& TrackSegment : TrackSegments)
+		{
+			FCenterlineSegment Segment;
+			Segment.Start = TrackSegment.TrackStartMiddlePoint;
+			Segment.End = TrackSegment.TrackEndMiddlePoint;
+			Segment.i_min = FMath::Max(0, FMath::FloorToInt((FMath::Min(Segment.Start.X, Segment.End.X) - Radius) / UnitSize));
+			Segment.i_max = FMath::Min(GridSize - 1, FMath::CeilToInt((FMath::Max(Segment.Start.X, Segment.End.X) + Radius) / UnitSize));
+			Segment.j_min = FMath::Max(0, FMath::FloorToInt((FMath::Min(Segment.Start.Y, Segment.End.Y) - Radius) / UnitSize));
+			Segment.j_max = FMath::Min(GridSize - 1, FMath::CeilToInt((FMath::Max(Segment.Start.Y, Segment.End.Y) + Radius) / UnitSize));
+			if (Segment.i_min > Segment.i_max || Segment.j_min > Segment.j_max) { continue; }
+			Centerline.Add(Segment);
+		}
+
+		const float SquaredRadius = Radius * Radius;
+		ParallelFor(GridSize, [&](int32 i)
+		{
+			const float X = i * UnitSize;
+			for (const FCenterlineSegment& Segment : Centerline)
+			{
+				if (i < Segment.i_min || i > Segment.i_max) { continue; }
+
+				const FVector2D Start = FVector2D(Segment.Start);
+				const FVector2D Direction = FVector2D(Segment.End) - Start;
+				const float SquaredLength = Direction.SizeSquared();
+
+				for (int32 j = Segment.j_min; j <= Segment.j_max; ++j)
+				{
+					const FVector2D Pt = FVector2D(X, j * UnitSize);
+					// position of the nearest point on the segment
+					const float Alpha = SquaredLength > KINDA_SMALL_NUMBER ? FMath::Clamp(FVector2D::DotProduct(Pt - Start, Direction) / SquaredLength, 0.f, 1.f) : 0.f;
+					const float SquaredDistance = FVector2D::DistSquared(Pt, Start + Alpha * Direction);
+					const int32 Index = i * GridSize + j;
+					if (SquaredDistance > SquaredRadius || SquaredDistance >= SquaredDistances[Index]) { continue; }
+					SquaredDistances[Index] = SquaredDistance;
+					Elevations[Index] = FMath::Lerp(Segment.Start.Z, Segment.End.Z, Alpha);
+				}
+			}
+		});
+	}
+
+	/**
+	 * calculates the track constraints of all lattice points of the field
+	 * points within HalfWidth of the centerline lie ElevationOffset below the track, further out the offset grows smoothly by up to FalloffDepth at HalfWidth + FalloffWidth
+	 * points on the tile's borders are only constrained under the track itself, the rest of the border is defined by the adjacent tiles
+	 * @param HalfWidth Half of the track's width
+	 * @param FalloffWidth Width of the band next to the track that is still constrained
+	 * @param FalloffDepth Additional offset of the terrain at the outer edge of the falloff band
+	 * @param ElevationOffset Offset between track and terrain
+	 * @param OUTPointsOnTrack The constrained points with their elevation
+	 */
+	void GetTrackConstraints(const float HalfWidth, const float FalloffWidth, const float FalloffDepth, const float ElevationOffset, TArray<FVector>& OUTPointsOnTrack) const
+	{
+		const float SquaredBorderRadius = FMath::Square(HalfWidth + UnitSize);
+		for (int32 i = 0; i < GridSize; ++i)
+		{
+			const bool bIsBorderRow = (i == 0) || (i == GridSize - 1);
+			for (int32 j = 0; j < GridSize; ++j)
+			{
+				const int32 Index = i * GridSize + j;
+				const float SquaredDistance = SquaredDistances[Index];
+				if (SquaredDistance == MAX_flt) { continue; }
+				if ((bIsBorderRow || j == 0 || j == GridSize - 1) && SquaredDistance > SquaredBorderRadius) { continue; }
+
+				float Offset = ElevationOffset;
+				const float Distance = FMath::Sqrt(SquaredDistance);
+				if (Distance > HalfWidth && FalloffWidth > 0.f)
+				{
+					Offset += FalloffDepth * FMath::SmoothStep(0.f, 1.f, (Distance - HalfWidth) / FalloffWidth);
+				}
+				OUTPointsOnTrack.Add(FVector(i * UnitSize, j * UnitSize, Elevations[Index] - Offset));
+			}
+		}
+	}
+};
+
 /**
  * struct for fractal noise terrain generation settings
  * to be used as subcategory in FTerrainSettings
- * all parameters are used as suggested in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+ * all parameters are used as suggested in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
  */
 USTRUCT(BlueprintType)
 struct FFractalNoiseTerrainSettings
@@ -1453,12 +1687,43 @@ struct FTrackGenerationSettings
 	GENERATED_USTRUCT_BODY()
 
 	/**
-	 * defines how many points on the Bzier curve should be calculated
+	 * defines how many points on the Bézier curve should be calculated
 	 * a higher number creates a smoother mesh, but also increases performance costs
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 TrackResolution = 20;
 
+	/**
+	 * true if the points on the bezier curve should be placed depending on the curve's curvature and elevation change instead of evenly by TrackResolution
+	 * the first and the last segment of every sector keep the length they have with TrackResolution, so the track's entry and exit direction do not change
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bAdaptiveTrackSampling = true;
+
+	/**
+	 * segments shorter than this are never split when sampling the track adaptively
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float MinimumTrackSegmentLength = 1000.f;
+
+	/**
+	 * segments longer than this are always split when sampling the track adaptively
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float MaximumTrackSegmentLength = 8000.f;
+
+	/**
+	 * maximum horizontal distance between the bezier curve and a track segment when sampling the track adaptively
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TrackSamplingTolerance = 50.f;
+
+	/**
+	 * maximum elevation difference between the bezier curve and a track segment when sampling the track adaptively
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TrackSamplingElevationTolerance = 50.f;
+
 	/**
 	 * the overall track width in cm
 	 */
@@ -1536,10 +1801,30 @@ struct FTrackGenerationSettings
 	float Steepness_Deviation = 0.2f;
 
 	/**
-	 * error tolerance for calculation if a point is inside the quad defined by a track segment's start and end line 
+	 * true if the track constraints should be calculated from a distance field of the track's centerline in one pass instead of segment by segment
+	 * bUseTightTrackBoundingBox is not used by the distance field
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseTrackCorridorField = true;
+
+	/**
+	 * how many sectors ahead the track planning looks for a continuation before it chooses the following sector
+	 * only directions that can be continued the longest are chosen, so the track does not run into dead ends between tiles without track, 0 to choose any free direction
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TrackPlanningSearchDepth = 4;
+
+	/**
+	 * width of the band next to the track whose terrain is still constrained by the track's distance field
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float TrackCorridorFalloffWidth = 300.f;
+
+	/**
+	 * how much deeper than TrackElevationOffset the terrain lies below the track at the outer edge of the falloff band, the depth grows smoothly from the track's edge
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
-	float PointInsideErrorTolerance = 100.f;
+	float TrackCorridorFalloffDepth = 50.f;
 };
 
 
@@ -1559,6 +1844,7 @@ struct FTerrainSettings
 
 	/**
 	 * Track segment to spawn player at (0-based)
+	 * segments are counted as if the start sector's track was sampled evenly by TrackResolution, also with bAdaptiveTrackSampling, so it has to be less than TrackResolution - 1
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
 	int32 TrackSegmentToSpawnPlayerAt = 0;
@@ -1696,7 +1982,7 @@ struct FTerrainSettings
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 TilesToBeCreatedAroundActorRadius = 3;
 
-	//Time in seconds after which a freed tile should be deleted
+	// time in seconds a freed tile has to be unused before it may be deleted when the tile pool shrinks
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float SecondsUntilFreeTileGetsDeleted = 30.f;
 
@@ -1704,13 +1990,426 @@ struct FTerrainSettings
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	int32 NumberOfThreadsToUse = 1;
 
-	// how many meshes should be updated per frame
+	/**
+	 * true if the track should be planned ahead on its own thread, so the game thread only takes planned sectors when tracked actors change sectors
+	 * the planned track is the same as without the thread, tiles of sectors the thread did not plan yet wait for it instead of being planned on the game thread
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bPlanTrackInBackground = true;
+
+	// how many sectors the track planning thread plans ahead of the last sector the game thread took
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TrackPlanningLookahead = 16;
+
+	// how many meshes should be updated per frame
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 MeshUpdatesPerFrame = 8;
 
+	/**
+	 * number of actors that are expected to be tracked at the same time
+	 * used together with TilesToBeCreatedAroundActorRadius to pre-warm the tile pool on BeginPlay
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 ExpectedNumberOfTrackedActors = 1;
+
+	/**
+	 * number of tiles the tile pool holds on top of the tiles needed by the expected tracked actors
+	 * a sector change of a tracked actor needs up to (2*n + 1) new tiles before the old ones are freed, so this should be at least that number
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 AdditionalPooledTiles = 7;
+
+	/**
+	 * number of tiles the tile pool may exceed its target size before free tiles get deleted
+	 * once the pool starts shrinking, it shrinks back to its target size
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 TilePoolShrinkHysteresis = 7;
+
+	/**
+	 * number of tiles that get created at once when the tile pool runs empty
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1"))
+	int32 TilePoolGrowBatchSize = 7;
+
+	/**
+	 * distance in cm a tracked actor has to move past the border of its current sector before it counts as having changed sector
+	 * prevents tiles from being freed and regenerated over and over when an actor moves along a sector border
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	float SectorChangeHysteresis = 4096.f;
+
+	/**
+	 * number of tiles that are kept intact (mesh, borders and checkpoint) after no tracked actor needs them anymore
+	 * when an actor returns to one of these sectors, the retained tile is shown again instead of generating a new one
+	 * the oldest retained tile gets freed when this number is exceeded, 0 disables tile retention
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 NumberOfRetainedTiles = 14;
+
+	/**
+	 * memory budget in megabytes for the cache of generated tiles
+	 * freed tiles are served from this cache when their sector is needed again (e.g. on resets or backtracking), 0 disables the cache
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 TileCacheBudgetMegabytes = 256;
+
+	/**
+	 * if true, a new seed is chosen on every BeginPlay and Seed is overwritten with it
+	 * disable to generate the same track and terrain in every session (e.g. for time trials)
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseRandomSeed = true;
+
+	/**
+	 * seed for track planning and terrain generation, only used if bUseRandomSeed is false
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "!bUseRandomSeed"))
+	int32 Seed = 0;
+
+	/**
+	 * if true, generated tiles are written to a cache file in the project's saved directory when the game ends
+	 * and are read from it in the next session with the same seed and settings instead of being generated again
+	 * only used if bUseRandomSeed is false, since tiles of random seeds would never be reused, so it has no effect with the default settings
+	 * the same seed does not reproduce the same track, it depends on blocked sectors and on how far the player got,
+	 * so only tiles without track and tiles whose track was planned the same way again are read from the cache, see FSectorTrackInfo::CalculateTrackHash
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "!bUseRandomSeed"))
+	bool bUsePersistentTileCache = true;
+
+	/**
+	 * if true, the quantized elevations of queued and cached tiles are delta encoded, which roughly halves their size but makes expansion slower
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bDeltaEncodeTileHeights = true;
+
+	/**
+	 * if true, queued and cached tiles store their normals, otherwise the normals are recalculated from the elevations when the tile is expanded
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bStoreTileNormals = false;
+
+	/**
+	 * tiles up to this many sectors (chebyshev distance) away from the nearest tracked actor are generated with all TriangleEdgeIterations
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 FullDetailTileRadius = 1;
+
+	/**
+	 * number of triangle edge iterations a tile loses for every sector it lies beyond FullDetailTileRadius
+	 * every iteration less quarters the number of triangles of the tile, 0 disables the distance based level of detail
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	int32 TileDetailReductionPerSector = 2;
+
+	/**
+	 * the lowest number of triangle edge iterations a tile is generated with
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1"))
+	int32 MinimumTileTriangleEdgeIterations = 2;
+
+	/**
+	 * if true, tiles that contain the track are always generated with all TriangleEdgeIterations, so the coarse terrain cannot cut through the track
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bFullDetailTrackTiles = true;
+
+	/**
+	 * depth in cm of the skirts that hang down from the borders of reduced detail tiles
+	 * a finer neighbor generated before a coarser tile has vertices between the coarse border vertices, the skirts hide the resulting gaps
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0"))
+	float TileSkirtDepth = 2048.f;
+
+	/**
+	 * if true, new tiles are first generated and shown with PreviewTriangleEdgeIterations
+	 * the workers refine them to their full detail once every queued tile got its preview, so no holes appear while the workers are busy
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bProgressiveTileGeneration = true;
+
+	/**
+	 * number of triangle edge iterations of the preview of a tile, see bProgressiveTileGeneration
+	 * the refined tile keeps all grid points of the preview, so borders without an adjacent tile stay as detailed as the preview's
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bProgressiveTileGeneration"))
+	int32 PreviewTriangleEdgeIterations = 4;
+
+	/**
+	 * if true, the terrain mesh of a tile uses large triangles where the terrain is flat, see FTerrainHeightfield::BuildAdaptiveMeshData
+	 * the tile borders and the area around the track always keep full resolution
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bAdaptiveTileTessellation = true;
+
+	/**
+	 * largest elevation difference in cm between a grid point of a tile and the large triangles it gets replaced by, see bAdaptiveTileTessellation
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0", EditCondition = "bAdaptiveTileTessellation"))
+	float AdaptiveTessellationTolerance = 50.f;
+
+	/**
+	 * if true, a tile that has to match a changed adjacent border (e.g. the tile behind the track's start point) only recalculates a band along this border,
+	 * see FTerrainHeightfield::ApplyBorderConstraints, and only uploads the changed vertices instead of generating the whole tile again
+	 * tiles with track are always generated again, since the band could move the terrain below the track
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bIncrementalBorderRegeneration = true;
+
+	/**
+	 * number of grid rows along a changed border that get recalculated, see bIncrementalBorderRegeneration
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bIncrementalBorderRegeneration"))
+	int32 BorderRegenerationBandWidth = 16;
+
+	/**
+	 * if true, the collision of a tile's terrain is built from a coarser level of its heightfield instead of the rendered terrain mesh,
+	 * see FTerrainHeightfield::BuildCollisionMeshData, only the area around the track keeps full resolution for the hover traces
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bLowResolutionTileCollision = true;
+
+	/**
+	 * number of quadtree levels the collision of a tile is coarser than its heightfield, every level quarters the collision triangles outside the track area
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0", UIMax = "6", EditCondition = "bLowResolutionTileCollision"))
+	int32 TileCollisionReductionLevels = 2;
+
+	/**
+	 * if true, the collision of a tile's terrain is a heightfield shape of the physics engine with all grid points of the tile, see UTerrainHeightfieldCollisionComponent
+	 * the heightfield needs no cooking and less memory than a triangle mesh, replaces bLowResolutionTileCollision
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bHeightfieldTileCollision = false;
+
+	/**
+	 * if true, a ring of very coarse terrain is shown around the tiles up to HorizonRadius sectors away from every tracked actor
+	 * the horizon is generated on the game thread with the same generator as the tiles and merged into a few mesh sections of the terrain manager
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseHorizon = true;
+
+	/**
+	 * number of sectors (chebyshev distance) around every tracked actor that are covered by the horizon, sectors covered by tiles are left out
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bUseHorizon"))
+	int32 HorizonRadius = 10;
+
+	/**
+	 * number of triangle edge iterations of a horizon sector, every sector of the horizon has 2 * 4^HorizonTriangleEdgeIterations triangles
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bUseHorizon"))
+	int32 HorizonTriangleEdgeIterations = 1;
+
+	/**
+	 * number of sectors per edge of a horizon chunk, every chunk is one mesh section that gets rebuilt when one of its sectors changes
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bUseHorizon"))
+	int32 HorizonChunkSize = 4;
+
+	/**
+	 * maximum number of horizon sectors that get generated per frame
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bUseHorizon"))
+	int32 HorizonCellsPerFrame = 16;
+
+	/**
+	 * maximum number of horizon chunks that get rebuilt and uploaded per frame
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bUseHorizon"))
+	int32 HorizonChunksPerFrame = 2;
+
+	/**
+	 * depth in cm of the skirts below the border of every horizon sector, hides the gaps to tiles and to other horizon sectors
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "0", UIMin = "0", EditCondition = "bUseHorizon"))
+	float HorizonSkirtDepth = 8192.f;
+
+	/**
+	 * calculates the number of triangle edge iterations for a tile the given number of sectors away from the nearest tracked actor
+	 */
+	int32 CalculateTileTriangleEdgeIterations(const int32 SectorDistance) const
+	{
+		const int32 FullIterations = FractalNoiseTerrainSettings.TriangleEdgeIterations;
+		const int32 Reduction = FMath::Max(SectorDistance - FullDetailTileRadius, 0) * FMath::Max(TileDetailReductionPerSector, 0);
+		return FMath::Clamp(FullIterations - Reduction, FMath::Min(FMath::Max(MinimumTileTriangleEdgeIterations, 1), FullIterations), FullIterations);
+	}
+
+	/**
+	 * depth of the skirts below the borders of a tile with the given number of grid points per edge, see TileSkirtDepth
+	 * reduced detail tiles get skirts, since finer neighbors may have border vertices between theirs
+	 */
+	float CalculateTileSkirtDepth(const int32 GridSize) const
+	{
+		const int32 FullDetailGridSize = (1 << (FractalNoiseTerrainSettings.TriangleEdgeIterations + 1)) + 1;
+		return GridSize < FullDetailGridSize ? TileSkirtDepth : 0.f;
+	}
+
+	/**
+	 * calculates a hash of all settings that influence the generated terrain and track
+	 * two settings with the same hash generate the same kind of tiles, so cached tiles can only be reused for the same hash
+	 */
+	uint32 CalculateGenerationSettingsHash() const
+	{
+		uint32 Hash = GetTypeHash(TileEdgeSize);
+		Hash = HashCombine(Hash, GetTypeHash(Point1Elevation));
+		Hash = HashCombine(Hash, GetTypeHash(Point2Elevation));
+		Hash = HashCombine(Hash, GetTypeHash(Point3Elevation));
+		Hash = HashCombine(Hash, GetTypeHash(Point4Elevation));
+		Hash = HashCombine(Hash, GetTypeHash(Point5Elevation));
+		Hash = HashCombine(Hash, GetTypeHash(TerrainMaterialTransitionLowMediumElevation));
+		Hash = HashCombine(Hash, GetTypeHash(TerrainMaterialTransitionMediumHighElevation));
+		Hash = HashCombine(Hash, GetTypeHash(TransitionElevationVariationMediumHigh));
+		Hash = HashCombine(Hash, GetTypeHash(TransitionElevationVariationLowMedium));
+
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.rt));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.rs));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.n));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.H));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.I));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.I_bu));
+		Hash = HashCombine(Hash, GetTypeHash(FractalNoiseTerrainSettings.TriangleEdgeIterations));
+		Hash = HashCombine(Hash, GetTypeHash(bProgressiveTileGeneration ? PreviewTriangleEdgeIterations : 0));
+		// cached tiles keep the quadtrees of their terrain and collision meshes, see FCompactTerrainTile::QuadLevels
+		Hash = HashCombine(Hash, GetTypeHash(bAdaptiveTileTessellation ? AdaptiveTessellationTolerance : -1.f));
+		Hash = HashCombine(Hash, GetTypeHash(bLowResolutionTileCollision && !bHeightfieldTileCollision ? TileCollisionReductionLevels : -1));
+
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackResolution));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.bAdaptiveTrackSampling ? 1 : 0));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.MinimumTrackSegmentLength));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.MaximumTrackSegmentLength));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackSamplingTolerance));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackSamplingElevationTolerance));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackWidth));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.bUseTightTrackBoundingBox ? 1 : 0));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.MaximumElevationDifference));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.DefaultEntryPointHeight));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackElevationOffset));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.CURVINESS_MEAN));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.CurvinessDisplacement));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.CurvinessRotation));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.MaximumRotationAngle));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.Hilliness));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.Steepness_Mean));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.Steepness_Deviation));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.bUseTrackCorridorField ? 1 : 0));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackPlanningSearchDepth));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackCorridorFalloffWidth));
+		Hash = HashCombine(Hash, GetTypeHash(TrackGenerationSettings.TrackCorridorFalloffDepth));
+		return Hash;
+	}
+
 
 };
 
+/**
+ * packed vertex of the terrain and track mesh sections, 24 bytes instead of the 32 bytes of FRuntimeMeshVertexSimple
+ * every vertex used to carry the same white color, which is dropped (the runtime mesh component then uses white for the whole section),
+ * normal and tangent are packed into 4 bytes each and the texture coordinates are stored as half floats
+ * the tangent is the same for every vertex but stays in the vertex, since the vertex factory needs a complete tangent basis
+ */
+struct FTerrainVertex
+{
+	FVector Position;
+
+	FPackedNormal Normal;
+
+	FPackedNormal Tangent;
+
+	FVector2DHalf UV0;
+
+	FTerrainVertex() {}
+
+	/**
+	 * creates a vertex with the tangent all terrain and track vertices use and texture coordinates derived from the position
+	 */
+	FTerrainVertex(const FVector& InPosition, const FVector& InNormal)
+		: FTerrainVertex(InPosition, InNormal, FVector2D(InPosition.X / 500.f, InPosition.Y / 500.f))
+	{}
+
+	FTerrainVertex(const FVector& InPosition, const FVector& InNormal, const FVector2D& InUV0)
+		: Position(InPosition)
+		, Normal(InNormal)
+		, Tangent(FVector(0.f, -1.f, 0.f))
+		, UV0(InUV0)
+	{
+		// sign of the binormal, same as FRuntimeMeshTangent(0.f, -1.f, 0.f) without flipped Y
+		Normal.Vector.W = 255;
+	}
+
+	// layout of the vertex for the runtime mesh component
+	static FRuntimeMeshVertexStreamStructure GetVertexStructure()
+	{
+		FRuntimeMeshVertexStreamStructure VertexStructure;
+		VertexStructure.Position = RUNTIMEMESH_VERTEXSTREAMCOMPONENT(FTerrainVertex, Position, VET_Float3);
+		VertexStructure.Normal = RUNTIMEMESH_VERTEXSTREAMCOMPONENT(FTerrainVertex, Normal, VET_PackedNormal);
+		VertexStructure.Tangent = RUNTIMEMESH_VERTEXSTREAMCOMPONENT(FTerrainVertex, Tangent, VET_PackedNormal);
+		VertexStructure.UVs.Add(RUNTIMEMESH_VERTEXSTREAMCOMPONENT(FTerrainVertex, UV0, VET_Half2));
+		return VertexStructure;
+	}
+};
+
+/**
+ * consecutive vertices of a mesh section's vertex buffer
+ */
+USTRUCT()
+struct FMeshVertexRange
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	int32 FirstVertex = 0;
+
+	UPROPERTY()
+	int32 NumVertices = 0;
+
+	FMeshVertexRange() {}
+
+	FMeshVertexRange(const int32 InFirstVertex, const int32 InNumVertices)
+		: FirstVertex(InFirstVertex), NumVertices(InNumVertices)
+	{}
+};
+
+/**
+ * heights of a tile's grid points for a heightfield collision shape, see UTerrainHeightfieldCollisionComponent
+ * heights are quantized to 16 bit around HeightOffset, the format the physics engine uses for heightfields
+ */
+USTRUCT()
+struct FTerrainCollisionHeightfield
+{
+	GENERATED_USTRUCT_BODY()
+
+	// number of grid points per tile edge
+	UPROPERTY()
+	int32 GridSize = 0;
+
+	// distance between two adjacent grid points
+	UPROPERTY()
+	float UnitSize = 0.f;
+
+	// elevation in cm of one step of the quantized heights
+	UPROPERTY()
+	float HeightScale = 1.f;
+
+	// elevation in cm of the quantized height 0
+	UPROPERTY()
+	float HeightOffset = 0.f;
+
+	// quantized elevation for every grid point, index is X * GridSize + Y like in FTerrainHeightfield
+	UPROPERTY()
+	TArray<int16> Heights;
+
+	bool IsValid() const
+	{
+		return GridSize > 1 && UnitSize > 0.f && HeightScale > 0.f && Heights.Num() == GridSize * GridSize;
+	}
+
+	float GetHeight(const int32 Index) const
+	{
+		return HeightOffset + Heights[Index] * HeightScale;
+	}
+};
+
 /**
  * struct for vertex and triangle buffer
  */
@@ -1720,12 +2419,230 @@ struct FMeshData
 	GENERATED_USTRUCT_BODY()
 
 	// vertex buffer
-	TArray<FRuntimeMeshVertexSimple> VertexBuffer;
+	TArray<FTerrainVertex> VertexBuffer;
 
 	// triangle buffer
 	UPROPERTY()
 	TArray<int32> TriangleBuffer;
 
+	// if false, the mesh section is only rendered and the collision comes from elsewhere, e.g. the tile's collision mesh
+	UPROPERTY()
+	bool bCreateCollision = true;
+
+	/**
+	 * compares the vertices with the vertices of a previous version of the same mesh
+	 * ranges of changed vertices that are at most MaximumGap vertices apart are merged, so the ranges can be uploaded with few updates
+	 * @return False if the triangle buffers differ, the whole mesh has to be updated then
+	 */
+	bool GetChangedVertexRanges(const FMeshData& Previous, TArray<FMeshVertexRange>& OUTRanges, const int32 MaximumGap = 16) const
+	{
+		OUTRanges.Reset();
+		if (VertexBuffer.Num() != Previous.VertexBuffer.Num() || TriangleBuffer != Previous.TriangleBuffer) { return false; }
+
+		for (int32 i = 0; i < VertexBuffer.Num(); ++i)
+		{
+			const FTerrainVertex& Vertex = VertexBuffer[i];
+			const FTerrainVertex& PreviousVertex = Previous.VertexBuffer[i];
+			if (Vertex.Position == PreviousVertex.Position && Vertex.Normal == PreviousVertex.Normal) { continue; }
+
+			if (OUTRanges.Num() > 0 && i - (OUTRanges.Last().FirstVertex + OUTRanges.Last().NumVertices) <= MaximumGap)
+			{
+				OUTRanges.Last().NumVertices = i - OUTRanges.Last().FirstVertex + 1;
+			}
+			else
+			{
+				OUTRanges.Add(FMeshVertexRange(i, 1));
+			}
+		}
+		return true;
+	}
+
+	bool CanUse16BitIndices() const
+	{
+		return VertexBuffer.Num() <= MAX_uint16 + 1;
+	}
+
+	/**
+	 * copies the triangle buffer into a buffer of 16 bit indices, which halves the size of the index buffer on the gpu
+	 * @return False if not all vertices can be addressed with 16 bit, OUTTriangleBuffer is empty then
+	 */
+	bool GetTriangleBuffer16(TArray<uint16>& OUTTriangleBuffer) const
+	{
+		OUTTriangleBuffer.Reset();
+		if (!CanUse16BitIndices()) { return false; }
+		OUTTriangleBuffer.SetNumUninitialized(TriangleBuffer.Num());
+		for (int32 i = 0; i < TriangleBuffer.Num(); ++i)
+		{
+			OUTTriangleBuffer[i] = static_cast<uint16>(TriangleBuffer[i]);
+		}
+		return true;
+	}
+
+	/**
+	 * simulates a FIFO post transform vertex cache of the given size and returns the average cache miss ratio,
+	 * i.e. the number of transformed vertices per triangle
+	 * 3 means no vertex is reused, a regular grid can get close to 0.5
+	 */
+	float CalculateACMR(const int32 CacheSize = 16) const
+	{
+		const int32 NumberOfTriangles = TriangleBuffer.Num() / 3;
+		if (NumberOfTriangles == 0 || CacheSize <= 0) { return 0.f; }
+
+		// position of every vertex in the stream of cache misses, a vertex is cached if it missed at most CacheSize misses ago
+		TArray<int32> MissPositions;
+		MissPositions.Init(INDEX_NONE, VertexBuffer.Num());
+		int32 Misses = 0;
+		for (const int32 VertexIndex : TriangleBuffer)
+		{
+			if (!MissPositions.IsValidIndex(VertexIndex)) { continue; }
+			if (MissPositions[VertexIndex] == INDEX_NONE || Misses - MissPositions[VertexIndex] > CacheSize)
+			{
+				MissPositions[VertexIndex] = Misses;
+				Misses++;
+			}
+		}
+		return static_cast<float>(Misses) / NumberOfTriangles;
+	}
+
+};
+
+/**
+ * compact representation of a tile's terrain that is used while the tile is queued or cached
+ * elevations are quantized to 16 bit relative to the tile's lowest elevation, the border strips are kept exact
+ * since adjacent tiles use them as constraints, normals are either stored octahedral encoded or recalculated on expansion
+ * encoded and expanded by FTerrainHeightfield, the terrain mesh section is only created right before the tile's mesh is uploaded
+ */
+USTRUCT()
+struct FCompactTerrainTile
+{
+	GENERATED_USTRUCT_BODY()
+
+	// number of grid points per tile edge, 0 if the tile was not encoded
+	UPROPERTY()
+	int32 GridSize = 0;
+
+	// distance between two adjacent grid points
+	UPROPERTY()
+	float UnitSize = 0.f;
+
+	// a quantized elevation Q decodes to MinHeight + Q * HeightStep
+	UPROPERTY()
+	float MinHeight = 0.f;
+
+	UPROPERTY()
+	float HeightStep = 0.f;
+
+	// if true, HeightData contains the residuals of a planar prediction as variable length integers, otherwise 16 bit values
+	UPROPERTY()
+	bool bIsDeltaEncoded = false;
+
+	// quantized elevations of all grid points
+	UPROPERTY()
+	TArray<uint8> HeightData;
+
+	// two octahedral encoded 8 bit components per grid point, empty if the normals are recalculated on expansion
+	UPROPERTY()
+	TArray<int8> NormalData;
+
+	// exact elevations of the left (Y = 0), right (Y = max), bottom (X = 0) and top (X = max) border, GridSize values each
+	UPROPERTY()
+	TArray<float> BorderHeights;
+
+	/**
+	 * level of the quad every leaf block (2x2 grid cells) of the adaptive terrain mesh belongs to, a quad of level L is 2^(L + 1) grid units large
+	 * calculated by the worker threads, so the terrain mesh section is only expanded from it, see FTerrainHeightfield::CalculateAdaptiveQuadLevels
+	 * empty if the terrain mesh section uses the uniform grid
+	 */
+	UPROPERTY()
+	TArray<uint8> QuadLevels;
+
+	// the same for the low resolution collision mesh, see FTerrainHeightfield::CalculateCollisionQuadLevels, empty if the tile has no low resolution collision
+	UPROPERTY()
+	TArray<uint8> CollisionQuadLevels;
+
+	bool IsValid() const
+	{
+		return GridSize > 1 && BorderHeights.Num() == 4 * GridSize;
+	}
+
+	/**
+	 * the largest difference between an original and an expanded elevation that the quantization allows
+	 */
+	float GetMaximumHeightError() const
+	{
+		return HeightStep * 0.5f;
+	}
+
+	/**
+	 * calculates the memory used by the compact tile in bytes
+	 */
+	int64 GetAllocatedSize() const
+	{
+		return sizeof(FCompactTerrainTile) + HeightData.GetAllocatedSize() + NormalData.GetAllocatedSize() + BorderHeights.GetAllocatedSize() + QuadLevels.GetAllocatedSize() + CollisionQuadLevels.GetAllocatedSize();
+	}
+};
+
+/**
+ * struct for storing a border vertex along with its normal
+ */
+USTRUCT()
+struct FBorderVertex
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	FVector Position;
+
+	UPROPERTY()
+	FVector Normal;
+
+	FBorderVertex()
+	{
+		Position = FVector();
+		Normal = FVector();
+	}
+
+	FBorderVertex(const FVector VertexPosition, const FVector VertexNormal)
+	{
+		Position = VertexPosition;
+		Normal = VertexNormal;
+	}
+
+	FBorderVertex(const FVector VertexPosition)
+	{
+		Position = VertexPosition;
+		Normal = FVector();
+	}
+};
+
+/**
+ * copy of the border a finished tile shares with an adjacent sector, used as border constraint for the terrain of that sector
+ */
+USTRUCT()
+struct FAdjacentTileBorder
+{
+	GENERATED_USTRUCT_BODY()
+
+	// sector of the tile the border belongs to
+	UPROPERTY()
+	FIntVector2D Sector;
+
+	// the tile's border vertices on the shared edge
+	UPROPERTY()
+	TArray<FBorderVertex> Vertices;
+
+	// corners of the tile
+	UPROPERTY()
+	FVector BottomLeftCorner;
+
+	UPROPERTY()
+	FVector BottomRightCorner;
+
+	UPROPERTY()
+	FVector TopRightCorner;
+
+	UPROPERTY()
+	FVector TopLeftCorner;
 };
 
 /**
@@ -1756,12 +2673,287 @@ struct FTerrainJob
 	UPROPERTY()
 	TArray<FMeshData> MeshData;
 
+	// the terrain section while the job is queued, expanded into MeshData right before the mesh is uploaded
+	UPROPERTY()
+	FCompactTerrainTile CompactTerrain;
+
+	// largest elevation difference between the generated and the compact terrain, -1 if it was not checked
+	UPROPERTY()
+	float CompactTerrainHeightError = -1.f;
+
+	/**
+	 * number of triangle edge iterations the terrain is generated with, fewer than FFractalNoiseTerrainSettings::TriangleEdgeIterations for distant tiles
+	 * 0 if the job was queued without a level of detail, the worker then uses all iterations
+	 */
+	UPROPERTY()
+	int32 TriangleEdgeIterations = 0;
+
+	// time in milliseconds the worker needed to generate the terrain
+	UPROPERTY()
+	float GenerationTime = 0.f;
+
+	// time in milliseconds the worker needed to calculate the quadtree of the adaptive terrain mesh, part of GenerationTime
+	UPROPERTY()
+	float TessellationTime = 0.f;
+
+	// average cache miss ratio of the terrain mesh section, measured by the worker in development builds, -1 if it was not measured
+	UPROPERTY()
+	float TerrainACMR = -1.f;
+
+	// number of triangle edge iterations of a coarse preview the worker publishes before the terrain is generated with all iterations, 0 for no preview
+	UPROPERTY()
+	int32 PreviewTriangleEdgeIterations = 0;
+
+	// true if this is the coarse preview of a job whose refined version follows
+	UPROPERTY()
+	bool bIsPreview = false;
+
+	// game time in seconds when the job was queued
+	UPROPERTY()
+	float QueuedTime = 0.f;
+
+	// the sector the terrain tile was assigned to when the job was queued
+	UPROPERTY()
+	FIntVector2D Sector;
+
+	// serial of the job among the jobs of its tile, the job is outdated once the tile got a newer job or was freed, see ATerrainTile::GetLatestJobSerial
+	UPROPERTY()
+	int32 JobSerial = 0;
+
+	// true if the mesh data was taken from the tile cache instead of being generated
+	UPROPERTY()
+	bool bServedFromCache = false;
+
+	// low resolution collision mesh of the terrain in tile space, empty if the terrain mesh section creates its own collision
+	UPROPERTY()
+	TArray<FVector> CollisionVertices;
+
+	UPROPERTY()
+	TArray<int32> CollisionTriangles;
+
+	// heightfield collision of the terrain, invalid if the terrain has no heightfield collision
+	UPROPERTY()
+	FTerrainCollisionHeightfield CollisionHeightfield;
+
+	// track info of the sector when the job was queued, the worker builds the track mesh from it
+	UPROPERTY()
+	FSectorTrackInfo TrackInfo;
+
+	// track info of the sector before it on the track
+	UPROPERTY()
+	FSectorTrackInfo PreviousTrackInfo;
+
+	// borders of retained tiles next to the sector, copied when the job was queued since the game thread frees retained tiles at any time
+	UPROPERTY()
+	TArray<FAdjacentTileBorder> RetainedTileBorders;
+
 	FTerrainJob()
 	{
 		MeshData.Init(FMeshData(), 4);
 	}
 };
 
+/**
+ * statistics of the terrain manager's tile pool
+ */
+USTRUCT(BlueprintType)
+struct FTilePoolStatistics
+{
+	GENERATED_USTRUCT_BODY()
+
+	// number of times a free tile could be taken from the pool
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PoolHits = 0;
+
+	// number of times the pool was empty and new tiles had to be spawned
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PoolMisses = 0;
+
+	// number of tile actors spawned since BeginPlay (including pre-warming)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TilesSpawned = 0;
+
+	// number of tile actors destroyed because the pool shrunk
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TilesDestroyed = 0;
+
+	// highest number of tiles that were in use at the same time
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PeakTilesInUse = 0;
+
+	// number of tiles currently in use
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TilesInUse = 0;
+
+	// number of tiles currently waiting in the pool
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 FreeTiles = 0;
+
+	// number of times a sector could be covered by a retained tile without generating terrain
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 RetentionHits = 0;
+
+	// number of tiles currently kept intact in the retention ring
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 RetainedTiles = 0;
+
+	// number of tiles the pool currently tries to hold
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TargetPoolSize = 0;
+
+	// number of terrain jobs that were served from the tile cache
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TileCacheHits = 0;
+
+	// number of terrain jobs that had to be generated because the tile cache did not contain the sector
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TileCacheMisses = 0;
+
+	// number of tiles currently stored in the tile cache
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 TileCacheEntries = 0;
+
+	// memory currently used by the tile cache in bytes
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int64 TileCacheBytes = 0;
+
+	// number of terrain jobs that were served from the persistent tile cache file
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PersistentTileCacheHits = 0;
+
+	// number of tiles currently stored in the persistent tile cache (file and not yet written tiles)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PersistentTileCacheEntries = 0;
+
+	// number of generated tiles that were encoded into compact tiles
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 CompactTiles = 0;
+
+	// average size of a compact terrain tile in bytes
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageCompactTileBytes = 0;
+
+	// average size of an expanded terrain mesh section in bytes
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageExpandedTileBytes = 0;
+
+	// largest elevation difference between a generated and its compact tile, measured in non shipping builds
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float MaximumCompactTileHeightError = 0.f;
+
+	// number of generated tiles with fewer triangle edge iterations than the full detail tiles
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 ReducedDetailTiles = 0;
+
+	// number of tiles that were generated again with more detail because a tracked actor came closer
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 RefinedTiles = 0;
+
+	// average number of terrain triangles of a generated full detail tile
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageFullDetailTileTriangles = 0;
+
+	// average number of terrain triangles of a generated reduced detail tile (including skirts)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageReducedDetailTileTriangles = 0;
+
+	// average time in milliseconds a worker needed to generate a full detail tile
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageFullDetailTileGenerationTime = 0.f;
+
+	// average time in milliseconds a worker needed to generate a reduced detail tile
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageReducedDetailTileGenerationTime = 0.f;
+
+	// number of coarse previews that were shown until the refined tile was generated
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 PreviewTiles = 0;
+
+	// average time in milliseconds from queuing a new tile to showing its first terrain (preview or refined)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageTimeToFirstTerrain = 0.f;
+
+	// number of finished jobs that were discarded because their tile was freed or moved in the meantime
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 DiscardedJobs = 0;
+
+	// number of tiles whose terrain mesh was built with adaptive tessellation
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AdaptiveTiles = 0;
+
+	// number of tiles that only recalculated a band along their changed borders instead of being generated again
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 IncrementalBorderRegenerations = 0;
+
+	// number of bytes of mesh data uploaded by incremental border regenerations
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 IncrementallyUploadedBytes = 0;
+
+	// average percentage of terrain triangles adaptive tessellation saved compared to the uniform grid
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageAdaptiveTriangleReduction = 0.f;
+
+	// average time in milliseconds to build the terrain mesh of a tile with adaptive tessellation
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageAdaptiveTessellationTime = 0.f;
+
+	// number of tiles whose terrain collision was built from a coarser level of their heightfield
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 LowResolutionCollisionTiles = 0;
+
+	// average number of collision triangles of a tile's terrain with low resolution collision
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageCollisionTriangles = 0;
+
+	// average size in bytes of the vertices and indices the physics engine has to cook per tile with low resolution collision
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageCollisionBytes = 0;
+
+	// average percentage of collision triangles low resolution collision saved compared to the rendered terrain mesh
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageCollisionTriangleReduction = 0.f;
+
+	// number of tiles whose terrain collision is a heightfield
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 HeightfieldCollisionTiles = 0;
+
+	// average time in milliseconds to create the collision heightfield of a tile, there is no cooking
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageHeightfieldCollisionTime = 0.f;
+
+	// average size in bytes of the heights handed to the physics engine per tile with heightfield collision
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageHeightfieldCollisionBytes = 0;
+
+	// number of sectors the horizon currently covers (including sectors covered by tiles)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 HorizonCells = 0;
+
+	// number of triangles of all horizon chunks currently shown
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 HorizonTriangles = 0;
+
+	// vertex and index data uploaded to the tiles' mesh sections since BeginPlay, only the changed parts of existing sections are uploaded
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float UploadedMeshMegabytes = 0.f;
+
+	// average number of bytes uploaded per tile mesh update
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 AverageUploadedMeshBytes = 0;
+
+	// number of tile mesh sections that were uploaded with 16 bit indices
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 MeshSections16BitIndices = 0;
+
+	// number of tile mesh sections that needed 32 bit indices
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	int32 MeshSections32BitIndices = 0;
+
+	// average cache miss ratio (transformed vertices per triangle) of the terrain mesh sections with a 16 entry FIFO vertex cache, not measured in shipping builds
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float AverageTerrainACMR = 0.f;
+};
+
 /**
  * TILE_FREE:			Tile was created, initialized, used, freed and is now waiting for usage again
  *						Runtime mesh sections do not exist
@@ -1820,16 +3012,16 @@ public:
 	{
 		// First vertex
 		FMeshData MeshData;
-		MeshData.VertexBuffer.Add(FRuntimeMeshVertexSimple(FVector(0, 0, 0), FVector(0, 0, 1), FRuntimeMeshTangent(0, -1, 0), FColor::White, FVector2D(0, 0)));
+		MeshData.VertexBuffer.Add(FTerrainVertex(FVector(0, 0, 0), FVector(0, 0, 1), FVector2D(0, 0)));
 
 		// second vertex
-		MeshData.VertexBuffer.Add(FRuntimeMeshVertexSimple(FVector(TerrainSettings.TileSizeXUnits * TerrainSettings.UnitTileSize, 0, 0), FVector(0, 0, 1), FRuntimeMeshTangent(0, -1, 0), FColor::White, FVector2D(TerrainSettings.UnitTileSize, 0)));
+		MeshData.VertexBuffer.Add(FTerrainVertex(FVector(TerrainSettings.TileSizeXUnits * TerrainSettings.UnitTileSize, 0, 0), FVector(0, 0, 1), FVector2D(TerrainSettings.UnitTileSize, 0)));
 
 		// third vertex
-		MeshData.VertexBuffer.Add(FRuntimeMeshVertexSimple(FVector(TerrainSettings.TileSizeXUnits * TerrainSettings.UnitTileSize, TerrainSettings.TileSizeYUnits * TerrainSettings.UnitTileSize, 0), FVector(0, 0, 1), FRuntimeMeshTangent(0, -1, 0), FColor::White, FVector2D(TerrainSettings.UnitTileSize, TerrainSettings.UnitTileSize)));
+		MeshData.VertexBuffer.Add(FTerrainVertex(FVector(TerrainSettings.TileSizeXUnits * TerrainSettings.UnitTileSize, TerrainSettings.TileSizeYUnits * TerrainSettings.UnitTileSize, 0), FVector(0, 0, 1), FVector2D(TerrainSettings.UnitTileSize, TerrainSettings.UnitTileSize)));
 
 		// fourth vertex
-		MeshData.VertexBuffer.Add(FRuntimeMeshVertexSimple(FVector(0, TerrainSettings.TileSizeYUnits * TerrainSettings.UnitTileSize, 0), FVector(0, 0, 1), FRuntimeMeshTangent(0, -1, 0), FColor::White, FVector2D(0, TerrainSettings.UnitTileSize)));
+		MeshData.VertexBuffer.Add(FTerrainVertex(FVector(0, TerrainSettings.TileSizeYUnits * TerrainSettings.UnitTileSize, 0), FVector(0, 0, 1), FVector2D(0, TerrainSettings.UnitTileSize)));
 
 		// Triangles
 		MeshData.TriangleBuffer.Add(0);
@@ -1850,7 +3042,7 @@ public:
 			{
 				float z = FMath::RandRange(-1.f, 1.f);
 				FVector Vec = FVector(x * TerrainSettings.UnitTileSize, y * TerrainSettings.UnitTileSize, z * 10.f);
-				MeshData.VertexBuffer.Add(FRuntimeMeshVertexSimple(Vec, FVector(0.f, 0.f, 1.f), FRuntimeMeshTangent(0, -1, 0), FColor::White, FVector2D(x, y)));
+				MeshData.VertexBuffer.Add(FTerrainVertex(Vec, FVector(0.f, 0.f, 1.f), FVector2D(x, y)));
 			}
 		}
 
@@ -1911,7 +3103,7 @@ public:
 		return (Buffer / FMath::Pow(10, Precision));
 	}
 
-	static void SaveBuffersToFile(const TArray<FRuntimeMeshVertexSimple>& VertexBuffer, const TArray<int32>& TriangleBuffer)
+	static void SaveBuffersToFile(const TArray<FTerrainVertex>& VertexBuffer, const TArray<int32>& TriangleBuffer)
 	{
 		FString SaveDirectory = "D:/Users/Julien/Documents/Unreal Engine Dumps";
 		FString VertexFileName = "VertexBuffer.txt";
@@ -2017,6 +3209,32 @@ public:
 		}
 	}
 
+	/**
+	 * normal distribution drawn from the given random stream whose value is optionally clamped between Min and Max
+	 * used instead of the std::random_device version wherever the result has to be reproducible from a seed
+	 * @param RandomStream The stream to draw from
+	 * @param Mean The mean
+	 * @param Deviation The standard deviation
+	 * @param Min If the value should be clamped to a minimum, set to 0 for no clamping
+	 * @param Max If the value should be clamped to a maximum, set to 0 for no clamping
+	 * @return A normal distributed value with mean Mean and standard deviation Deviation, optionally clamped to [Min, Max]
+	 */
+	static float GetNormalDistribution(const FRandomStream& RandomStream, const float Mean, const float Deviation, const float Min = 0.f, const float Max = 0.f)
+	{
+		// Box-Muller transform, U1 must not be 0 since its logarithm is taken
+		const float U1 = FMath::Max(RandomStream.GetFraction(), SMALL_NUMBER);
+		const float U2 = RandomStream.GetFraction();
+		const float Value = Mean + Deviation * FMath::Sqrt(-2.f * FMath::Loge(U1)) * FMath::Cos(2.f * PI * U2);
+		if (Min == 0.f && Max == 0.f)
+		{
+			return Value;
+		}
+		else
+		{
+			return FMath::Clamp<float>(Value, Min, Max);
+		}
+	}
+
 	/**
 	 * Calculates distance from the first point in the array to the last point in the array
 	 * @param Traverse Array containing all points in the traverse in the right order
@@ -2133,6 +3351,64 @@ public:
 		}
 	}
 
+	/**
+	 * returns the border of the sector that it shares with the given adjacent sector, ETB_Invalid if the sectors are not adjacent
+	 */
+	static ETileBorder GetTileBorderTowards(const FIntVector2D Sector, const FIntVector2D AdjacentSector)
+	{
+		const FIntVector2D Offset = AdjacentSector - Sector;
+		if (Offset == FIntVector2D(1, 0)) { return ETileBorder::ETB_Top; }
+		if (Offset == FIntVector2D(0, 1)) { return ETileBorder::ETB_Right; }
+		if (Offset == FIntVector2D(-1, 0)) { return ETileBorder::ETB_Bottom; }
+		if (Offset == FIntVector2D(0, -1)) { return ETileBorder::ETB_Left; }
+		return ETileBorder::ETB_Invalid;
+	}
+
+	/**
+	 * evaluates a cubic bezier curve
+	 * @param BezierPoints The four control points of the curve
+	 * @param T Curve parameter in [0, 1]
+	 */
+	static FVector EvaluateCubicBezier(const FVector BezierPoints[4], const float T)
+	{
+		const float U = 1.f - T;
+		return (U * U * U) * BezierPoints[0] + (3.f * U * U * T) * BezierPoints[1] + (3.f * U * T * T) * BezierPoints[2] + (T * T * T) * BezierPoints[3];
+	}
 
+	/**
+	 * samples the part of a cubic bezier curve between the parameters T0 and T1 adaptively, segments are split at their middle parameter until they follow the curve closely enough
+	 * a segment is split if it is longer than MaximumSegmentLength, or if it is longer than MinimumSegmentLength and the curve's point at the middle parameter is too far away from the segment horizontally or vertically
+	 * @param BezierPoints The four control points of the curve
+	 * @param T0 Parameter of the segment's start point
+	 * @param P0 The segment's start point
+	 * @param T1 Parameter of the segment's end point
+	 * @param P1 The segment's end point
+	 * @param Depth Remaining number of times the segment may be split
+	 * @param OUTPoints The points within the segment are appended to this array, neither P0 nor P1 are added
+	 */
+	static void SubdivideCubicBezier(const FVector BezierPoints[4], const float T0, const FVector P0, const float T1, const FVector P1, const int32 Depth, const float MinimumSegmentLength, const float MaximumSegmentLength, const float Tolerance, const float ElevationTolerance, TArray<FVector>& OUTPoints)
+	{
+		if (Depth <= 0) { return; }
+
+		const float TMiddle = (T0 + T1) / 2.f;
+		const FVector PMiddle = EvaluateCubicBezier(BezierPoints, TMiddle);
+		const float SegmentLength = FVector::Dist(P0, P1);
+
+		bool bSplit = SegmentLength > MaximumSegmentLength;
+		if (!bSplit && SegmentLength > MinimumSegmentLength)
+		{
+			// horizontal distance of the curve's middle point to the segment and its elevation compared to the segment's elevation at the same position
+			const FVector2D Start = FVector2D(P0);
+			const FVector2D Direction = FVector2D(P1) - Start;
+			const float SquaredLength = Direction.SizeSquared();
+			const float Alpha = SquaredLength > KINDA_SMALL_NUMBER ? FMath::Clamp(FVector2D::DotProduct(FVector2D(PMiddle) - Start, Direction) / SquaredLength, 0.f, 1.f) : 0.5f;
+			bSplit = FVector2D::Distance(FVector2D(PMiddle), Start + Alpha * Direction) > Tolerance || FMath::Abs(PMiddle.Z - FMath::Lerp(P0.Z, P1.Z, Alpha)) > ElevationTolerance;
+		}
+		if (!bSplit) { return; }
+
+		SubdivideCubicBezier(BezierPoints, T0, P0, TMiddle, PMiddle, Depth - 1, MinimumSegmentLength, MaximumSegmentLength, Tolerance, ElevationTolerance, OUTPoints);
+		OUTPoints.Add(PMiddle);
+		SubdivideCubicBezier(BezierPoints, TMiddle, PMiddle, T1, P1, Depth - 1, MinimumSegmentLength, MaximumSegmentLength, Tolerance, ElevationTolerance, OUTPoints);
+	}
 };
 	
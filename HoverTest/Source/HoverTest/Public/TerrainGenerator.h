@@ -122,40 +122,7 @@ struct FVectorArray
 };
 
 /**
- * struct for storing a border vertex along with its normal
- */
-USTRUCT()
-struct FBorderVertex
-{
-	GENERATED_USTRUCT_BODY()
-
-	UPROPERTY()
-	FVector Position;
-
-	UPROPERTY()
-	FVector Normal;
-
-	FBorderVertex()
-	{
-		Position = FVector();
-		Normal = FVector();
-	}
-
-	FBorderVertex(const FVector VertexPosition, const FVector VertexNormal)
-	{
-		Position = VertexPosition;
-		Normal = VertexNormal;
-	}
-
-	FBorderVertex(const FVector VertexPosition)
-	{
-		Position = VertexPosition;
-		Normal = FVector();
-	}
-};
-
-/**
- * struct for a digital elevation map (DEM) as presented in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+ * struct for a digital elevation map (DEM) as presented in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
  */
 USTRUCT()
 struct FDEM
@@ -239,6 +206,9 @@ struct FDEM
 	// fractal dimension
 	float H = -0.5f;
 
+	// stream the random displacements are drawn from, seeded per tile so a tile's terrain can be reproduced
+	FRandomStream RandomStream;
+
 	/**
 	 * scaling factor, used in Deviation calculation
 	 * @DEPRECATED
@@ -255,7 +225,7 @@ struct FDEM
 	float n = 3.f;
 
 	/** 
-	 * hgeligkeit, used as mean for normal distribution
+	 * hügeligkeit, used as mean for normal distribution
 	 * @DEPRECATED
 	 */
 	float Hilly = 600.f;
@@ -317,6 +287,34 @@ struct FDEM
 		MeshVertices.Init(FVectorArray(), 4);
 	}
 
+	/**
+	 * creates a DEM with the fractal noise and material transition settings of the given terrain settings
+	 */
+	explicit FDEM(const FTerrainSettings& Settings)
+		: FDEM
+		(
+			Settings.FractalNoiseTerrainSettings.H,
+			Settings.FractalNoiseTerrainSettings.I,
+			Settings.FractalNoiseTerrainSettings.I_bu,
+			Settings.FractalNoiseTerrainSettings.rt,
+			Settings.FractalNoiseTerrainSettings.rs,
+			Settings.FractalNoiseTerrainSettings.n,
+			Settings.TerrainMaterialTransitionLowMediumElevation,
+			Settings.TerrainMaterialTransitionMediumHighElevation,
+			Settings.TransitionElevationVariationLowMedium,
+			Settings.TransitionElevationVariationMediumHigh
+		)
+	{
+	}
+
+	/**
+	 * seeds the stream the random displacements are drawn from
+	 */
+	void SetRandomSeed(const int32 Seed)
+	{
+		RandomStream.Initialize(Seed);
+	}
+
 	void GetVerticesLeftBorder(TArray<FBorderVertex>& OUTVertices) const
 	{
 		OUTVertices.Append(VerticesLeftBorder);
@@ -578,7 +576,7 @@ struct FDEM
 	}
 
 	/**
-	 * as suggested in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+	 * as suggested in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
 	 */
 	int32 Sigma(const float I) const
 	{
@@ -586,7 +584,7 @@ struct FDEM
 	}
 
 	/**
-	 * as suggested in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+	 * as suggested in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
 	 */
 	float Delta_BU(const float e, const float d) const
 	{
@@ -599,7 +597,7 @@ struct FDEM
 	}
 
 	/**
-	 * non-linear interpolation as suggested in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+	 * non-linear interpolation as suggested in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
 	 * @param e Elevation of the ascendant cell
 	 * @param d Euclidean distance from ascendant cell to child cell
 	 * @return Non-linear interpolated elevation
@@ -654,11 +652,11 @@ struct FDEM
 	}
 
 	/**
-	 * calculates a signed random displacement as proposed in "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj in 2007
+	 * calculates a signed random displacement as proposed in "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj in 2007
 	 */
 	float GetRandomDisplacement(const int32 Iteration) const
 	{
-		return ((FMath::RandRange(-1.f, 1.f) + rt) * rs * FMath::Pow(2, (-Iteration * n * H)));
+		return ((RandomStream.FRandRange(-1.f, 1.f) + rt) * rs * FMath::Pow(2, (-Iteration * n * H)));
 	}
 
 	float CalculateDeviation(const float Iteration) const
@@ -773,27 +771,21 @@ struct FDEM
 	}
 
 
-	// Creates a FRuntimeMeshVertexSimple from the given Vertex
-	FRuntimeMeshVertexSimple CreateRuntimeMeshVertexSimple(const FVector Vertex) const
+	// Creates a FTerrainVertex from the given Vertex, tangent and texture coordinates are derived by FTerrainVertex
+	FTerrainVertex CreateTerrainVertex(const FVector Vertex) const
 	{
-		return FRuntimeMeshVertexSimple(
+		return FTerrainVertex(
 			Vertex,										// Vertex position
-			FVector(0.f, 0.f, 1.f),						// Vertex normal
-			FRuntimeMeshTangent(0.f, -1.f, 0.f),		// Vertex tangent
-			FColor::White,								
-			FVector2D(Vertex.X/500.f, Vertex.Y/500.f)	// Vertex texture coordinates
+			FVector(0.f, 0.f, 1.f)						// Vertex normal
 		);
 	}
 
-	// Creates a FRuntimeMeshVertexSimple from the given Vertex
-	FRuntimeMeshVertexSimple CreateRuntimeMeshVertexSimple(const FVector Vertex, const FVector Normal) const
+	// Creates a FTerrainVertex from the given Vertex, tangent and texture coordinates are derived by FTerrainVertex
+	FTerrainVertex CreateTerrainVertex(const FVector Vertex, const FVector Normal) const
 	{
-		return FRuntimeMeshVertexSimple(
+		return FTerrainVertex(
 			Vertex,											// Vertex position
-			Normal,											// Vertex normal
-			FRuntimeMeshTangent(0.f, -1.f, 0.f),			// Vertex tangent
-			FColor::White,
-			FVector2D(Vertex.X / 500.f, Vertex.Y / 500.f)	// Vertex texture coordinates
+			Normal											// Vertex normal
 		);
 	}
 
@@ -976,9 +968,9 @@ struct FDEM
 
 
 		/*VertexBufferIndex = MeshData[BufferToUse].VertexBuffer.Num();
-		MeshData[BufferToUse].VertexBuffer.Add(CreateRuntimeMeshVertexSimple(Vertex1));
-		MeshData[BufferToUse].VertexBuffer.Add(CreateRuntimeMeshVertexSimple(Vertex2));
-		MeshData[BufferToUse].VertexBuffer.Add(CreateRuntimeMeshVertexSimple(Vertex3));
+		MeshData[BufferToUse].VertexBuffer.Add(CreateTerrainVertex(Vertex1));
+		MeshData[BufferToUse].VertexBuffer.Add(CreateTerrainVertex(Vertex2));
+		MeshData[BufferToUse].VertexBuffer.Add(CreateTerrainVertex(Vertex3));
 		MeshData[BufferToUse].TriangleBuffer.Add(VertexBufferIndex);
 		MeshData[BufferToUse].TriangleBuffer.Add(VertexBufferIndex + 1);
 		MeshData[BufferToUse].TriangleBuffer.Add(VertexBufferIndex + 2);*/
@@ -1006,7 +998,7 @@ struct FDEM
 				GetPointNormal(MeshVertices[i].Array[VertexIndex], Normal);
 				OUTMeshData[i].VertexBuffer.Add
 				(
-					CreateRuntimeMeshVertexSimple
+					CreateTerrainVertex
 					(
 						MeshVertices[i].Array[VertexIndex],
 						Normal
@@ -1532,7 +1524,7 @@ struct FDEM
 	}
 
 	/**
-	* implementation of the MDBU algorithm from "Terrain Modeling: A Constrained Fractal Model" by Fars Belhadj (2007)
+	* implementation of the MDBU algorithm from "Terrain Modeling: A Constrained Fractal Model" by Farès Belhadj (2007)
 	* comments refer to the pseudo code provided in the paper above
 	*/
 	void MidpointDisplacementBottomUp(const TArray<FVector>* InitialConstraints, const TArray<FBorderVertex>* BorderConstraints, const TArray<FVector>* TrackConstraints)
@@ -10,6 +10,9 @@
 #include "Runtime/Core/Public/HAL/Runnable.h"
 #include "Runtime/Core/Public/Containers/Queue.h"
 #include "MyStaticLibrary.h"
+#include "TerrainGenerator.h"
+#include "TerrainHeightfield.h"
+#include "TrackMeshBuilder.h"
 
 class ATerrainManager;
 struct FTerrainSettings;
@@ -29,10 +32,64 @@ public:
 	virtual void Exit();
 
 private:
+	/**
+	 * a job whose coarse preview was already published and that still needs to be generated with all of its iterations
+	 */
+	struct FPendingRefinement
+	{
+		FTerrainJob Job;
+
+		// the published preview, its grid points are kept by the refinement
+		FTerrainHeightfield CoarseHeightfield;
+
+		TArray<FTrackSegment> TrackSegments;
+
+		// time in milliseconds the preview needed
+		float PreviewGenerationTime = 0.f;
+	};
+
+	// generates the track mesh and the terrain of a new job, or only its preview if the job asks for one
+	void ProcessTerrainJob(FTerrainJob& Job);
+
+	// generates the terrain of a job whose preview was published with all of the job's iterations
+	void RefineTerrainJob(FPendingRefinement& Refinement);
+
+	// true if the job's tile got a newer job or was freed since the job was queued
+	static bool IsJobOutdated(const FTerrainJob& Job);
+
+	// creates a DEM with the terrain settings and the random stream of the given sector
+	FDEM CreateDEM(const FIntVector2D Sector) const;
+
+	/**
+	 * runs the constrained triangle edge algorithm for the given sector
+	 * @param RetainedTileBorders Borders of adjacent retained tiles, see FTerrainJob::RetainedTileBorders
+	 * @param CoarseHeightfield If not nullptr, all of its grid points are used as constraints
+	 */
+	void GenerateDEM(FDEM& DEM, const FIntVector2D Sector, const int32 TriangleEdgeIterations, const TArray<FTrackSegment>& TrackSegments, const TArray<FAdjacentTileBorder>& RetainedTileBorders, const FTerrainHeightfield* CoarseHeightfield);
+
+	/**
+	 * encodes the terrain of the DEM into the job, applies the DEM's border vertices to the job's tile and hands the job to the terrain manager
+	 * @param OUTHeightfield The heightfield the compact terrain was encoded from, invalid if the DEM could not be read as a heightfield
+	 */
+	void FinishTerrainJob(FTerrainJob& Job, FDEM& DEM, const int32 TriangleEdgeIterations, const double GenerationStartTime, FTerrainHeightfield& OUTHeightfield);
+
+	/**
+	 * calculates the quadtrees of the adaptive terrain mesh and of the low resolution collision mesh into the job's compact terrain,
+	 * so the terrain manager only expands the meshes from them on the game thread, see FCompactTerrainTile::QuadLevels
+	 */
+	void CalculateTerrainQuadLevels(FTerrainJob& Job, const FTerrainHeightfield& Heightfield) const;
+
+	// collects the areas in tile space around the triangles of the track mesh, expanded by two grid units
+	static void GetTrackAreas(const FMeshData& TrackMeshData, const float UnitSize, TArray<FBox2D>& OUTAreas);
+
 	ATerrainManager* TerrainManager;
 	FTerrainSettings TerrainSettings;
+	FTrackMeshBuilder TrackMeshBuilder;
 	TQueue<FTerrainJob, EQueueMode::Spsc>* InputQueue;
 	FTerrainJob TerrainJob;
 	bool IsThreadFinished;
 
+	// jobs waiting for their refinement, only processed while the input queue is empty
+	TQueue<FPendingRefinement, EQueueMode::Spsc> PendingRefinements;
+
 };
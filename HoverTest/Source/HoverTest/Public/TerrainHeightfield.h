@@ -0,0 +1,1093 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+#include "TerrainGenerator.h"
+#include "RuntimeMeshComponent.h"
+#include "TerrainHeightfield.generated.h"
+
+/**
+ * regular grid representation of a generated terrain tile
+ * the triangle edge algorithm in FDEM only creates vertices on a regular grid with (2^(TriangleEdgeIterations + 1) + 1) vertices per edge,
+ * so a tile can be stored as elevations and normals per grid point and the terrain mesh can be rebuilt from it
+ * grid point (X, Y) is located at (X * UnitSize, Y * UnitSize) in tile space, X is the tile's bottom-top axis and Y its left-right axis
+ */
+USTRUCT()
+struct FTerrainHeightfield
+{
+	GENERATED_USTRUCT_BODY()
+
+	// number of grid points per tile edge
+	UPROPERTY()
+	int32 GridSize = 0;
+
+	// distance between two adjacent grid points
+	UPROPERTY()
+	float UnitSize = 0.f;
+
+	// elevation for every grid point, index is X * GridSize + Y
+	UPROPERTY()
+	TArray<float> Heights;
+
+	// normalized vertex normal for every grid point, index is X * GridSize + Y
+	UPROPERTY()
+	TArray<FVector> Normals;
+
+	/**
+	 * calculates the number of grid points per tile edge for the given number of triangle edge iterations
+	 */
+	static int32 CalculateGridSize(const int32 TriangleEdgeIterations)
+	{
+		return (1 << (TriangleEdgeIterations + 1)) + 1;
+	}
+
+	/**
+	 * inverse of CalculateGridSize
+	 */
+	static int32 CalculateTriangleEdgeIterations(const int32 GridSize)
+	{
+		return GridSize > 2 ? static_cast<int32>(FMath::FloorLog2(static_cast<uint32>(GridSize - 1))) - 1 : 0;
+	}
+
+	bool IsValid() const
+	{
+		return GridSize > 1 && Heights.Num() == GridSize * GridSize && Normals.Num() == GridSize * GridSize;
+	}
+
+	int32 GetIndex(const int32 X, const int32 Y) const
+	{
+		return X * GridSize + Y;
+	}
+
+	FVector GetPosition(const int32 X, const int32 Y) const
+	{
+		return FVector(X * UnitSize, Y * UnitSize, Heights[GetIndex(X, Y)]);
+	}
+
+	/**
+	 * reads elevations and vertex normals of all grid points from a DEM after FDEM::TriangleEdge
+	 * @param TileEdgeSize The edge size of a tile in cm
+	 * @param TriangleEdgeIterations The number of triangle edge iterations the DEM was created with
+	 * @return True if every grid point was found in the DEM
+	 */
+	bool InitializeFromDEM(const FDEM& DEM, const float TileEdgeSize, const int32 TriangleEdgeIterations)
+	{
+		GridSize = CalculateGridSize(TriangleEdgeIterations);
+		UnitSize = TileEdgeSize / (GridSize - 1);
+		if (!FMath::IsNearlyEqual(UnitSize, DEM.GetUnitSize(), KINDA_SMALL_NUMBER))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unit size of DEM (%f) does not match the terrain grid (%f)"), DEM.GetUnitSize(), UnitSize);
+			return false;
+		}
+		Heights.SetNumUninitialized(GridSize * GridSize);
+		Normals.SetNumUninitialized(GridSize * GridSize);
+
+		for (int32 X = 0; X < GridSize; ++X)
+		{
+			for (int32 Y = 0; Y < GridSize; ++Y)
+			{
+				const FVector2D Point(X * UnitSize, Y * UnitSize);
+				const int32 Index = GetIndex(X, Y);
+				if (!DEM.GetPointElevation(Point, Heights[Index]) || !DEM.GetPointNormal(Point, Normals[Index]))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * calculates the vertex normals from the elevations the same way FDEM does,
+	 * i.e. as the normalized sum of the (not normalized) face normals of all triangles a grid point belongs to
+	 */
+	void CalculateNormals()
+	{
+		Normals.SetNumZeroed(GridSize * GridSize);
+		CalculateNormals(0, GridSize - 1, 0, GridSize - 1);
+	}
+
+	/**
+	 * recalculates the vertex normals of the grid points in the given region only, e.g. after the elevations of the region changed
+	 * the region has to include the grid points next to the changed ones, since their normals depend on the changed elevations as well
+	 */
+	void CalculateNormals(const int32 MinX, const int32 MaxX, const int32 MinY, const int32 MaxY)
+	{
+		auto IsInRegion = [MinX, MaxX, MinY, MaxY](const int32 X, const int32 Y)
+		{
+			return X >= MinX && X <= MaxX && Y >= MinY && Y <= MaxY;
+		};
+		for (int32 X = MinX; X <= MaxX; ++X)
+		{
+			for (int32 Y = MinY; Y <= MaxY; ++Y)
+			{
+				Normals[GetIndex(X, Y)] = FVector(0.f, 0.f, 0.f);
+			}
+		}
+		ForEachTriangle([this, &IsInRegion](const int32 X1, const int32 Y1, const int32 X2, const int32 Y2, const int32 X3, const int32 Y3)
+		{
+			const bool bIsInRegion1 = IsInRegion(X1, Y1);
+			const bool bIsInRegion2 = IsInRegion(X2, Y2);
+			const bool bIsInRegion3 = IsInRegion(X3, Y3);
+			if (!bIsInRegion1 && !bIsInRegion2 && !bIsInRegion3) { return; }
+
+			const FVector Vertex1 = GetPosition(X1, Y1);
+			const FVector FaceNormal = FVector::CrossProduct(GetPosition(X2, Y2) - Vertex1, GetPosition(X3, Y3) - Vertex1);
+			if (bIsInRegion1) { Normals[GetIndex(X1, Y1)] += FaceNormal; }
+			if (bIsInRegion2) { Normals[GetIndex(X2, Y2)] += FaceNormal; }
+			if (bIsInRegion3) { Normals[GetIndex(X3, Y3)] += FaceNormal; }
+		});
+		for (int32 X = MinX; X <= MaxX; ++X)
+		{
+			for (int32 Y = MinY; Y <= MaxY; ++Y)
+			{
+				FVector& Normal = Normals[GetIndex(X, Y)];
+				Normal = Normal.GetSafeNormal();
+			}
+		}
+	}
+
+	/**
+	 * replaces the elevations of one border by the given border constraints and only recalculates a band along this border,
+	 * instead of generating the whole tile again when an adjacent tile's border changed
+	 * the change of the border is propagated into the band row by row, bottom-up from the border:
+	 * every grid point changes by the average change of its three neighbors in the row closer to the border, fading out linearly towards the inner edge of the band
+	 * the grid points of the other borders keep their elevations, so they still match their adjacent tiles
+	 * @param Direction Side of the border, e.g. (1, 0) for the top border
+	 * @param BorderVertices Border constraints in tile space, resampled to this heightfield's grid with ResampleBorderVertices
+	 * @param BandWidth Number of grid rows along the border that are recalculated, including the border
+	 * @param Tolerance Largest elevation difference on the border that is ignored
+	 * @return Largest elevation change on the border, 0 if the border was within the tolerance and nothing changed
+	 */
+	float ApplyBorderConstraints(const FIntVector2D Direction, const TArray<FBorderVertex>& BorderVertices, const int32 BandWidth, const float Tolerance)
+	{
+		if (!IsValid() || FMath::Abs(Direction.X) + FMath::Abs(Direction.Y) != 1) { return 0.f; }
+
+		const int32 Last = GridSize - 1;
+		// top and bottom borders run along Y
+		const bool bAlongY = Direction.X != 0;
+		const bool bIsFarBorder = Direction.X > 0 || Direction.Y > 0;
+		// grid index of the point at the given distance from the border and the given position along the border
+		auto GetBandIndex = [this, Last, bAlongY, bIsFarBorder](const int32 Depth, const int32 Position)
+		{
+			const int32 Row = bIsFarBorder ? Last - Depth : Depth;
+			return bAlongY ? GetIndex(Row, Position) : GetIndex(Position, Row);
+		};
+
+		TArray<float> Deltas;
+		Deltas.Init(0.f, GridSize);
+		float MaximumDelta = 0.f;
+		for (const FBorderVertex& Vertex : BorderVertices)
+		{
+			const int32 Position = FMath::RoundToInt((bAlongY ? Vertex.Position.Y : Vertex.Position.X) / UnitSize);
+			if (Position < 0 || Position > Last) { continue; }
+			Deltas[Position] = Vertex.Position.Z - Heights[GetBandIndex(0, Position)];
+			MaximumDelta = FMath::Max(MaximumDelta, FMath::Abs(Deltas[Position]));
+		}
+		if (MaximumDelta <= Tolerance) { return 0.f; }
+
+		const int32 Depth = FMath::Clamp(BandWidth, 1, Last);
+		TArray<float> PreviousDeltas;
+		for (int32 Row = 0; Row < Depth; ++Row)
+		{
+			if (Row > 0)
+			{
+				PreviousDeltas = Deltas;
+				// the product of all factors up to a row is (Depth - Row) / Depth
+				const float Falloff = static_cast<float>(Depth - Row) / (Depth - Row + 1);
+				for (int32 Position = 1; Position < Last; ++Position)
+				{
+					Deltas[Position] = (PreviousDeltas[Position - 1] + PreviousDeltas[Position] + PreviousDeltas[Position + 1]) / 3.f * Falloff;
+				}
+				Deltas[0] = 0.f;
+				Deltas[Last] = 0.f;
+			}
+			for (int32 Position = 0; Position <= Last; ++Position)
+			{
+				Heights[GetBandIndex(Row, Position)] += Deltas[Position];
+			}
+		}
+
+		// the first unchanged row gets new normals as well
+		const int32 InnerRow = bIsFarBorder ? Last - Depth : Depth;
+		const int32 BorderRow = bIsFarBorder ? Last : 0;
+		const int32 MinRow = FMath::Min(InnerRow, BorderRow);
+		const int32 MaxRow = FMath::Max(InnerRow, BorderRow);
+		if (bAlongY)
+		{
+			CalculateNormals(MinRow, MaxRow, 0, Last);
+		}
+		else
+		{
+			CalculateNormals(0, Last, MinRow, MaxRow);
+		}
+		return MaximumDelta;
+	}
+
+	/**
+	 * recreates the terrain mesh section with the same triangles FDEM::TriangleEdge creates
+	 * unlike FDEM::CopyBufferToMeshData, every grid point is only one vertex that is shared by all of its triangles
+	 * and the leaf quads are ordered for the post transform vertex cache, see ForEachBlockInVertexCacheOrder
+	 * @param SkirtDepth If greater than zero, a vertical skirt of this depth is added below every tile border
+	 */
+	void BuildMeshData(FMeshData& OUTMeshData, const float SkirtDepth = 0.f) const
+	{
+		OUTMeshData.VertexBuffer.Reset();
+		OUTMeshData.TriangleBuffer.Reset();
+		if (!IsValid()) { return; }
+
+		const int32 NumberOfSkirtSegments = SkirtDepth > 0.f ? 4 * (GridSize - 1) : 0;
+		OUTMeshData.VertexBuffer.Reserve(GridSize * GridSize + NumberOfSkirtSegments * 2);
+		OUTMeshData.TriangleBuffer.Reserve(((GridSize - 1) * (GridSize - 1) + NumberOfSkirtSegments) * 6);
+
+		TArray<int32> VertexIndices;
+		VertexIndices.Init(INDEX_NONE, GridSize * GridSize);
+		ForEachBlockInVertexCacheOrder((GridSize - 1) / 2, [this, &OUTMeshData, &VertexIndices](const int32 BlockX, const int32 BlockY)
+		{
+			AddLeafQuad(OUTMeshData, VertexIndices, BlockX * 2, BlockY * 2);
+		});
+
+		if (SkirtDepth > 0.f)
+		{
+			AddSkirts(OUTMeshData, VertexIndices, SkirtDepth);
+		}
+	}
+
+	/**
+	 * calculates the adaptive restricted quadtree the terrain mesh section is built with instead of the uniform grid, see BuildAdaptiveMeshData
+	 * quads of the quadtree whose grid points deviate at most Tolerance from a fan of large triangles are drawn as such a fan,
+	 * all other quads are split down to the 2x2 leaf quads of the triangle edge algorithm, which are drawn like BuildMeshData does
+	 * adjacent quads differ by at most one level and a fan gets the midpoint of every edge next to smaller quads, so there are no cracks
+	 * the leaf quads along the tile borders always keep full resolution, so the borders match the adjacent tiles exactly
+	 * @param OUTQuadLevels Level of the quad of every leaf block, see FCompactTerrainTile::QuadLevels, empty if the grid cannot be tessellated adaptively
+	 * @param Tolerance Largest allowed elevation difference in cm between a grid point and the triangles it is replaced by
+	 * @param FullResolutionAreas Areas in tile space that keep full resolution, e.g. around the track
+	 */
+	void CalculateAdaptiveQuadLevels(TArray<uint8>& OUTQuadLevels, const float Tolerance, const TArray<FBox2D>& FullResolutionAreas) const
+	{
+		CalculateQuadtreeLevels(OUTQuadLevels, Tolerance, FullResolutionAreas, GridSize - 1, true);
+	}
+
+	/**
+	 * builds the terrain mesh section from a quadtree of CalculateAdaptiveQuadLevels, only the vertices and triangles are created
+	 * quad levels that do not fit this heightfield are ignored and the uniform grid of BuildMeshData is built
+	 * @param SkirtDepth If greater than zero, a vertical skirt of this depth is added below every tile border
+	 */
+	void BuildAdaptiveMeshData(FMeshData& OUTMeshData, const TArray<uint8>& QuadLevels, const float SkirtDepth = 0.f) const
+	{
+		BuildQuadtreeMeshData(OUTMeshData, QuadLevels, SkirtDepth);
+	}
+
+	/**
+	 * calculates the quadtree of a coarser mesh of the terrain for collision, see BuildCollisionMeshData
+	 * quads are merged up to 2^(ReductionLevels + 1) grid units regardless of their elevations, only FullResolutionAreas keep the leaf quads of the render mesh
+	 * the tile borders are not kept at full resolution, but every border edge gets its midpoint, so tiles with the same reduction share their border vertices
+	 * @param ReductionLevels Number of quadtree levels above the leaf quads, 0 keeps full resolution
+	 * @param FullResolutionAreas Areas in tile space that keep full resolution, e.g. the track corridor
+	 */
+	void CalculateCollisionQuadLevels(TArray<uint8>& OUTQuadLevels, const int32 ReductionLevels, const TArray<FBox2D>& FullResolutionAreas) const
+	{
+		const int32 MaximumQuadSize = FMath::Min(2 << FMath::Clamp(ReductionLevels, 0, 16), GridSize - 1);
+		CalculateQuadtreeLevels(OUTQuadLevels, MAX_flt, FullResolutionAreas, MaximumQuadSize, false);
+	}
+
+	/**
+	 * builds the collision mesh of the terrain from a quadtree of CalculateCollisionQuadLevels
+	 * quad levels that do not fit this heightfield are ignored and the collision mesh gets full resolution
+	 */
+	void BuildCollisionMeshData(TArray<FVector>& OUTVertices, TArray<int32>& OUTTriangles, const TArray<uint8>& QuadLevels) const
+	{
+		FMeshData MeshData;
+		BuildQuadtreeMeshData(MeshData, QuadLevels, 0.f);
+		OUTVertices.Reset(MeshData.VertexBuffer.Num());
+		for (const FTerrainVertex& Vertex : MeshData.VertexBuffer)
+		{
+			OUTVertices.Add(Vertex.Position);
+		}
+		OUTTriangles = MoveTemp(MeshData.TriangleBuffer);
+	}
+
+	/**
+	 * quantizes the elevations of all grid points to 16 bit for a heightfield collision shape
+	 * the quantization steps are as small as the tile's range of elevations allows
+	 */
+	void BuildCollisionHeightfield(FTerrainCollisionHeightfield& OUTHeightfield) const
+	{
+		OUTHeightfield = FTerrainCollisionHeightfield();
+		if (!IsValid()) { return; }
+
+		float MinHeight = MAX_flt;
+		float MaxHeight = -MAX_flt;
+		for (const float Height : Heights)
+		{
+			MinHeight = FMath::Min(MinHeight, Height);
+			MaxHeight = FMath::Max(MaxHeight, Height);
+		}
+		OUTHeightfield.GridSize = GridSize;
+		OUTHeightfield.UnitSize = UnitSize;
+		OUTHeightfield.HeightOffset = 0.5f * (MinHeight + MaxHeight);
+		// the height scale has to be positive even if the tile is flat
+		OUTHeightfield.HeightScale = FMath::Max(0.5f * (MaxHeight - MinHeight) / MAX_int16, KINDA_SMALL_NUMBER);
+		OUTHeightfield.Heights.SetNumUninitialized(Heights.Num());
+		for (int32 i = 0; i < Heights.Num(); ++i)
+		{
+			const int32 Quantized = FMath::RoundToInt((Heights[i] - OUTHeightfield.HeightOffset) / OUTHeightfield.HeightScale);
+			OUTHeightfield.Heights[i] = static_cast<int16>(FMath::Clamp(Quantized, -static_cast<int32>(MAX_int16), static_cast<int32>(MAX_int16)));
+		}
+	}
+
+	/**
+	 * calls the given function with the grid coordinates of every triangle in the order FDEM::TriangleEdge creates them
+	 * every 2x2 block of grid cells is a leaf quad of the triangle edge algorithm and gets split into 8 triangles
+	 */
+	template <typename FunctionType>
+	void ForEachTriangle(FunctionType Function) const
+	{
+		for (int32 X = 0; X + 2 < GridSize; X += 2)
+		{
+			for (int32 Y = 0; Y + 2 < GridSize; Y += 2)
+			{
+				/**
+				 * naming as in FDEM::TriangleEdge
+				 * A = (X, Y), B = (X, Y + 2), C = (X + 2, Y + 2), D = (X + 2, Y)
+				 * E = (X, Y + 1), F = (X + 1, Y + 2), G = (X + 2, Y + 1), H = (X + 1, Y), I = (X + 1, Y + 1)
+				 */
+				Function(X, Y, X, Y + 1, X + 1, Y);					// A, E, H
+				Function(X, Y + 1, X + 1, Y + 1, X + 1, Y);			// E, I, H
+				Function(X, Y + 1, X, Y + 2, X + 1, Y + 1);			// E, B, I
+				Function(X + 1, Y + 1, X, Y + 2, X + 1, Y + 2);		// I, B, F
+				Function(X + 1, Y, X + 1, Y + 1, X + 2, Y);			// H, I, D
+				Function(X + 1, Y + 1, X + 2, Y + 1, X + 2, Y);		// I, G, D
+				Function(X + 1, Y + 1, X + 1, Y + 2, X + 2, Y + 1);	// I, F, G
+				Function(X + 1, Y + 2, X + 2, Y + 2, X + 2, Y + 1);	// F, C, G
+			}
+		}
+	}
+
+	/**
+	 * calls the given function with the block coordinates of every leaf quad (block of 2x2 grid cells) in an order that reuses the post transform vertex cache
+	 * the blocks are visited in bands that are two blocks wide along Y, every band row by row along X,
+	 * so only about 2 * 5 vertices have to stay cached between two rows instead of a whole grid row
+	 */
+	template <typename FunctionType>
+	static void ForEachBlockInVertexCacheOrder(const int32 NumberOfBlocks, FunctionType Function)
+	{
+		const int32 BandWidth = 2;
+		for (int32 BandY = 0; BandY < NumberOfBlocks; BandY += BandWidth)
+		{
+			const int32 BandEnd = FMath::Min(BandY + BandWidth, NumberOfBlocks);
+			for (int32 BlockX = 0; BlockX < NumberOfBlocks; ++BlockX)
+			{
+				for (int32 BlockY = BandY; BlockY < BandEnd; ++BlockY)
+				{
+					Function(BlockX, BlockY);
+				}
+			}
+		}
+	}
+
+	/**
+	 * encodes a normalized vector with octahedral mapping into two values in [-1, 1]
+	 */
+	static FVector2D EncodeOctahedralNormal(const FVector& Normal)
+	{
+		const float L1Norm = FMath::Abs(Normal.X) + FMath::Abs(Normal.Y) + FMath::Abs(Normal.Z);
+		if (L1Norm <= SMALL_NUMBER)
+		{
+			return FVector2D(0.f, 0.f);
+		}
+		FVector2D Encoded(Normal.X / L1Norm, Normal.Y / L1Norm);
+		if (Normal.Z < 0.f)
+		{
+			Encoded = FVector2D((1.f - FMath::Abs(Encoded.Y)) * FMath::Sign(Encoded.X), (1.f - FMath::Abs(Encoded.X)) * FMath::Sign(Encoded.Y));
+		}
+		return Encoded;
+	}
+
+	/**
+	 * decodes a normal encoded with EncodeOctahedralNormal
+	 */
+	static FVector DecodeOctahedralNormal(const FVector2D& Encoded)
+	{
+		FVector Normal(Encoded.X, Encoded.Y, 1.f - FMath::Abs(Encoded.X) - FMath::Abs(Encoded.Y));
+		if (Normal.Z < 0.f)
+		{
+			const float X = Normal.X;
+			Normal.X = (1.f - FMath::Abs(Normal.Y)) * FMath::Sign(X);
+			Normal.Y = (1.f - FMath::Abs(X)) * FMath::Sign(Normal.Y);
+		}
+		return Normal.GetSafeNormal();
+	}
+
+	/**
+	 * encodes the heightfield into a compact tile
+	 * @param bDeltaEncode If the quantized elevations should be delta encoded, smaller but slower to expand
+	 * @param bStoreNormals If the normals should be stored, otherwise they are recalculated on expansion
+	 */
+	void Encode(FCompactTerrainTile& OUTTile, const bool bDeltaEncode, const bool bStoreNormals) const
+	{
+		OUTTile.GridSize = GridSize;
+		OUTTile.UnitSize = UnitSize;
+		OUTTile.bIsDeltaEncoded = bDeltaEncode;
+		OUTTile.HeightData.Reset();
+		OUTTile.NormalData.Reset();
+		OUTTile.BorderHeights.Reset();
+		if (!IsValid())
+		{
+			OUTTile.GridSize = 0;
+			return;
+		}
+
+		const int32 NumberOfPoints = GridSize * GridSize;
+		float MinHeight = Heights[0];
+		float MaxHeight = Heights[0];
+		for (const float Height : Heights)
+		{
+			MinHeight = FMath::Min(MinHeight, Height);
+			MaxHeight = FMath::Max(MaxHeight, Height);
+		}
+		OUTTile.MinHeight = MinHeight;
+		OUTTile.HeightStep = (MaxHeight - MinHeight) / MAX_uint16;
+
+		TArray<uint16> Quantized;
+		Quantized.SetNumUninitialized(NumberOfPoints);
+		for (int32 i = 0; i < NumberOfPoints; ++i)
+		{
+			Quantized[i] = OUTTile.HeightStep > 0.f ? static_cast<uint16>(FMath::Clamp(FMath::RoundToInt((Heights[i] - MinHeight) / OUTTile.HeightStep), 0, static_cast<int32>(MAX_uint16))) : 0;
+		}
+
+		if (bDeltaEncode)
+		{
+			OUTTile.HeightData.Reserve(NumberOfPoints * 2);
+			for (int32 X = 0; X < GridSize; ++X)
+			{
+				for (int32 Y = 0; Y < GridSize; ++Y)
+				{
+					const int32 Residual = static_cast<int32>(Quantized[GetIndex(X, Y)]) - PredictQuantizedHeight(Quantized.GetData(), X, Y);
+					// zigzag encoding, so small negative residuals get small unsigned values
+					uint32 Value = (static_cast<uint32>(Residual) << 1) ^ static_cast<uint32>(Residual >> 31);
+					while (Value >= 0x80)
+					{
+						OUTTile.HeightData.Add(static_cast<uint8>(Value | 0x80));
+						Value >>= 7;
+					}
+					OUTTile.HeightData.Add(static_cast<uint8>(Value));
+				}
+			}
+			OUTTile.HeightData.Shrink();
+		}
+		else
+		{
+			OUTTile.HeightData.SetNumUninitialized(NumberOfPoints * sizeof(uint16));
+			FMemory::Memcpy(OUTTile.HeightData.GetData(), Quantized.GetData(), OUTTile.HeightData.Num());
+		}
+
+		if (bStoreNormals)
+		{
+			OUTTile.NormalData.SetNumUninitialized(NumberOfPoints * 2);
+			for (int32 i = 0; i < NumberOfPoints; ++i)
+			{
+				const FVector2D Encoded = EncodeOctahedralNormal(Normals[i]);
+				OUTTile.NormalData[2 * i] = static_cast<int8>(FMath::RoundToInt(FMath::Clamp(Encoded.X, -1.f, 1.f) * 127.f));
+				OUTTile.NormalData[2 * i + 1] = static_cast<int8>(FMath::RoundToInt(FMath::Clamp(Encoded.Y, -1.f, 1.f) * 127.f));
+			}
+		}
+
+		OUTTile.BorderHeights.SetNumUninitialized(4 * GridSize);
+		for (int32 i = 0; i < GridSize; ++i)
+		{
+			OUTTile.BorderHeights[i] = Heights[GetIndex(i, 0)];
+			OUTTile.BorderHeights[GridSize + i] = Heights[GetIndex(i, GridSize - 1)];
+			OUTTile.BorderHeights[2 * GridSize + i] = Heights[GetIndex(0, i)];
+			OUTTile.BorderHeights[3 * GridSize + i] = Heights[GetIndex(GridSize - 1, i)];
+		}
+	}
+
+	/**
+	 * restores the heightfield from a compact tile
+	 * the border elevations are exact, all other elevations differ by at most FCompactTerrainTile::GetMaximumHeightError
+	 * @return False if the compact tile is corrupted
+	 */
+	bool InitializeFromCompactTile(const FCompactTerrainTile& Tile)
+	{
+		if (!Tile.IsValid()) { return false; }
+
+		GridSize = Tile.GridSize;
+		UnitSize = Tile.UnitSize;
+		const int32 NumberOfPoints = GridSize * GridSize;
+		TArray<uint16> Quantized;
+		Quantized.SetNumUninitialized(NumberOfPoints);
+		if (Tile.bIsDeltaEncoded)
+		{
+			int32 ByteIndex = 0;
+			for (int32 X = 0; X < GridSize; ++X)
+			{
+				for (int32 Y = 0; Y < GridSize; ++Y)
+				{
+					uint32 Value = 0;
+					int32 Shift = 0;
+					uint8 Byte = 0;
+					do
+					{
+						if (ByteIndex >= Tile.HeightData.Num() || Shift > 28) { return false; }
+						Byte = Tile.HeightData[ByteIndex++];
+						Value |= static_cast<uint32>(Byte & 0x7F) << Shift;
+						Shift += 7;
+					} while (Byte & 0x80);
+					const int32 Residual = static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+					Quantized[GetIndex(X, Y)] = static_cast<uint16>(PredictQuantizedHeight(Quantized.GetData(), X, Y) + Residual);
+				}
+			}
+		}
+		else
+		{
+			if (Tile.HeightData.Num() != NumberOfPoints * static_cast<int32>(sizeof(uint16))) { return false; }
+			FMemory::Memcpy(Quantized.GetData(), Tile.HeightData.GetData(), Tile.HeightData.Num());
+		}
+
+		Heights.SetNumUninitialized(NumberOfPoints);
+		for (int32 i = 0; i < NumberOfPoints; ++i)
+		{
+			Heights[i] = Tile.MinHeight + Quantized[i] * Tile.HeightStep;
+		}
+		for (int32 i = 0; i < GridSize; ++i)
+		{
+			Heights[GetIndex(i, 0)] = Tile.BorderHeights[i];
+			Heights[GetIndex(i, GridSize - 1)] = Tile.BorderHeights[GridSize + i];
+			Heights[GetIndex(0, i)] = Tile.BorderHeights[2 * GridSize + i];
+			Heights[GetIndex(GridSize - 1, i)] = Tile.BorderHeights[3 * GridSize + i];
+		}
+
+		if (Tile.NormalData.Num() == 2 * NumberOfPoints)
+		{
+			Normals.SetNumUninitialized(NumberOfPoints);
+			for (int32 i = 0; i < NumberOfPoints; ++i)
+			{
+				Normals[i] = DecodeOctahedralNormal(FVector2D(Tile.NormalData[2 * i] / 127.f, Tile.NormalData[2 * i + 1] / 127.f));
+			}
+		}
+		else
+		{
+			CalculateNormals();
+		}
+		return true;
+	}
+
+	/**
+	 * expands the compact tile and compares it to this heightfield, which it was encoded from
+	 * @return The largest difference between an original and an expanded elevation, -1 if the tile could not be expanded
+	 */
+	float CalculateHeightError(const FCompactTerrainTile& Tile) const
+	{
+		FTerrainHeightfield Expanded;
+		if (!Expanded.InitializeFromCompactTile(Tile) || Expanded.Heights.Num() != Heights.Num()) { return -1.f; }
+
+		float Error = 0.f;
+		for (int32 i = 0; i < Heights.Num(); ++i)
+		{
+			Error = FMath::Max(Error, FMath::Abs(Heights[i] - Expanded.Heights[i]));
+		}
+		return Error;
+	}
+
+	/**
+	 * creates the border vertex arrays from the exact border elevations of a compact tile like FDEM::CheckForBorderVertex does
+	 * the coordinates are already transformed, so they can directly be used as border constraints of the adjacent tile
+	 */
+	static void GetBorderVertices(const FCompactTerrainTile& Tile, TArray<FBorderVertex>& OUTLeftBorder, TArray<FBorderVertex>& OUTRightBorder, TArray<FBorderVertex>& OUTTopBorder, TArray<FBorderVertex>& OUTBottomBorder)
+	{
+		OUTLeftBorder.Reset();
+		OUTRightBorder.Reset();
+		OUTTopBorder.Reset();
+		OUTBottomBorder.Reset();
+		if (!Tile.IsValid()) { return; }
+
+		const int32 Size = Tile.GridSize;
+		const float EdgeSize = (Size - 1) * Tile.UnitSize;
+		for (int32 i = 0; i < Size; ++i)
+		{
+			OUTLeftBorder.Add(FBorderVertex(FVector(i * Tile.UnitSize, EdgeSize, Tile.BorderHeights[i])));
+			OUTRightBorder.Add(FBorderVertex(FVector(i * Tile.UnitSize, 0.f, Tile.BorderHeights[Size + i])));
+			OUTBottomBorder.Add(FBorderVertex(FVector(EdgeSize, i * Tile.UnitSize, Tile.BorderHeights[2 * Size + i])));
+			OUTTopBorder.Add(FBorderVertex(FVector(0.f, i * Tile.UnitSize, Tile.BorderHeights[3 * Size + i])));
+		}
+	}
+
+	/**
+	 * replaces border vertices of an adjacent tile by vertices on every grid point of a tile with the given unit size
+	 * the adjacent tile may have been generated with another number of triangle edge iterations, its border is a polyline through its border vertices,
+	 * so grid points between two of its border vertices are interpolated linearly and both tiles share the same border
+	 * @param bAlongY True if the border runs along the tile's Y axis (top and bottom borders), false if it runs along the X axis (left and right borders)
+	 */
+	static void ResampleBorderVertices(TArray<FBorderVertex>& Vertices, const bool bAlongY, const float UnitSize, const float TileEdgeSize)
+	{
+		if (Vertices.Num() < 2 || UnitSize <= 0.f) { return; }
+
+		Vertices.Sort([bAlongY](const FBorderVertex& A, const FBorderVertex& B)
+		{
+			return bAlongY ? A.Position.Y < B.Position.Y : A.Position.X < B.Position.X;
+		});
+
+		TArray<FBorderVertex> Resampled;
+		const int32 NumberOfGridPoints = FMath::RoundToInt(TileEdgeSize / UnitSize) + 1;
+		Resampled.Reserve(NumberOfGridPoints);
+		int32 Segment = 0;
+		for (int32 i = 0; i < NumberOfGridPoints; ++i)
+		{
+			const float Coordinate = i * UnitSize;
+			while (Segment + 2 < Vertices.Num() && (bAlongY ? Vertices[Segment + 1].Position.Y : Vertices[Segment + 1].Position.X) < Coordinate)
+			{
+				Segment++;
+			}
+			const FVector& Start = Vertices[Segment].Position;
+			const FVector& End = Vertices[Segment + 1].Position;
+			const float StartCoordinate = bAlongY ? Start.Y : Start.X;
+			const float EndCoordinate = bAlongY ? End.Y : End.X;
+			const float Alpha = EndCoordinate > StartCoordinate ? FMath::Clamp((Coordinate - StartCoordinate) / (EndCoordinate - StartCoordinate), 0.f, 1.f) : 0.f;
+
+			// keep the other coordinate of the adjacent tile's border, it is the same for all of its vertices
+			FVector Position = Start;
+			if (bAlongY) { Position.Y = Coordinate; }
+			else { Position.X = Coordinate; }
+			Position.Z = FMath::Lerp(Start.Z, End.Z, Alpha);
+			Resampled.Add(FBorderVertex(Position));
+		}
+		Vertices = MoveTemp(Resampled);
+	}
+
+private:
+
+	/**
+	 * calculates the levels of a restricted quadtree, see CalculateAdaptiveQuadLevels
+	 * this is the expensive part of the adaptive tessellation, so it is done by the worker threads
+	 * @param Tolerance Largest allowed elevation difference of a merged quad, MAX_flt to merge quads regardless of their elevations
+	 * @param MaximumQuadSize Largest quad size in grid units
+	 * @param bFullResolutionBorders If true, the leaf quads along the tile borders keep full resolution
+	 */
+	void CalculateQuadtreeLevels(TArray<uint8>& OUTQuadLevels, const float Tolerance, const TArray<FBox2D>& FullResolutionAreas, const int32 MaximumQuadSize, const bool bFullResolutionBorders) const
+	{
+		OUTQuadLevels.Reset();
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		if (!IsValid() || NumberOfBlocks < 4 || !FMath::IsPowerOfTwo(GridSize - 1)) { return; }
+
+		// leaf quads of the triangle edge algorithm (blocks of 2x2 grid cells) that have to keep full resolution
+		TArray<bool> FullResolutionBlocks;
+		FullResolutionBlocks.Init(false, NumberOfBlocks * NumberOfBlocks);
+		for (int32 i = 0; i < NumberOfBlocks && bFullResolutionBorders; ++i)
+		{
+			FullResolutionBlocks[i] = true;
+			FullResolutionBlocks[(NumberOfBlocks - 1) * NumberOfBlocks + i] = true;
+			FullResolutionBlocks[i * NumberOfBlocks] = true;
+			FullResolutionBlocks[i * NumberOfBlocks + NumberOfBlocks - 1] = true;
+		}
+		const float BlockSize = 2.f * UnitSize;
+		for (const FBox2D& Area : FullResolutionAreas)
+		{
+			const int32 MinX = FMath::Clamp(FMath::FloorToInt(Area.Min.X / BlockSize), 0, NumberOfBlocks - 1);
+			const int32 MaxX = FMath::Clamp(FMath::FloorToInt(Area.Max.X / BlockSize), 0, NumberOfBlocks - 1);
+			const int32 MinY = FMath::Clamp(FMath::FloorToInt(Area.Min.Y / BlockSize), 0, NumberOfBlocks - 1);
+			const int32 MaxY = FMath::Clamp(FMath::FloorToInt(Area.Max.Y / BlockSize), 0, NumberOfBlocks - 1);
+			for (int32 BlockX = MinX; BlockX <= MaxX; ++BlockX)
+			{
+				for (int32 BlockY = MinY; BlockY <= MaxY; ++BlockY)
+				{
+					FullResolutionBlocks[BlockX * NumberOfBlocks + BlockY] = true;
+				}
+			}
+		}
+
+		// size in grid units of the quad every block belongs to
+		TArray<int32> QuadSizes;
+		QuadSizes.Init(2, NumberOfBlocks * NumberOfBlocks);
+		SubdivideQuad(0, 0, GridSize - 1, Tolerance, MaximumQuadSize, FullResolutionBlocks, QuadSizes);
+		RestrictQuadSizes(QuadSizes);
+
+		OUTQuadLevels.SetNumUninitialized(QuadSizes.Num());
+		for (int32 i = 0; i < QuadSizes.Num(); ++i)
+		{
+			OUTQuadLevels[i] = static_cast<uint8>(FMath::FloorLog2(static_cast<uint32>(QuadSizes[i])) - 1);
+		}
+	}
+
+	/**
+	 * builds the mesh of a restricted quadtree of CalculateQuadtreeLevels, see BuildAdaptiveMeshData
+	 * falls back to the uniform grid if the quad levels do not fit this heightfield
+	 */
+	void BuildQuadtreeMeshData(FMeshData& OUTMeshData, const TArray<uint8>& QuadLevels, const float SkirtDepth) const
+	{
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		TArray<int32> QuadSizes;
+		if (!GetQuadSizes(QuadLevels, QuadSizes))
+		{
+			BuildMeshData(OUTMeshData, SkirtDepth);
+			return;
+		}
+		OUTMeshData.VertexBuffer.Reset();
+		OUTMeshData.TriangleBuffer.Reset();
+
+		OUTMeshData.VertexBuffer.Reserve(GridSize * GridSize);
+		OUTMeshData.TriangleBuffer.Reserve((GridSize - 1) * (GridSize - 1) * 6);
+		TArray<int32> VertexIndices;
+		VertexIndices.Init(INDEX_NONE, GridSize * GridSize);
+		ForEachBlockInVertexCacheOrder(NumberOfBlocks, [this, &OUTMeshData, &VertexIndices, &QuadSizes, NumberOfBlocks](const int32 BlockX, const int32 BlockY)
+		{
+			const int32 Size = QuadSizes[BlockX * NumberOfBlocks + BlockY];
+			const int32 X = BlockX * 2;
+			const int32 Y = BlockY * 2;
+			// every quad is drawn once from its first block
+			if (X % Size != 0 || Y % Size != 0) { return; }
+
+			const bool bBottomSplit = IsFanEdgeSplit(GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, -1, 0), Size);
+			const bool bTopSplit = IsFanEdgeSplit(GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 1, 0), Size);
+			const bool bLeftSplit = IsFanEdgeSplit(GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 0, -1), Size);
+			const bool bRightSplit = IsFanEdgeSplit(GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 0, 1), Size);
+			// a leaf quad surrounded by leaf quads is drawn exactly like the uniform grid
+			if (Size == 2 && bBottomSplit && bTopSplit && bLeftSplit && bRightSplit)
+			{
+				AddLeafQuad(OUTMeshData, VertexIndices, X, Y);
+				return;
+			}
+
+			const int32 Half = Size / 2;
+			const int32 CenterX = X + Half;
+			const int32 CenterY = Y + Half;
+			AddFanEdge(OUTMeshData, VertexIndices, X, Y, X, Y + Size, CenterX, CenterY, bBottomSplit);
+			AddFanEdge(OUTMeshData, VertexIndices, X + Size, Y, X + Size, Y + Size, CenterX, CenterY, bTopSplit);
+			AddFanEdge(OUTMeshData, VertexIndices, X, Y, X + Size, Y, CenterX, CenterY, bLeftSplit);
+			AddFanEdge(OUTMeshData, VertexIndices, X, Y + Size, X + Size, Y + Size, CenterX, CenterY, bRightSplit);
+		});
+
+		if (SkirtDepth > 0.f)
+		{
+			AddSkirts(OUTMeshData, VertexIndices, SkirtDepth);
+		}
+	}
+
+	/**
+	 * converts quad levels into the size in grid units of the quad every block belongs to
+	 * @return False if the quad levels do not fit this heightfield, e.g. because they were calculated for another grid size
+	 */
+	bool GetQuadSizes(const TArray<uint8>& QuadLevels, TArray<int32>& OUTQuadSizes) const
+	{
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		if (!IsValid() || NumberOfBlocks < 4 || !FMath::IsPowerOfTwo(GridSize - 1) || QuadLevels.Num() != NumberOfBlocks * NumberOfBlocks) { return false; }
+
+		OUTQuadSizes.SetNumUninitialized(QuadLevels.Num());
+		for (int32 i = 0; i < QuadLevels.Num(); ++i)
+		{
+			// quads larger than the tile would be drawn outside of the grid
+			if (QuadLevels[i] > 30 || (2 << QuadLevels[i]) > GridSize - 1) { return false; }
+			OUTQuadSizes[i] = 2 << QuadLevels[i];
+		}
+		return true;
+	}
+
+	/**
+	 * returns the index of the vertex of the grid point (X, Y), the vertex is added when the grid point is used for the first time
+	 * @param VertexIndices Vertex index of every grid point, INDEX_NONE if the grid point has no vertex yet
+	 */
+	int32 AddGridVertex(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const int32 X, const int32 Y) const
+	{
+		int32& VertexIndex = VertexIndices[GetIndex(X, Y)];
+		if (VertexIndex == INDEX_NONE)
+		{
+			VertexIndex = AddVertex(OUTMeshData, GetPosition(X, Y), Normals[GetIndex(X, Y)]);
+		}
+		return VertexIndex;
+	}
+
+	static int32 AddVertex(FMeshData& OUTMeshData, const FVector& Position, const FVector& Normal)
+	{
+		// same vertex as FDEM::CreateTerrainVertex
+		return OUTMeshData.VertexBuffer.Add(FTerrainVertex(Position, Normal));
+	}
+
+	static void AddTriangle(FMeshData& OUTMeshData, const int32 Vertex1, const int32 Vertex2, const int32 Vertex3)
+	{
+		OUTMeshData.TriangleBuffer.Add(Vertex1);
+		OUTMeshData.TriangleBuffer.Add(Vertex2);
+		OUTMeshData.TriangleBuffer.Add(Vertex3);
+	}
+
+	void AddSkirts(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const float SkirtDepth) const
+	{
+		const int32 Last = GridSize - 1;
+		for (int32 i = 0; i < Last; ++i)
+		{
+			AddSkirtQuad(OUTMeshData, VertexIndices, i, 0, i + 1, 0, FVector(0.f, -1.f, 0.f), SkirtDepth);			// left
+			AddSkirtQuad(OUTMeshData, VertexIndices, i, Last, i + 1, Last, FVector(0.f, 1.f, 0.f), SkirtDepth);	// right
+			AddSkirtQuad(OUTMeshData, VertexIndices, 0, i, 0, i + 1, FVector(-1.f, 0.f, 0.f), SkirtDepth);			// bottom
+			AddSkirtQuad(OUTMeshData, VertexIndices, Last, i, Last, i + 1, FVector(1.f, 0.f, 0.f), SkirtDepth);	// top
+		}
+	}
+
+	/**
+	 * adds the 8 triangles of the 2x2 leaf quad at (X, Y) in the same order and winding as ForEachTriangle
+	 */
+	void AddLeafQuad(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const int32 X, const int32 Y) const
+	{
+		const int32 Triangles[8][6] = {
+			{ X, Y, X, Y + 1, X + 1, Y },
+			{ X, Y + 1, X + 1, Y + 1, X + 1, Y },
+			{ X, Y + 1, X, Y + 2, X + 1, Y + 1 },
+			{ X + 1, Y + 1, X, Y + 2, X + 1, Y + 2 },
+			{ X + 1, Y, X + 1, Y + 1, X + 2, Y },
+			{ X + 1, Y + 1, X + 2, Y + 1, X + 2, Y },
+			{ X + 1, Y + 1, X + 1, Y + 2, X + 2, Y + 1 },
+			{ X + 1, Y + 2, X + 2, Y + 2, X + 2, Y + 1 }
+		};
+		for (const int32* Triangle : Triangles)
+		{
+			const int32 Vertex1 = AddGridVertex(OUTMeshData, VertexIndices, Triangle[0], Triangle[1]);
+			const int32 Vertex2 = AddGridVertex(OUTMeshData, VertexIndices, Triangle[2], Triangle[3]);
+			const int32 Vertex3 = AddGridVertex(OUTMeshData, VertexIndices, Triangle[4], Triangle[5]);
+			AddTriangle(OUTMeshData, Vertex1, Vertex2, Vertex3);
+		}
+	}
+
+	/**
+	 * adds a triangle of grid points with the winding of the triangles of ForEachTriangle, whose (V2 - V1) x (V3 - V1) points downwards in grid space
+	 */
+	void AddGridTriangle(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const int32 X1, const int32 Y1, const int32 X2, const int32 Y2, const int32 X3, const int32 Y3) const
+	{
+		const int32 Cross = (X2 - X1) * (Y3 - Y1) - (Y2 - Y1) * (X3 - X1);
+		const int32 Vertex1 = AddGridVertex(OUTMeshData, VertexIndices, X1, Y1);
+		const int32 Vertex2 = AddGridVertex(OUTMeshData, VertexIndices, X2, Y2);
+		const int32 Vertex3 = AddGridVertex(OUTMeshData, VertexIndices, X3, Y3);
+		if (Cross < 0)
+		{
+			AddTriangle(OUTMeshData, Vertex1, Vertex2, Vertex3);
+		}
+		else
+		{
+			AddTriangle(OUTMeshData, Vertex1, Vertex3, Vertex2);
+		}
+	}
+
+	/**
+	 * adds the triangles of a fan quad between one of its edges and its center
+	 * @param bSplit If the edge's midpoint is used, because the quad on the other side of the edge is smaller
+	 */
+	void AddFanEdge(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const int32 X1, const int32 Y1, const int32 X2, const int32 Y2, const int32 CenterX, const int32 CenterY, const bool bSplit) const
+	{
+		if (bSplit)
+		{
+			const int32 MidX = (X1 + X2) / 2;
+			const int32 MidY = (Y1 + Y2) / 2;
+			AddGridTriangle(OUTMeshData, VertexIndices, X1, Y1, MidX, MidY, CenterX, CenterY);
+			AddGridTriangle(OUTMeshData, VertexIndices, MidX, MidY, X2, Y2, CenterX, CenterY);
+		}
+		else
+		{
+			AddGridTriangle(OUTMeshData, VertexIndices, X1, Y1, X2, Y2, CenterX, CenterY);
+		}
+	}
+
+	/**
+	 * elevation of the plane through three grid points at the given position in grid units
+	 */
+	float InterpolateGridTriangle(const int32 X1, const int32 Y1, const int32 X2, const int32 Y2, const int32 X3, const int32 Y3, const int32 X, const int32 Y) const
+	{
+		const float Denominator = static_cast<float>((Y2 - Y3) * (X1 - X3) + (X3 - X2) * (Y1 - Y3));
+		if (FMath::IsNearlyZero(Denominator)) { return Heights[GetIndex(X1, Y1)]; }
+		const float Weight1 = ((Y2 - Y3) * (X - X3) + (X3 - X2) * (Y - Y3)) / Denominator;
+		const float Weight2 = ((Y3 - Y1) * (X - X3) + (X1 - X3) * (Y - Y3)) / Denominator;
+		return Weight1 * Heights[GetIndex(X1, Y1)] + Weight2 * Heights[GetIndex(X2, Y2)] + (1.f - Weight1 - Weight2) * Heights[GetIndex(X3, Y3)];
+	}
+
+	/**
+	 * calculates the largest elevation difference between the grid points of a quad and the fan that would replace them
+	 * every quarter of the fan is drawn with or without its edge midpoint, depending on its neighbor, so both variants are checked
+	 */
+	float CalculateFanError(const int32 X, const int32 Y, const int32 Size) const
+	{
+		const int32 Half = Size / 2;
+		const int32 CenterX = X + Half;
+		const int32 CenterY = Y + Half;
+		float Error = 0.f;
+		for (int32 PointX = X; PointX <= X + Size; ++PointX)
+		{
+			for (int32 PointY = Y; PointY <= Y + Size; ++PointY)
+			{
+				const int32 U = PointX - CenterX;
+				const int32 V = PointY - CenterY;
+				// corners and midpoint of the edge of the quarter the point lies in
+				int32 X1, Y1, X2, Y2, MidX, MidY;
+				int32 AlongEdge;
+				if (FMath::Abs(U) >= FMath::Abs(V))
+				{
+					X1 = X2 = MidX = U < 0 ? X : X + Size;
+					Y1 = Y;
+					Y2 = Y + Size;
+					MidY = CenterY;
+					AlongEdge = V;
+				}
+				else
+				{
+					Y1 = Y2 = MidY = V < 0 ? Y : Y + Size;
+					X1 = X;
+					X2 = X + Size;
+					MidX = CenterX;
+					AlongEdge = U;
+				}
+				const float Height = Heights[GetIndex(PointX, PointY)];
+				const float FanHeight = InterpolateGridTriangle(X1, Y1, X2, Y2, CenterX, CenterY, PointX, PointY);
+				const float SplitFanHeight = AlongEdge <= 0
+					? InterpolateGridTriangle(X1, Y1, MidX, MidY, CenterX, CenterY, PointX, PointY)
+					: InterpolateGridTriangle(MidX, MidY, X2, Y2, CenterX, CenterY, PointX, PointY);
+				Error = FMath::Max(Error, FMath::Max(FMath::Abs(Height - FanHeight), FMath::Abs(Height - SplitFanHeight)));
+			}
+		}
+		return Error;
+	}
+
+	/**
+	 * splits the quad at (X, Y) top down until it is at most MaximumQuadSize large, its fan is within the tolerance and it contains no full resolution block
+	 */
+	void SubdivideQuad(const int32 X, const int32 Y, const int32 Size, const float Tolerance, const int32 MaximumQuadSize, const TArray<bool>& FullResolutionBlocks, TArray<int32>& QuadSizes) const
+	{
+		if (Size <= 2) { return; }
+
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		bool bCanMerge = Size <= MaximumQuadSize;
+		for (int32 BlockX = X / 2; BlockX < (X + Size) / 2 && bCanMerge; ++BlockX)
+		{
+			for (int32 BlockY = Y / 2; BlockY < (Y + Size) / 2; ++BlockY)
+			{
+				if (FullResolutionBlocks[BlockX * NumberOfBlocks + BlockY])
+				{
+					bCanMerge = false;
+					break;
+				}
+			}
+		}
+
+		if (bCanMerge && (Tolerance == MAX_flt || CalculateFanError(X, Y, Size) <= Tolerance))
+		{
+			for (int32 BlockX = X / 2; BlockX < (X + Size) / 2; ++BlockX)
+			{
+				for (int32 BlockY = Y / 2; BlockY < (Y + Size) / 2; ++BlockY)
+				{
+					QuadSizes[BlockX * NumberOfBlocks + BlockY] = Size;
+				}
+			}
+			return;
+		}
+
+		const int32 Half = Size / 2;
+		SubdivideQuad(X, Y, Half, Tolerance, MaximumQuadSize, FullResolutionBlocks, QuadSizes);
+		SubdivideQuad(X + Half, Y, Half, Tolerance, MaximumQuadSize, FullResolutionBlocks, QuadSizes);
+		SubdivideQuad(X, Y + Half, Half, Tolerance, MaximumQuadSize, FullResolutionBlocks, QuadSizes);
+		SubdivideQuad(X + Half, Y + Half, Half, Tolerance, MaximumQuadSize, FullResolutionBlocks, QuadSizes);
+	}
+
+	/**
+	 * returns true if an edge of a quad of the given size needs its midpoint
+	 * leaf quads always contain their edge midpoints, so edges next to them are always split, edges of two equally sized larger quads never are
+	 */
+	static bool IsFanEdgeSplit(const int32 NeighborSize, const int32 Size)
+	{
+		return NeighborSize < Size || NeighborSize <= 2;
+	}
+
+	/**
+	 * returns the size of the smallest quad next to the given side of the quad at (X, Y)
+	 * the tile border counts as a leaf quad, since it has to contain every border vertex
+	 */
+	int32 GetMinimumNeighborQuadSize(const TArray<int32>& QuadSizes, const int32 X, const int32 Y, const int32 Size, const int32 DirectionX, const int32 DirectionY) const
+	{
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		const int32 FirstBlockX = DirectionX < 0 ? X / 2 - 1 : (DirectionX > 0 ? (X + Size) / 2 : X / 2);
+		const int32 FirstBlockY = DirectionY < 0 ? Y / 2 - 1 : (DirectionY > 0 ? (Y + Size) / 2 : Y / 2);
+		if (FirstBlockX < 0 || FirstBlockY < 0 || FirstBlockX >= NumberOfBlocks || FirstBlockY >= NumberOfBlocks) { return 2; }
+
+		int32 MinimumSize = MAX_int32;
+		for (int32 i = 0; i < Size / 2; ++i)
+		{
+			const int32 BlockX = DirectionX == 0 ? FirstBlockX + i : FirstBlockX;
+			const int32 BlockY = DirectionY == 0 ? FirstBlockY + i : FirstBlockY;
+			MinimumSize = FMath::Min(MinimumSize, QuadSizes[BlockX * NumberOfBlocks + BlockY]);
+		}
+		return MinimumSize;
+	}
+
+	/**
+	 * splits quads until adjacent quads differ by at most one level, so every edge of a fan has at most one vertex of a neighbor in between
+	 */
+	void RestrictQuadSizes(TArray<int32>& QuadSizes) const
+	{
+		const int32 NumberOfBlocks = (GridSize - 1) / 2;
+		bool bChanged = true;
+		while (bChanged)
+		{
+			bChanged = false;
+			for (int32 BlockX = 0; BlockX < NumberOfBlocks; ++BlockX)
+			{
+				for (int32 BlockY = 0; BlockY < NumberOfBlocks; ++BlockY)
+				{
+					const int32 Size = QuadSizes[BlockX * NumberOfBlocks + BlockY];
+					const int32 X = BlockX * 2;
+					const int32 Y = BlockY * 2;
+					if (Size <= 4 || X % Size != 0 || Y % Size != 0) { continue; }
+
+					const int32 Half = Size / 2;
+					if (GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, -1, 0) < Half || GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 1, 0) < Half
+						|| GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 0, -1) < Half || GetMinimumNeighborQuadSize(QuadSizes, X, Y, Size, 0, 1) < Half)
+					{
+						for (int32 SplitX = BlockX; SplitX < BlockX + Size / 2; ++SplitX)
+						{
+							for (int32 SplitY = BlockY; SplitY < BlockY + Size / 2; ++SplitY)
+							{
+								QuadSizes[SplitX * NumberOfBlocks + SplitY] = Half;
+							}
+						}
+						bChanged = true;
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * adds the two triangles of the skirt below the border edge between the grid points (X1, Y1) and (X2, Y2)
+	 * the top vertices are the border vertices of the terrain, the skirt vertices below them use their normals, so the skirt is lit like the terrain next to it
+	 * @param Outward Direction the skirt faces, pointing away from the tile
+	 */
+	void AddSkirtQuad(FMeshData& OUTMeshData, TArray<int32>& VertexIndices, const int32 X1, const int32 Y1, const int32 X2, const int32 Y2, const FVector& Outward, const float SkirtDepth) const
+	{
+		const FVector Position1 = GetPosition(X1, Y1);
+		const FVector Position2 = GetPosition(X2, Y2);
+		const FVector BottomPosition1 = Position1 - FVector(0.f, 0.f, SkirtDepth);
+		const int32 Top1 = AddGridVertex(OUTMeshData, VertexIndices, X1, Y1);
+		const int32 Top2 = AddGridVertex(OUTMeshData, VertexIndices, X2, Y2);
+		const int32 Bottom1 = AddVertex(OUTMeshData, BottomPosition1, Normals[GetIndex(X1, Y1)]);
+		const int32 Bottom2 = AddVertex(OUTMeshData, Position2 - FVector(0.f, 0.f, SkirtDepth), Normals[GetIndex(X2, Y2)]);
+
+		// the terrain triangles' face normals (V2 - V1) x (V3 - V1) point away from their visible side, so skirts are wound the same way
+		const bool bSwapWinding = FVector::DotProduct(FVector::CrossProduct(Position2 - Position1, BottomPosition1 - Position1), Outward) > 0.f;
+		if (bSwapWinding)
+		{
+			AddTriangle(OUTMeshData, Top1, Bottom1, Top2);
+			AddTriangle(OUTMeshData, Bottom1, Bottom2, Top2);
+		}
+		else
+		{
+			AddTriangle(OUTMeshData, Top1, Top2, Bottom1);
+			AddTriangle(OUTMeshData, Bottom1, Top2, Bottom2);
+		}
+	}
+
+	/**
+	 * predicts a quantized elevation from its already known neighbors at (X - 1, Y), (X, Y - 1) and (X - 1, Y - 1)
+	 */
+	int32 PredictQuantizedHeight(const uint16* Quantized, const int32 X, const int32 Y) const
+	{
+		if (X == 0 && Y == 0) { return 0; }
+		if (X == 0) { return Quantized[Y - 1]; }
+		if (Y == 0) { return Quantized[GetIndex(X - 1, 0)]; }
+		const int32 Prediction = static_cast<int32>(Quantized[GetIndex(X, Y - 1)]) + Quantized[GetIndex(X - 1, Y)] - Quantized[GetIndex(X - 1, Y - 1)];
+		return FMath::Clamp(Prediction, 0, static_cast<int32>(MAX_uint16));
+	}
+};
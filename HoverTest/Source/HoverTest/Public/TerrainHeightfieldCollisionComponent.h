@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysxUserData.h"
+#include "MyStaticLibrary.h"
+#include "TerrainHeightfieldCollisionComponent.generated.h"
+
+namespace physx
+{
+	class PxHeightField;
+	class PxRigidStatic;
+}
+
+/**
+ * collision of a terrain tile as a heightfield shape of the physics engine instead of a cooked triangle mesh
+ * the heightfield is created directly from the 16 bit heights of FTerrainCollisionHeightfield, like the collision of the landscape, so nothing has to be cooked
+ * only handles collision, the terrain is still rendered by the tile's runtime mesh component
+ */
+UCLASS()
+class HOVERTEST_API UTerrainHeightfieldCollisionComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTerrainHeightfieldCollisionComponent();
+
+	/**
+	 * replaces the heightfield of the component, an invalid heightfield removes the collision
+	 * @param InHeightfield Heights of the tile's grid points in the component's space
+	 * @return Time in milliseconds the physics engine needed to create the heightfield
+	 */
+	float SetHeightfield(const FTerrainCollisionHeightfield& InHeightfield);
+
+	bool HasHeightfield() const;
+
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+	virtual bool ShouldCreatePhysicsState() const override;
+
+	virtual void BeginDestroy() override;
+
+protected:
+	virtual void OnCreatePhysicsState() override;
+
+	virtual void OnDestroyPhysicsState() override;
+
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport = ETeleportType::None) override;
+
+private:
+	/**
+	 * transform of the heightfield's actor in world space
+	 * rows of the physics engine's heightfield run along the component's Y axis, columns along its X axis and heights along its Z axis
+	 */
+	FTransform GetHeightfieldTransform() const;
+
+	void ReleaseHeightfield();
+
+	UPROPERTY()
+	FTerrainCollisionHeightfield Heightfield;
+
+	physx::PxHeightField* PHeightField = nullptr;
+
+	physx::PxRigidStatic* PActor = nullptr;
+
+	// lets scene queries that hit the heightfield find this component
+	FPhysxUserData PhysxUserData;
+};
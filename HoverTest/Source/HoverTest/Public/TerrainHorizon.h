@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+#include "TerrainHeightfield.h"
+
+class ATerrainTile;
+
+/**
+ * very coarse terrain that covers the sectors around the tracked actors up to HorizonRadius, so the world does not end behind the last tile
+ * every sector of the horizon (a cell) is generated with the same generator and seed as the tiles, but with only HorizonTriangleEdgeIterations iterations
+ * cells take their borders from finished tiles and already generated cells next to them, so the horizon continues the terrain of the tiles
+ * cells are merged into chunks of HorizonChunkSize x HorizonChunkSize sectors, every chunk is one mesh section of a single mesh component
+ * sectors covered by a finished tile are left out of the chunks
+ * only to be used from the game thread
+ */
+class HOVERTEST_API FTerrainHorizon
+{
+public:
+	void Initialize(const FTerrainSettings& InSettings);
+
+	/**
+	 * updates the sectors the horizon is centered around (the sectors of the tracked actors)
+	 * cells that are no longer needed are removed, missing cells are queued nearest first
+	 */
+	void SetCenterSectors(const TArray<FIntVector2D>& InCenterSectors);
+
+	/**
+	 * generates the next queued cell
+	 * @param FindTile Returns the finished tile of the given sector whose border vertices are set, nullptr if there is none
+	 * @return True if a cell was generated
+	 */
+	bool GenerateNextCell(TFunctionRef<const ATerrainTile*(const FIntVector2D)> FindTile);
+
+	/**
+	 * queues the cells of the given sector and its adjacent sectors to be generated again, before all other queued cells
+	 * to be called when the tile of the sector got new terrain, so the horizon continues its borders
+	 */
+	void RegenerateCellsAround(const FIntVector2D Sector);
+
+	/**
+	 * marks the chunk of the given sector to be rebuilt, e.g. because a tile started or stopped covering the sector
+	 */
+	void MarkSectorChanged(const FIntVector2D Sector);
+
+	/**
+	 * rebuilds the mesh of the next changed chunk in world space
+	 * @param IsSectorCovered Returns true if the given sector is covered by a finished tile and should be left out
+	 * @param OUTSection The mesh section of the chunk, INDEX_NONE if the chunk has no mesh section and nothing has to be done
+	 * @param OUTMeshData The chunk's mesh, empty if the chunk's mesh section should be cleared
+	 * @return True if a chunk was rebuilt
+	 */
+	bool BuildNextChangedChunk(TFunctionRef<bool(const FIntVector2D)> IsSectorCovered, int32& OUTSection, FMeshData& OUTMeshData);
+
+	int32 NumCells() const;
+
+	int32 NumPendingCells() const;
+
+	// number of triangles of all chunks
+	int32 NumTriangles() const;
+
+private:
+	/**
+	 * a mesh section of the horizon's mesh component
+	 */
+	struct FHorizonChunk
+	{
+		int32 Section = 0;
+		int32 Triangles = 0;
+	};
+
+	/**
+	 * collects the border vertices of one side of a cell, transformed into the cell's space and resampled to the cell's grid
+	 * the border is taken from the sector's own tile, the adjacent tile or the adjacent cell, in this order
+	 * @param Direction Direction of the side, e.g. (1, 0) for the top border
+	 * @return True if a border was found
+	 */
+	bool GetBorderVertices(const FIntVector2D Sector, const FIntVector2D Direction, TFunctionRef<const ATerrainTile*(const FIntVector2D)> FindTile, TArray<FBorderVertex>& OUTVertices) const;
+
+	// chebyshev distance to the nearest center sector
+	int32 GetDistanceToCenters(const FIntVector2D Sector) const;
+
+	FIntVector2D GetChunk(const FIntVector2D Sector) const;
+
+	FTerrainSettings Settings;
+
+	TArray<FIntVector2D> CenterSectors;
+
+	TMap<FIntVector2D, FTerrainHeightfield> Cells;
+
+	// cells that still need to be generated, the next cell is the last element
+	TArray<FIntVector2D> PendingCells;
+
+	TSet<FIntVector2D> ChangedChunks;
+
+	TMap<FIntVector2D, FHorizonChunk> Chunks;
+
+	// mesh sections of removed chunks, reused before new sections are created
+	TArray<int32> FreeSections;
+
+	int32 NextSection = 0;
+};
@@ -7,10 +7,16 @@
 #include "MyStaticLibrary.h"
 #include "Runtime/Core/Public/Containers/Queue.h"
 #include "ProceduralCheckpoint.h"
+#include "TerrainTileCache.h"
+#include "TerrainTileDiskCache.h"
+#include "TerrainHorizon.h"
+#include "TrackSplineIndex.h"
+#include "TrackPlanner.h"
 #include "TerrainManager.generated.h"
 
 class ATerrainTile;
 class AHoverTestGameModeProceduralLevel;
+class URuntimeMeshComponent;
 
 UCLASS()
 class HOVERTEST_API ATerrainManager : public AActor
@@ -25,6 +31,9 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or the manager is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	// actors that are tracked by the terrain manager, i.e. actors around which terrain is generated
 	UPROPERTY()
 	TArray<AActor*> TrackedActors;
@@ -37,6 +46,24 @@ protected:
 	UPROPERTY()
 	TArray<ATerrainTile*> TilesInUse;
 
+	/**
+	 * terrain tiles that are no longer needed by any tracked actor but are kept intact in case an actor returns
+	 * ordered from oldest to most recently retained, limited to NumberOfRetainedTiles in FTerrainSettings
+	 */
+	UPROPERTY()
+	TArray<ATerrainTile*> RetainedTiles;
+
+	// tiles in use whose sector is in SectorsWaitingForTrack, their terrain jobs are queued once the sector's track is known
+	UPROPERTY()
+	TArray<ATerrainTile*> TilesWaitingForTrack;
+
+	/**
+	 * the sector every tracked actor is currently assigned to
+	 * because of SectorChangeHysteresis, this may differ from the sector calculated from the actor's location
+	 */
+	UPROPERTY()
+	TMap<AActor*, FIntVector2D> TrackedActorSectors;
+
 	/**
 	* returns an array containing all sectors around the input location that should be covered with tiles according to TilesToBeCreatedAroundActorRadius in FTerrainSettings
 	* the function does not check if sectors may already be covered by tiles
@@ -58,9 +85,6 @@ protected:
 	// queue for pending terrain jobs
 	TQueue<FTerrainJob, EQueueMode::Spsc> PendingTerrainJobQueue;
 
-	// queue for pending checkpoint spawns
-	TQueue<FCheckpointSpawnJob, EQueueMode::Spsc> PendingCheckpointSpawnQueue;
-
 	// array of all used threads
 	TArray<FRunnableThread*> Threads;
 
@@ -69,42 +93,84 @@ protected:
 	TMap<FIntVector2D, FSectorTrackInfo> TrackMap;
 
 	/**
-	 * calculates the global track path for all sectors in SectorsToCreateTileFor
+	 * calculates the global track path for all sectors in SectorsToCreate
+	 * sectors that are not in TrackMap yet wait for their track info in SectorsWaitingForTrack, see ExtendTrackThroughWaitingSectors
 	 */
 	UFUNCTION()
-	void CalculateTrackPath(const TArray<FIntVector2D> SectorsToCreate);
+	void CalculateTrackPath(const TArray<FIntVector2D>& SectorsToCreate);
 
 	/**
-	 * the following 4 points define a quad that restricts the area, where new track parts can be created
-	 * i.e. NextTrackSector cannot be located in the defined quad
-	 * in the comments, this quad is often refered to as 'no-go quad'
+	 * extends the track through all sectors in SectorsWaitingForTrack it reaches in one pass and adds them to TrackMap
+	 * if the planning thread did not plan the next sector yet, the sectors keep waiting and the track is extended again on the next tick
+	 * otherwise the sectors the track did not reach are added to TrackMap without track
 	 */
+	void ExtendTrackThroughWaitingSectors();
 
-	UPROPERTY()
-	FIntVector2D TopLeftCorner;
+	/**
+	 * queues the terrain jobs of the tiles in TilesWaitingForTrack whose sector's track is known now
+	 */
+	void QueueTilesWaitingForTrack();
 
-	UPROPERTY()
-	FIntVector2D TopRightCorner;
+	// sectors that need a tile but are not in TrackMap yet, since the track may still reach them
+	TSet<FIntVector2D> SectorsWaitingForTrack;
 
-	UPROPERTY()
-	FIntVector2D BottomLeftCorner;
+	/**
+	 * state of the track planning after the last sector that was added to TrackMap
+	 */
+	FTrackPlannerState TrackPlannerState;
 
-	UPROPERTY()
-	FIntVector2D BottomRightCorner;
+	/**
+	 * plans sectors on the game thread if bPlanTrackInBackground is not set in FTerrainSettings
+	 */
+	FTrackPlanner TrackPlanner;
 
-	// the sector where the next track segment should be created (not yet created)
-	UPROPERTY()
-	FIntVector2D NextTrackSector = FIntVector2D();
+	// thread that plans the track ahead, see bPlanTrackInBackground in FTerrainSettings
+	FRunnableThread* TrackPlanningThread = nullptr;
 
-	// the sector where the current last track segment is located (already created)
-	UPROPERTY()
-	FIntVector2D CurrentTrackSector = FIntVector2D();
+	// runnable of TrackPlanningThread, owned by the manager
+	FTrackPlanningWorker* TrackPlanningWorker = nullptr;
+
+	// restarts of the planning thread
+	TQueue<FTrackPlanningRestart, EQueueMode::Spsc> TrackPlanningRestartQueue;
+
+	// sectors planned by the planning thread
+	TQueue<FPlannedTrackSector, EQueueMode::Spsc> PlannedTrackQueue;
+
+	// sectors planned by the planning thread that were taken from PlannedTrackQueue but not yet added to TrackMap, in track order
+	TArray<FPlannedTrackSector> PlannedTrack;
+
+	// number of planned sectors added to TrackMap, tells the planning thread how far it may plan ahead
+	FThreadSafeCounter TakenTrackSectors;
+
+	// current restart of the track planning, sectors planned for older restarts are discarded
+	int32 TrackPlanningGeneration = 0;
+
+	// all sectors in TrackMap
+	FSectorBitmap TrackMapSectors;
+
+	// sectors the track must not enter as of the last restart, i.e. TrackMapSectors at that time
+	FSectorBitmap BlockedTrackSectors;
+
+	// number of sectors taken from the planning thread and planned on the game thread
+	int32 NumberOfTrackSectorsPlannedAhead = 0;
+	int32 NumberOfTrackSectorsPlannedOnGameThread = 0;
 
 	/**
-	 * Next available check point ID
+	 * takes the planned track of TrackPlannerState.NextTrackSector from the planning thread, or plans it on the game thread if there is no planning thread
+	 * if the planned following sector got a tile without track in the meantime, the planning is restarted and the sector is planned again
+	 * @return False if the planning thread did not plan the sector yet or was restarted, the sector has to wait for it then
 	 */
-	UPROPERTY()
-	uint32 NextAvailableCheckPointID = 1;
+	bool TakePlannedTrackSector(FPlannedTrackSector& OUTPlannedSector);
+
+	/**
+	 * discards all planned sectors and lets the planning thread continue from TrackPlannerState, with all sectors in TrackMap blocked
+	 */
+	void RestartTrackPlanning();
+
+	/**
+	 * stops the track planning thread, waits until it has finished and deletes it and its worker
+	 */
+	void StopTrackPlanningThread();
 
 	/**
 	 * array that contains sectors that need coverage before the player can be resetted
@@ -146,98 +212,278 @@ private:
 	void GetRelevantAdjacentSectors(const FIntVector2D Sector, TArray<FIntVector2D>& OUTAdjacentSectors);
 
 	/**
-	 * calculates the new NextTrackSector
-	 * updates NextTrackSector and CurrentTrackSector
+	 * bool to check if at least one tile has been added to the terrain creation queue
+	 * this is used to check if we can spawn the player (i.e. if all tiles that needed to be created at game start have been created and drawn)
 	 */
-	UFUNCTION()
-	FSectorTrackInfo CalculateNewNextTrackSector();
+	UPROPERTY()
+	bool bHasTileBeenAddedToQueue = false;
 
 	/**
-	 * checks if the given sector lies within the quad specified by TopLeftCorner, TopRightCorner, BottomLeftCorner, BottomRightCorner
+	 * counter that keeps track on how many tiles were added to the terrain creation queue and how many tiles are already processed
+	 * used in combination with bHasTileBeenAddedToQueue to check if all initially needed tiles have been created
 	 */
-	UFUNCTION()
-	bool CheckSectorWithinQuad(const FIntVector2D Sector);
+	UPROPERTY()
+	int32 TilesInProcessCounter = 0;
+
+	/**
+	 * bool to make sure only one player gets spawned
+	 */
+	UPROPERTY()
+	int32 RemainingPlayersToSpawn = 1;
+
+	UPROPERTY()
+	AHoverTestGameModeProceduralLevel* GameMode = nullptr;
+
+	/**
+	 * statistics of the tile pool, returned by GetTilePoolStatistics()
+	 */
+	UPROPERTY()
+	FTilePoolStatistics TilePoolStatistics;
+
+	/**
+	 * number of tiles (free and in use) the tile pool tries to hold
+	 * calculated on BeginPlay and raised whenever more tiles are in use at the same time
+	 */
+	UPROPERTY()
+	int32 TilePoolTargetSize = 0;
+
+	/**
+	 * true while the tile pool deletes free tiles to get back to TilePoolTargetSize
+	 */
+	UPROPERTY()
+	bool bIsTilePoolShrinking = false;
 
 	/**
-	 * checks if the given sector can become the new NextTrackSector
+	 * returns a free tile from the tile pool
+	 * grows the pool by TilePoolGrowBatchSize tiles if no free tile is available
+	 * @return The free tile, nullptr if no tile could be created
 	 */
 	UFUNCTION()
-	bool CheckupSector(const FIntVector2D Sector);
+	ATerrainTile* GetTileFromPool();
 
 	/**
-	 * calculates the entry and exit points for the CurrentTrackSector with the given FSectorTrackInfo
+	 * takes a tile from the tile pool, moves it to the given sector and queues a terrain job for it
+	 * @param Sector The sector the tile should cover
+	 * @param bAssociateActor If the associated actor count of the tile should be increased
+	 * @return True if a tile could be assigned to the sector
 	 */
 	UFUNCTION()
-	void CalculateEntryExitPoints(const FSectorTrackInfo TrackInfo, FVector2D& OUTEntryPoint, FVector2D& OUTExitPoint);
+	bool AssignTileToSector(const FIntVector2D Sector, const bool bAssociateActor);
 
 	/**
-	 * adjusts the no-go quad's corner points to include the new CurrentTrackSector
+	 * deletes free tiles that were unused for at least SecondsUntilFreeTileGetsDeleted seconds
+	 * only starts when the pool exceeds its target size by more than TilePoolShrinkHysteresis tiles and stops when the target size is reached
 	 */
 	UFUNCTION()
-	void AdjustQuad();
+	void ShrinkTilePool();
 
 	/**
-	 * creates a FRuntimeMeshVertexSimple struct from the given information
+	 * to be called when a tile is no longer needed by any tracked actor and was removed from TilesInUse
+	 * puts finished tiles into the retention ring, all other tiles get freed and returned to the tile pool
 	 */
-	FRuntimeMeshVertexSimple CreateRuntimeMeshVertexSimple(const FVector Vertex, const FVector Normal) const;
+	UFUNCTION()
+	void ReleaseTile(ATerrainTile* Tile);
 
 	/**
-	 * calculates the TrackExitPoint's elevation for a track in the specified sector
-	 * @param Sector The sector for which the exit point elevation should be calculated
-	 * @param TrackInfo The current sector's track info
-	 * @param OUTExitPointElevation Out parameter that contains the exit point's elevation
-	 * @return True if exit point's elevation could be calculated successfully, false if an error occured
+	 * frees the oldest tile in the retention ring and returns it to the tile pool
 	 */
 	UFUNCTION()
-	bool CalculateTrackExitPointElevation(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, float& OUTExitPointElevation);
+	void EvictOldestRetainedTile();
 
 	/**
-	 * calculates the two control points of the bezier curve for the given sector
-	 * @param Sector The sector to calculate the control points for
-	 * @param TrackEntryPoint The entry point of the track in the current sector, with elevation
-	 * @param OUTControlPointOne Out parameter of the first control point
-	 * @param OUTControlPointTwo Out parameter of the second control point
+	 * removes the retained tile for the given sector from the retention ring
+	 * @return The retained tile, nullptr if no tile is retained for the sector
 	 */
 	UFUNCTION()
-	void CalculateBezierControlPoints(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, FVector& OUTControlPointOne, FVector& OUTControlPointTwo);
+	ATerrainTile* TakeRetainedTile(const FIntVector2D Sector);
 
 	/**
-	 * bool to check if at least one tile has been added to the terrain creation queue
-	 * this is used to check if we can spawn the player (i.e. if all tiles that needed to be created at game start have been created and drawn)
+	 * copies the borders of the retained tiles next to the given sector, so a worker can use them as constraints without touching the retained tiles
 	 */
-	UPROPERTY()
-	bool bHasTileBeenAddedToQueue = false;
+	void GetRetainedTileBorders(const FIntVector2D Sector, TArray<FAdjacentTileBorder>& OUTBorders) const;
 
 	/**
-	 * counter that keeps track on how many tiles were added to the terrain creation queue and how many tiles are already processed
-	 * used in combination with bHasTileBeenAddedToQueue to check if all initially needed tiles have been created
+	 * cache of generated tiles, used to show freed tiles again without generating them
 	 */
-	UPROPERTY()
-	int32 TilesInProcessCounter = 0;
+	FTerrainTileCache TileCache;
 
 	/**
-	 * bool to make sure only one player gets spawned
+	 * hash of the terrain settings, part of the tile cache key
 	 */
-	UPROPERTY()
-	int32 RemainingPlayersToSpawn = 1;
+	uint32 GenerationSettingsHash = 0;
+
+	/**
+	 * persistent cache of generated tiles, read on BeginPlay and written on EndPlay
+	 * only opened if a fixed seed is used
+	 */
+	FTerrainTileDiskCache TileDiskCache;
+
+	/**
+	 * reads the tile of the given sector from the persistent tile cache and creates its track mesh
+	 * @param MinimumGridSize Cached tiles with fewer grid points per edge are ignored
+	 * @return True if the sector was in the persistent tile cache with enough detail and was generated around the sector's current track
+	 */
+	bool LoadTileFromDiskCache(const FIntVector2D Sector, const int32 MinimumGridSize, FCachedTerrainTile& OUTTile);
+
+	// index of the terrain mesh section in FTerrainJob::MeshData, see FDEM::AddTriangleToBuffer
+	static const int32 TerrainMeshSection = 1;
+
+	// index of the track mesh section in FTerrainJob::MeshData
+	static const int32 TrackMeshSection = 0;
+
+	/**
+	 * creates the terrain mesh section and the collision of the given job from its compact terrain, to be called right before the mesh is uploaded
+	 * the quadtrees of both meshes were calculated by the worker, see FCompactTerrainTile::QuadLevels, so only vertices and triangles are created
+	 */
+	void ExpandCompactTerrain(FTerrainJob& Job);
+
+	/**
+	 * builds the terrain mesh section of a tile from its heightfield, with adaptive tessellation if enabled
+	 * @param QuadLevels The quadtree of the adaptive terrain mesh, see FCompactTerrainTile::QuadLevels
+	 */
+	void BuildTerrainMeshData(const FTerrainHeightfield& Heightfield, const TArray<uint8>& QuadLevels, FMeshData& OUTMeshData) const;
+
+	/**
+	 * builds the collision heightfield of a tile's terrain if bHeightfieldTileCollision is set in FTerrainSettings,
+	 * otherwise its low resolution collision mesh if bLowResolutionTileCollision is set
+	 * the terrain mesh section only creates its own collision if there is neither
+	 * @param CollisionQuadLevels The quadtree of the low resolution collision mesh, see FCompactTerrainTile::CollisionQuadLevels
+	 */
+	void BuildTerrainCollision(const FTerrainHeightfield& Heightfield, const TArray<uint8>& CollisionQuadLevels, FMeshData& TerrainMeshData, TArray<FVector>& OUTVertices, TArray<int32>& OUTTriangles, FTerrainCollisionHeightfield& OUTHeightfield);
+
+	/**
+	 * replaces the collision mesh and the collision heightfield of a tile, see BuildTerrainCollision
+	 */
+	void UpdateTileCollision(ATerrainTile* Tile, const TArray<FVector>& Vertices, const TArray<int32>& Triangles, const FTerrainCollisionHeightfield& Heightfield);
+
+	/**
+	 * makes the borders of a finished tile match its adjacent finished tiles by only recalculating a band along every changed border,
+	 * see bIncrementalBorderRegeneration in FTerrainSettings, only the changed vertices of the terrain mesh section are uploaded
+	 * @return False if the tile cannot be changed incrementally and has to be generated again
+	 */
+	bool RegenerateTileBorders(ATerrainTile* Tile);
+
+	// summed size of all compact tiles of generated jobs, used for the average in the tile pool statistics
+	int64 TotalCompactTileBytes = 0;
+
+	// summed size of all expanded terrain mesh sections, used for the average in the tile pool statistics
+	int64 TotalExpandedTileBytes = 0;
+
+	int32 NumberOfExpandedTiles = 0;
+
+	// summed terrain triangles and generation times of generated tiles, used for the averages in the tile pool statistics
+	int64 TotalFullDetailTileTriangles = 0;
+
+	int64 TotalReducedDetailTileTriangles = 0;
+
+	double TotalFullDetailTileGenerationTime = 0.0;
+
+	double TotalReducedDetailTileGenerationTime = 0.0;
+
+	int32 NumberOfFullDetailTiles = 0;
+
+	// summed game time in seconds from queuing a new tile until it showed terrain, used for the average in the tile pool statistics
+	double TotalTimeToFirstTerrain = 0.0;
+
+	int32 NumberOfFirstTerrains = 0;
+
+	// summed triangle reduction in percent and time in ms of adaptive tessellation, used for the averages in the tile pool statistics
+	double TotalAdaptiveTriangleReduction = 0.0;
+
+	double TotalAdaptiveTessellationTime = 0.0;
+
+	// summed average cache miss ratio of the expanded terrain mesh sections, only measured in non shipping builds
+	double TotalTerrainACMR = 0.0;
+
+	int32 NumberOfMeasuredACMRTiles = 0;
+
+	// summed bytes of vertex and index data uploaded to tiles and the number of tile mesh updates, used for the averages in the tile pool statistics
+	int64 TotalUploadedMeshBytes = 0;
+
+	int32 NumberOfMeshUploads = 0;
+
+	// summed triangles, bytes and triangle reduction in percent of low resolution tile collision, used for the averages in the tile pool statistics
+	int64 TotalCollisionTriangles = 0;
+
+	int64 TotalCollisionBytes = 0;
+
+	double TotalCollisionTriangleReduction = 0.0;
+
+	// summed creation time in ms and bytes of collision heightfields, used for the averages in the tile pool statistics
+	double TotalHeightfieldCollisionTime = 0.0;
+
+	int64 TotalHeightfieldCollisionBytes = 0;
+
+	/**
+	 * calculates the number of triangle edge iterations the terrain of the given sector should be generated with
+	 * depends on the distance to the nearest tracked actor, all iterations are used as long as no actor is tracked
+	 */
+	int32 CalculateTileTriangleEdgeIterations(const FIntVector2D Sector) const;
+
+	/**
+	 * queues new terrain jobs for all finished tiles in use whose sector needs more detail than they were generated with
+	 * to be called after tracked actors changed their sector
+	 * tiles never lose detail, since they get freed anyway once they are far enough away
+	 */
+	void RefineTilesAroundTrackedActors();
+
+	/**
+	 * queues a terrain job for the given tile
+	 * if the tile's sector is in the tile cache or the persistent tile cache with enough detail, the cached data is applied to the tile and the job is directly handed to the FinishedJobQueue
+	 * @param Tile The tile to create the terrain for, already moved to its sector
+	 * @param bAllowTileCache If the job may be served from the tile cache
+	 */
+	void EnqueueTerrainJob(ATerrainTile* Tile, const bool bAllowTileCache);
+
+	/**
+	 * moves the compact terrain and track mesh of a finished, generated job into the tile cache and adds it to the persistent tile cache
+	 * cached neighbors that are not in use get removed from both caches, since their borders might not match the newly generated tile
+	 */
+	void AddFinishedJobToTileCache(FTerrainJob& Job);
+
+	/**
+	 * spawns the checkpoint of the tile's sector with the transform from the track planning, if the sector has one and the tile does not have it yet
+	 */
+	void SpawnCheckpointForTile(ATerrainTile* Tile);
 
+	/**
+	 * copies the track info of the job's sector and of the sector before it on the track into the job, so the worker does not need to read TrackMap
+	 */
+	void SetJobTrackInfo(FTerrainJob& Job) const;
+
+	/**
+	 * calculates the hash of the sector's current track, cached tiles are only used if they were generated around the same track
+	 */
+	uint32 CalculateSectorTrackHash(const FIntVector2D Sector) const;
+
+	/**
+	 * mesh of the horizon, every horizon chunk is one mesh section, its vertices are in world space
+	 */
 	UPROPERTY()
-	AHoverTestGameModeProceduralLevel* GameMode = nullptr;
+	URuntimeMeshComponent* HorizonMesh = nullptr;
 
 	/**
-	 * calculates points that lie on the bezier curve defined by the parameters in TrackInfo
-	 * @param Sector The sector for which the bezier curve should be calculated
-	 * @param TrackInfo The track info 
-	 * @param OUTPointsOnBezierCurve Out array containing points that lie on the bezier curve
+	 * very coarse terrain around the tiles, see bUseHorizon in FTerrainSettings
 	 */
-	UFUNCTION()
-	void CalculatePointsOnBezierCurve(const FIntVector2D Sector, const FSectorTrackInfo TrackInfo, TArray<FVector>& OUTPointsOnBezierCurve);
+	FTerrainHorizon Horizon;
 
 	/**
-	 * calculates Y0 and Y1 for last track segment
+	 * arc length index of the track, every sector is added when CalculateTrackPath calculates its track
 	 */
-	UFUNCTION()
-	void CalculateY0Y1(const TArray<FVector>& PointsOnTrack, const float ExitPointElevation, FVector& OUTY0, FVector& OUTY1);
+	FTrackSplineIndex TrackSplineIndex;
+
+	// sector of every checkpoint in TrackMap, by checkpoint ID
+	TMap<int32, FIntVector2D> CheckpointSectors;
+
+	/**
+	 * generates and uploads the horizon around the tracked actors within the per frame budget of FTerrainSettings
+	 */
+	void UpdateHorizon();
+
+	/**
+	 * returns the tile in use that shows terrain in the given sector and whose border vertices are set, nullptr if there is none
+	 */
+	const ATerrainTile* FindFinishedTile(const FIntVector2D Sector) const;
 
 
 
@@ -280,6 +526,16 @@ public:
 	UFUNCTION(BlueprintCallable)
 	FIntVector2D CalculateSectorFromLocation(FVector CurrentWorldLocation);
 
+	/**
+	 * checks if the given location lies outside the given sector extended by SectorChangeHysteresis on each side
+	 * used by tracker components to decide when their actor changed sector
+	 * @param Location The world location to check
+	 * @param Sector The sector the location is currently assigned to
+	 * @return True if the location has left the sector including its hysteresis margin
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool HasLocationLeftSector(const FVector Location, const FIntVector2D Sector) const;
+
 	virtual void BeginDestroy() override;
 
 	/**
@@ -294,7 +550,7 @@ public:
 
 	/**
 	 * calculates all tiles adjacent to the given sector (all neighboring tiles)
-	 * only tiles in use are searched
+	 * only tiles in use are searched, the borders of retained tiles are copied into the terrain job, see FTerrainJob::RetainedTileBorders
 	 * @param Sector The sector for which adjacent tiles should be searched
 	 * @param OUTAdjacentTiles Out parameter containing all tiles adjacent to the given sector
 	 * @param OnlyReturnRelevantTiles If only relevant tiles should be returned. Relevant tiles are only top, bottom, left and right of the given sector.
@@ -312,16 +568,6 @@ public:
 	UFUNCTION()
 	int32 GetTrackPointsForSector(const FIntVector2D Sector, FVector& OUTTrackEntryPoint, FVector& OUTTrackExitPoint);
 
-	/**
-	 * calculates a Bzier curve given by the provided start and end point and two internal created control points
-	 * @param Sector The sector for which the track gets generated, used to update its track sector info
-	 * @param StartPoint The start point of the Bzier curve (the entry point of the track in the tile)
-	 * @param EndPoint The end point of the Bzier curve (the exit point of the track in the tile)
-	 * @param OUTVertexBuffer A vertex buffer where the generated triangle points should be stored
-	 * @param OUTTriangleBuffer A triangle buffer where the generated triangle point order should be stored
-	 */
-	void GenerateTrackMesh(const FIntVector2D Sector, TArray<FRuntimeMeshVertexSimple>& OUTVertexBuffer, TArray<int32>& OUTTriangleBuffer, TArray<FTrackSegment>& OUTTrackSegments);
-
 	/**
 	 * used to recalculate the tile for the given sector
 	 * only recalculates the tile if it was already calculated (i.e. a tile with the given sector is in TilesInUse)
@@ -361,4 +607,48 @@ public:
 
 	UFUNCTION()
 	bool ContainsSectorTrack(const FIntVector2D Sector) const;
+
+	/**
+	 * finds the point on the track horizontally nearest to the given location, e.g. for race progress or resets
+	 * @param Location The location in world space
+	 * @param OUTPoint The nearest point on the track in world space
+	 * @param OUTDistanceAlongTrack Distance along the track from the track's start to the nearest point
+	 * @return False if no track was calculated yet
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool FindNearestPointOnTrack(const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const;
+
+	/**
+	 * calculates the location on the track at the given distance along it, the distance is clamped to the length of the calculated track
+	 * @param DistanceAlongTrack Distance along the track from the track's start
+	 * @param OUTLocation The location on the track in world space
+	 * @param OUTDirection Direction of the track at that location
+	 * @return False if no track was calculated yet
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool GetTrackLocationAtDistance(const float DistanceAlongTrack, FVector& OUTLocation, FVector& OUTDirection) const;
+
+	// length of the track calculated so far
+	UFUNCTION(BlueprintCallable)
+	float GetTrackLength() const;
+
+	/**
+	 * looks up the transform of a checkpoint on the calculated track, the checkpoint's tile does not need to exist
+	 * @return False if no checkpoint with the given ID was calculated yet
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool GetCheckpointTransform(const int32 CheckpointID, FTransform& OUTTransform) const;
+
+	/**
+	 * looks up the player's spawn transform on the start sector's track
+	 * @return False if the start sector was not calculated yet or its track is too short
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool GetPlayerSpawnTransform(FTransform& OUTTransform) const;
+
+	/**
+	 * returns the statistics of the tile pool (pool hits, pool misses, spawned and destroyed tiles)
+	 */
+	UFUNCTION(BlueprintCallable)
+	FTilePoolStatistics GetTilePoolStatistics() const;
 };
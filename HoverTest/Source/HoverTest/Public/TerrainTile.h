@@ -5,12 +5,90 @@
 #include "MyStaticLibrary.h"
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "HAL/ThreadSafeCounter.h"
 #include "TerrainGenerator.h"
 #include "TerrainTile.generated.h"
 
 class URuntimeMeshComponent;
+class UTerrainHeightfieldCollisionComponent;
 class AProceduralCheckpoint;
 
+/**
+ * checksums of the mesh data last uploaded to a mesh section, used to find out which parts of the section changed since then
+ * the vertex buffer is checked in blocks of VertexBlockSize vertices, so only changed blocks have to be uploaded again
+ */
+struct FMeshSectionUploadState
+{
+	static const int32 VertexBlockSize = 256;
+
+	int32 NumVertices = 0;
+
+	int32 NumIndices = 0;
+
+	uint32 TriangleBufferCrc = 0;
+
+	bool b16BitIndices = false;
+
+	bool bCreateCollision = true;
+
+	TArray<uint32> VertexBlockCrcs;
+
+	FMeshSectionUploadState() {}
+
+	FMeshSectionUploadState(const FMeshData& MeshData, const bool bUse16BitIndices)
+	{
+		NumVertices = MeshData.VertexBuffer.Num();
+		NumIndices = MeshData.TriangleBuffer.Num();
+		TriangleBufferCrc = FCrc::MemCrc32(MeshData.TriangleBuffer.GetData(), NumIndices * sizeof(int32));
+		b16BitIndices = bUse16BitIndices;
+		bCreateCollision = MeshData.bCreateCollision;
+		const int32 NumberOfBlocks = (NumVertices + VertexBlockSize - 1) / VertexBlockSize;
+		VertexBlockCrcs.SetNumUninitialized(NumberOfBlocks);
+		for (int32 Block = 0; Block < NumberOfBlocks; ++Block)
+		{
+			const int32 FirstVertex = Block * VertexBlockSize;
+			const int32 BlockVertices = FMath::Min(VertexBlockSize, NumVertices - FirstVertex);
+			VertexBlockCrcs[Block] = FCrc::MemCrc32(&MeshData.VertexBuffer[FirstVertex], BlockVertices * sizeof(FTerrainVertex));
+		}
+	}
+
+	// if true, the section's index buffer does not have to be uploaded again
+	bool HasSameTriangles(const FMeshSectionUploadState& Other) const
+	{
+		return NumVertices == Other.NumVertices && NumIndices == Other.NumIndices && TriangleBufferCrc == Other.TriangleBufferCrc && b16BitIndices == Other.b16BitIndices && bCreateCollision == Other.bCreateCollision;
+	}
+
+	// if true, the section can be updated, otherwise it has to be created again
+	bool CanUpdateSection(const FMeshSectionUploadState& Other) const
+	{
+		return b16BitIndices == Other.b16BitIndices && bCreateCollision == Other.bCreateCollision;
+	}
+
+	/**
+	 * collects the vertex blocks that differ from the previous upload, adjacent blocks are merged into one range
+	 * only valid if HasSameTriangles is true
+	 */
+	void GetChangedVertexRanges(const FMeshSectionUploadState& Previous, TArray<FMeshVertexRange>& OUTRanges) const
+	{
+		OUTRanges.Reset();
+		for (int32 Block = 0; Block < VertexBlockCrcs.Num(); ++Block)
+		{
+			if (Previous.VertexBlockCrcs.IsValidIndex(Block) && Previous.VertexBlockCrcs[Block] == VertexBlockCrcs[Block]) { continue; }
+
+			const int32 FirstVertex = Block * VertexBlockSize;
+			const int32 BlockVertices = FMath::Min(VertexBlockSize, NumVertices - FirstVertex);
+			if (OUTRanges.Num() > 0 && OUTRanges.Last().FirstVertex + OUTRanges.Last().NumVertices == FirstVertex)
+			{
+				OUTRanges.Last().NumVertices += BlockVertices;
+			}
+			else
+			{
+				OUTRanges.Add(FMeshVertexRange(FirstVertex, BlockVertices));
+			}
+		}
+	}
+};
+
 UCLASS()
 class HOVERTEST_API ATerrainTile : public AActor
 {
@@ -40,7 +118,10 @@ public:
 	UFUNCTION()
 	AProceduralCheckpoint* GetCheckpointReference() const;
 
-	// to be called only once directly after terrain tile is created
+	/**
+	 * to be called only once directly after terrain tile is created
+	 * the runtime mesh component is created in the constructor, so this only applies the terrain settings to it
+	 */
 	UFUNCTION()
 	void SetupTile(FTerrainSettings TerrainSettings, FIntVector2D Sector);
 
@@ -54,13 +135,58 @@ public:
 	/**
 	 * called when mesh data should be updated
 	 * unhides the actor
+	 * sections that already exist only get the parts uploaded that changed since their last upload:
+	 * the index buffer is skipped if the triangles did not change, and only changed vertex ranges are written, see FMeshSectionUploadState
+	 * materials are only set if they differ from the section's current material
+	 * @return Number of bytes of vertex and index data that were uploaded
 	 */
 	UFUNCTION()
-	void UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMeshData>& MeshData);
+	int32 UpdateMeshData(FTerrainSettings TerrainSettings, TArray<FMeshData>& MeshData);
+
+	/**
+	 * updates only the given vertices of an existing mesh section, the section's index buffer and material stay as they are
+	 * to be used if the caller knows which vertices changed, UpdateMeshData finds them itself
+	 * @param MeshData The section's complete mesh data with the same triangles as the section, only the vertices in Ranges are written
+	 * @return Number of uploaded bytes, 0 if the section does not exist or has other triangles
+	 */
+	int32 UpdateMeshSectionVertices(const int32 Section, const FMeshData& MeshData, const TArray<FMeshVertexRange>& Ranges);
+
+	/**
+	 * replaces the collision mesh of the tile, which is used in addition to the collision of mesh sections with FMeshData::bCreateCollision
+	 * an empty mesh clears the collision mesh
+	 * @param Vertices Vertices in tile space
+	 */
+	void UpdateCollisionMesh(const TArray<FVector>& Vertices, const TArray<int32>& Triangles);
+
+	/**
+	 * replaces the heightfield collision of the tile, an invalid heightfield removes it
+	 * @return Time in milliseconds needed to create the heightfield
+	 */
+	float UpdateCollisionHeightfield(const FTerrainCollisionHeightfield& Heightfield);
+
+	/**
+	 * keeps the compact terrain the tile's terrain mesh section was built from, so the terrain can be changed later without generating it again
+	 * an invalid compact terrain clears it, e.g. when a new terrain job is queued for the tile
+	 */
+	void SetCompactTerrain(const FCompactTerrainTile& Terrain);
+
+	const FCompactTerrainTile& GetCompactTerrain() const;
 
 	UFUNCTION(BlueprintCallable)
 	FIntVector2D GetCurrentSector() const;
 
+	/**
+	 * to be called when a new terrain job is queued for the tile, all jobs queued before are outdated from now on
+	 * @return The serial of the new job, see FTerrainJob::JobSerial
+	 */
+	int32 BeginTerrainJob();
+
+	/**
+	 * serial of the tile's latest terrain job, jobs with another serial are outdated
+	 * thread safe, so worker threads can drop outdated jobs without reading the tile's state
+	 */
+	int32 GetLatestJobSerial() const;
+
 	UFUNCTION(BlueprintCallable)
 	void AddAssociatedActor();
 
@@ -74,6 +200,23 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void FreeTile();
 
+	/**
+	 * called when no tracked actor needs the tile anymore, but it should be kept for later reuse
+	 * hides the tile ingame and disables its collision and checkpoint, but keeps mesh sections, border vertices and checkpoint
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RetainTile();
+
+	/**
+	 * called when a retained tile is used again
+	 * unhides the tile and enables its collision and checkpoint again
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RestoreRetainedTile();
+
+	UFUNCTION(BlueprintCallable)
+	bool IsTileRetained() const;
+
 	// returns time in seconds since the tile was freed
 	UFUNCTION(BlueprintCallable)
 	float GetTimeSinceTileFreed() const;
@@ -150,12 +293,45 @@ public:
 	UFUNCTION()
 	void SetTopLeftCorner(const FVector Vertex);
 
+	/**
+	 * copies the border vertices the tile shares with the given sector and the tile's corners
+	 * @param Sector The sector on top of, below, left or right of the tile
+	 * @return False if the sector is not next to the tile or the tile's border vertices are not set yet
+	 */
+	bool GetBorderToSector(const FIntVector2D Sector, FAdjacentTileBorder& OUTBorder) const;
+
+	/**
+	 * sets the number of triangle edge iterations of the latest terrain job queued for this tile
+	 */
+	UFUNCTION()
+	void SetTriangleEdgeIterations(const int32 Iterations);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetTriangleEdgeIterations() const;
+
 private:
+	/**
+	 * creates or updates a mesh section, with 16 bit indices if all of the section's vertices can be addressed with them
+	 * the index type and collision of a section are fixed when the section is created, so an existing section where they change is created again
+	 * @return Number of uploaded bytes
+	 */
+	int32 UploadMeshSection(const int32 Section, const FMeshData& MeshData, const bool bSectionExists);
+
+	/**
+	 * writes the given vertices of an existing mesh section with the section updater of the runtime mesh component
+	 * @return Number of written vertices
+	 */
+	int32 WriteMeshSectionVertices(const int32 Section, const FMeshData& MeshData, const TArray<FMeshVertexRange>& Ranges);
+
 
 	// component that is responsible for rendering the terrain
 	UPROPERTY()
 	URuntimeMeshComponent* RuntimeMesh = nullptr;
 
+	// collision of the terrain if bHeightfieldTileCollision is set, see FTerrainSettings
+	UPROPERTY()
+	UTerrainHeightfieldCollisionComponent* HeightfieldCollision = nullptr;
+
 
 	// represents the state of the tile
 	UPROPERTY()
@@ -164,6 +340,9 @@ private:
 	// is the tile initialized
 	bool bIsInitialized = false;
 
+	// is the tile currently kept in the terrain manager's retention ring
+	bool bIsRetained = false;
+
 	/**
 	 * the sector the tile is currently located in
 	 * a sector has the same size as a tile but has a fixed position, whereas tiles can be moved around (i.e. tiles can be moved to different sectors)
@@ -171,6 +350,9 @@ private:
 	UPROPERTY()
 	FIntVector2D CurrentSector;
 
+	// serial of the latest terrain job queued for the tile, increased when the tile is freed as well
+	FThreadSafeCounter LatestJobSerial;
+
 	/**
 	 * number of actors that are associated with this tile (i.e. actors that this tile is relevant for)
 	 * if this number is zero, the tile can be freed
@@ -184,6 +366,12 @@ private:
 	UPROPERTY()
 	TArray<int32> MeshSectionsCreated;
 
+	// checksums of the last upload of every created mesh section
+	TMap<int32, FMeshSectionUploadState> UploadedMeshSections;
+
+	// does the runtime mesh component have a collision mesh set by UpdateCollisionMesh
+	bool bHasCollisionMesh = false;
+
 	// all vertices on the left border of the tile
 	UPROPERTY()
 	TArray<FBorderVertex> VerticesLeftBorder;
@@ -218,4 +406,12 @@ private:
 	// corner vertices of the terrain mesh
 	UPROPERTY()
 	FVector TopLeftCorner;
+
+	// number of triangle edge iterations the tile's terrain is (or is being) generated with, 0 if the tile has no terrain
+	UPROPERTY()
+	int32 TriangleEdgeIterations = 0;
+
+	// compact terrain the terrain mesh section was built from, invalid while a new terrain job is pending
+	UPROPERTY()
+	FCompactTerrainTile CompactTerrain;
 };
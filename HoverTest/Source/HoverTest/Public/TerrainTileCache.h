@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+#include "TerrainGenerator.h"
+#include "TerrainHeightfield.h"
+#include "TerrainTileCache.generated.h"
+
+/**
+ * everything that is needed to show a generated tile again without running the terrain generation
+ */
+USTRUCT()
+struct FCachedTerrainTile
+{
+	GENERATED_USTRUCT_BODY()
+
+	// mesh data of all mesh sections except the terrain section, which is stored compact in Terrain
+	UPROPERTY()
+	TArray<FMeshData> MeshData;
+
+	// the terrain, the terrain mesh section and the border vertices are created from it
+	UPROPERTY()
+	FCompactTerrainTile Terrain;
+
+	UPROPERTY()
+	FVector BottomLeftCorner;
+
+	UPROPERTY()
+	FVector BottomRightCorner;
+
+	UPROPERTY()
+	FVector TopRightCorner;
+
+	UPROPERTY()
+	FVector TopLeftCorner;
+
+	// hash of the track the terrain was carved around, see FSectorTrackInfo::CalculateTrackHash, 0 if the sector has no track
+	uint32 TrackHash = 0;
+
+	// value of the cache's access counter when the entry was last used, used to find the least recently used entry
+	uint64 LastAccess = 0;
+
+	/**
+	 * calculates the memory used by this entry in bytes
+	 */
+	int64 GetAllocatedSize() const
+	{
+		int64 Size = sizeof(FCachedTerrainTile) + MeshData.GetAllocatedSize();
+		for (const FMeshData& Data : MeshData)
+		{
+			Size += Data.VertexBuffer.GetAllocatedSize() + Data.TriangleBuffer.GetAllocatedSize();
+		}
+		Size += Terrain.GetAllocatedSize() - sizeof(FCompactTerrainTile);
+		return Size;
+	}
+};
+
+/**
+ * key of a cached tile
+ * tiles are only valid for the settings they were generated with, so the settings hash is part of the key
+ */
+struct FTerrainTileCacheKey
+{
+	FIntVector2D Sector;
+
+	uint32 SettingsHash = 0;
+
+	FTerrainTileCacheKey() {}
+
+	FTerrainTileCacheKey(const FIntVector2D InSector, const uint32 InSettingsHash)
+		: Sector(InSector), SettingsHash(InSettingsHash)
+	{}
+
+	bool operator==(const FTerrainTileCacheKey& Other) const
+	{
+		return Sector == Other.Sector && SettingsHash == Other.SettingsHash;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FTerrainTileCacheKey& Key)
+	{
+		return HashCombine(GetTypeHash(Key.Sector), Key.SettingsHash);
+	}
+};
+
+/**
+ * least recently used cache of generated tiles with a memory budget
+ * only to be used from the game thread
+ */
+class HOVERTEST_API FTerrainTileCache
+{
+public:
+	/**
+	 * sets the memory budget of the cache and evicts entries until the cache fits into it
+	 * @param BudgetInBytes Memory budget in bytes, 0 disables the cache
+	 */
+	void SetBudget(const int64 BudgetInBytes);
+
+	/**
+	 * adds the tile to the cache, replacing an existing entry with the same key
+	 * evicts least recently used entries until the cache fits into its budget
+	 */
+	void Add(const FTerrainTileCacheKey& Key, FCachedTerrainTile&& Tile);
+
+	/**
+	 * returns the cached tile for the given key and marks it as most recently used
+	 * @return Pointer to the cached tile, nullptr if the key is not cached. Only valid until the cache is modified.
+	 */
+	const FCachedTerrainTile* Find(const FTerrainTileCacheKey& Key);
+
+	/**
+	 * removes the cached tile for the given key, if existent
+	 */
+	void Remove(const FTerrainTileCacheKey& Key);
+
+	// removes all cached tiles
+	void Empty();
+
+	int32 Num() const;
+
+	// memory used by all cached tiles in bytes
+	int64 GetUsedBytes() const;
+
+	int32 GetHits() const;
+
+	int32 GetMisses() const;
+
+private:
+	// evicts least recently used entries until the cache fits into its budget
+	void EvictToBudget();
+
+	TMap<FTerrainTileCacheKey, FCachedTerrainTile> Entries;
+
+	// memory budget in bytes
+	int64 Budget = 0;
+
+	// memory used by all entries in bytes
+	int64 UsedBytes = 0;
+
+	// incremented on every access, used as timestamp for the least recently used order
+	uint64 AccessCounter = 0;
+
+	int32 Hits = 0;
+
+	int32 Misses = 0;
+};
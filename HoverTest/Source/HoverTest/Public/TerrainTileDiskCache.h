@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+#include "TerrainTileCache.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * persistent cache of generated tiles in a binary file, so a session with the same seed and settings does not have to generate them again
+ *
+ * file layout (little endian, every block 8 byte aligned):
+ *	header:	magic, version, seed, settings hash, number of tiles
+ *	index:	sector and offset / size of the tile's block for every tile
+ *	blocks:	per tile a header (grid size, unit size, height quantization, data sizes, track hash, corners) followed by the arrays of the tile's FCompactTerrainTile, including its quad levels
+ *
+ * the file is memory mapped and tiles are copied directly from the mapped blocks
+ * tiles added during the session are kept encoded in memory and written together with the still valid tiles of the file in Save
+ * only to be used from the game thread
+ */
+class HOVERTEST_API FTerrainTileDiskCache
+{
+public:
+	~FTerrainTileDiskCache();
+
+	/**
+	 * maps the given cache file and reads its index
+	 * a missing file, an old version or a file of another seed or other settings is treated as an empty cache and gets replaced in Save
+	 * @param InFilename The cache file
+	 * @param InSeed The seed tiles are generated with
+	 * @param InSettingsHash The hash of the settings tiles are generated with, see FTerrainSettings::CalculateGenerationSettingsHash
+	 */
+	void Open(const FString& InFilename, const int32 InSeed, const uint32 InSettingsHash);
+
+	/**
+	 * writes all valid tiles to the cache file, the file is replaced only after the new one was written completely
+	 * @return True if the file was written or nothing had changed
+	 */
+	bool Save();
+
+	// unmaps the cache file and forgets all tiles
+	void Close();
+
+	bool IsOpen() const;
+
+	/**
+	 * reads the tile of the given sector
+	 * fills the compact terrain, the track hash and the corners of OUTTile, the mesh sections are left empty
+	 * a tile that was carved around another track than the current one is removed from the cache
+	 * @param TrackHash Hash of the sector's current track, see FSectorTrackInfo::CalculateTrackHash
+	 * @return True if the sector was cached with the given track
+	 */
+	bool Find(const FIntVector2D Sector, const uint32 TrackHash, FCachedTerrainTile& OUTTile);
+
+	/**
+	 * stores the compact terrain, the track hash and the corners of the given tile until the next Save, replacing an existing entry of the sector
+	 */
+	void Add(const FIntVector2D Sector, const FCachedTerrainTile& Tile);
+
+	/**
+	 * removes the tile of the given sector, if existent
+	 */
+	void Remove(const FIntVector2D Sector);
+
+	int32 Num() const;
+
+	int32 GetHits() const;
+
+private:
+	/**
+	 * position of a tile's block inside the cache file
+	 */
+	struct FBlockLocation
+	{
+		int64 Offset = 0;
+		int64 Size = 0;
+	};
+
+	// returns the tile's block in the cache file or in the tiles added this session, nullptr if the sector is not cached
+	const uint8* FindBlock(const FIntVector2D Sector, int64& OUTSize) const;
+
+	static bool WriteBlock(const FCachedTerrainTile& Tile, TArray<uint8>& OUTBlock);
+
+	static bool ReadBlock(const uint8* Block, const int64 BlockSize, FCachedTerrainTile& OUTTile);
+
+	FString Filename;
+
+	int32 Seed = 0;
+
+	uint32 SettingsHash = 0;
+
+	bool bIsOpen = false;
+
+	// true if tiles were added or removed since the file was opened
+	bool bIsDirty = false;
+
+	IMappedFileHandle* MappedFileHandle = nullptr;
+
+	IMappedFileRegion* MappedFileRegion = nullptr;
+
+	// file content if the platform does not support memory mapping
+	TArray<uint8> LoadedFile;
+
+	// start of the cache file's content, either mapped or loaded
+	const uint8* FileData = nullptr;
+
+	int64 FileSize = 0;
+
+	// valid tiles of the cache file
+	TMap<FIntVector2D, FBlockLocation> FileIndex;
+
+	// encoded tiles added this session
+	TMap<FIntVector2D, TArray<uint8>> AddedBlocks;
+
+	int32 Hits = 0;
+};
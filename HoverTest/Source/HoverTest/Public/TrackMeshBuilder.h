@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+
+/**
+ * everything the track mesh of one sector results in
+ */
+struct FTrackMeshBuildResult
+{
+	TArray<FTerrainVertex> Vertices;
+
+	TArray<int32> Triangles;
+
+	// track segments the terrain of the sector is constrained with
+	TArray<FTrackSegment> TrackSegments;
+};
+
+/**
+ * builds the track mesh of a sector from its planned track info
+ * the builder only reads its own copy of the terrain settings and the track infos it is given, so any number of worker threads can use it at the same time
+ * checkpoints and the player spawn are not part of the mesh, their transforms are calculated when the track is planned
+ */
+class HOVERTEST_API FTrackMeshBuilder
+{
+public:
+	void Initialize(const FTerrainSettings& InSettings);
+
+	/**
+	 * builds the track mesh and the track segments of the given sector
+	 * @param Sector The sector to build the track for
+	 * @param TrackInfo The sector's track info, has to have a track
+	 * @param PreviousTrackInfo Track info of the sector before it on the track, its border points at the exit are the entry border points of the sector
+	 * @param OUTResult The built track
+	 */
+	void Build(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FTrackMeshBuildResult& OUTResult) const;
+
+	/**
+	 * plans Sectors sectors of track and builds the track mesh of each of them, logs the time per sector
+	 * to be called with the console command HoverTest.BenchmarkTrackMeshBuilder [Sectors]
+	 */
+	static void RunBenchmark(const TArray<FString>& Args);
+
+private:
+	FTerrainSettings TerrainSettings;
+};
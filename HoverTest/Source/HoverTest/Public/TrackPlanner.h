@@ -0,0 +1,266 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Runtime/Core/Public/HAL/Runnable.h"
+#include "Runtime/Core/Public/Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "MyStaticLibrary.h"
+
+/**
+ * sparse set of sectors stored as bits, every 8 x 8 sectors share one 64 bit word
+ * a lookup is a single hash lookup of the word and a bit test, much cheaper than a lookup in a map of FSectorTrackInfo
+ */
+struct FSectorBitmap
+{
+	void Add(const FIntVector2D Sector)
+	{
+		Words.FindOrAdd(GetWordKey(Sector)) |= GetBit(Sector);
+	}
+
+	bool Contains(const FIntVector2D Sector) const
+	{
+		const uint64* Word = Words.Find(GetWordKey(Sector));
+		return Word && (*Word & GetBit(Sector)) != 0;
+	}
+
+	void Reset()
+	{
+		Words.Reset();
+	}
+
+private:
+	static FIntVector2D GetWordKey(const FIntVector2D Sector)
+	{
+		// arithmetic shift, so negative sectors are rounded down as well
+		return FIntVector2D(Sector.X >> 3, Sector.Y >> 3);
+	}
+
+	static uint64 GetBit(const FIntVector2D Sector)
+	{
+		return uint64(1) << (((Sector.X & 7) << 3) | (Sector.Y & 7));
+	}
+
+	TMap<FIntVector2D, uint64> Words;
+};
+
+/**
+ * everything the track planning needs to continue the track after the last planned sector
+ */
+struct FTrackPlannerState
+{
+	/**
+	 * the following 4 points define a quad that restricts the area, where new track parts can be created
+	 * i.e. NextTrackSector cannot be located in the defined quad
+	 * in the comments, this quad is often refered to as 'no-go quad'
+	 */
+	FIntVector2D TopLeftCorner;
+	FIntVector2D TopRightCorner;
+	FIntVector2D BottomLeftCorner;
+	FIntVector2D BottomRightCorner;
+
+	// the sector where the next track segment should be created (not yet created)
+	FIntVector2D NextTrackSector;
+
+	// the sector where the current last track segment is located (already created)
+	FIntVector2D CurrentTrackSector;
+
+	// track info of CurrentTrackSector, the previous sector of the next planned sector
+	FSectorTrackInfo CurrentTrackInfo;
+
+	/**
+	 * stream all random decisions of the track planning are drawn from
+	 * the track is planned once per sector in the order the track is extended, so the same seed always results in the same track
+	 */
+	FRandomStream TrackRandomStream;
+
+	// next available check point ID
+	uint32 NextAvailableCheckPointID = 1;
+
+	// number of sectors planned so far, including sectors where the track ended
+	int32 PlannedSectors = 0;
+};
+
+/**
+ * a planned track sector together with the planner's state after it
+ */
+struct FPlannedTrackSector
+{
+	FIntVector2D Sector;
+
+	// track info of the sector, has no track if the track ended in the sector
+	FSectorTrackInfo TrackInfo;
+
+	// the planner's state after planning the sector
+	FTrackPlannerState State;
+
+	// restart of the planning the sector belongs to, sectors of older restarts are outdated
+	int32 Generation = 0;
+};
+
+/**
+ * tells the planning thread to discard its planned sectors and to continue from the given state
+ */
+struct FTrackPlanningRestart
+{
+	int32 Generation = 0;
+
+	FTrackPlannerState State;
+
+	// sectors the track must not enter besides the no-go quad
+	FSectorBitmap BlockedSectors;
+};
+
+/**
+ * plans the track sector by sector: chooses the following sector, the entry and exit points, the bezier curve and the track's border points at the exit
+ * the planner has no state of its own, so the same state and blocked sectors always result in the same planned sector, no matter which thread plans it
+ */
+class HOVERTEST_API FTrackPlanner
+{
+public:
+	void Initialize(const FTerrainSettings& InSettings);
+
+	/**
+	 * plans the track of State.NextTrackSector and chooses the sector after it
+	 * @param State The planner's state, advanced past the planned sector
+	 * @param BlockedSectors Sectors the track must not enter besides the no-go quad, i.e. sectors whose tiles were created without track
+	 * @param OUTPlannedSector The planned sector, its track info and the advanced state
+	 * @return False if no sector after the planned one could be determined and the track ends
+	 */
+	bool PlanNextSector(FTrackPlannerState& State, const FSectorBitmap& BlockedSectors, FPlannedTrackSector& OUTPlannedSector) const;
+
+	/**
+	 * chooses the following sector of Sectors sectors, with sectors next to the track randomly blocked like tiles without track, and logs the time per sector and the dead ends
+	 * to be called with the console command HoverTest.BenchmarkTrackPlanner [Sectors] [BlockedSectorProbability]
+	 */
+	static void RunBenchmark(const TArray<FString>& Args);
+
+private:
+	/**
+	 * calculates the new NextTrackSector
+	 * updates NextTrackSector and CurrentTrackSector
+	 */
+	FSectorTrackInfo CalculateNewNextTrackSector(FTrackPlannerState& State, const FSectorBitmap& BlockedSectors) const;
+
+	/**
+	 * measures how far the track can continue from the given sector without entering the no-go quad or a blocked sector
+	 * the quad grows with every sector of the continuation, the same way AdjustQuad grows it
+	 * the search is depth first and stops as soon as a continuation of Depth sectors is found, so it usually probes only about Depth sectors
+	 * @param QuadMin Smallest X and Y of the no-go quad before the sector is added
+	 * @param QuadMax Largest X and Y of the no-go quad before the sector is added
+	 * @return Length of the longest continuation found, at most Depth
+	 */
+	static int32 MeasureContinuation(const FSectorBitmap& BlockedSectors, const FIntVector2D Sector, FIntVector2D QuadMin, FIntVector2D QuadMax, const int32 Depth);
+
+	/**
+	 * checks if the given sector lies within the quad specified by TopLeftCorner, TopRightCorner, BottomLeftCorner, BottomRightCorner
+	 */
+	bool CheckSectorWithinQuad(const FTrackPlannerState& State, const FIntVector2D Sector) const;
+
+	/**
+	 * checks if the given sector can become the new NextTrackSector
+	 */
+	bool CheckupSector(const FTrackPlannerState& State, const FSectorBitmap& BlockedSectors, const FIntVector2D Sector) const;
+
+	/**
+	 * calculates the entry and exit points for the CurrentTrackSector with the given FSectorTrackInfo
+	 */
+	void CalculateEntryExitPoints(const FTrackPlannerState& State, const FSectorTrackInfo& TrackInfo, FVector2D& OUTEntryPoint, FVector2D& OUTExitPoint) const;
+
+	/**
+	 * adjusts the no-go quad's corner points to include the new CurrentTrackSector
+	 */
+	void AdjustQuad(FTrackPlannerState& State) const;
+
+	/**
+	 * calculates the TrackExitPoint's elevation for a track in the specified sector
+	 * @param Sector The sector for which the exit point elevation should be calculated
+	 * @param PreviousTrackInfo The previous sector's track info
+	 * @param OUTExitPointElevation Out parameter that contains the exit point's elevation
+	 */
+	void CalculateTrackExitPointElevation(FTrackPlannerState& State, const FIntVector2D Sector, const FSectorTrackInfo& PreviousTrackInfo, float& OUTExitPointElevation) const;
+
+	/**
+	 * calculates the two control points of the bezier curve for the given sector
+	 * @param Sector The sector to calculate the control points for
+	 * @param TrackInfo The sector's track info with entry and exit points
+	 * @param PreviousTrackInfo The previous sector's track info
+	 * @param OUTControlPointOne Out parameter of the first control point
+	 * @param OUTControlPointTwo Out parameter of the second control point
+	 */
+	void CalculateBezierControlPoints(FTrackPlannerState& State, const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FVector& OUTControlPointOne, FVector& OUTControlPointTwo) const;
+
+	/**
+	 * calculates points that lie on the bezier curve defined by the parameters in TrackInfo
+	 * @param Sector The sector for which the bezier curve should be calculated
+	 * @param TrackInfo The track info
+	 * @param PreviousTrackInfo The previous sector's track info
+	 * @param OUTPointsOnBezierCurve Out array containing points that lie on the bezier curve
+	 */
+	void CalculatePointsOnBezierCurve(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, TArray<FVector>& OUTPointsOnBezierCurve) const;
+
+	/**
+	 * gets the start point, the control points and the end point of the sector's bezier curve
+	 */
+	void GetBezierPoints(const FIntVector2D Sector, const FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo, FVector OUTBezierPoints[4]) const;
+
+	/**
+	 * calculates the transforms of the sector's checkpoint and of the player's spawn
+	 * the player spawn is evaluated on the bezier curve where even sampling by TrackResolution put TrackSegmentToSpawnPlayerAt, so it does not depend on bAdaptiveTrackSampling
+	 * @param Sector The sector the track info belongs to
+	 * @param TrackInfo Track info with the points on the bezier curve, gets the transforms
+	 * @param PreviousTrackInfo The previous sector's track info
+	 */
+	void CalculateSpawnTransforms(const FIntVector2D Sector, FSectorTrackInfo& TrackInfo, const FSectorTrackInfo& PreviousTrackInfo) const;
+
+	/**
+	 * calculates Y0 and Y1 for last track segment
+	 * both points are placed exactly on the exit border, the following sector starts its track with the very same points
+	 * @param ExitBorder The border of the sector the track leaves it through
+	 */
+	void CalculateY0Y1(const TArray<FVector>& PointsOnTrack, const float ExitPointElevation, const ETileBorder ExitBorder, FVector& OUTY0, FVector& OUTY1) const;
+
+	FTerrainSettings TerrainSettings;
+};
+
+/**
+ * plans the track ahead of the game thread, up to TrackPlanningLookahead sectors after the last sector the game thread took
+ * planned sectors are handed to the game thread through a lock free queue, restarts are received through another one
+ */
+class HOVERTEST_API FTrackPlanningWorker : public FRunnable
+{
+public:
+	FTrackPlanningWorker(const FTerrainSettings& Settings, TQueue<FTrackPlanningRestart, EQueueMode::Spsc>* InRestartQueue, TQueue<FPlannedTrackSector, EQueueMode::Spsc>* InPlannedQueue, FThreadSafeCounter* InTakenSectors);
+
+	virtual bool Init();
+	virtual uint32 Run();
+	virtual void Stop();
+	virtual void Exit();
+
+private:
+	FTrackPlanner Planner;
+
+	TQueue<FTrackPlanningRestart, EQueueMode::Spsc>* RestartQueue;
+
+	TQueue<FPlannedTrackSector, EQueueMode::Spsc>* PlannedQueue;
+
+	// number of planned sectors the game thread took, see FTrackPlannerState::PlannedSectors
+	FThreadSafeCounter* TakenSectors;
+
+	int32 Lookahead = 0;
+
+	// state of the last restart, advanced with every planned sector
+	FTrackPlannerState State;
+
+	FSectorBitmap BlockedSectors;
+
+	int32 Generation = 0;
+
+	// false until the first restart arrived or after the track ended
+	bool bCanPlan = false;
+
+	// set by the game thread in Stop
+	FThreadSafeBool IsThreadFinished = false;
+};
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyStaticLibrary.h"
+
+/**
+ * arc length index of the whole track, used for race progress, resets and AI
+ * sectors are added in track order while the track path is calculated, every sector stores its points on the track in world space together with their distance along the track
+ * distance queries are binary searches over the sectors and their points, nearest point queries only look at the sectors around the location
+ * only to be used from the game thread
+ */
+class HOVERTEST_API FTrackSplineIndex
+{
+public:
+	void Initialize(const float InTileEdgeSize);
+
+	/**
+	 * appends the track of the given sector to the index
+	 * @param Sector The sector, has to be the sector that follows the last added sector on the track
+	 * @param PointsOnTrack The points on the sector's track, relative to the sector
+	 */
+	void AddSector(const FIntVector2D Sector, const TArray<FVector>& PointsOnTrack);
+
+	/**
+	 * finds the point on the track horizontally nearest to the given location
+	 * sectors are searched in rings around the location's sector until no sector of the next ring can contain a nearer point
+	 * @param Location The location in world space
+	 * @param OUTPoint The nearest point on the track
+	 * @param OUTDistanceAlongTrack Distance along the track from the track's start to the nearest point
+	 * @return False if the index is empty
+	 */
+	bool FindNearestPoint(const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const;
+
+	/**
+	 * calculates the location on the track at the given distance along it, the distance is clamped to the length of the track
+	 * @param DistanceAlongTrack Distance along the track from the track's start
+	 * @param OUTLocation The location on the track in world space
+	 * @param OUTDirection Direction of the track at that location
+	 * @return False if the index is empty
+	 */
+	bool GetLocationAtDistance(const float DistanceAlongTrack, FVector& OUTLocation, FVector& OUTDirection) const;
+
+	// length of the track of all added sectors
+	float GetTrackLength() const;
+
+	int32 NumSectors() const;
+
+private:
+	/**
+	 * the track of one sector
+	 */
+	struct FTrackSplineSector
+	{
+		FIntVector2D Sector;
+
+		// distance along the track at the sector's first point
+		float StartDistance = 0.f;
+
+		// points on the track in world space
+		TArray<FVector> Points;
+
+		// distance along the track of every point, measured from the sector's first point
+		TArray<float> Distances;
+	};
+
+	/**
+	 * finds the point of the sector's track nearest to the given location, the points of a sector are searched linearly since a sector only has a few dozen of them
+	 * @return Squared distance between the location and the nearest point
+	 */
+	float FindNearestPointInSector(const FTrackSplineSector& SplineSector, const FVector Location, FVector& OUTPoint, float& OUTDistanceAlongTrack) const;
+
+	float TileEdgeSize = 0.f;
+
+	// sectors in track order
+	TArray<FTrackSplineSector> Sectors;
+
+	// index into Sectors of every sector with track
+	TMap<FIntVector2D, int32> SectorIndices;
+
+	// bounds of all sectors with track, limits the ring search of FindNearestPoint
+	FIntVector2D MinSector;
+	FIntVector2D MaxSector;
+};